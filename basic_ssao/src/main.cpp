@@ -798,6 +798,9 @@ int main()
         const Mat4 &proj = camera.getProjectionMatrix();
         const Mat4 &mvp = proj * view;
 
+        Frustum frustum;
+        frustum.extractFromMatrix(mvp);
+
         const Mat4 ortho = Mat4::Ortho(0.0f, (float)screenWidth, (float)screenHeight, 0.0f, -1.0f, 1.0f);
 
         driver.SetCulling(CullMode::Back);
@@ -822,13 +825,13 @@ int main()
         // Render plane
         Mat4 model;// = Mat4::Translation(0.0f, -0.5f, 0.0f) * Mat4::Scale(5.0f, 1.0f, 5.0f);
         ssao.gemetry->SetUniformMat4("uModel", model.m);
-        driver.DrawMesh(room);
+        driver.DrawMesh(room, frustum, model);
         // Render cubes
         for (int i = 0; i < 10; i++)
         {
             model = Mat4::Translation(cubePositions[i]);
             ssao.gemetry->SetUniformMat4("uModel", model.m);
-            driver.DrawMesh(cube);
+            driver.DrawMesh(cube, frustum, model);
         }
 
         // === 2. SSAO PASS ===
@@ -971,7 +974,7 @@ int main()
         //stas 
         int y = screenHeight - 40;
         font.Print(10,y,"Tris: %d Vertices: %d", driver.GetCountTriangle(), driver.GetCountVertex());
-        font.Print(10,y - 20,"Draw Calls: %d Meshes: %d MeshBuffers: %d", driver.GetCountDrawCall(),driver.GetCountMesh(),driver.GetCountMeshBuffer());
+        font.Print(10,y - 20,"Draw Calls: %d Meshes: %d MeshBuffers: %d (culled %d)", driver.GetCountDrawCall(),driver.GetCountMesh(),driver.GetCountMeshBuffer(),driver.GetCountCulledMeshBuffer());
         font.Print(10,y - 40,"Textures: %d Programs: %d", driver.GetCountTextures(),driver.GetCountPrograms());
 
 
@@ -0,0 +1,233 @@
+#pragma once
+
+#include "Config.hpp"
+#include "Math.hpp"
+#include "Triangle.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+// ==================== BVH ====================
+// Hierarquia de caixas sobre os triangulos do CollisionSystem.
+// Build top-down com SAH em bins (BVH_BINS por eixo); os ramos de cima sao
+// partidos em serie e as subarvores construidas em paralelo no JobSystem.
+// Os nodes ficam num array plano, 32 bytes cada, e os dois filhos de um
+// node interior lado a lado. As folhas apontam para indices, os triangulos
+// ficam na ordem do CollisionSystem
+
+const u32 BVH_BINS = 16;
+const u32 BVH_MAX_LEAF = 8;    // folha forcada acima disto so sem split valido
+const u32 BVH_STACK_SIZE = 64; // profundidade maxima da travessia
+
+struct BVHNode
+{
+    Vec3 min;
+    u32 first; // folha: primeiro em indices; interior: filho esquerdo (o direito e first + 1)
+    Vec3 max;
+    u32 count; // triangulos da folha, 0 = interior
+
+    bool isLeaf() const { return count > 0; }
+};
+
+class BVH
+{
+public:
+    void build(const std::vector<Triangle> &triangles);
+    void clear();
+
+    bool isEmpty() const { return nodes.empty(); }
+    u32 getNodeCount() const { return (u32)nodes.size(); }
+    const std::vector<BVHNode> &getNodes() const { return nodes; }
+    const std::vector<u32> &getIndices() const { return indices; }
+
+    // fn(index) para cada triangulo cuja folha toca a caixa [boxMin, boxMax]
+    template <typename Func>
+    void queryBox(const Vec3 &boxMin, const Vec3 &boxMax, Func &&fn) const;
+
+    // fn(first, count) por folha: posicoes em getIndices(), para dados
+    // guardados na ordem das folhas
+    template <typename Func>
+    void queryLeaves(const Vec3 &boxMin, const Vec3 &boxMax, Func &&fn) const;
+
+    // fn(index, tMax) para os triangulos das folhas que o ray atravessa
+    // antes de tMax, o filho mais perto primeiro. fn pode baixar tMax
+    // (closest hit) e os nodes mais longe deixam de ser visitados
+    template <typename Func>
+    void queryRay(const Vec3 &origin, const Vec3 &direction, float tMax, Func &&fn) const;
+
+    // fn(first, count, tMax) por folha, como o queryLeaves, para um volume
+    // que anda de origin ate origin + direction * tMax: os nodes crescem
+    // extent por eixo e sao visitados por ordem de entrada. fn pode baixar
+    // tMax (em unidades de direction) e os mais longe deixam de contar
+    template <typename Func>
+    void querySweep(const Vec3 &origin, const Vec3 &direction, const Vec3 &extent, float tMax, Func &&fn) const;
+
+private:
+    std::vector<BVHNode> nodes;
+    std::vector<u32> indices;
+
+    static bool overlaps(const BVHNode &node, const Vec3 &boxMin, const Vec3 &boxMax)
+    {
+        return node.min.x <= boxMax.x && node.max.x >= boxMin.x && node.min.y <= boxMax.y &&
+               node.max.y >= boxMin.y && node.min.z <= boxMax.z && node.max.z >= boxMin.z;
+    }
+
+    // Slab test; devolve a entrada no node ou FLT_MAX se falha. extent
+    // alarga a caixa em cada eixo (sweeps)
+    static float intersect(const BVHNode &node, const Vec3 &origin, const Vec3 &invDirection, float tMax,
+                           const float *extent = nullptr)
+    {
+        const float ex = extent ? extent[0] : 0.0f, ey = extent ? extent[1] : 0.0f, ez = extent ? extent[2] : 0.0f;
+        float tx1 = (node.min.x - ex - origin.x) * invDirection.x, tx2 = (node.max.x + ex - origin.x) * invDirection.x;
+        float tNear = std::fmin(tx1, tx2), tFar = std::fmax(tx1, tx2);
+        float ty1 = (node.min.y - ey - origin.y) * invDirection.y, ty2 = (node.max.y + ey - origin.y) * invDirection.y;
+        tNear = std::fmax(tNear, std::fmin(ty1, ty2));
+        tFar = std::fmin(tFar, std::fmax(ty1, ty2));
+        float tz1 = (node.min.z - ez - origin.z) * invDirection.z, tz2 = (node.max.z + ez - origin.z) * invDirection.z;
+        tNear = std::fmax(tNear, std::fmin(tz1, tz2));
+        tFar = std::fmin(tFar, std::fmax(tz1, tz2));
+        return (tFar >= tNear && tFar >= 0.0f && tNear <= tMax) ? tNear : FLT_MAX;
+    }
+};
+
+template <typename Func>
+void BVH::queryBox(const Vec3 &boxMin, const Vec3 &boxMax, Func &&fn) const
+{
+    queryLeaves(boxMin, boxMax,
+                [&](u32 first, u32 count)
+                {
+                    for (u32 i = first; i < first + count; i++)
+                        fn(indices[i]);
+                });
+}
+
+template <typename Func>
+void BVH::queryLeaves(const Vec3 &boxMin, const Vec3 &boxMax, Func &&fn) const
+{
+    if (nodes.empty() || !overlaps(nodes[0], boxMin, boxMax))
+        return;
+
+    u32 stack[BVH_STACK_SIZE];
+    u32 top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const BVHNode &node = nodes[stack[--top]];
+        if (node.isLeaf())
+        {
+            fn(node.first, node.count);
+            continue;
+        }
+        for (u32 child = node.first; child < node.first + 2; child++)
+        {
+            if (overlaps(nodes[child], boxMin, boxMax))
+                stack[top++] = child;
+        }
+    }
+}
+
+template <typename Func>
+void BVH::queryRay(const Vec3 &origin, const Vec3 &direction, float tMax, Func &&fn) const
+{
+    if (nodes.empty())
+        return;
+
+    // Componentes a zero: slabs infinitos em vez de divisao por zero
+    const Vec3 invDirection(direction.x != 0.0f ? 1.0f / direction.x : 1e30f,
+                            direction.y != 0.0f ? 1.0f / direction.y : 1e30f,
+                            direction.z != 0.0f ? 1.0f / direction.z : 1e30f);
+    if (intersect(nodes[0], origin, invDirection, tMax) == FLT_MAX)
+        return;
+
+    u32 stack[BVH_STACK_SIZE];
+    float entry[BVH_STACK_SIZE];
+    u32 top = 0;
+    stack[top] = 0;
+    entry[top++] = 0.0f;
+    while (top > 0)
+    {
+        --top;
+        if (entry[top] > tMax)
+            continue; // um hit depois de empilhado ja o tapa
+        const BVHNode &node = nodes[stack[top]];
+        if (node.isLeaf())
+        {
+            for (u32 i = 0; i < node.count; i++)
+                fn(indices[node.first + i], tMax);
+            continue;
+        }
+
+        u32 nearChild = node.first, farChild = node.first + 1;
+        float nearT = intersect(nodes[nearChild], origin, invDirection, tMax);
+        float farT = intersect(nodes[farChild], origin, invDirection, tMax);
+        if (farT < nearT)
+        {
+            std::swap(nearChild, farChild);
+            std::swap(nearT, farT);
+        }
+        // O mais longe entra primeiro para sair depois
+        if (farT != FLT_MAX)
+        {
+            stack[top] = farChild;
+            entry[top++] = farT;
+        }
+        if (nearT != FLT_MAX)
+        {
+            stack[top] = nearChild;
+            entry[top++] = nearT;
+        }
+    }
+}
+
+template <typename Func>
+void BVH::querySweep(const Vec3 &origin, const Vec3 &direction, const Vec3 &extent, float tMax, Func &&fn) const
+{
+    if (nodes.empty())
+        return;
+
+    const Vec3 invDirection(direction.x != 0.0f ? 1.0f / direction.x : 1e30f,
+                            direction.y != 0.0f ? 1.0f / direction.y : 1e30f,
+                            direction.z != 0.0f ? 1.0f / direction.z : 1e30f);
+    const float grow[3] = {extent.x, extent.y, extent.z};
+    const float rootT = intersect(nodes[0], origin, invDirection, tMax, grow);
+    if (rootT == FLT_MAX)
+        return;
+
+    u32 stack[BVH_STACK_SIZE];
+    float entry[BVH_STACK_SIZE];
+    u32 top = 0;
+    stack[top] = 0;
+    entry[top++] = rootT;
+    while (top > 0)
+    {
+        --top;
+        if (entry[top] > tMax)
+            continue;
+        const BVHNode &node = nodes[stack[top]];
+        if (node.isLeaf())
+        {
+            fn(node.first, node.count, tMax);
+            continue;
+        }
+
+        u32 nearChild = node.first, farChild = node.first + 1;
+        float nearT = intersect(nodes[nearChild], origin, invDirection, tMax, grow);
+        float farT = intersect(nodes[farChild], origin, invDirection, tMax, grow);
+        if (farT < nearT)
+        {
+            std::swap(nearChild, farChild);
+            std::swap(nearT, farT);
+        }
+        if (farT != FLT_MAX)
+        {
+            stack[top] = farChild;
+            entry[top++] = farT;
+        }
+        if (nearT != FLT_MAX)
+        {
+            stack[top] = nearChild;
+            entry[top++] = nearT;
+        }
+    }
+}
@@ -3,6 +3,8 @@
 #include "Math.hpp"
 #include "Triangle.hpp"
 #include "Plane3D.hpp"
+#include "Ray.hpp"
+#include "BVH.hpp"
 #include <vector>
 #include <cfloat>
 
@@ -52,6 +54,38 @@ public:
         : eRadius(1, 1, 1), foundCollision(false), nearestDistance(FLT_MAX), intersectionTriangle(nullptr), slidingSpeed(0.001f), maxRecursionDepth(5) {}
 };
 
+// ==================== Collision Triangles ====================
+// Dados por triangulo pre-calculados em structure-of-arrays, na ordem das
+// folhas da BVH (uma folha e um intervalo contiguo). Tudo em R3: o sweep
+// passa para ellipsoid space so o que precisa. Os arrays tem
+// COLLISION_LANES floats de folga no fim para os loads SIMD
+
+const u32 COLLISION_LANES = 8;
+
+struct CollisionTriangles
+{
+    std::vector<float> v0x, v0y, v0z, v1x, v1y, v1z, v2x, v2y, v2z;
+    std::vector<float> nx, ny, nz, d;                  // plano: dot(n, p) + d = 0
+    std::vector<float> e0x, e0y, e0z, e1x, e1y, e1z;   // v1 - v0, v2 - v1
+    std::vector<float> e2x, e2y, e2z;                  // v0 - v2
+    std::vector<float> invEdge0, invEdge1, invEdge2;   // 1 / |edge|^2
+    std::vector<float> bux, buy, buz, bwx, bwy, bwz;   // baricentricas: v = dot(p - v0, bu), w = dot(p - v0, bw)
+    std::vector<u32> source;                           // indice em CollisionSystem::triangles
+
+    void build(const std::vector<Triangle> &triangles, const std::vector<u32> &order);
+    void clear();
+    u32 size() const { return (u32)source.size(); }
+
+    // Bit i a 1 se o triangulo first + i (i < count <= COLLISION_LANES)
+    // pode tocar na esfera de raio ellipsoid que vai de from a to: fora
+    // sao os que ficam do mesmo lado do plano, a mais de um raio, nas
+    // duas pontas. AVX faz os 8 de uma vez, SSE 4 a 4
+    u32 planeCandidates(u32 first, u32 count, const Vec3 &from, const Vec3 &to, const Vec3 &radius) const;
+
+    // "AVX", "SSE" ou "scalar"
+    static const char *getKernelName();
+};
+
 // ==================== Collision System ====================
 
 class CollisionSystem
@@ -59,15 +93,26 @@ class CollisionSystem
 private:
     std::vector<Triangle> triangles;
 
-    // Testar colisão de swept sphere com triângulo
-    bool checkTriangle(CollisionPacket &packet, const Triangle &triangle);
+    // Todas as queries passam pela BVH; refeita na primeira query depois
+    // de mudar os triangulos
+    mutable BVH bvh;
+    mutable CollisionTriangles store;
+    mutable bool bvhDirty = true;
+    void updateBVH() const;
+
+    // Testar colisão de swept sphere com o triângulo slot do store
+    bool checkTriangle(CollisionPacket &packet, u32 slot) const;
+
+    // Sweep do packet (ePosition, eVelocity) contra os triângulos da BVH
+    // dentro da caixa do movimento; o mais perto fica no packet
+    void sweepTriangles(CollisionPacket &packet) const;
 
     // Testar swept sphere com ponto
-    bool getLowestRoot(float a, float b, float c, float maxR, float &root);
+    static bool getLowestRoot(float a, float b, float c, float maxR, float &root);
 
     // Colisão recursiva com sliding
     Vec3 collideWithWorld(int recursionDepth, CollisionPacket &packet,
-                          const Vec3 &pos, const Vec3 &vel);
+                          const Vec3 &pos, const Vec3 &vel) const;
 
 public:
     CollisionSystem();
@@ -93,17 +138,25 @@ public:
     // outGrounded: true se está no chão
     Vec3 collideAndSlide(const Vec3 &position, const Vec3 &velocity,
                          const Vec3 &radius, const Vec3 &gravity,
-                         bool &outGrounded);
+                         bool &outGrounded) const;
 
     // Versão sem gravidade
     Vec3 collideAndSlide(const Vec3 &position, const Vec3 &velocity,
-                         const Vec3 &radius);
+                         const Vec3 &radius) const;
 
     // Versão para sphere simples (raio uniforme)
     Vec3 sphereSlide(const Vec3 &position, const Vec3 &velocity,
-                     float radius, const Vec3 &gravity, bool &outGrounded);
+                     float radius, const Vec3 &gravity, bool &outGrounded) const;
 
-    Vec3 sphereSlide(const Vec3 &position, const Vec3 &velocity, float radius);
+    Vec3 sphereSlide(const Vec3 &position, const Vec3 &velocity, float radius) const;
+
+    // Vários agentes de uma vez (NPCs): collideAndSlide de cada um nos
+    // workers do JobSystem, com o mundo só para leitura. gravity pode ser
+    // nullptr (sem gravidade) e outGrounded também (não escrito). outPositions
+    // pode ser o próprio positions
+    void collideAndSlideBatch(u32 count, const Vec3 *positions, const Vec3 *velocities,
+                              const Vec3 *radii, const Vec3 *gravity,
+                              Vec3 *outPositions, u8 *outGrounded) const;
 
     // ==================== Simple Collision Tests ====================
 
@@ -118,7 +171,19 @@ public:
     bool rayCastClosest(const Vec3 &origin, const Vec3 &direction,
                         float maxDistance, CollisionInfo &outInfo) const;
 
-    // Sphere cast (swept sphere)
+    // ==================== Batch Ray Casting ====================
+
+    // Closest hit de count rays em outHits[i] (t em unidades da direction,
+    // que no Ray ja vem normalizada). Pacotes de 8 rays com AVX, 4 com
+    // SSE, espalhados pelo JobSystem; pacotes incoerentes e rays que ficam
+    // sozinhos numa subarvore seguem um a um
+    void rayCastBatch(const Ray *rays, u32 count, float maxDistance, RayHit *outHits) const;
+    void rayCastBatch(const std::vector<Ray> &rays, float maxDistance, std::vector<RayHit> &outHits) const;
+
+    // Sphere cast (swept sphere): primeiro contacto de uma sphere de raio
+    // radius a andar de origin ao longo de direction até maxDistance.
+    // nearestDistance é a distância percorrida pelo centro, o ponto e a
+    // normal são os do contacto; a começar já a tocar dá distância 0
     bool sphereCast(const Vec3 &origin, const Vec3 &direction,
                     float radius, float maxDistance, CollisionInfo &outInfo) const;
 };
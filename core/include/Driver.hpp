@@ -6,6 +6,7 @@
 
 class Mesh;
 class MeshBuffer;
+class Frustum;
 
 enum class BlendFactor : u8
 {
@@ -179,6 +180,8 @@ public:
 
     void DrawMeshBuffer( MeshBuffer *meshBuffer);
     void DrawMesh(Mesh *mesh);
+    // Salta os buffers cujos bounds (levados por world) estao fora do frustum
+    void DrawMesh(Mesh *mesh, const Frustum &frustum, const Mat4 &world);
  
 
     void DrawElements(u32 mode, u32 count, u32 type, const void *indices);
@@ -186,6 +189,7 @@ public:
 
 
     u32 GetCountMeshBuffer() const { return m_countMeshBuffer; }
+    u32 GetCountCulledMeshBuffer() const { return m_countCulledMeshBuffer; }
     u32 GetCountMesh() const { return m_countMesh; }
     u32 GetCountTriangle() const { return m_countTriangle; }
     u32 GetCountVertex() const { return m_countVertex; }
@@ -204,6 +208,8 @@ public:
 private:
     Driver();
     ~Driver() = default;
+
+    void BindMaterial(Mesh *mesh, MeshBuffer *buffer);
     Driver(const Driver &) = delete;
     Driver &operator=(const Driver &) = delete;
 
@@ -224,6 +230,7 @@ private:
     float m_clearDepth = 1.0f;
     int m_clearStencil = 0;
     u32 m_countMeshBuffer = 0;
+    u32 m_countCulledMeshBuffer = 0;
     u32 m_countMesh = 0;
     u32 m_countTriangle = 0;
     u32 m_countVertex = 0;
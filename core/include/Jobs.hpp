@@ -0,0 +1,61 @@
+#pragma once
+#include "Config.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// JOB SYSTEM
+// Pool de threads fixo para dividir ciclos grandes (skinning, tangentes,
+// BVH...). Quem chama tambem trabalha, por isso com 1 core corre tudo inline.
+// ParallelFor chamado dentro de um job corre em serie (sem deadlock).
+// ============================================================================
+
+class JobSystem
+{
+public:
+    // func(begin, end, slot): slot < GetWorkerCount() e unico por thread
+    // durante a chamada, para acumuladores por thread sem locks
+    typedef std::function<void(u32 begin, u32 end, u32 slot)> RangeFunc;
+
+    static JobSystem &Instance();
+
+    // Threads que participam num ParallelFor (workers + quem chama)
+    u32 GetWorkerCount() const { return (u32)m_threads.size() + 1; }
+
+    // Divide [0, count) em blocos de pelo menos grain elementos e espera.
+    // Com count <= grain (ou dentro de um job) chama func(0, count, 0)
+    void ParallelFor(u32 count, u32 grain, const RangeFunc &func);
+
+    // Limita o numero de threads (0 = hardware_concurrency). Recria o pool
+    void SetWorkerCount(u32 count);
+
+private:
+    JobSystem();
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    void Start(u32 threads);
+    void Stop();
+    void WorkerLoop(u32 slot);
+    void RunChunks(u32 slot);
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    std::mutex m_submit; // um ParallelFor de cada vez
+
+    const RangeFunc *m_func = nullptr;
+    u32 m_count = 0;
+    u32 m_chunk = 0;
+    std::atomic<u32> m_next{0};
+    u32 m_generation = 0;
+    u32 m_active = 0;
+    bool m_quit = false;
+};
@@ -588,6 +588,7 @@ struct BoundingBox
     Vec3 center() const;
     Vec3 size() const;
     bool contains(const Vec3 &point) const;
+    BoundingBox transformed(const Mat4 &matrix) const; // AABB que contem a box transformada
 };
 
  
@@ -1,6 +1,8 @@
 #pragma once
 #include "Config.hpp"
 #include "LoadTypes.hpp"
+#include "MeshOptimizer.hpp"
+#include "Skinning.hpp"
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -15,32 +17,40 @@ class Stream;
 class Texture;
 class Driver;
 class RenderBatch;
+class Frustum;
 class MeshWriter;
 class MeshLoader;
 class Animator;
+class SkeletonInstance;
 
 constexpr u32 MESH_MAGIC = 0x4D455348; // "MESH"
-constexpr u32 MESH_VERSION = 100;      // 1.00
+constexpr u32 MESH_VERSION = 103;      // 1.03
 
 constexpr u32 BUFFER_FLAG_SKINNED = 1 << 0;  // Tem skinning data
 constexpr u32 BUFFER_FLAG_TANGENTS = 1 << 1; // Tem tangents
 constexpr u32 BUFFER_FLAG_COLORS = 1 << 2;   // Tem vertex colors
+constexpr u32 BUFFER_FLAG_QUANTIZED = 1 << 3; // Vertices em QVTX/QSKN
 
 constexpr u32 CHUNK_MATS = 0x4D415453; // "MATS" - Materials
 constexpr u32 CHUNK_BUFF = 0x42554646; // "BUFF" - Buffer
 constexpr u32 CHUNK_VRTS = 0x56525453; // "VRTS" - Vertices
-constexpr u32 CHUNK_IDXS = 0x49445853; // "IDXS" - Indices
+constexpr u32 CHUNK_IDXS = 0x49445853; // "IDXS" - Indices (count, largura 2/4 desde 1.03)
 constexpr u32 CHUNK_SKEL = 0x534B454C; // "SKEL" - Skeleton
 constexpr u32 CHUNK_SKIN = 0x534B494E; // "SKIN" - Skinning data
 constexpr u32 CHUNK_ANIM = 0x414E494D; // "ANIM" - Reserved
+constexpr u32 CHUNK_LODS = 0x4C4F4453; // "LODS" - Nivel de LOD (contem BUFFs)
+constexpr u32 CHUNK_QVTX = 0x51565458; // "QVTX" - Vertices quantizados
+constexpr u32 CHUNK_QSKN = 0x51534B4E; // "QSKN" - Skinning com pesos quantizados
+constexpr u32 CHUNK_TANG = 0x54414E47; // "TANG" - Tangentes (float4)
 
 constexpr u32 ANIM_MAGIC = 0x414E494D; // "ANIM"
-constexpr u32 ANIM_VERSION = 100;      // v1.00
+constexpr u32 ANIM_VERSION = 101;      // v1.01: CCHN
 
 // Chunk IDs
 constexpr u32 ANIM_CHUNK_INFO = 0x494E464F; // "INFO" - Animation info
 constexpr u32 ANIM_CHUNK_CHAN = 0x4348414E; // "CHAN" - Channel (per bone)
 constexpr u32 ANIM_CHUNK_KEYS = 0x4B455953; // "KEYS" - Keyframes
+constexpr u32 ANIM_CHUNK_CCHN = 0x4343484E; // "CCHN" - Channel comprimido (tracks separadas)
 
 struct ChunkHeader
 {
@@ -109,6 +119,27 @@ public:
     float GetShininess() const { return m_shininess; }
 };
 
+// Skinning de uma SkeletonInstance num MeshBuffer: VAO proprio com os
+// vertices skinned, para cada copia do personagem manter a sua pose na GPU
+// entre frames. Os indices sao os do MeshBuffer (partilhados) e o skinning
+// corre num scratch do lote; so os VBOs sao por instancia
+struct SkinnedOutput
+{
+    VertexArray *array = nullptr; // dono do vb e tangentBuffer; o ib e do MeshBuffer
+    VertexBuffer *vb = nullptr;
+    VertexBuffer *tangentBuffer = nullptr;
+    Skinning::SkinnedPose pose;
+    BoundingBox bounds;              // da pose atual
+    u32 indexCount = 0;
+    u32 sourceVersion = 0;           // MeshBuffer::m_buildVersion de quando foi criada
+    size_t gpuBytes = 0;             // vb + tangentBuffer
+
+    SkinnedOutput() = default;
+    ~SkinnedOutput();
+    SkinnedOutput(const SkinnedOutput &) = delete;
+    SkinnedOutput &operator=(const SkinnedOutput &) = delete;
+};
+
 class MeshBuffer
 {
 private:
@@ -116,20 +147,52 @@ private:
     std::vector<Vertex> m_skinnedVertices;
 
     std::vector<VertexSkin> m_skinData;
-    std::vector<u32> indices;
+    std::vector<Vec4> m_tangents; // opcional: xyz + sinal da bitangente
+    std::vector<Vec4> m_skinnedTangents;
+    std::vector<u8> m_packed; // scratch do UploadVertices; so fica nos skinned
+    MeshOptimizer::IndexArray indices; // u16 enquanto os vertices cabem
+    std::vector<MeshOptimizer::Meshlet> m_meshlets;
+    MeshOptimizer::VertexAdjacency m_adjacency;
+    bool m_adjacencyDirty = true;
+    MeshOptimizer::VertexFormat m_format;
+    Vec3 m_quantCenter{0.0f};
+    float m_quantScale{1.0f};
+    static bool s_shaderDecode;
     bool m_isSkinned = false;
     bool m_vdirty;
     bool m_idirty;
     VertexArray *buffer;
     VertexBuffer *vb;
+    VertexBuffer *m_tangentBuffer{nullptr}; // stream 1, so com tangentes
     IndexBuffer *ib;
+    BoundingBox m_boundingBox;
+    Vec3 m_boundingCenter;
+    float m_boundingRadius{0.0f};
     u32 m_material{0};
+    bool m_meshletFallbackWarned{false};
+    Skinning::SkinnedPose m_skinnedPose; // pose no VBO
+    u32 m_buildVersion{0};               // sobe quando o Build sobe vertices ou indices
     friend class Mesh;
     friend class MeshManager;
     friend class Driver;
     friend class MeshReader;
     friend class MeshWriter;
 
+    void ResetGpuBuffers();
+    void CreateVertexStreams(VertexArray *array, VertexBuffer *&vertexBuffer, VertexBuffer *&tangentBuffer) const;
+    void UploadVertices(VertexBuffer *target, const Vertex *source, u32 count);
+    MeshOptimizer::VertexFormat GetGpuFormat() const;
+
+    // UpdateSkinning em duas fases: o job (CPU, pode correr em paralelo com
+    // outros buffers) e o upload da pose (GL, thread principal). pose e o
+    // dono da paleta (Mesh ou SkeletonInstance); false tambem quando essa
+    // pose ja esta no VBO. Com output o destino e o VAO da instancia e
+    // nao o deste buffer, e job.destination fica para quem chama
+    bool PrepareSkinning(const std::vector<Skinning::AffineMatrix> &palette, const void *pose, u32 poseVersion,
+                         Skinning::SkinningMode mode, Skinning::SkinningJob &job, SkinnedOutput *output = nullptr);
+    void UploadSkinning(const Skinning::SkinningJob &job, SkinnedOutput *output = nullptr);
+    void BuildSkinnedOutput(SkinnedOutput &output);
+
 public:
     MeshBuffer();
     ~MeshBuffer();
@@ -153,14 +216,82 @@ public:
     void Render();
     void Debug(RenderBatch *batch);
 
-    void UpdateSkinning(Mesh *mesh);
+    // SKIN_POSITION_ONLY (sombras/depth) deixa normais e tangentes da ultima pose completa
+    void UpdateSkinning(Mesh *mesh, Skinning::SkinningMode mode = Skinning::SKIN_FULL);
 
     void RemoveDuplicateVertices(float threshold);
-    void Optimize();
 
-    void CalculateNormals(bool smooth = true);
+    // Reordena os indices para o post-transform cache (Forsyth); devolve ACMR/ATVR
+    // antes e depois, medidos com cacheSize
+    MeshOptimizer::VertexCacheResult Optimize(u32 cacheSize = MeshOptimizer::DEFAULT_CACHE_SIZE);
+    MeshOptimizer::VertexCacheStats AnalyzeVertexCache(u32 cacheSize = 16) const;
+
+    // Renumera os vertices pela ordem de uso (vertices, skin e indices juntos);
+    // devolve o overfetch antes e depois
+    MeshOptimizer::VertexFetchResult OptimizeVertexFetch();
+    MeshOptimizer::VertexFetchStats AnalyzeVertexFetch() const;
+
+    // Ordena clusters de triangulos para reduzir overdraw; chamar depois de Optimize().
+    // Devolve o overdraw antes e depois
+    MeshOptimizer::OverdrawResult OptimizeOverdraw(float threshold = MeshOptimizer::DEFAULT_OVERDRAW_THRESHOLD);
+    MeshOptimizer::OverdrawStats AnalyzeOverdraw() const;
+
+    // Reduz ate targetIndexCount indices (ou ate maxError) e compacta os vertices.
+    // Retorna o erro geometrico em unidades do objeto
+    float Simplify(u32 targetIndexCount, float maxError);
+
+    // Reordena os triangulos em meshlets (bounds + cone) para culling por cluster.
+    // Chamar de novo depois de mexer nos indices
+    u32 BuildMeshlets(u32 maxVertices = MeshOptimizer::MESHLET_MAX_VERTICES,
+                      u32 maxTriangles = MeshOptimizer::MESHLET_MAX_TRIANGLES);
+    const std::vector<MeshOptimizer::Meshlet> &GetMeshlets() const { return m_meshlets; }
+    bool HasMeshlets() const;
+
+    // Desenha so os meshlets visiveis. frustum e camera no espaco do objeto
+    // (ex: frustum.extractFromMatrix(viewProj * world)). Retorna os desenhados;
+    // skinned ou sem meshlets desenha tudo, retorna 0 e avisa uma vez
+    u32 RenderMeshlets(const Frustum &frustum, const Vec3 &cameraPosition);
+
+    // Layout compacto do vertex buffer na GPU e no .mesh (os vertices em CPU
+    // ficam float). Recria o VAO se ja estava construido. Skinned nao suporta
+    // SNORM16 (as posicoes saem dos bounds), usa HALF4. NORMAL_OCT16 e
+    // SNORM16 so vao para a GPU com SetShaderDecode(true) (shaders com o
+    // MeshOptimizer::VERTEX_DECODE_GLSL); senao sobem como HALF4/FLOAT3
+    MeshOptimizer::QuantizationError SetVertexFormat(const MeshOptimizer::VertexFormat &format);
+    MeshOptimizer::QuantizationError SetVertexFormat(const MeshOptimizer::VertexFormat &format, const Vec3 &center,
+                                                     float scale);
+    const MeshOptimizer::VertexFormat &GetVertexFormat() const { return m_format; }
+
+    // Posicao no espaco do objeto a partir da do vertex buffer; identidade
+    // quando a GPU nao recebe SNORM16. Cada buffer tem a sua (muda se os
+    // vertices sairem dos bounds)
+    Mat4 GetPositionDecode() const;
+
+    // Global, antes do Build: os shaders em uso descodificam OCT16/SNORM16
+    static void SetShaderDecode(bool enable) { s_shaderDecode = enable; }
+    static bool GetShaderDecode() { return s_shaderDecode; }
+
+    // smooth: media das faces de cada vertice (em paralelo); flat: um vertice por canto
+    void CalculateNormals(bool smooth = true,
+                          MeshOptimizer::NormalWeighting weighting = MeshOptimizer::NORMAL_WEIGHT_AREA);
+
+    // Vertice -> triangulos (CSR), so reconstruida quando os indices mudam
+    const MeshOptimizer::VertexAdjacency &GetAdjacency();
+
+    // Tangentes (MeshOptimizer::GenerateTangents) num stream separado
+    // (VES_TANGENT, float4).
+    // Precisa de normais e UVs; pode acrescentar vertices (UVs espelhados, leques soltos).
+    // Mudar normais ou geometria descarta-as (chamar de novo)
     void CalculateTangents();
+    bool HasTangents() const { return !m_tangents.empty() && m_tangents.size() == vertices.size(); }
+    const Vec4 *GetTangents() const { return m_tangents.data(); }
+
+    // Bounds no espaco do objeto (AABB + esfera). Recalculados no Build()
+    // quando os vertices mudam; em skinned seguem a pose do UpdateSkinning
     void CalculateBoundingBox();
+    const BoundingBox &GetBoundingBox() const { return m_boundingBox; }
+    const Vec3 &GetBoundingCenter() const { return m_boundingCenter; }
+    float GetBoundingRadius() const { return m_boundingRadius; }
 
     void GeneratePlanarUVsAuto(float resolution);
     void GeneratePlanarUVsAxis(float resolutionS, float resolutionT, int axis, const Vec3 &offset);
@@ -195,7 +326,7 @@ public:
         m_isSkinned = !data.empty();
     }
     const Vertex *GetVertices() const { return vertices.data(); }
-    const u32 *GetIndices() const { return indices.data(); }
+    const MeshOptimizer::IndexArray &GetIndices() const { return indices; }
 };
 
 struct AnimationKeyframe
@@ -207,47 +338,128 @@ struct AnimationKeyframe
     AnimationKeyframe() : time(0.0f), position(), rotation() {}
 };
 
+// Quaternion em 48 bits (smallest-three): 2 bits com a maior componente e
+// as outras 3 em 15 bits no intervalo [-1/sqrt(2), 1/sqrt(2)]
+struct PackedQuat
+{
+    u16 data[3];
+
+    static PackedQuat Pack(const Quat &rotation);
+    Quat Unpack() const;
+};
+
+struct AnimationCompression
+{
+    float positionTolerance = 0.001f;  // erro maximo na posicao, unidades do clip
+    float rotationTolerance = 0.0005f; // erro maximo na rotacao, radianos
+};
+
 struct AnimationChannel
 {
     std::string boneName;
     u32 boneIndex; // Index no mesh
     std::vector<AnimationKeyframe> keyframes;
+
+    // Comprimido (Animation::Compress ou CCHN): keyframes fica vazio e cada
+    // track tem as suas chaves, uma so quando e constante
+    std::vector<float> positionTimes;
+    std::vector<Vec3> positions;
+    std::vector<float> rotationTimes;
+    std::vector<PackedQuat> rotations;
+
+    bool IsCompressed() const { return keyframes.empty() && !positions.empty(); }
+    size_t GetMemorySize() const;
+};
+
+// Onde o sample de um channel ficou, guardado por quem toca o clip
+// (AnimationLayer, Animation::Sample) e nao no clip, que e partilhado entre
+// personagens e so lido. So uma pista: sem cursor, ou com um de outro
+// tempo, o sample cai na pesquisa binaria
+struct AnimationCursor
+{
+    u32 key = 0;         // keyframes, ou posicoes comprimidas
+    u32 rotationKey = 0; // rotacoes comprimidas (tempos proprios)
+
+    // Rotacoes comprimidas i e i + 1 ja descompactadas (mesmo hemisferio) e
+    // a direcao do slerp entre elas: so descompacta quando muda de intervalo
+    u32 rotationCacheKey = (u32)-1;
+    Quat rotationCache[3];
+    float rotationCacheAngle = 0.0f; // 0 = perto, nlerp
 };
 
 class Animation
 {
 public:
     bool Load(const std::string &filename);
+    bool Load(Stream *stream);
     void Update(float deltaTime);
     void BindToMesh(Mesh *mesh);
     float GetDuration() const { return m_duration; }
     float GetTicksPerSecond() const { return m_ticksPerSecond; }
+    void SetDuration(float duration) { m_duration = duration; } // em ticks
+    void SetTicksPerSecond(float ticksPerSecond) { m_ticksPerSecond = ticksPerSecond; }
     const std::string &GetName() const { return m_name; }
 
     AnimationChannel *GetChannel(u32 index) { return &m_channels[index]; }
 
     AnimationChannel *FindChannel(const std::string &name);
+    AnimationChannel *AddChannel(const std::string &boneName);
 
-    Vec3 InterpolatePosition(const AnimationChannel &channel, float time);
-    Quat InterpolateRotation(const AnimationChannel &channel, float time);
+    Vec3 InterpolatePosition(const AnimationChannel &channel, float time, AnimationCursor *cursor = nullptr) const;
+    Quat InterpolateRotation(const AnimationChannel &channel, float time, AnimationCursor *cursor = nullptr) const;
 
     u32 GetChannelCount() const { return m_channels.size(); }
 
+    // Tracks separadas, tracks constantes numa chave, chaves que a
+    // interpolacao reproduz dentro da tolerancia removidas e rotacoes em 48
+    // bits. O sample le as tracks diretamente
+    void Compress(const AnimationCompression &settings = AnimationCompression());
+    bool IsCompressed() const;
+    size_t GetMemorySize() const; // bytes das chaves (e da tabela baked)
+
+    // Opcional por clip: reamostra todos os channels a framesPerSecond numa
+    // tabela (uma linha por frame, um channel por coluna). O sample passa a
+    // ler duas linhas e fazer lerp/nlerp, sem procuras; as tracks ficam
+    // para o Unbake
+    void Bake(float framesPerSecond = 30.0f);
+    void Unbake();
+    bool IsBaked() const { return m_bakedFrames > 0; }
+
+    // Pose de todos os channels (arrays com GetChannelCount() entradas;
+    // cursors tambem, ou nullptr)
+    void SamplePose(float time, Vec3 *positions, Quat *rotations, AnimationCursor *cursors = nullptr) const;
+
     bool operator==(const Animation &other) const { return m_name == other.m_name; }
     bool operator!=(const Animation &other) const { return !(*this == other); }
 
 private:
     std::string m_name;
-    float m_duration;
-    float m_ticksPerSecond;
+    float m_duration = 0.0f;
+    float m_ticksPerSecond = 25.0f;
     Mesh *m_mesh = nullptr;
-    float m_currentTime;
+    float m_currentTime = 0.0f;
+    std::vector<AnimationCursor> m_cursors; // so do Update/Sample ligado ao mesh
     friend class Animator;
     friend class AnimationLayer;
+    friend class AnimWriter;
 
     void Sample(float time);
 
+    // Chave i com times[i] <= time <= times[i + 1], ou -1 fora do clip
+    // (times com stride em bytes, para os keyframes e as tracks). Tenta o
+    // cursor e a chave seguinte/anterior (playback, ping-pong); seeks e
+    // blends a outro tempo caem na pesquisa binaria
+    static u32 FindKey(const float *times, size_t stride, u32 count, u32 &cursor, float time);
+
     std::vector<AnimationChannel> m_channels;
+
+    std::vector<Vec3> m_bakedPositions; // m_bakedFrames linhas x m_channels.size()
+    std::vector<Quat> m_bakedRotations; // sinal continuo entre linhas (nlerp direto)
+    u32 m_bakedFrames = 0;
+    float m_bakedRate = 0.0f; // linhas por tick: (frames - 1) / duracao
+
+    void GetBakedRows(float time, u32 &row0, u32 &row1, float &factor) const;
+    s32 GetChannelIndex(const AnimationChannel &channel) const;
 };
 
 enum class PlayMode
@@ -266,8 +478,12 @@ public:
     ~AnimationLayer();
 
     
-    void AddAnimation(const std::string &name, Animation *anim);
+    // owned = false para clips partilhados entre instancias: o layer nao
+    // os apaga nem os liga ao mesh (o binding fica no layer)
+    void AddAnimation(const std::string &name, Animation *anim, bool owned = true);
     Animation *GetAnimation(const std::string &name);
+
+    // Pelo AnimationLibrary: o ficheiro e lido uma vez para todos os layers
     Animation *LoadAnimation(const std::string &name, const std::string &filename);
 
     // Controle de playback (animação única)
@@ -280,9 +496,21 @@ public:
     void Resume();
 
  
-    // Update
+    // Update: so para um layer sem Animator (escreve no mesh e faz o
+    // skinning); com Animator e o Animator::Update que trata de tudo
     void Update(float deltaTime);
 
+    // Peso do layer na mistura do Animator, por ordem de AddLayer
+    void SetWeight(float weight) { m_weight = weight; }
+    float GetWeight() const { return m_weight; }
+
+    // Mascara por bone: SetBoneMask deixa so o bone e os descendentes
+    // (ex: "Spine" para o tronco); sem mascara todos os bones contam
+    void SetBoneMask(const std::string &rootBone);
+    void SetBoneWeight(u32 boneIndex, float weight);
+    void ClearBoneMask();
+    float GetBoneWeight(u32 boneIndex) const; // peso do layer * mascara
+
     // Getters
     bool IsPlaying(const std::string &animName) const;
     float GetCurrentTime() const { return m_currentTime; }
@@ -295,6 +523,13 @@ public:
 private:
     Mesh *m_mesh;
     std::map<std::string, Animation *> m_animations;
+    std::vector<Animation *> m_sharedAnimations; // em m_animations mas nao nossos
+    std::vector<Animation *> m_libraryAnimations; // do AnimationLibrary, Release no fim
+
+    // channel -> bone deste mesh e cursores de sample, por clip (os clips
+    // partilhados nao mudam)
+    std::unordered_map<const Animation *, std::vector<u32>> m_bindings;
+    std::unordered_map<const Animation *, std::vector<AnimationCursor>> m_cursors;
 
     // Animação única atual
     std::string m_currentAnimName;
@@ -302,6 +537,7 @@ private:
     Animation *m_currentAnim;
     Animation *m_previousAnim;
     Animation *m_playTo;
+    std::string m_playToName;
 
     float m_currentTime;
     float m_currentTimeBlend;
@@ -323,11 +559,29 @@ private:
     PlayMode m_toReturnMode;
     float m_defaultBlendTime;
     bool m_isPingPongReverse;
+
+    std::vector<Vec3> m_positions; // scratch por channel do SamplePose
+    std::vector<Quat> m_rotations;
+
+    // Pose local do layer por bone (remap pelo boneIndex dos channels)
+    std::vector<Vec3> m_posePositions;
+    std::vector<Quat> m_poseRotations;
+    std::vector<u8> m_poseValid;
+    std::vector<float> m_boneMask;
+    float m_weight = 1.0f;
+
+    friend class Animator;
      
     // Métodos privados
     void UpdateBlending(float deltaTime);
     void UpdateLayers(float deltaTime);
     bool CheckAnimationEnd();
+
+    // Avanca o tempo e amostra para a pose do layer, sem tocar no mesh
+    void Advance(float deltaTime);
+    void SampleToPose(Animation *anim, float time, float weight);
+    const std::vector<u32> &GetBinding(const Animation *anim);
+    AnimationCursor *GetCursors(const Animation *anim);
 };
 
 
@@ -336,12 +590,30 @@ class Animator
 
     std::vector<AnimationLayer*> layers;
     Mesh *m_mesh;
+    SkeletonInstance *m_instance = nullptr;
+
+    // Bind pose decomposta e a pose misturada do frame
+    std::vector<Vec3> m_bindPositions;
+    std::vector<Quat> m_bindRotations;
+    std::vector<Vec3> m_posePositions;
+    std::vector<Quat> m_poseRotations;
+    std::vector<u8> m_poseUsed;
+
 public:
 
     Animator(Mesh *mesh);
     ~Animator();
+
+    // Avanca todos os layers, mistura as poses por peso e mascara sobre a
+    // bind pose e faz o skinning uma vez
     void Update(float deltaTime);
 
+    // Com instancia a pose vai para ela e o mesh fica intacto; o skinning
+    // fica para o Mesh::UpdateSkinning(instances) do frame e o desenho para
+    // o Mesh::Render(instance)
+    void SetInstance(SkeletonInstance *instance) { m_instance = instance; }
+    SkeletonInstance *GetInstance() const { return m_instance; }
+
     AnimationLayer* AddLayer();
     AnimationLayer* GetLayer(u32 index);
 
@@ -349,6 +621,58 @@ public:
 
 };
 
+// ============================================================================
+// ANIMATION LIBRARY
+// Cache de clips por caminho e por hash do conteudo: o mesmo .anim (ou uma
+// copia com outro nome) e lido uma vez e partilhado por todos os layers.
+// O hash so encontra candidatos: partilhar exige o mesmo tamanho e os
+// mesmos bytes que o ficheiro de onde o clip veio. Os clips sao so de
+// leitura depois de carregados; o binding aos bones fica em cada
+// AnimationLayer. Acquire/Release contam referencias
+// ============================================================================
+
+class AnimationLibrary
+{
+public:
+    static AnimationLibrary &Instance();
+
+    Animation *Acquire(const std::string &filename);
+    void Release(Animation *anim);
+
+    u32 GetRefCount(const Animation *anim) const;
+    size_t GetCount() const { return m_clips.size(); }
+    size_t GetMemorySize() const;
+
+    // Liberta os clips sem referencias; os ainda em uso ficam (com aviso)
+    void UnloadAll();
+
+    AnimationLibrary() = default;
+    ~AnimationLibrary();
+
+private:
+    struct Clip
+    {
+        Animation *anim = nullptr;
+        u32 refs = 0;
+        size_t size = 0;    // bytes do ficheiro
+        u64 check = 0;      // segundo digest do conteudo (a chave e o primeiro)
+        std::string source; // caminho de onde foi lido (para os logs)
+    };
+
+    std::unordered_map<std::string, Animation *> m_paths; // caminho -> clip
+    std::unordered_multimap<u64, Clip> m_clips;           // hash do conteudo (colisoes lado a lado)
+
+    Clip *FindClip(const Animation *anim);
+    void Erase(const Animation *anim);
+};
+
+struct MeshLod
+{
+    float ratio = 1.0f; // fracao de triangulos pedida
+    float error = 0.0f; // erro geometrico em unidades do objeto
+    std::vector<MeshBuffer *> buffers;
+};
+
 class Mesh
 {
 public:
@@ -360,6 +684,7 @@ public:
     MeshBuffer *AddBuffer(u32 material = 0);
     void Render();
     void CalculateNormals();
+    void CalculateTangents();
 
     void SetTexture(u32 layer, Texture *texture);
 
@@ -373,8 +698,37 @@ public:
     bool SetBufferMaterial(u32 index, u32 material);
     bool SetMaterial(u32 material);
 
+    // Junta buffers com o mesmo material e otimiza cache, overdraw e fetch
     void OptimizeBuffers();
 
+    // Parte os buffers com mais de maxVertices vertices (e LODs) para todos
+    // usarem indices u16. Retorna quantos buffers foram acrescentados
+    u32 SplitBuffers(u32 maxVertices = MeshOptimizer::INDEX16_MAX_VERTICES);
+
+    // LOD 0 sao os buffers normais; cada ratio gera um nivel simplificado.
+    // maxError e relativo ao tamanho da mesh (diagonal da bounding box)
+    u32 GenerateLods(const std::vector<float> &ratios, float maxError = 0.05f);
+    void ClearLods();
+    MeshLod *AddLod(float ratio, float error);
+    MeshBuffer *AddLodBuffer(u32 lod, u32 material = 0);
+
+    u32 GetLodCount() const { return (u32)m_lods.size() + 1; }
+    float GetLodError(u32 lod) const;
+    size_t GetLodBufferCount(u32 lod) const;
+    MeshBuffer *GetLodBuffer(u32 lod, size_t index) const;
+
+    // Escolhe o LOD mais simples cujo erro projetado fica abaixo de maxPixelError.
+    // distance em unidades do objeto, fovY em graus
+    u32 SelectLod(float distance, float screenHeight, float fovY, float maxPixelError = 1.0f) const;
+    void SetLod(u32 lod);
+    u32 GetLod() const { return m_currentLod; }
+
+    // Aplica o formato a todos os buffers (e LODs) com bounds comuns. Cada
+    // buffer guarda o seu decode (GetPositionDecode do buffer ou por indice
+    // abaixo). Retorna o pior erro e os bytes totais
+    MeshOptimizer::QuantizationError SetVertexFormat(const MeshOptimizer::VertexFormat &format);
+    Mat4 GetPositionDecode(u32 lod, size_t index) const;
+
     bool HasSkeleton() const { return !m_bones.empty(); }
     bool IsSkinned() const { return !m_bones.empty(); }
     u32 GetBoneCount() const { return m_bones.size(); }
@@ -384,12 +738,41 @@ public:
     std::vector<Bone *> &GetBones() { return m_bones; }
     const std::vector<Bone *> &GetBones() const { return m_bones; }
 
-    void UpdateSkinning();
+    void UpdateSkinning(Skinning::SkinningMode mode = Skinning::SKIN_FULL);
+
+    // Multidoes: paletas, depois o CPU skinning de todos os buffers num so
+    // ParallelFor, e so no fim os uploads
+    static void UpdateSkinning(const std::vector<Mesh *> &meshes, Skinning::SkinningMode mode = Skinning::SKIN_FULL);
+
+    // Copias que partilham o mesh: cada instancia faz skinning para os seus
+    // proprios VAOs (SkinnedOutput) e desenha-se com Render(instance). Uma
+    // pose que nao mudou nao repete o skinning nem o upload
+    void UpdateSkinning(SkeletonInstance *instance, Skinning::SkinningMode mode = Skinning::SKIN_FULL);
+
+    // Multidao de instancias (de um ou varios meshes): paletas, o CPU
+    // skinning de todas num so ParallelFor e no fim os uploads
+    static void UpdateSkinning(const std::vector<SkeletonInstance *> &instances,
+                               Skinning::SkinningMode mode = Skinning::SKIN_FULL);
+
+    // Os buffers ativos com a pose da instancia (os sem skinning dela
+    // desenham-se normalmente)
+    void Render(SkeletonInstance *instance);
+
+    // Com deferred o UpdateSkinning() (chamado pelas animacoes) so marca o
+    // mesh; o skinning fica para o UpdateSkinning(meshes) do frame
+    void SetDeferredSkinning(bool deferred) { m_deferredSkinning = deferred; }
+    bool IsDeferredSkinning() const { return m_deferredSkinning; }
+    bool IsSkinningPending() const { return m_skinningPending; }
 
     void Debug(RenderBatch *batch);
 
+    // Liga os pais e ordena os bones (pais antes dos filhos)
     void CalculateBoneMatrices();
+    // Paleta de skinning, uma matriz por bone e por frame:
+    // GetBoneGlobals()[i] = global, GetBoneMatrices()[i] = global * inverseBindPose
+    void UpdateBonePalette();
     const std::vector<Mat4> &GetBoneMatrices() const { return m_boneMatrices; }
+    const std::vector<Mat4> &GetBoneGlobals() const { return m_boneGlobals; }
     Bone *FindBone(const std::string &name);
 
     u32 FindBoneIndex(const std::string &name);
@@ -400,17 +783,112 @@ public:
     void SetBoneStatic(u32 index);
     void ResetBones();
 
+    // Sobe quando a paleta muda; os buffers com a pose atual nao repetem o
+    // skinning nem o upload. So Set/Reset marcam bones: quem mexe nos Bone
+    // diretamente chama MarkPoseDirty()
+    u32 GetPoseVersion() const { return m_poseVersion; }
+    void MarkPoseDirty();
+
 private:
     std::vector<Bone *> m_bones;
     std::vector<Mat4> m_boneMatrices;
+    std::vector<Mat4> m_boneGlobals;
+    std::vector<Skinning::AffineMatrix> m_bonePalette; // m_boneMatrices em 3x4 para os kernels
+    std::vector<u32> m_boneOrder; // indices dos bones, pais primeiro
+    std::vector<u8> m_boneDirty;  // local mudou desde a ultima paleta
+    bool m_poseDirty = true;
+    u32 m_poseVersion = 0;
     std::vector<MeshBuffer *> buffers;
     std::vector<Material *> materials;
+    std::vector<MeshLod> m_lods;
+    u32 m_currentLod = 0;
+    u32 m_bufferGeneration = 0; // sobe quando buffers (ou LODs) sao apagados
+    bool m_deferredSkinning = false;
+    bool m_skinningPending = false;
+
+    void MarkBoneDirty(u32 index);
+    static void RunSkinning(std::vector<Skinning::SkinningJob> &jobs, const std::vector<MeshBuffer *> &targets,
+                            const std::vector<SkinnedOutput *> *outputs = nullptr);
+
+    // Destino do skinning das SkeletonInstance: partilhado por todas e
+    // reaproveitado entre frames, so vive ate ao upload
+    static std::vector<Vertex> s_instanceVertices;
+    static std::vector<Vec4> s_instanceTangents;
+
+    static MeshBuffer *CreateSplitBuffer(const MeshBuffer *source, const MeshOptimizer::IndexSplit &split);
+    static u32 SplitBufferList(std::vector<MeshBuffer *> &list, u32 maxVertices);
 
     friend class MeshBuffer;
     friend class MeshManager;
     friend class Driver;
+    friend class MeshWriter;
+    friend class SkeletonInstance;
 
     void SortByMaterial();
+    const std::vector<MeshBuffer *> &GetActiveBuffers() const;
+    void BindMaterial(u32 material) const;
+};
+
+// ============================================================================
+// SKELETON INSTANCE
+// O rig (bones, hierarquia, bind pose, nomes, ordem) fica no Mesh e e so
+// lido; cada copia de um personagem tem as poses locais, globais e a paleta,
+// e muitas instancias partilham um Mesh e os mesmos clips. Os vertices
+// skinned (SkinnedOutput) so existem depois do primeiro UpdateSkinning
+// ============================================================================
+
+class SkeletonInstance
+{
+public:
+    explicit SkeletonInstance(const Mesh *mesh);
+    ~SkeletonInstance();
+    SkeletonInstance(const SkeletonInstance &) = delete;
+    SkeletonInstance &operator=(const SkeletonInstance &) = delete;
+
+    const Mesh *GetMesh() const { return m_mesh; }
+    u32 GetBoneCount() const { return (u32)m_positions.size(); }
+
+    void SetBoneTransform(u32 index, const Vec3 &position, const Quat &rotation);
+    void SetBoneStatic(u32 index);
+    void ResetBones();
+    void MarkPoseDirty();
+
+    // Como o Mesh::UpdateBonePalette, so os bones sujos e os descendentes.
+    // A ordem dos bones vem do rig (CalculateBoneMatrices no load ou depois
+    // de o montar); com a ordem velha avisa e nao mexe na paleta
+    void UpdateBonePalette();
+    const std::vector<Mat4> &GetBoneGlobals() const { return m_globals; }
+    const std::vector<Skinning::AffineMatrix> &GetBonePalette() const { return m_palette; }
+
+    // Unica entre todas as instancias: chave da pose nos SkinnedOutput
+    u32 GetPoseVersion() const { return m_poseVersion; }
+
+    // Saida de skinning desta instancia para um buffer do mesh (nullptr se
+    // ainda nao houve UpdateSkinning). Cresce com os vertices skinned (so
+    // os VBOs; indices e scratch de skinning sao partilhados).
+    // Se o mesh apagou buffers desde o ultimo Acquire (ClearLods,
+    // OptimizeBuffers...), as saidas antigas deixam de valer
+    SkinnedOutput *GetOutput(const MeshBuffer *buffer) const;
+    SkinnedOutput *AcquireOutput(const MeshBuffer *buffer);
+    void ReleaseOutputs();
+
+    size_t GetMemorySize() const; // CPU e os VBOs das saidas
+
+private:
+    const Mesh *m_mesh;
+    std::vector<Vec3> m_positions;
+    std::vector<Quat> m_rotations;
+    std::vector<u8> m_animated; // 0 = bind pose (localPose do rig)
+    std::vector<u8> m_boneDirty;
+    std::vector<Mat4> m_globals;
+    std::vector<Skinning::AffineMatrix> m_palette;
+    bool m_poseDirty = true;
+    u32 m_poseVersion = 0;
+    std::unordered_map<const MeshBuffer *, SkinnedOutput *> m_outputs;
+    u32 m_outputGeneration = 0; // Mesh::m_bufferGeneration das chaves de m_outputs
+
+    void Resize();
+    void MarkBoneDirty(u32 index);
 };
 
 class MeshLoader
@@ -567,6 +1045,10 @@ private:
     void WriteVerticesChunk(const MeshBuffer *buffer);
     void WriteIndicesChunk(const MeshBuffer *buffer);
     void WriteSkinChunk(const MeshBuffer *buffer);
+    void WriteTangentsChunk(const MeshBuffer *buffer);
+    void WriteQuantizedVerticesChunk(const MeshBuffer *buffer);
+    void WriteQuantizedSkinChunk(const MeshBuffer *buffer);
+    void WriteLodChunk(const Mesh *mesh, u32 lod);
 };
 
 class MeshReader
@@ -576,6 +1058,7 @@ public:
 
 private:
     Stream *m_stream;
+    u32 m_version = MESH_VERSION;
 
     ChunkHeader ReadChunkHeader();
     void SkipChunk(const ChunkHeader &header);
@@ -583,10 +1066,14 @@ private:
 
     void ReadMaterialsChunk(Mesh *mesh, const ChunkHeader &header);
     void ReadSkeletonChunk(Mesh *mesh, const ChunkHeader &header);
-    void ReadBufferChunk(Mesh *mesh, const ChunkHeader &header);
+    void ReadBufferChunk(Mesh *mesh, const ChunkHeader &header, s32 lod = -1);
+    void ReadLodChunk(Mesh *mesh, const ChunkHeader &header);
     void ReadVerticesChunk(MeshBuffer *buffer, const ChunkHeader &header);
     void ReadIndicesChunk(MeshBuffer *buffer, const ChunkHeader &header);
     void ReadSkinChunk(MeshBuffer *buffer, const ChunkHeader &header);
+    void ReadTangentsChunk(MeshBuffer *buffer, const ChunkHeader &header);
+    void ReadQuantizedVerticesChunk(MeshBuffer *buffer, const ChunkHeader &header);
+    void ReadQuantizedSkinChunk(MeshBuffer *buffer, const ChunkHeader &header);
 };
 
 class AnimReader
@@ -596,6 +1083,12 @@ public:
     {
         std::string boneName;                     // Nome do bone (ex: "mixamorig:LeftArm")
         std::vector<AnimationKeyframe> keyframes; // Keyframes ao longo do tempo
+
+        // CCHN: tracks comprimidas (keyframes vazio)
+        std::vector<float> positionTimes;
+        std::vector<Vec3> positions;
+        std::vector<float> rotationTimes;
+        std::vector<PackedQuat> rotations;
     };
 
     struct FrameAnimation
@@ -612,11 +1105,30 @@ public:
     };
 
     FrameAnimation *Load(const std::string &filename);
+    FrameAnimation *Load(Stream *stream);
 
 private:
     Stream *m_stream;
     bool ReadInfoChunk(FrameAnimation &info);
     bool ReadChannelChunk(Channel &channel);
+    bool ReadCompressedChannelChunk(Channel &channel);
+};
+
+class AnimWriter
+{
+public:
+    // Channels comprimidos vao como CCHN, os outros como CHAN
+    bool Save(const Animation *animation, const std::string &filename);
+
+private:
+    Stream *m_stream;
+
+    void BeginChunk(u32 chunkId, long *posOut);
+    void EndChunk(long startPos);
+
+    void WriteInfoChunk(const Animation *animation);
+    void WriteChannelChunk(const AnimationChannel &channel);
+    void WriteCompressedChannelChunk(const AnimationChannel &channel);
 };
 
 class MeshManager
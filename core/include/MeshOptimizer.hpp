@@ -0,0 +1,397 @@
+#pragma once
+#include "Config.hpp"
+#include "Math.hpp"
+#include <algorithm>
+#include <vector>
+
+struct Vertex;
+struct VertexSkin;
+
+// ============================================================================
+// MESH OPTIMIZER
+// Algoritmos que trabalham diretamente sobre arrays de vertices/indices.
+// Nao tocam em GL, por isso podem correr em tools/threads e ser testados
+// sem contexto. O MeshBuffer usa-os internamente.
+// ============================================================================
+
+namespace MeshOptimizer
+{
+    const u32 DEFAULT_CACHE_SIZE = 32;
+    const u32 MAX_CACHE_SIZE = 64;
+    const float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+    const float MAX_SKIN_DISTANCE = 0.5f;
+    const u32 MESHLET_MAX_VERTICES = 64;
+    const u32 MESHLET_MAX_TRIANGLES = 124;
+    const u32 INDEX16_MAX_VERTICES = 65536;
+
+    // Estatisticas do post-transform cache (simulado como FIFO)
+    // ACMR = vertices transformados / triangulos (ideal ~0.5, pior 3.0)
+    // ATVR = vertices transformados / vertices (ideal 1.0)
+    struct VertexCacheStats
+    {
+        u32 triangleCount = 0;
+        u32 vertexCount = 0;
+        u32 transformedVertices = 0;
+        float acmr = 0.0f;
+        float atvr = 0.0f;
+    };
+
+    // Estatisticas do vertex fetch (cache de linhas de 64 bytes, direct mapped)
+    // overfetch = bytes lidos / bytes dos vertices usados (ideal 1.0)
+    struct VertexFetchStats
+    {
+        u32 bytesFetched = 0;
+        float overfetch = 0.0f;
+    };
+
+    // Overdraw medido com um rasterizador por software em 6 vistas ortogonais
+    // overdraw = pixels sombreados / pixels cobertos (ideal 1.0)
+    struct OverdrawStats
+    {
+        u32 pixelsCovered = 0;
+        u32 pixelsShaded = 0;
+        float overdraw = 0.0f;
+    };
+
+    // Metricas de uma passada de otimizacao, medidas do mesmo jeito antes e depois
+    template <typename Stats> struct OptimizeResult
+    {
+        Stats before;
+        Stats after;
+    };
+
+    typedef OptimizeResult<VertexCacheStats> VertexCacheResult;
+    typedef OptimizeResult<VertexFetchStats> VertexFetchResult;
+    typedef OptimizeResult<OverdrawStats> OverdrawResult;
+
+    // Formatos compactos (opcionais) para o vertex buffer e para o .mesh
+    enum PositionFormat : u8
+    {
+        POSITION_FLOAT3 = 0, // 12 bytes
+        POSITION_HALF4,      // 8 bytes, w = 1
+        POSITION_SNORM16,    // 8 bytes, relativo aos bounds (ver GetPositionDecode)
+    };
+
+    enum NormalFormat : u8
+    {
+        NORMAL_FLOAT3 = 0, // 12 bytes
+        NORMAL_OCT16,      // 4 bytes, octahedral snorm16x2 (o shader descodifica)
+    };
+
+    enum TexCoordFormat : u8
+    {
+        TEXCOORD_FLOAT2 = 0, // 8 bytes
+        TEXCOORD_HALF2,      // 4 bytes
+    };
+
+    enum WeightFormat : u8
+    {
+        WEIGHT_FLOAT = 0, // 16 bytes
+        WEIGHT_UNORM16,   // 8 bytes
+        WEIGHT_UNORM8,    // 4 bytes
+    };
+
+    struct VertexFormat
+    {
+        PositionFormat position = POSITION_FLOAT3;
+        NormalFormat normal = NORMAL_FLOAT3;
+        TexCoordFormat texCoord = TEXCOORD_FLOAT2;
+        WeightFormat weights = WEIGHT_FLOAT;
+
+        bool IsFloat() const { return position == POSITION_FLOAT3 && normal == NORMAL_FLOAT3 && texCoord == TEXCOORD_FLOAT2; }
+    };
+
+    // Erro maximo por atributo depois de quantizar
+    struct QuantizationError
+    {
+        float position = 0.0f; // unidades do objeto
+        float normal = 0.0f;   // graus
+        float texCoord = 0.0f;
+        float weight = 0.0f;
+        u32 vertexBytes = 0;   // por vertice, antes -> depois
+        u32 packedBytes = 0;
+        u32 skinBytes = 0;
+        u32 packedSkinBytes = 0;
+    };
+
+    // Indices guardados em u16 enquanto o maior indice couber, senao em u32.
+    // Interface parecida com std::vector para o MeshBuffer; os algoritmos
+    // daqui trabalham em u32, por isso ToVector/Assign fazem a conversao
+    class IndexArray
+    {
+    public:
+        bool Is16Bit() const { return !m_wide; }
+        u32 GetIndexSize() const { return m_wide ? sizeof(u32) : sizeof(u16); }
+        size_t GetMemorySize() const { return (size_t)size() * GetIndexSize(); }
+
+        u32 size() const { return m_wide ? (u32)m_data32.size() : (u32)m_data16.size(); }
+        bool empty() const { return size() == 0; }
+        const void *data() const { return m_wide ? (const void *)m_data32.data() : (const void *)m_data16.data(); }
+        u32 operator[](size_t i) const { return m_wide ? m_data32[i] : m_data16[i]; }
+
+        void Set(size_t i, u32 value)
+        {
+            if (!m_wide && value > 0xFFFF)
+                Widen();
+            if (m_wide)
+                m_data32[i] = value;
+            else
+                m_data16[i] = (u16)value;
+        }
+
+        void push_back(u32 value)
+        {
+            if (!m_wide && value > 0xFFFF)
+                Widen();
+            if (m_wide)
+                m_data32.push_back(value);
+            else
+                m_data16.push_back((u16)value);
+        }
+
+        void reserve(size_t count)
+        {
+            if (m_wide)
+                m_data32.reserve(count);
+            else
+                m_data16.reserve(count);
+        }
+
+        // Volta a u16
+        void clear()
+        {
+            m_data16.clear();
+            m_data32.clear();
+            m_data16.shrink_to_fit();
+            m_data32.shrink_to_fit();
+            m_wide = false;
+        }
+
+        // Escolhe a largura pelo maior indice
+        void Assign(const u32 *indices, u32 count)
+        {
+            u32 maxIndex = 0;
+            for (u32 i = 0; i < count; ++i)
+                maxIndex = indices[i] > maxIndex ? indices[i] : maxIndex;
+
+            clear();
+            m_wide = maxIndex > 0xFFFF;
+            if (m_wide)
+                m_data32.assign(indices, indices + count);
+            else
+                m_data16.assign(indices, indices + count);
+        }
+        void Assign(const std::vector<u32> &indices) { Assign(indices.data(), (u32)indices.size()); }
+
+        void CopyTo(u32 *destination) const
+        {
+            if (m_wide)
+                std::copy(m_data32.begin(), m_data32.end(), destination);
+            else
+                std::copy(m_data16.begin(), m_data16.end(), destination);
+        }
+
+        std::vector<u32> ToVector() const
+        {
+            std::vector<u32> result(size());
+            CopyTo(result.data());
+            return result;
+        }
+
+        // indices[i] = table[indices[i]]; pode mudar de largura
+        void Remap(const u32 *table)
+        {
+            std::vector<u32> result = ToVector();
+            for (u32 &index : result)
+                index = table[index];
+            Assign(result);
+        }
+
+    private:
+        void Widen()
+        {
+            m_data32.assign(m_data16.begin(), m_data16.end());
+            m_data16.clear();
+            m_data16.shrink_to_fit();
+            m_wide = true;
+        }
+
+        std::vector<u16> m_data16;
+        std::vector<u32> m_data32;
+        bool m_wide = false;
+    };
+
+    // Grupo de triangulos de um buffer grande com no maximo maxVertices vertices.
+    // vertices: indices originais; indices: ja renumerados para o grupo
+    struct IndexSplit
+    {
+        std::vector<u32> vertices;
+        std::vector<u32> indices;
+    };
+
+    // Adjacencia vertice -> triangulos em CSR: os triangulos do vertice v sao
+    // faces[offsets[v] .. offsets[v + 1]), por ordem crescente. Um triangulo
+    // degenerado aparece uma vez por canto
+    struct VertexAdjacency
+    {
+        std::vector<u32> offsets; // vertexCount + 1
+        std::vector<u32> faces;   // indexCount
+
+        u32 GetFaceCount(u32 vertex) const { return offsets[vertex + 1] - offsets[vertex]; }
+        const u32 *GetFaces(u32 vertex) const { return faces.data() + offsets[vertex]; }
+        bool IsValid(u32 vertexCount, u32 indexCount) const
+        {
+            return offsets.size() == vertexCount + 1 && faces.size() == indexCount;
+        }
+    };
+
+    enum NormalWeighting : u8
+    {
+        NORMAL_WEIGHT_AREA = 0, // triangulos grandes pesam mais
+        NORMAL_WEIGHT_ANGLE,    // angulo do canto (nao depende da triangulacao)
+    };
+
+    // Cluster de triangulos contiguos no index buffer, com bounds para culling.
+    // Cone: o cluster esta todo de costas se
+    //   dot(normalize(coneApex - camera), coneAxis) >= coneCutoff
+    // coneCutoff > 1 quando as normais estao demasiado espalhadas (nunca passa)
+    struct Meshlet
+    {
+        u32 indexOffset = 0;
+        u32 indexCount = 0;
+        u32 vertexCount = 0;
+
+        Vec3 center;
+        float radius = 0.0f;
+
+        Vec3 coneApex;
+        Vec3 coneAxis;
+        float coneCutoff = 2.0f;
+    };
+
+    // Solda vertices cuja posicao, normal e UV estao todas dentro do threshold.
+    // As posicoes sao quantizadas numa hash grid com celulas do tamanho do
+    // threshold, e cada vertice so e comparado com as 27 celulas vizinhas.
+    // remap[i] recebe o novo indice do vertice i; os indices novos sao
+    // atribuidos pela ordem da primeira ocorrencia (igual ao metodo O(n^2)).
+    // Retorna o numero de vertices unicos.
+    u32 WeldVertices(const Vertex *vertices, u32 vertexCount, float threshold, std::vector<u32> &remap);
+
+    // Simula um cache FIFO de cacheSize entradas sobre a lista de triangulos
+    VertexCacheStats AnalyzeVertexCache(const u32 *indices, u32 indexCount, u32 vertexCount, u32 cacheSize = 16);
+
+    // Reordena os triangulos para o post-transform cache (Forsyth, "Linear-Speed
+    // Vertex Cache Optimisation"). Tempo linear: so os triangulos dos vertices
+    // que entram/saem do cache LRU simulado sao re-pontuados.
+    // destination pode ser o mesmo array que indices.
+    void OptimizeVertexCache(u32 *destination, const u32 *indices, u32 indexCount, u32 vertexCount,
+                             u32 cacheSize = DEFAULT_CACHE_SIZE);
+
+    VertexFetchStats AnalyzeVertexFetch(const u32 *indices, u32 indexCount, u32 vertexCount, u32 vertexSize);
+
+    // Renumera os vertices pela ordem do primeiro uso nos indices.
+    // Vertices nao referenciados vao para o fim, pela ordem original.
+    // remap[i] recebe o novo indice do vertice i (vertexCount entradas).
+    // Retorna o numero de vertices referenciados.
+    u32 OptimizeVertexFetchRemap(u32 *remap, const u32 *indices, u32 indexCount, u32 vertexCount);
+
+    OverdrawStats AnalyzeOverdraw(const u32 *indices, u32 indexCount, const Vertex *vertices, u32 vertexCount);
+
+    // Reordena clusters de triangulos para desenhar primeiro os que estao
+    // virados para fora (Sander et al., "Fast Triangle Reordering for Vertex
+    // Locality and Reduced Overdraw"). Espera indices ja otimizados para o
+    // cache; threshold limita a perda de ACMR (1.05 = ate 5% pior).
+    // destination pode ser o mesmo array que indices.
+    void OptimizeOverdraw(u32 *destination, const u32 *indices, u32 indexCount, const Vertex *vertices, u32 vertexCount,
+                          float threshold = DEFAULT_OVERDRAW_THRESHOLD);
+
+    // Simplificacao por edge collapse com quadricas (Garland-Heckbert).
+    // Os vertices colapsam para vizinhos que ja existem, por isso UVs, normais
+    // e skin continuam validos. Seams de UV/normal so colapsam ao longo do
+    // proprio seam, bordas abertas ficam presas, e com skin != nullptr nao ha
+    // colapsos entre vertices cujos pesos diferem mais que MAX_SKIN_DISTANCE.
+    // Para quando chega a targetIndexCount ou quando o proximo colapso passa
+    // targetError (distancia em unidades do objeto).
+    // Retorna o numero de indices escritos; resultError recebe o erro final.
+    u32 SimplifyMesh(u32 *destination, const u32 *indices, u32 indexCount, const Vertex *vertices, const VertexSkin *skin,
+                     u32 vertexCount, u32 targetIndexCount, float targetError, float *resultError = nullptr);
+
+    // Parte os triangulos em meshlets de ate maxVertices/maxTriangles. Cresce
+    // cada cluster pelos triangulos vizinhos que trazem menos vertices novos
+    // e estao mais alinhados com a normal do cluster (cones mais apertados).
+    // destination recebe os indices reordenados (meshlets contiguos) e pode
+    // ser o mesmo array que indices.
+    u32 BuildMeshlets(std::vector<Meshlet> &meshlets, u32 *destination, const u32 *indices, u32 indexCount,
+                      const Vertex *vertices, u32 vertexCount,
+                      u32 maxVertices = MESHLET_MAX_VERTICES, u32 maxTriangles = MESHLET_MAX_TRIANGLES);
+
+    bool IsMeshletBackfacing(const Meshlet &meshlet, const Vec3 &cameraPosition);
+
+    // Parte os triangulos (pela ordem do index buffer, para manter o cache) em
+    // grupos que cabem em indices u16. Retorna o numero de grupos
+    u32 SplitIndices(std::vector<IndexSplit> &splits, const u32 *indices, u32 indexCount, u32 vertexCount,
+                     u32 maxVertices = INDEX16_MAX_VERTICES);
+
+    void BuildVertexAdjacency(VertexAdjacency &adjacency, const u32 *indices, u32 indexCount, u32 vertexCount);
+
+    // Normais suaves: normais das faces em paralelo e depois um gather por
+    // vertice sobre a adjacencia (cada vertice so escreve em si, sem races).
+    // Vertices sem triangulos ficam com normal zero
+    void GenerateNormals(Vertex *vertices, u32 vertexCount, const u32 *indices, u32 indexCount,
+                         const VertexAdjacency &adjacency, NormalWeighting weighting = NORMAL_WEIGHT_AREA);
+
+    // Tangentes MikkTSpace: por canto, projetadas no plano da normal e
+    // pesadas pelo angulo do canto; w = sinal da bitangente
+    // (B = w * cross(N, T)). Como no Mikk, os cantos de um vertice so se
+    // juntam se as faces estiverem ligadas por arestas desse vertice e
+    // tiverem a mesma orientacao UV; cada grupo a mais vira uma copia (UVs
+    // espelhados, leques separados). Diferencas: vertices com indices
+    // diferentes nunca se soldam (o Mikk compara os dados), nao ha limite
+    // de angulo entre grupos (o default do Mikk, 180) e as faces degeneradas
+    // ficam no vertice original. A copia k fica no indice vertexCount + k,
+    // duplicates[k] recebe o vertice original e indices e reescrito.
+    // tangents recebe vertexCount + duplicates.size() entradas.
+    void GenerateTangents(std::vector<Vec4> &tangents, std::vector<u32> &duplicates, u32 *indices, u32 indexCount,
+                          const Vertex *vertices, u32 vertexCount);
+
+    u16 EncodeHalf(float value);
+    float DecodeHalf(u16 value);
+
+    // Normal unitaria -> 2 componentes snorm16 (octahedral)
+    void EncodeOctahedral(const Vec3 &normal, s16 out[2]);
+    Vec3 DecodeOctahedral(const s16 in[2]);
+
+    // Pesos -> inteiros [0, maxValue] cuja soma e exatamente maxValue
+    void QuantizeWeights(const float weights[4], u32 maxValue, u32 out[4]);
+
+    u32 GetVertexStride(const VertexFormat &format);
+    u32 GetSkinStride(const VertexFormat &format);
+
+    // Layout que vai para a GPU. Sem descodificacao no shader (shaderDecode
+    // false) os formatos que a pedem passam aos mais proximos que um
+    // "in vec3" le diretamente: SNORM16 -> HALF4, OCT16 -> FLOAT3
+    VertexFormat GetGpuFormat(const VertexFormat &format, bool shaderDecode);
+
+    // Funcoes GLSL para quem liga a descodificacao: decodeOctNormal(vec2) e
+    // decodePosition(vec4, mat4) com a matriz do MeshBuffer::GetPositionDecode
+    extern const char *VERTEX_DECODE_GLSL;
+
+    // Bounds para POSITION_SNORM16: centro + escala uniforme (normais nao deformam)
+    void ComputeQuantizationBounds(const Vertex *vertices, u32 vertexCount, Vec3 &center, float &scale);
+
+    // Empacota/desempacota no layout do vertex buffer (posicao, normal, uv)
+    void PackVertices(u8 *destination, const Vertex *vertices, u32 vertexCount, const VertexFormat &format,
+                      const Vec3 &center, float scale);
+    void UnpackVertices(Vertex *destination, const u8 *data, u32 vertexCount, const VertexFormat &format,
+                        const Vec3 &center, float scale);
+
+    // Skin: 4 bone ids (u8) + 4 pesos no formato pedido
+    void PackSkin(u8 *destination, const VertexSkin *skin, u32 vertexCount, const VertexFormat &format);
+    void UnpackSkin(VertexSkin *destination, const u8 *data, u32 vertexCount, const VertexFormat &format);
+
+    // Empacota e desempacota para medir o erro; sem center/scale usa os bounds dos vertices
+    QuantizationError AnalyzeQuantization(const Vertex *vertices, const VertexSkin *skin, u32 vertexCount,
+                                          const VertexFormat &format);
+    QuantizationError AnalyzeQuantization(const Vertex *vertices, const VertexSkin *skin, u32 vertexCount,
+                                          const VertexFormat &format, const Vec3 &center, float scale);
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "Config.hpp"
+#include "Math.hpp"
+
+struct Vertex;
+struct VertexSkin;
+
+// ============================================================================
+// SKINNING
+// Kernels de skinning no CPU sobre arrays, sem GL (como o MeshOptimizer).
+// Os bones vem numa paleta de matrizes afins 3x4; cada vertice mistura as
+// suas 4 matrizes pelos pesos e transforma uma vez. Pesos a zero entram na
+// mistura (sem branches), bone ids fora da paleta contam como peso zero.
+// Com AVX faz 2 vertices por iteracao, com SSE3 um; senao o escalar.
+// ============================================================================
+
+namespace Skinning
+{
+    // Linhas 0..2 de uma Mat4 afim (a ultima e sempre 0 0 0 1), row-major
+    struct alignas(16) AffineMatrix
+    {
+        float m[12];
+    };
+
+    enum SkinningMode : u8
+    {
+        SKIN_FULL = 0,      // posicao, normal e tangente
+        SKIN_POSITION_ONLY, // sombras/depth: so a posicao
+    };
+
+    void ToAffine(AffineMatrix *destination, const Mat4 *matrices, u32 count);
+
+    // Posicao, normal (normalizada), uv e, se tangents != nullptr, a tangente
+    // (xyz normalizado, w copiado). Retorna os bounds das posicoes
+    BoundingBox SkinVertices(Vertex *destination, const Vertex *vertices, const VertexSkin *skin, u32 vertexCount,
+                             const AffineMatrix *bones, u32 boneCount, Vec4 *destinationTangents = nullptr,
+                             const Vec4 *tangents = nullptr);
+
+    // So x, y, z de destination; o resto do vertice fica como estava
+    BoundingBox SkinPositions(Vertex *destination, const Vertex *vertices, const VertexSkin *skin, u32 vertexCount,
+                              const AffineMatrix *bones, u32 boneCount);
+
+    // Versoes escalares: fallback e referencia para os testes
+    BoundingBox SkinVerticesScalar(Vertex *destination, const Vertex *vertices, const VertexSkin *skin,
+                                   u32 vertexCount, const AffineMatrix *bones, u32 boneCount,
+                                   Vec4 *destinationTangents = nullptr, const Vec4 *tangents = nullptr);
+    BoundingBox SkinPositionsScalar(Vertex *destination, const Vertex *vertices, const VertexSkin *skin,
+                                    u32 vertexCount, const AffineMatrix *bones, u32 boneCount);
+
+    // "AVX", "SSE3" ou "scalar"
+    const char *GetKernelName();
+
+    const u32 SKINNING_GRAIN = 2048; // vertices por bloco no JobSystem
+
+    // Um buffer para skinning. RunJobs parte todos os jobs em blocos de
+    // vertices e corre tudo num so ParallelFor (uma multidao inteira escala
+    // pelos cores); bounds fica com as posicoes do job inteiro
+    struct SkinningJob
+    {
+        Vertex *destination = nullptr;
+        const Vertex *vertices = nullptr;
+        const VertexSkin *skin = nullptr;
+        u32 vertexCount = 0;
+        const AffineMatrix *bones = nullptr;
+        u32 boneCount = 0;
+        Vec4 *destinationTangents = nullptr; // opcional, so em SKIN_FULL
+        const Vec4 *tangents = nullptr;
+        SkinningMode mode = SKIN_FULL;
+        BoundingBox bounds;
+    };
+
+    void RunJobs(SkinningJob *jobs, u32 count, u32 grain = SKINNING_GRAIN);
+
+    // Pose que esta num buffer de saida: dono (Mesh ou SkeletonInstance),
+    // GetPoseVersion() desse dono e modo. Uma completa tambem serve para
+    // position-only. Reset quando o buffer volta a ter a bind pose
+    struct SkinnedPose
+    {
+        const void *owner = nullptr;
+        u32 version = 0; // 0 = nenhuma
+        SkinningMode mode = SKIN_FULL;
+
+        bool Matches(const void *pose, u32 poseVersion, SkinningMode wanted) const
+        {
+            return owner && owner == pose && version == poseVersion && (mode == SKIN_FULL || mode == wanted);
+        }
+        void Set(const void *pose, u32 poseVersion, SkinningMode wanted)
+        {
+            owner = pose;
+            version = poseVersion;
+            mode = wanted;
+        }
+        void Reset()
+        {
+            owner = nullptr;
+            version = 0;
+        }
+    };
+}
@@ -13,7 +13,11 @@ enum VertexElementType
     VET_COLOR,  // 4 bytes RGBA
     VET_SHORT2, // 2 shorts
     VET_SHORT4, // 4 shorts
-    VET_UBYTE4  // 4 unsigned bytes
+    VET_UBYTE4, // 4 unsigned bytes
+    VET_SHORT2N,  // 2 shorts normalizados [-1, 1]
+    VET_SHORT4N,  // 4 shorts normalizados [-1, 1]
+    VET_HALF2,    // 2 half floats
+    VET_HALF4     // 4 half floats
 };
 
 enum VertexElementSemantic
@@ -156,6 +160,7 @@ public:
     // Getters
     u32 GetIndexCount() const { return m_indexCount; }
     u32 GetIndexType() const;
+    bool Is16Bit() const { return m_is16Bit; }
     u32 GetHandle() const { return m_ibo; }
     bool IsValid() const { return m_ibo != 0; }
 };
@@ -171,6 +176,7 @@ private:
     VertexDeclaration *m_vertexDeclaration;
     std::vector<VertexBuffer *> m_vertexBuffers;
     IndexBuffer *m_indexBuffer;
+    bool m_ownsIndexBuffer;
     mutable bool m_isBuilt;
     mutable bool m_needsRebuild;
 
@@ -192,6 +198,9 @@ public:
 
     VertexBuffer *AddVertexBuffer(u32 vSize, u32 vCount, bool dynamic = false);
     IndexBuffer *CreateIndexBuffer(u32 iCount, bool dynamic = false, bool use16Bit = true);
+    // Usa o index buffer de outro VAO sem ficar dono: quem o partilha tem de
+    // deixar de renderizar antes de o dono o apagar
+    void ShareIndexBuffer(IndexBuffer *indexBuffer);
 
     void Release();
 
@@ -199,6 +208,8 @@ public:
     void MarkDirty() { m_needsRebuild = true; }
 
     void Render(PrimitiveType type, u32 count) const;
+    // first/count em indices (ou vertices, sem index buffer)
+    void RenderRange(PrimitiveType type, u32 first, u32 count) const;
     void RenderInstanced(PrimitiveType type, u32 count, u32 instanceCount) const;
 
     bool IsValid() const { return m_vao != 0; }
@@ -3,6 +3,7 @@
 #include "Mesh.hpp"
 #include "Texture.hpp"
 #include "Stream.hpp"
+#include <functional>
 
 
 Animator::Animator(Mesh *mesh)
@@ -21,10 +22,67 @@ Animator::~Animator()
 
 void Animator::Update(float deltaTime)
 {
+    const u32 boneCount = m_mesh->GetBoneCount();
+    if (m_bindPositions.size() != boneCount)
+    {
+        m_bindPositions.resize(boneCount);
+        m_bindRotations.resize(boneCount);
+        for (u32 bone = 0; bone < boneCount; bone++)
+            Mat4::DecomposeMatrix(m_mesh->GetBone(bone)->localPose, &m_bindPositions[bone], &m_bindRotations[bone]);
+    }
+
+    // Pose local do frame: parte da bind pose e cada layer mistura por cima
+    m_posePositions = m_bindPositions;
+    m_poseRotations = m_bindRotations;
+    m_poseUsed.assign(boneCount, 0);
+
     for (size_t i = 0; i < layers.size(); i++)
     {
-        layers[i]->Update(deltaTime);
+        AnimationLayer *layer = layers[i];
+        layer->Advance(deltaTime);
+        if (layer->m_weight <= 0.0f)
+            continue;
+
+        const u32 count = std::min((u32)layer->m_poseValid.size(), boneCount);
+        for (u32 bone = 0; bone < count; bone++)
+        {
+            if (!layer->m_poseValid[bone])
+                continue;
+            const float weight = layer->GetBoneWeight(bone);
+            if (weight <= 0.0f)
+                continue;
+
+            if (weight >= 1.0f)
+            {
+                m_posePositions[bone] = layer->m_posePositions[bone];
+                m_poseRotations[bone] = layer->m_poseRotations[bone];
+            }
+            else
+            {
+                m_posePositions[bone] = Vec3::Lerp(m_posePositions[bone], layer->m_posePositions[bone], weight);
+                m_poseRotations[bone] = Quat::Slerp(m_poseRotations[bone], layer->m_poseRotations[bone], weight);
+            }
+            m_poseUsed[bone] = 1;
+        }
+    }
+
+    // Bones sem layer ficam como estavam; um so skinning por frame
+    if (m_instance)
+    {
+        for (u32 bone = 0; bone < boneCount; bone++)
+        {
+            if (m_poseUsed[bone])
+                m_instance->SetBoneTransform(bone, m_posePositions[bone], m_poseRotations[bone]);
+        }
+        return;
     }
+
+    for (u32 bone = 0; bone < boneCount; bone++)
+    {
+        if (m_poseUsed[bone])
+            m_mesh->SetBoneTransform(bone, m_posePositions[bone], m_poseRotations[bone]);
+    }
+    m_mesh->UpdateSkinning();
 }
 
 AnimationLayer *Animator::AddLayer()
@@ -55,20 +113,59 @@ AnimationLayer::~AnimationLayer()
     // Deleta as animações que foram criadas pelo AnimationLayer
     for (auto &pair : m_animations)
     {
-        delete pair.second;
+        if (std::find(m_sharedAnimations.begin(), m_sharedAnimations.end(), pair.second) == m_sharedAnimations.end())
+            delete pair.second;
     }
+    for (Animation *anim : m_libraryAnimations)
+        AnimationLibrary::Instance().Release(anim);
     m_animations.clear();
+    m_sharedAnimations.clear();
+    m_libraryAnimations.clear();
+    m_bindings.clear();
+    m_cursors.clear();
 }
 
 // ============================================================================
 // GERENCIAMENTO DE ANIMAÇÕES
 // ============================================================================
 
-void AnimationLayer::AddAnimation(const std::string &name, Animation *anim)
+void AnimationLayer::AddAnimation(const std::string &name, Animation *anim, bool owned)
 {
     m_animations[name] = anim;
-    if (anim)
+    if (!anim)
+        return;
+
+    if (owned)
         anim->BindToMesh(m_mesh);
+    else
+        m_sharedAnimations.push_back(anim);
+    m_bindings.erase(anim);
+    m_cursors.erase(anim);
+    GetBinding(anim);
+}
+
+const std::vector<u32> &AnimationLayer::GetBinding(const Animation *anim)
+{
+    std::vector<u32> &binding = m_bindings[anim];
+    if (binding.size() != anim->m_channels.size())
+    {
+        binding.resize(anim->m_channels.size());
+        for (size_t c = 0; c < binding.size(); c++)
+        {
+            binding[c] = m_mesh->FindBoneIndex(anim->m_channels[c].boneName);
+            if (binding[c] == (u32)-1)
+                LogWarning("[AnimationLayer] Bone not found: %s", anim->m_channels[c].boneName.c_str());
+        }
+    }
+    return binding;
+}
+
+AnimationCursor *AnimationLayer::GetCursors(const Animation *anim)
+{
+    std::vector<AnimationCursor> &cursors = m_cursors[anim];
+    if (cursors.size() != anim->m_channels.size())
+        cursors.assign(anim->m_channels.size(), AnimationCursor());
+    return cursors.data();
 }
 
 Animation *AnimationLayer::GetAnimation(const std::string &name)
@@ -84,15 +181,12 @@ Animation *AnimationLayer::LoadAnimation(const std::string &name, const std::str
     if (GetAnimation(name))
         return nullptr;
 
-    Animation *anim = new Animation();
-    if (!anim->Load(filename))
-    {
-        delete anim;
+    Animation *anim = AnimationLibrary::Instance().Acquire(filename);
+    if (!anim)
         return nullptr;
-    }
-    anim->m_name = name;
 
-    AddAnimation(name, anim);
+    m_libraryAnimations.push_back(anim);
+    AddAnimation(name, anim, false);
     return anim;
 }
 
@@ -129,6 +223,7 @@ void AnimationLayer::Play(const std::string &animName, PlayMode mode, float blen
     }
 
     m_playTo = anim;
+    m_playToName = animName;
     m_currentMode = mode;
     m_shouldReturn = false;
     m_isPingPongReverse = false;
@@ -209,9 +304,27 @@ bool AnimationLayer::IsPlaying(const std::string &animName) const
 
 void AnimationLayer::Update(float deltaTime)
 {
+    // Layer sozinho: a pose vai direta para o mesh
+    Advance(deltaTime);
+    for (u32 bone = 0; bone < (u32)m_poseValid.size(); bone++)
+    {
+        if (m_poseValid[bone])
+            m_mesh->SetBoneTransform(bone, m_posePositions[bone], m_poseRotations[bone]);
+    }
+    m_mesh->UpdateSkinning();
+}
+
+void AnimationLayer::Advance(float deltaTime)
+{
+    // Pausado mantem a ultima pose
     if (m_isPaused)
         return;
 
+    const u32 boneCount = m_mesh->GetBoneCount();
+    m_posePositions.resize(boneCount);
+    m_poseRotations.resize(boneCount);
+    m_poseValid.assign(boneCount, 0);
+
     float dt = deltaTime * m_globalSpeed;
     bool isOnBlend = false;
 
@@ -223,7 +336,7 @@ void AnimationLayer::Update(float deltaTime)
             if (m_currentAnim)
             {
                 m_previousAnim = m_currentAnim;
-                m_previousAnimName = m_currentAnim->GetName();
+                m_previousAnimName = m_currentAnimName;
             }
 
             if (m_isBlending)
@@ -240,7 +353,7 @@ void AnimationLayer::Update(float deltaTime)
                     m_blendTime = 0.0f;
                     m_blendDuration = 0.0f;
                     isOnBlend = false;
-                    m_currentAnimName = m_playTo->GetName(); 
+                    m_currentAnimName = m_playToName; 
                     m_currentAnim = m_playTo;
                     m_playTo = nullptr;
                 }
@@ -249,7 +362,7 @@ void AnimationLayer::Update(float deltaTime)
                     
                   //  LogInfo("[ANIMATOR]  Blending %f - %f - Blend %f ", m_blendTime, m_blendDuration,blend);
 
-                       m_currentAnimName= m_playTo->GetName(); 
+                       m_currentAnimName = m_playToName; 
                        m_currentTimeBlend+= dt  * m_playTo->GetTicksPerSecond();
 
                        while (m_currentTimeBlend >= m_playTo->GetDuration())
@@ -259,41 +372,9 @@ void AnimationLayer::Update(float deltaTime)
                   
                         isOnBlend = true;
 
-                        for (const auto &channel : m_currentAnim->m_channels)
-                        {
-                            if (channel.boneIndex == (u32)-1)
-                                continue;
-
-                            
-                            Vec3 pos1, pos2;
-                            Quat rot1, rot2;
-
-                            pos1 = m_currentAnim->InterpolatePosition(channel, m_currentTime);
-                            rot1 = m_currentAnim->InterpolateRotation(channel, m_currentTime);
-
-                            AnimationChannel* newCh = m_playTo->FindChannel(channel.boneName);
-                            if (newCh)
-                            {
-                                pos2 = m_playTo->InterpolatePosition(*newCh,m_currentTimeBlend);
-                                rot2 = m_playTo->InterpolateRotation(*newCh,m_currentTimeBlend);
-
-                                Vec3 finalPos = Vec3::Lerp(pos1 , pos2, blend);
-                                Quat finalRot = Quat::Slerp(rot1, rot2, blend);
-                    
-
-                            m_mesh->SetBoneTransform(channel.boneIndex, finalPos, finalRot);
-                            }
-                            else
-                            {
-                                //LogWarning("Channel not found: %s", channel.boneName.c_str());
-                                m_mesh->SetBoneTransform(channel.boneIndex, pos1, rot1);
-                            }
-
-
-
-                       
-                        }
-                        m_mesh->UpdateSkinning();
+                        // Os dois clips pelo binding de cada channel, sem procurar nomes
+                        SampleToPose(m_currentAnim, m_currentTime, 1.0f);
+                        SampleToPose(m_playTo, m_currentTimeBlend, blend);
                 }
 
 
@@ -306,7 +387,7 @@ void AnimationLayer::Update(float deltaTime)
                 m_isBlending = false;
                 m_blendTime = 0.0f;
                 m_blendDuration = 0.0f;
-                m_currentAnimName = m_playTo->GetName();
+                m_currentAnimName = m_playToName;
                 m_currentAnim = m_playTo;
                 m_playTo = nullptr;
             }
@@ -364,19 +445,92 @@ void AnimationLayer::Update(float deltaTime)
         }
 
         // Sample da animação
-        for (const auto &channel : m_currentAnim->m_channels)
+        SampleToPose(m_currentAnim, m_currentTime, 1.0f);
+    }
+}
+
+void AnimationLayer::SampleToPose(Animation *anim, float time, float weight)
+{
+    // A pose toda de uma vez (clips baked leem 2 linhas), depois por bone
+    const u32 channelCount = anim->GetChannelCount();
+    m_positions.resize(channelCount);
+    m_rotations.resize(channelCount);
+    anim->SamplePose(time, m_positions.data(), m_rotations.data(), GetCursors(anim));
+
+    const std::vector<u32> &binding = GetBinding(anim);
+    for (u32 c = 0; c < channelCount; c++)
+    {
+        const u32 bone = binding[c];
+        if (bone >= (u32)m_poseValid.size())
+            continue;
+
+        // Bones que so o segundo clip tem entram com o valor dele
+        if (weight >= 1.0f || !m_poseValid[bone])
         {
-            if (channel.boneIndex == (u32)-1)
-                continue;
+            m_posePositions[bone] = m_positions[c];
+            m_poseRotations[bone] = m_rotations[c];
+        }
+        else
+        {
+            m_posePositions[bone] = Vec3::Lerp(m_posePositions[bone], m_positions[c], weight);
+            m_poseRotations[bone] = Quat::Slerp(m_poseRotations[bone], m_rotations[c], weight);
+        }
+        m_poseValid[bone] = 1;
+    }
+}
+
+// ============================================================================
+// MASCARA E PESO
+// ============================================================================
 
-            Vec3 pos = m_currentAnim->InterpolatePosition(channel, m_currentTime);
-            Quat rot = m_currentAnim->InterpolateRotation(channel, m_currentTime);
-            m_mesh->SetBoneTransform(channel.boneIndex, pos, rot);
+void AnimationLayer::SetBoneMask(const std::string &rootBone)
+{
+    const std::vector<Bone *> &bones = m_mesh->GetBones();
+    const u32 root = m_mesh->FindBoneIndex(rootBone);
+    if (root == (u32)-1)
+    {
+        LogWarning("[AnimationLayer] Mask bone not found: %s", rootBone.c_str());
+        return;
+    }
+
+    // 1 no bone e nos descendentes, 0 no resto
+    m_boneMask.assign(bones.size(), 0.0f);
+    for (u32 i = 0; i < (u32)bones.size(); i++)
+    {
+        s32 bone = (s32)i;
+        for (u32 depth = 0; bone >= 0 && depth < bones.size(); depth++)
+        {
+            if ((u32)bone == root)
+            {
+                m_boneMask[i] = 1.0f;
+                break;
+            }
+            bone = bones[bone]->parentIndex;
         }
-        m_mesh->UpdateSkinning();
     }
 }
 
+void AnimationLayer::SetBoneWeight(u32 boneIndex, float weight)
+{
+    if (boneIndex >= m_mesh->GetBoneCount())
+        return;
+    if (m_boneMask.size() != m_mesh->GetBoneCount())
+        m_boneMask.assign(m_mesh->GetBoneCount(), 1.0f);
+    m_boneMask[boneIndex] = weight;
+}
+
+void AnimationLayer::ClearBoneMask()
+{
+    m_boneMask.clear();
+}
+
+float AnimationLayer::GetBoneWeight(u32 boneIndex) const
+{
+    if (boneIndex >= m_boneMask.size())
+        return m_weight;
+    return m_weight * m_boneMask[boneIndex];
+}
+
 
 
 // ============================================================================
@@ -423,4 +577,520 @@ bool AnimationLayer::CheckAnimationEnd()
     }
 
     return false;
-}
\ No newline at end of file
+}
+
+// ============================================================================
+// COMPRESSAO
+// ============================================================================
+
+namespace
+{
+    const float QUAT_RANGE = 0.70710678f; // as 3 menores cabem em +-1/sqrt(2)
+    const float QUAT_STEPS = 32767.0f;    // 15 bits
+
+    float Factor(float t0, float t1, float time)
+    {
+        return t1 > t0 ? (time - t0) / (t1 - t0) : 0.0f;
+    }
+
+    // Angulo da rotacao entre a e b. Pela corda e nao pelo acos do dot,
+    // que em float nao distingue angulos abaixo de ~5e-4
+    float QuatAngle(const Quat &a, const Quat &b)
+    {
+        const Quat qa = a.normalized();
+        Quat qb = b.normalized();
+        if (Quat::Dot(qa, qb) < 0.0f)
+            qb = -qb;
+        const float half = (qa - qb).length() * 0.5f;
+        return 4.0f * std::asin(half < 1.0f ? half : 1.0f);
+    }
+
+    // Guarda a primeira e a ultima chave; cada intervalo vai ate a chave mais
+    // longe cujas chaves do meio a interpolacao entre as pontas reproduz.
+    // O alcance procura-se a duplicar o passo e depois por bissecao:
+    // O(n log n) testes em vez de O(n^2) a crescer uma chave de cada vez
+    template <typename Error>
+    std::vector<u32> ReduceKeys(u32 count, float tolerance, Error error)
+    {
+        auto fits = [&](u32 anchor, u32 end)
+        {
+            for (u32 k = anchor + 1; k < end; ++k)
+            {
+                if (error(anchor, end, k) > tolerance)
+                    return false;
+            }
+            return true;
+        };
+
+        std::vector<u32> kept(1, 0);
+        u32 anchor = 0;
+        while (anchor + 1 < count)
+        {
+            u32 good = anchor + 1; // chaves vizinhas cabem sempre
+            u32 bad = count;
+            for (u32 span = 2;; span *= 2)
+            {
+                const u32 end = std::min(anchor + span, count - 1);
+                if (end <= good)
+                    break;
+                if (!fits(anchor, end))
+                {
+                    bad = end;
+                    break;
+                }
+                good = end;
+            }
+            while (bad - good > 1)
+            {
+                const u32 middle = good + (bad - good) / 2;
+                if (fits(anchor, middle))
+                    good = middle;
+                else
+                    bad = middle;
+            }
+            kept.push_back(good);
+            anchor = good;
+        }
+        return kept;
+    }
+
+    void CompressChannel(AnimationChannel &channel, const AnimationCompression &settings)
+    {
+        const std::vector<AnimationKeyframe> &keys = channel.keyframes;
+        const u32 count = (u32)keys.size();
+
+        // Posicoes
+        bool constant = true;
+        for (u32 k = 1; k < count && constant; ++k)
+            constant = (keys[k].position - keys[0].position).length() <= settings.positionTolerance;
+
+        std::vector<u32> kept = constant ? std::vector<u32>(1, 0)
+                                         : ReduceKeys(count, settings.positionTolerance, [&](u32 a, u32 b, u32 k)
+                                                      {
+                                                          const Vec3 p = Vec3::Lerp(keys[a].position, keys[b].position,
+                                                                                    Factor(keys[a].time, keys[b].time, keys[k].time));
+                                                          return (p - keys[k].position).length();
+                                                      });
+        channel.positionTimes.clear();
+        channel.positions.clear();
+        for (u32 k : kept)
+        {
+            channel.positionTimes.push_back(keys[k].time);
+            channel.positions.push_back(keys[k].position);
+        }
+
+        // Rotacoes: o erro mede-se ja com as chaves quantizadas
+        std::vector<PackedQuat> packed(count);
+        std::vector<Quat> decoded(count);
+        for (u32 k = 0; k < count; ++k)
+        {
+            packed[k] = PackedQuat::Pack(keys[k].rotation);
+            decoded[k] = packed[k].Unpack();
+        }
+
+        constant = true;
+        for (u32 k = 1; k < count && constant; ++k)
+            constant = QuatAngle(decoded[0], keys[k].rotation) <= settings.rotationTolerance;
+
+        kept = constant ? std::vector<u32>(1, 0)
+                        : ReduceKeys(count, settings.rotationTolerance, [&](u32 a, u32 b, u32 k)
+                                     {
+                                         const Quat q = Quat::Slerp(decoded[a], decoded[b],
+                                                                    Factor(keys[a].time, keys[b].time, keys[k].time));
+                                         return QuatAngle(q, keys[k].rotation);
+                                     });
+        channel.rotationTimes.clear();
+        channel.rotations.clear();
+        for (u32 k : kept)
+        {
+            channel.rotationTimes.push_back(keys[k].time);
+            channel.rotations.push_back(packed[k]);
+        }
+
+        std::vector<AnimationKeyframe>().swap(channel.keyframes);
+    }
+}
+
+PackedQuat PackedQuat::Pack(const Quat &rotation)
+{
+    const Quat q = rotation.normalized();
+    const float c[4] = {q.x, q.y, q.z, q.w};
+
+    u32 largest = 0;
+    for (u32 i = 1; i < 4; ++i)
+    {
+        if (std::fabs(c[i]) > std::fabs(c[largest]))
+            largest = i;
+    }
+
+    // q e -q sao a mesma rotacao: a maior fica positiva e nao se guarda
+    const float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+    u64 bits = largest;
+    for (u32 i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+        float v = (c[i] * sign + QUAT_RANGE) / (2.0f * QUAT_RANGE);
+        v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+        bits = (bits << 15) | (u64)(v * QUAT_STEPS + 0.5f);
+    }
+
+    PackedQuat result;
+    result.data[0] = (u16)(bits >> 32);
+    result.data[1] = (u16)(bits >> 16);
+    result.data[2] = (u16)bits;
+    return result;
+}
+
+Quat PackedQuat::Unpack() const
+{
+    const u64 bits = ((u64)data[0] << 32) | ((u64)data[1] << 16) | (u64)data[2];
+    const u32 largest = (u32)(bits >> 45) & 3;
+
+    float c[4];
+    float sum = 0.0f;
+    u32 shift = 30;
+    for (u32 i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+        c[i] = (float)((bits >> shift) & 0x7FFF) / QUAT_STEPS * (2.0f * QUAT_RANGE) - QUAT_RANGE;
+        sum += c[i] * c[i];
+        shift -= 15;
+    }
+    c[largest] = std::sqrt(sum < 1.0f ? 1.0f - sum : 0.0f);
+
+    return Quat(c[0], c[1], c[2], c[3]);
+}
+
+size_t AnimationChannel::GetMemorySize() const
+{
+    return keyframes.size() * sizeof(AnimationKeyframe) + positionTimes.size() * sizeof(float) +
+           positions.size() * sizeof(Vec3) + rotationTimes.size() * sizeof(float) +
+           rotations.size() * sizeof(PackedQuat);
+}
+
+void Animation::Compress(const AnimationCompression &settings)
+{
+    size_t before = GetMemorySize();
+    for (AnimationChannel &channel : m_channels)
+    {
+        if (!channel.keyframes.empty())
+            CompressChannel(channel, settings);
+    }
+
+    LogInfo("[Animation] Compressed %s: %zu -> %zu bytes", m_name.c_str(), before, GetMemorySize());
+}
+
+bool Animation::IsCompressed() const
+{
+    bool compressed = false;
+    for (const AnimationChannel &channel : m_channels)
+    {
+        if (!channel.keyframes.empty())
+            return false;
+        compressed = compressed || channel.IsCompressed();
+    }
+    return compressed;
+}
+
+size_t Animation::GetMemorySize() const
+{
+    size_t bytes = m_bakedPositions.size() * sizeof(Vec3) + m_bakedRotations.size() * sizeof(Quat);
+    for (const AnimationChannel &channel : m_channels)
+        bytes += channel.GetMemorySize();
+    return bytes;
+}
+
+// ============================================================================
+// POSE BAKED
+// ============================================================================
+
+void Animation::Bake(float framesPerSecond)
+{
+    Unbake();
+    if (m_channels.empty() || framesPerSecond <= 0.0f || m_ticksPerSecond <= 0.0f)
+        return;
+
+    // Linhas igualmente espacadas de 0 a duracao, pelo menos rate por tick:
+    // com duracao * rate fracionario o passo encolhe para a ultima linha
+    // cair na duracao e o GetBakedRows continuar a ser time * rate
+    const float rate = framesPerSecond / m_ticksPerSecond;
+    const u32 frames = m_duration > 0.0f ? (u32)std::ceil(m_duration * rate) + 1 : 1;
+    const float step = frames > 1 ? m_duration / (float)(frames - 1) : 0.0f;
+    const size_t stride = m_channels.size();
+
+    std::vector<Vec3> positions(frames * stride);
+    std::vector<Quat> rotations(frames * stride);
+    std::vector<AnimationCursor> cursors(stride);
+    for (u32 f = 0; f < frames; ++f)
+    {
+        const float time = f + 1 < frames ? (float)f * step : m_duration;
+        for (size_t c = 0; c < stride; ++c)
+        {
+            positions[f * stride + c] = InterpolatePosition(m_channels[c], time, &cursors[c]);
+            Quat q = InterpolateRotation(m_channels[c], time, &cursors[c]).normalized();
+            if (f > 0 && Quat::Dot(q, rotations[(f - 1) * stride + c]) < 0.0f)
+                q = -q;
+            rotations[f * stride + c] = q;
+        }
+    }
+
+    m_bakedPositions.swap(positions);
+    m_bakedRotations.swap(rotations);
+    m_bakedRate = step > 0.0f ? 1.0f / step : 0.0f;
+    m_bakedFrames = frames;
+}
+
+void Animation::Unbake()
+{
+    std::vector<Vec3>().swap(m_bakedPositions);
+    std::vector<Quat>().swap(m_bakedRotations);
+    m_bakedFrames = 0;
+    m_bakedRate = 0.0f;
+}
+
+void Animation::GetBakedRows(float time, u32 &row0, u32 &row1, float &factor) const
+{
+    // Fora do clip (e NaN) fica na primeira ou na ultima linha
+    const float last = (float)(m_bakedFrames - 1);
+    float frame = time * m_bakedRate;
+    frame = frame > 0.0f ? frame : 0.0f;
+    frame = frame < last ? frame : last;
+
+    row0 = (u32)frame;
+    row1 = row0 + (row0 + 1 < m_bakedFrames ? 1 : 0);
+    factor = frame - (float)row0;
+}
+
+s32 Animation::GetChannelIndex(const AnimationChannel &channel) const
+{
+    std::less<const AnimationChannel *> before;
+    if (m_channels.empty() || before(&channel, m_channels.data()) || !before(&channel, m_channels.data() + m_channels.size()))
+        return -1;
+    return (s32)(&channel - m_channels.data());
+}
+
+void Animation::SamplePose(float time, Vec3 *positions, Quat *rotations, AnimationCursor *cursors) const
+{
+    const size_t count = m_channels.size();
+    if (!IsBaked())
+    {
+        for (size_t c = 0; c < count; ++c)
+        {
+            positions[c] = InterpolatePosition(m_channels[c], time, cursors ? &cursors[c] : nullptr);
+            rotations[c] = InterpolateRotation(m_channels[c], time, cursors ? &cursors[c] : nullptr);
+        }
+        return;
+    }
+
+    // Duas linhas contiguas, lerp/nlerp coluna a coluna
+    u32 row0, row1;
+    float factor;
+    GetBakedRows(time, row0, row1, factor);
+    const Vec3 *p0 = &m_bakedPositions[row0 * count];
+    const Vec3 *p1 = &m_bakedPositions[row1 * count];
+    const Quat *q0 = &m_bakedRotations[row0 * count];
+    const Quat *q1 = &m_bakedRotations[row1 * count];
+    for (size_t c = 0; c < count; ++c)
+    {
+        positions[c] = Vec3::Lerp(p0[c], p1[c], factor);
+        rotations[c] = Quat::Lerp(q0[c], q1[c], factor).normalized();
+    }
+}
+
+// ============================================================================
+// ANIMATION LIBRARY
+// ============================================================================
+
+namespace
+{
+    // FNV-1a 64: so para reconhecer ficheiros iguais, nao e criptografico
+    u64 HashBytes(const u8 *data, size_t size)
+    {
+        u64 hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Segundo digest, com outra mistura: com o tamanho e o FNV-1a, dois
+    // ficheiros diferentes so passam por iguais se colidirem nos dois
+    u64 CheckBytes(const u8 *data, size_t size)
+    {
+        u64 hash = 0x9E3779B97F4A7C15ull ^ (u64)size;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ data[i]) * 0xFF51AFD7ED558CCDull;
+            hash ^= hash >> 32;
+        }
+        return hash;
+    }
+
+    bool ReadFile(const std::string &filename, std::vector<u8> &data)
+    {
+        FileStream stream;
+        if (!stream.Open(filename, "rb"))
+            return false;
+        data.resize(stream.Size());
+        const size_t size = data.empty() ? 0 : stream.Read(data.data(), data.size());
+        stream.Close();
+        return size == data.size();
+    }
+}
+
+AnimationLibrary &AnimationLibrary::Instance()
+{
+    static AnimationLibrary instance;
+    return instance;
+}
+
+AnimationLibrary::~AnimationLibrary()
+{
+    // Fim do programa: ja nao ha layers a usar os clips
+    for (auto &pair : m_clips)
+        delete pair.second.anim;
+    m_clips.clear();
+    m_paths.clear();
+}
+
+AnimationLibrary::Clip *AnimationLibrary::FindClip(const Animation *anim)
+{
+    for (auto &pair : m_clips)
+    {
+        if (pair.second.anim == anim)
+            return &pair.second;
+    }
+    return nullptr;
+}
+
+void AnimationLibrary::Erase(const Animation *anim)
+{
+    for (auto path = m_paths.begin(); path != m_paths.end();)
+    {
+        if (path->second == anim)
+            path = m_paths.erase(path);
+        else
+            ++path;
+    }
+    for (auto it = m_clips.begin(); it != m_clips.end(); ++it)
+    {
+        if (it->second.anim == anim)
+        {
+            delete it->second.anim;
+            m_clips.erase(it);
+            return;
+        }
+    }
+}
+
+Animation *AnimationLibrary::Acquire(const std::string &filename)
+{
+    // Caminho ja visto: nem abre o ficheiro
+    auto path = m_paths.find(filename);
+    if (path != m_paths.end())
+    {
+        Clip *clip = FindClip(path->second);
+        if (clip)
+        {
+            clip->refs++;
+            return clip->anim;
+        }
+        m_paths.erase(path);
+    }
+
+    std::vector<u8> data;
+    if (!ReadFile(filename, data))
+    {
+        LogError("[AnimationLibrary] Failed to read: %s", filename.c_str());
+        return nullptr;
+    }
+
+    // Outro caminho com o mesmo conteudo: partilha o clip. O FNV-1a pode
+    // colidir, por isso tambem compara o tamanho e o segundo digest (sem
+    // voltar a ler o ficheiro original, que pode ja nao existir)
+    const u64 hash = HashBytes(data.data(), data.size());
+    const u64 check = CheckBytes(data.data(), data.size());
+    auto range = m_clips.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        Clip &clip = it->second;
+        if (clip.size != data.size() || clip.check != check)
+            continue;
+        m_paths[filename] = clip.anim;
+        clip.refs++;
+        return clip.anim;
+    }
+    if (range.first != range.second)
+        LogWarning("[AnimationLibrary] %s has the hash of another clip but not its content", filename.c_str());
+
+    MemoryStream memory(data.data(), data.size(), false);
+    Animation *anim = new Animation();
+    if (!anim->Load(&memory))
+    {
+        delete anim;
+        return nullptr;
+    }
+
+    Clip clip;
+    clip.anim = anim;
+    clip.refs = 1;
+    clip.size = data.size();
+    clip.check = check;
+    clip.source = filename;
+    m_clips.emplace(hash, clip);
+    m_paths[filename] = anim;
+    return anim;
+}
+
+void AnimationLibrary::Release(Animation *anim)
+{
+    if (!anim)
+        return;
+
+    Clip *clip = FindClip(anim);
+    if (!clip)
+    {
+        LogWarning("[AnimationLibrary] Release of a clip not in the library");
+        return;
+    }
+    if (--clip->refs == 0)
+        Erase(anim);
+}
+
+u32 AnimationLibrary::GetRefCount(const Animation *anim) const
+{
+    for (const auto &pair : m_clips)
+    {
+        if (pair.second.anim == anim)
+            return pair.second.refs;
+    }
+    return 0;
+}
+
+size_t AnimationLibrary::GetMemorySize() const
+{
+    size_t total = 0;
+    for (const auto &pair : m_clips)
+        total += pair.second.anim->GetMemorySize();
+    return total;
+}
+
+void AnimationLibrary::UnloadAll()
+{
+    // Apagar um clip em uso deixava os layers com um ponteiro solto
+    std::vector<const Animation *> unused;
+    for (const auto &pair : m_clips)
+    {
+        if (pair.second.refs == 0)
+            unused.push_back(pair.second.anim);
+        else
+            LogWarning("[AnimationLibrary] UnloadAll skipped %s (%u references)", pair.second.source.c_str(),
+                       pair.second.refs);
+    }
+    for (const Animation *anim : unused)
+        Erase(anim);
+}
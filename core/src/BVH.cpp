@@ -0,0 +1,266 @@
+#include "pch.h"
+#include "BVH.hpp"
+#include "Jobs.hpp"
+
+namespace
+{
+    const u32 BVH_GRAIN = 4096;     // triangulos por bloco nas caixas
+    const u32 BVH_MIN_TASK = 2048;  // subarvores mais pequenas nao compensam um job
+    const u32 BVH_MAX_DEPTH = BVH_STACK_SIZE - 4;
+
+    struct BuildRange
+    {
+        u32 node;
+        u32 begin;
+        u32 end;
+        u32 depth;
+    };
+
+    // Caixa em floats: as operacoes do Vec3 nao sao inline e o build passa
+    // muitas vezes por cada triangulo
+    struct Box
+    {
+        float min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+        float max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+        void grow(const Box &other)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                min[axis] = std::min(min[axis], other.min[axis]);
+                max[axis] = std::max(max[axis], other.max[axis]);
+            }
+        }
+
+        void grow(const float *point)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                min[axis] = std::min(min[axis], point[axis]);
+                max[axis] = std::max(max[axis], point[axis]);
+            }
+        }
+
+        float halfArea() const
+        {
+            const float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+            return x * y + y * z + z * x;
+        }
+    };
+
+    struct Bin
+    {
+        Box box;
+        u32 count = 0;
+    };
+
+    struct Center
+    {
+        float v[3];
+    };
+
+    // Caixas e centros por triangulo, partilhados por todas as subarvores
+    struct BuildContext
+    {
+        std::vector<Box> boxes;
+        std::vector<Center> centers;
+        u32 *indices;
+
+        // Caixa do node e dos centros; false = folha. Senao parte
+        // indices[begin, end) e devolve o meio em mid
+        bool split(BVHNode &node, const BuildRange &range, u32 &mid) const
+        {
+            Box bounds, centerBounds;
+            for (u32 i = range.begin; i < range.end; i++)
+            {
+                const u32 tri = indices[i];
+                bounds.grow(boxes[tri]);
+                centerBounds.grow(centers[tri].v);
+            }
+            node.min = Vec3(bounds.min[0], bounds.min[1], bounds.min[2]);
+            node.max = Vec3(bounds.max[0], bounds.max[1], bounds.max[2]);
+
+            const u32 count = range.end - range.begin;
+            if (count <= 2 || range.depth >= BVH_MAX_DEPTH)
+                return false;
+
+            // Custo de cada plano entre bins: n esquerda * area + n direita * area
+            float bestCost = FLT_MAX;
+            int bestAxis = -1;
+            u32 bestBin = 0;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const float extent = centerBounds.max[axis] - centerBounds.min[axis];
+                if (extent <= 1e-12f)
+                    continue;
+                const float scale = (float)BVH_BINS / extent;
+                const float origin = centerBounds.min[axis];
+
+                Bin bins[BVH_BINS];
+                for (u32 i = range.begin; i < range.end; i++)
+                {
+                    const u32 tri = indices[i];
+                    const u32 b = std::min(BVH_BINS - 1, (u32)((centers[tri].v[axis] - origin) * scale));
+                    bins[b].count++;
+                    bins[b].box.grow(boxes[tri]);
+                }
+
+                float leftArea[BVH_BINS - 1];
+                u32 leftCount[BVH_BINS - 1];
+                Bin left;
+                for (u32 b = 0; b < BVH_BINS - 1; b++)
+                {
+                    left.count += bins[b].count;
+                    left.box.grow(bins[b].box);
+                    leftCount[b] = left.count;
+                    leftArea[b] = left.count ? left.box.halfArea() : 0.0f;
+                }
+                Bin right;
+                for (u32 b = BVH_BINS - 1; b > 0; b--)
+                {
+                    right.count += bins[b].count;
+                    right.box.grow(bins[b].box);
+                    if (!leftCount[b - 1] || !right.count)
+                        continue;
+                    const float cost = leftCount[b - 1] * leftArea[b - 1] + right.count * right.box.halfArea();
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestBin = b;
+                    }
+                }
+            }
+
+            // Centros todos no mesmo sitio: nao ha plano que os separe
+            if (bestAxis < 0)
+                return false;
+
+            // Travessia conta como um triangulo
+            if (count <= BVH_MAX_LEAF && bestCost >= (float)(count - 1) * bounds.halfArea())
+                return false;
+
+            const float scale = (float)BVH_BINS / (centerBounds.max[bestAxis] - centerBounds.min[bestAxis]);
+            const float origin = centerBounds.min[bestAxis];
+            u32 *middle = std::partition(indices + range.begin, indices + range.end,
+                                         [&](u32 tri)
+                                         {
+                                             const float offset = (centers[tri].v[bestAxis] - origin) * scale;
+                                             return std::min(BVH_BINS - 1, (u32)offset) < bestBin;
+                                         });
+            mid = (u32)(middle - indices);
+            return mid > range.begin && mid < range.end;
+        }
+
+        // Constroi a arvore de root em nodes (root ja alocado). Com deferred,
+        // ranges ate taskSize ficam la com o node alocado e sem filhos
+        void build(std::vector<BVHNode> &nodes, const BuildRange &root, u32 taskSize,
+                   std::vector<BuildRange> *deferred) const
+        {
+            std::vector<BuildRange> stack;
+            stack.push_back(root);
+            while (!stack.empty())
+            {
+                const BuildRange range = stack.back();
+                stack.pop_back();
+
+                if (deferred && range.end - range.begin <= taskSize)
+                {
+                    deferred->push_back(range);
+                    continue;
+                }
+
+                u32 mid = 0;
+                BVHNode node;
+                if (!split(node, range, mid))
+                {
+                    node.first = range.begin;
+                    node.count = range.end - range.begin;
+                    nodes[range.node] = node;
+                    continue;
+                }
+
+                node.first = (u32)nodes.size();
+                node.count = 0;
+                nodes[range.node] = node;
+                nodes.resize(nodes.size() + 2);
+                stack.push_back({node.first + 1, mid, range.end, range.depth + 1});
+                stack.push_back({node.first, range.begin, mid, range.depth + 1});
+            }
+        }
+    };
+}
+
+void BVH::clear()
+{
+    nodes.clear();
+    indices.clear();
+}
+
+void BVH::build(const std::vector<Triangle> &triangles)
+{
+    clear();
+    const u32 count = (u32)triangles.size();
+    if (count == 0)
+        return;
+
+    BuildContext context;
+    context.boxes.resize(count);
+    context.centers.resize(count);
+    indices.resize(count);
+    context.indices = indices.data();
+
+    JobSystem &jobs = JobSystem::Instance();
+    jobs.ParallelFor(count, BVH_GRAIN,
+                     [&](u32 begin, u32 end, u32)
+                     {
+                         for (u32 i = begin; i < end; i++)
+                         {
+                             const Triangle &tri = triangles[i];
+                             Box &box = context.boxes[i];
+                             box = Box();
+                             box.grow(&tri.v0.x);
+                             box.grow(&tri.v1.x);
+                             box.grow(&tri.v2.x);
+                             for (int axis = 0; axis < 3; axis++)
+                                 context.centers[i].v[axis] = (box.min[axis] + box.max[axis]) * 0.5f;
+                             indices[i] = i;
+                         }
+                     });
+
+    // Topo em serie ate haver subarvores para todos os workers
+    const u32 workers = jobs.GetWorkerCount();
+    const u32 taskSize = workers > 1 ? std::max(BVH_MIN_TASK, count / (workers * 4)) : count;
+    std::vector<BuildRange> tasks;
+    nodes.reserve(count * 2);
+    nodes.resize(1);
+    context.build(nodes, {0, 0, count, 0}, taskSize, &tasks);
+
+    // Cada subarvore no seu array (o root local e o 0), depois colados
+    std::vector<std::vector<BVHNode>> subtrees(tasks.size());
+    jobs.ParallelFor((u32)tasks.size(), 1,
+                     [&](u32 begin, u32 end, u32)
+                     {
+                         for (u32 t = begin; t < end; t++)
+                         {
+                             std::vector<BVHNode> &local = subtrees[t];
+                             local.reserve((tasks[t].end - tasks[t].begin) * 2);
+                             local.resize(1);
+                             context.build(local, {0, tasks[t].begin, tasks[t].end, tasks[t].depth}, 0, nullptr);
+                         }
+                     });
+
+    for (size_t t = 0; t < tasks.size(); t++)
+    {
+        std::vector<BVHNode> &local = subtrees[t];
+        const u32 base = (u32)nodes.size() - 1; // local 1 passa a base + 1
+        for (BVHNode &node : local)
+        {
+            if (!node.isLeaf())
+                node.first += base;
+        }
+        nodes[tasks[t].node] = local[0];
+        nodes.insert(nodes.end(), local.begin() + 1, local.end());
+    }
+    nodes.shrink_to_fit();
+}
@@ -1,5 +1,168 @@
 #include "pch.h"
 #include "Collision.hpp"
+#include "Jobs.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define COLLISION_AVX 1
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define COLLISION_SSE 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// ==================== Collision Triangles ====================
+
+void CollisionTriangles::clear()
+{
+    std::vector<float> *arrays[] = {&v0x, &v0y, &v0z, &v1x, &v1y, &v1z, &v2x, &v2y, &v2z, &nx, &ny, &nz, &d,
+                                    &e0x, &e0y, &e0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z,
+                                    &invEdge0, &invEdge1, &invEdge2, &bux, &buy, &buz, &bwx, &bwy, &bwz};
+    for (std::vector<float> *array : arrays)
+        array->clear();
+    source.clear();
+}
+
+void CollisionTriangles::build(const std::vector<Triangle> &triangles, const std::vector<u32> &order)
+{
+    clear();
+    const u32 count = (u32)order.size();
+    std::vector<float> *arrays[] = {&v0x, &v0y, &v0z, &v1x, &v1y, &v1z, &v2x, &v2y, &v2z, &nx, &ny, &nz, &d,
+                                    &e0x, &e0y, &e0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z,
+                                    &invEdge0, &invEdge1, &invEdge2, &bux, &buy, &buz, &bwx, &bwy, &bwz};
+    for (std::vector<float> *array : arrays)
+        array->assign(count + COLLISION_LANES, 0.0f);
+    source = order;
+
+    auto inverse = [](float value)
+    { return value > 1e-12f ? 1.0f / value : 0.0f; };
+
+    for (u32 i = 0; i < count; i++)
+    {
+        const Triangle &tri = triangles[order[i]];
+        v0x[i] = tri.v0.x, v0y[i] = tri.v0.y, v0z[i] = tri.v0.z;
+        v1x[i] = tri.v1.x, v1y[i] = tri.v1.y, v1z[i] = tri.v1.z;
+        v2x[i] = tri.v2.x, v2y[i] = tri.v2.y, v2z[i] = tri.v2.z;
+
+        const Vec3 e0 = tri.v1 - tri.v0, e1 = tri.v2 - tri.v1, e2 = tri.v0 - tri.v2;
+        e0x[i] = e0.x, e0y[i] = e0.y, e0z[i] = e0.z;
+        e1x[i] = e1.x, e1y[i] = e1.y, e1z[i] = e1.z;
+        e2x[i] = e2.x, e2y[i] = e2.y, e2z[i] = e2.z;
+        invEdge0[i] = inverse(e0.lengthSquared());
+        invEdge1[i] = inverse(e1.lengthSquared());
+        invEdge2[i] = inverse(e2.lengthSquared());
+
+        // Como o Plane3D(v0, v1, v2); degenerado fica com normal zero
+        const Vec3 side = tri.v2 - tri.v0;
+        const Vec3 cross = Vec3::Cross(e0, side);
+        const float length = cross.length();
+        const Vec3 normal = length > 1e-12f ? cross / length : Vec3(0, 0, 0);
+        nx[i] = normal.x, ny[i] = normal.y, nz[i] = normal.z;
+        d[i] = -Vec3::Dot(normal, tri.v0);
+
+        // Base dual de (e0, side): v e w do Triangle::getBarycentricCoords
+        // num produto escalar cada
+        const float d00 = e0.lengthSquared(), d01 = Vec3::Dot(e0, side), d11 = side.lengthSquared();
+        const float denom = d00 * d11 - d01 * d01;
+        const float invDenom = std::fabs(denom) < 1e-12f ? 0.0f : 1.0f / denom;
+        const Vec3 bu = (e0 * d11 - side * d01) * invDenom;
+        const Vec3 bw = (side * d00 - e0 * d01) * invDenom;
+        bux[i] = bu.x, buy[i] = bu.y, buz[i] = bu.z;
+        bwx[i] = bw.x, bwy[i] = bw.y, bwz[i] = bw.z;
+    }
+}
+
+u32 CollisionTriangles::planeCandidates(u32 first, u32 count, const Vec3 &from, const Vec3 &to,
+                                        const Vec3 &radius) const
+{
+    // Distancia em R3 ao plano contra o raio na direcao da normal:
+    // |n * radius| (a esfera unitaria em ellipsoid space). Folga relativa
+    // para nunca rejeitar o que o sweep exato aceitaria
+    const float slack = 1.0f + 1e-4f;
+    u32 mask = 0;
+    u32 lane = 0;
+
+#ifdef COLLISION_AVX
+    if (count > 4)
+    {
+        const __m256 fx = _mm256_set1_ps(from.x), fy = _mm256_set1_ps(from.y), fz = _mm256_set1_ps(from.z);
+        const __m256 tx = _mm256_set1_ps(to.x), ty = _mm256_set1_ps(to.y), tz = _mm256_set1_ps(to.z);
+        const __m256 rx = _mm256_set1_ps(radius.x), ry = _mm256_set1_ps(radius.y), rz = _mm256_set1_ps(radius.z);
+        const __m256 a = _mm256_loadu_ps(&nx[first]), b = _mm256_loadu_ps(&ny[first]);
+        const __m256 c = _mm256_loadu_ps(&nz[first]), w = _mm256_loadu_ps(&d[first]);
+
+        const __m256 d0 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, fx), _mm256_mul_ps(b, fy)),
+                                        _mm256_add_ps(_mm256_mul_ps(c, fz), w));
+        const __m256 d1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, tx), _mm256_mul_ps(b, ty)),
+                                        _mm256_add_ps(_mm256_mul_ps(c, tz), w));
+        const __m256 ax = _mm256_mul_ps(a, rx), by = _mm256_mul_ps(b, ry), cz = _mm256_mul_ps(c, rz);
+        const __m256 reach = _mm256_mul_ps(
+            _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, ax), _mm256_mul_ps(by, by)),
+                                         _mm256_mul_ps(cz, cz))),
+            _mm256_set1_ps(slack));
+        const __m256 negReach = _mm256_sub_ps(_mm256_setzero_ps(), reach);
+
+        const __m256 front = _mm256_and_ps(_mm256_cmp_ps(d0, reach, _CMP_GT_OQ), _mm256_cmp_ps(d1, reach, _CMP_GT_OQ));
+        const __m256 back =
+            _mm256_and_ps(_mm256_cmp_ps(d0, negReach, _CMP_LT_OQ), _mm256_cmp_ps(d1, negReach, _CMP_LT_OQ));
+        mask = ~(u32)_mm256_movemask_ps(_mm256_or_ps(front, back)) & 0xFFu;
+        return mask & ((1u << count) - 1u);
+    }
+#endif
+
+#ifdef COLLISION_SSE
+    const __m128 fx = _mm_set1_ps(from.x), fy = _mm_set1_ps(from.y), fz = _mm_set1_ps(from.z);
+    const __m128 tx = _mm_set1_ps(to.x), ty = _mm_set1_ps(to.y), tz = _mm_set1_ps(to.z);
+    const __m128 rx = _mm_set1_ps(radius.x), ry = _mm_set1_ps(radius.y), rz = _mm_set1_ps(radius.z);
+    const __m128 scale = _mm_set1_ps(slack);
+    for (; lane < count; lane += 4)
+    {
+        const u32 i = first + lane;
+        const __m128 a = _mm_loadu_ps(&nx[i]), b = _mm_loadu_ps(&ny[i]);
+        const __m128 c = _mm_loadu_ps(&nz[i]), w = _mm_loadu_ps(&d[i]);
+
+        const __m128 d0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, fx), _mm_mul_ps(b, fy)), _mm_add_ps(_mm_mul_ps(c, fz), w));
+        const __m128 d1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, tx), _mm_mul_ps(b, ty)), _mm_add_ps(_mm_mul_ps(c, tz), w));
+        const __m128 ax = _mm_mul_ps(a, rx), by = _mm_mul_ps(b, ry), cz = _mm_mul_ps(c, rz);
+        const __m128 reach = _mm_mul_ps(
+            _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, ax), _mm_mul_ps(by, by)), _mm_mul_ps(cz, cz))), scale);
+        const __m128 negReach = _mm_sub_ps(_mm_setzero_ps(), reach);
+
+        const __m128 front = _mm_and_ps(_mm_cmpgt_ps(d0, reach), _mm_cmpgt_ps(d1, reach));
+        const __m128 back = _mm_and_ps(_mm_cmplt_ps(d0, negReach), _mm_cmplt_ps(d1, negReach));
+        mask |= (~(u32)_mm_movemask_ps(_mm_or_ps(front, back)) & 0xFu) << lane;
+    }
+    return mask & ((1u << count) - 1u);
+#else
+    for (; lane < count; lane++)
+    {
+        const u32 i = first + lane;
+        const float d0 = nx[i] * from.x + ny[i] * from.y + nz[i] * from.z + d[i];
+        const float d1 = nx[i] * to.x + ny[i] * to.y + nz[i] * to.z + d[i];
+        const float ax = nx[i] * radius.x, by = ny[i] * radius.y, cz = nz[i] * radius.z;
+        const float reach = std::sqrt(ax * ax + by * by + cz * cz) * slack;
+        if (!((d0 > reach && d1 > reach) || (d0 < -reach && d1 < -reach)))
+            mask |= 1u << lane;
+    }
+    return mask;
+#endif
+}
+
+const char *CollisionTriangles::getKernelName()
+{
+#if defined(COLLISION_AVX)
+    return "AVX";
+#elif defined(COLLISION_SSE)
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
 
 // ==================== CollisionSystem ====================
 
@@ -8,11 +171,13 @@ CollisionSystem::CollisionSystem() {}
 void CollisionSystem::addTriangle(const Triangle &tri)
 {
     triangles.push_back(tri);
+    bvhDirty = true;
 }
 
 void CollisionSystem::addTriangles(const std::vector<Triangle> &tris)
 {
     triangles.insert(triangles.end(), tris.begin(), tris.end());
+    bvhDirty = true;
 }
 
 void CollisionSystem::removeTriangle(int index)
@@ -20,12 +185,25 @@ void CollisionSystem::removeTriangle(int index)
     if (index >= 0 && index < static_cast<int>(triangles.size()))
     {
         triangles.erase(triangles.begin() + index);
+        bvhDirty = true;
     }
 }
 
 void CollisionSystem::clear()
 {
     triangles.clear();
+    bvh.clear();
+    store.clear();
+    bvhDirty = false;
+}
+
+void CollisionSystem::updateBVH() const
+{
+    if (!bvhDirty)
+        return;
+    bvh.build(triangles);
+    store.build(triangles, bvh.getIndices());
+    bvhDirty = false;
 }
 
 int CollisionSystem::getTriangleCount() const
@@ -81,33 +259,32 @@ bool CollisionSystem::getLowestRoot(float a, float b, float c, float maxR, float
     return false;
 }
 
-bool CollisionSystem::checkTriangle(CollisionPacket &packet, const Triangle &triangle)
+bool CollisionSystem::checkTriangle(CollisionPacket &packet, u32 slot) const
 {
-    // Todos os cálculos em ellipsoid space
-
-    const Vec3 &p1 = triangle.v0;
-    const Vec3 &p2 = triangle.v1;
-    const Vec3 &p3 = triangle.v2;
-
-    // Plano do triângulo
-    Plane3D trianglePlane = triangle.getPlane();
-    Vec3 planeNormal = trianglePlane.getNormal();
-    float planeD = trianglePlane.getD();
-
-    // Verificar se sphere está viajando na direção do plano
-    float normalDotVelocity = Vec3::Dot(planeNormal, packet.eVelocity);
-
-    // Se viaja para longe ou paralelo, sem colisão
-    if (std::fabs(normalDotVelocity) < 1e-6f)
+    // Todos os cálculos em ellipsoid space: o store está em R3
+    const CollisionTriangles &tris = store;
+    const Vec3 &radius = packet.eRadius;
+    const Vec3 p[3] = {Vec3(tris.v0x[slot] / radius.x, tris.v0y[slot] / radius.y, tris.v0z[slot] / radius.z),
+                       Vec3(tris.v1x[slot] / radius.x, tris.v1y[slot] / radius.y, tris.v1z[slot] / radius.z),
+                       Vec3(tris.v2x[slot] / radius.x, tris.v2y[slot] / radius.y, tris.v2z[slot] / radius.z)};
+
+    // Plano em ellipsoid space: normal * raio, renormalizada
+    Vec3 planeNormal(tris.nx[slot] * radius.x, tris.ny[slot] * radius.y, tris.nz[slot] * radius.z);
+    const float normalLength = planeNormal.length();
+    if (normalLength < 1e-12f)
     {
-        return false;
+        return false; // Triângulo degenerado
     }
+    planeNormal = planeNormal / normalLength;
+    const float planeD = tris.d[slot] / normalLength;
 
-    // Calcular intervalo de tempo durante o qual sphere interseta plano
+    // Calcular intervalo de tempo durante o qual sphere interseta plano;
+    // t em [0,1] do movimento todo (eVelocity), não da velocidade normalizada
+    float normalDotVelocity = Vec3::Dot(planeNormal, packet.eVelocity);
     float t0, t1;
     bool embeddedInPlane = false;
 
-    float signedDistToPlane = trianglePlane.distance(packet.ePosition);
+    float signedDistToPlane = Vec3::Dot(planeNormal, packet.ePosition) + planeD;
     float normalDotNormVel = Vec3::Dot(planeNormal, packet.eNormalizedVelocity);
 
     if (std::fabs(normalDotNormVel) < 1e-6f)
@@ -127,7 +304,7 @@ bool CollisionSystem::checkTriangle(CollisionPacket &packet, const Triangle &tri
     else
     {
         // Calcular intervalo de intersecção
-        float nvi = 1.0f / normalDotNormVel;
+        float nvi = 1.0f / normalDotVelocity;
         t0 = (-1.0f - signedDistToPlane) * nvi;
         t1 = (1.0f - signedDistToPlane) * nvi;
 
@@ -163,7 +340,14 @@ bool CollisionSystem::checkTriangle(CollisionPacket &packet, const Triangle &tri
         Vec3 planeIntersectPoint = (packet.ePosition - planeNormal) +
                                    packet.eVelocity * t0;
 
-        if (triangle.contains(planeIntersectPoint))
+        // Baricêntricas são afins: testa o ponto de volta em R3
+        const float px = planeIntersectPoint.x * radius.x - tris.v0x[slot];
+        const float py = planeIntersectPoint.y * radius.y - tris.v0y[slot];
+        const float pz = planeIntersectPoint.z * radius.z - tris.v0z[slot];
+        const float v = px * tris.bux[slot] + py * tris.buy[slot] + pz * tris.buz[slot];
+        const float w = px * tris.bwx[slot] + py * tris.bwy[slot] + pz * tris.bwz[slot];
+
+        if (v >= 0.0f && w >= 0.0f && v + w <= 1.0f)
         {
             foundCollision = true;
             t = t0;
@@ -180,126 +364,120 @@ bool CollisionSystem::checkTriangle(CollisionPacket &packet, const Triangle &tri
         float a, b, c;
         float newT;
 
-        // P1
+        // Vértices
         a = velocitySquaredLength;
-        b = 2.0f * Vec3::Dot(velocity, base - p1);
-        c = (p1 - base).lengthSquared() - 1.0f;
-        if (getLowestRoot(a, b, c, t, newT))
-        {
-            t = newT;
-            foundCollision = true;
-            collisionPoint = p1;
-        }
-
-        // P2
-        b = 2.0f * Vec3::Dot(velocity, base - p2);
-        c = (p2 - base).lengthSquared() - 1.0f;
-        if (getLowestRoot(a, b, c, t, newT))
-        {
-            t = newT;
-            foundCollision = true;
-            collisionPoint = p2;
-        }
-
-        // P3
-        b = 2.0f * Vec3::Dot(velocity, base - p3);
-        c = (p3 - base).lengthSquared() - 1.0f;
-        if (getLowestRoot(a, b, c, t, newT))
-        {
-            t = newT;
-            foundCollision = true;
-            collisionPoint = p3;
-        }
-
-        // Edges
-        // Edge P1-P2
-        Vec3 edge = p2 - p1;
-        Vec3 baseToVertex = p1 - base;
-        float edgeSquaredLength = edge.lengthSquared();
-        float edgeDotVelocity = Vec3::Dot(edge, velocity);
-        float edgeDotBaseToVertex = Vec3::Dot(edge, baseToVertex);
-
-        a = edgeSquaredLength * -velocitySquaredLength + edgeDotVelocity * edgeDotVelocity;
-        b = edgeSquaredLength * (2.0f * Vec3::Dot(velocity, baseToVertex)) -
-            2.0f * edgeDotVelocity * edgeDotBaseToVertex;
-        c = edgeSquaredLength * (1.0f - baseToVertex.lengthSquared()) +
-            edgeDotBaseToVertex * edgeDotBaseToVertex;
-
-        if (getLowestRoot(a, b, c, t, newT))
+        for (int i = 0; i < 3; i++)
         {
-            float f = (edgeDotVelocity * newT - edgeDotBaseToVertex) / edgeSquaredLength;
-            if (f >= 0.0f && f <= 1.0f)
+            b = 2.0f * Vec3::Dot(velocity, base - p[i]);
+            c = (p[i] - base).lengthSquared() - 1.0f;
+            if (getLowestRoot(a, b, c, t, newT))
             {
                 t = newT;
                 foundCollision = true;
-                collisionPoint = p1 + edge * f;
+                collisionPoint = p[i];
             }
         }
 
-        // Edge P2-P3
-        edge = p3 - p2;
-        baseToVertex = p2 - base;
-        edgeSquaredLength = edge.lengthSquared();
-        edgeDotVelocity = Vec3::Dot(edge, velocity);
-        edgeDotBaseToVertex = Vec3::Dot(edge, baseToVertex);
+        // Edges P1-P2, P2-P3, P3-P1; 1/|edge|^2 do store, escalado quando
+        // o raio é uniforme (sphere)
+        const bool uniform = radius.x == radius.y && radius.y == radius.z;
+        const Vec3 edges[3] = {Vec3(tris.e0x[slot], tris.e0y[slot], tris.e0z[slot]) / radius,
+                               Vec3(tris.e1x[slot], tris.e1y[slot], tris.e1z[slot]) / radius,
+                               Vec3(tris.e2x[slot], tris.e2y[slot], tris.e2z[slot]) / radius};
+        const float invEdges[3] = {tris.invEdge0[slot], tris.invEdge1[slot], tris.invEdge2[slot]};
 
-        a = edgeSquaredLength * -velocitySquaredLength + edgeDotVelocity * edgeDotVelocity;
-        b = edgeSquaredLength * (2.0f * Vec3::Dot(velocity, baseToVertex)) -
-            2.0f * edgeDotVelocity * edgeDotBaseToVertex;
-        c = edgeSquaredLength * (1.0f - baseToVertex.lengthSquared()) +
-            edgeDotBaseToVertex * edgeDotBaseToVertex;
-
-        if (getLowestRoot(a, b, c, t, newT))
+        for (int i = 0; i < 3; i++)
         {
-            float f = (edgeDotVelocity * newT - edgeDotBaseToVertex) / edgeSquaredLength;
-            if (f >= 0.0f && f <= 1.0f)
+            const Vec3 &edge = edges[i];
+            Vec3 baseToVertex = p[i] - base;
+            float edgeSquaredLength = edge.lengthSquared();
+            if (edgeSquaredLength < 1e-12f)
+                continue;
+            float invEdgeSquaredLength = uniform ? invEdges[i] * radius.x * radius.x : 1.0f / edgeSquaredLength;
+            float edgeDotVelocity = Vec3::Dot(edge, velocity);
+            float edgeDotBaseToVertex = Vec3::Dot(edge, baseToVertex);
+
+            a = edgeSquaredLength * -velocitySquaredLength + edgeDotVelocity * edgeDotVelocity;
+            b = edgeSquaredLength * (2.0f * Vec3::Dot(velocity, baseToVertex)) -
+                2.0f * edgeDotVelocity * edgeDotBaseToVertex;
+            c = edgeSquaredLength * (1.0f - baseToVertex.lengthSquared()) +
+                edgeDotBaseToVertex * edgeDotBaseToVertex;
+
+            if (getLowestRoot(a, b, c, t, newT))
             {
-                t = newT;
-                foundCollision = true;
-                collisionPoint = p2 + edge * f;
+                float f = (edgeDotVelocity * newT - edgeDotBaseToVertex) * invEdgeSquaredLength;
+                if (f >= 0.0f && f <= 1.0f)
+                {
+                    t = newT;
+                    foundCollision = true;
+                    collisionPoint = p[i] + edge * f;
+                }
             }
         }
+    }
 
-        // Edge P3-P1
-        edge = p1 - p3;
-        baseToVertex = p3 - base;
-        edgeSquaredLength = edge.lengthSquared();
-        edgeDotVelocity = Vec3::Dot(edge, velocity);
-        edgeDotBaseToVertex = Vec3::Dot(edge, baseToVertex);
+    // Atualizar packet se encontrou colisão mais próxima; a distância é em
+    // ellipsoid space, como o collideWithWorld a usa
+    const float distance = t * packet.eVelocity.length();
+    if (foundCollision && t >= 0.0f && distance <= packet.nearestDistance)
+    {
+        packet.nearestDistance = distance;
+        packet.intersectionPoint = collisionPoint;
+        packet.foundCollision = true;
+        packet.intersectionTriangle = &triangles[tris.source[slot]];
+        return true;
+    }
 
-        a = edgeSquaredLength * -velocitySquaredLength + edgeDotVelocity * edgeDotVelocity;
-        b = edgeSquaredLength * (2.0f * Vec3::Dot(velocity, baseToVertex)) -
-            2.0f * edgeDotVelocity * edgeDotBaseToVertex;
-        c = edgeSquaredLength * (1.0f - baseToVertex.lengthSquared()) +
-            edgeDotBaseToVertex * edgeDotBaseToVertex;
+    return false;
+}
 
-        if (getLowestRoot(a, b, c, t, newT))
+void CollisionSystem::sweepTriangles(CollisionPacket &packet) const
+{
+    // Por folha os planos rejeitam em bloco e só o resto faz o sweep completo
+    const Vec3 &radius = packet.eRadius;
+    const Vec3 from = packet.ePosition * radius;
+    const Vec3 motion = packet.eVelocity * radius;
+    const Vec3 to = from + motion;
+    const Vec3 extent = radius * (1.0f + 1e-4f) + Vec3(1e-4f, 1e-4f, 1e-4f);
+    auto testLeaf = [&](u32 first, u32 count)
+    {
+        for (u32 block = 0; block < count; block += COLLISION_LANES)
         {
-            float f = (edgeDotVelocity * newT - edgeDotBaseToVertex) / edgeSquaredLength;
-            if (f >= 0.0f && f <= 1.0f)
+            const u32 lanes = std::min(COLLISION_LANES, count - block);
+            u32 mask = store.planeCandidates(first + block, lanes, from, to, radius);
+            for (u32 lane = 0; mask; lane++, mask >>= 1)
             {
-                t = newT;
-                foundCollision = true;
-                collisionPoint = p3 + edge * f;
+                if (mask & 1u)
+                    checkTriangle(packet, first + block + lane);
             }
         }
-    }
+    };
+
+    updateBVH();
 
-    // Atualizar packet se encontrou colisão mais próxima
-    if (foundCollision && t >= 0.0f && t <= packet.nearestDistance)
+    // Passos curtos (sliding): a caixa do movimento chega e sai mais barata
+    const float maxRadius = std::max(radius.x, std::max(radius.y, radius.z));
+    if (motion.lengthSquared() <= 4.0f * maxRadius * maxRadius)
     {
-        packet.nearestDistance = t;
-        packet.intersectionPoint = collisionPoint;
-        packet.foundCollision = true;
-        packet.intersectionTriangle = &triangle;
-        return true;
+        bvh.queryLeaves(Vec3::Min(from, to) - extent, Vec3::Max(from, to) + extent, testLeaf);
+        return;
     }
 
-    return false;
+    // Casts longos: só as folhas cuja caixa, alargada pelo raio, o centro
+    // atravessa, por ordem ao longo do movimento e cortadas pelo contacto
+    // mais perto
+    const float length = packet.eVelocity.length();
+    bvh.querySweep(from, motion, extent, 1.0f,
+                   [&](u32 first, u32 count, float &tMax)
+                   {
+                       testLeaf(first, count);
+                       if (packet.foundCollision)
+                           tMax = std::min(tMax, packet.nearestDistance / length);
+                   });
 }
 
 Vec3 CollisionSystem::collideWithWorld(int recursionDepth, CollisionPacket &packet,
-                                       const Vec3 &pos, const Vec3 &vel)
+                                       const Vec3 &pos, const Vec3 &vel) const
 {
     if (recursionDepth > packet.maxRecursionDepth)
     {
@@ -312,11 +490,7 @@ Vec3 CollisionSystem::collideWithWorld(int recursionDepth, CollisionPacket &pack
     packet.foundCollision = false;
     packet.nearestDistance = std::numeric_limits<float>::max();
 
-    // Testar contra todos os triângulos
-    for (const auto &tri : triangles)
-    {
-        checkTriangle(packet, tri);
-    }
+    sweepTriangles(packet);
 
     // Se não há colisão, retornar destino
     if (!packet.foundCollision)
@@ -362,7 +536,7 @@ Vec3 CollisionSystem::collideWithWorld(int recursionDepth, CollisionPacket &pack
 
 Vec3 CollisionSystem::collideAndSlide(const Vec3 &position, const Vec3 &velocity,
                                       const Vec3 &radius, const Vec3 &gravity,
-                                      bool &outGrounded)
+                                      bool &outGrounded) const
 {
     CollisionPacket packet;
     packet.eRadius = radius;
@@ -399,25 +573,57 @@ Vec3 CollisionSystem::collideAndSlide(const Vec3 &position, const Vec3 &velocity
 }
 
 Vec3 CollisionSystem::collideAndSlide(const Vec3 &position, const Vec3 &velocity,
-                                      const Vec3 &radius)
+                                      const Vec3 &radius) const
 {
     bool grounded;
     return collideAndSlide(position, velocity, radius, Vec3(0, 0, 0), grounded);
 }
 
 Vec3 CollisionSystem::sphereSlide(const Vec3 &position, const Vec3 &velocity,
-                                  float radius, const Vec3 &gravity, bool &outGrounded)
+                                  float radius, const Vec3 &gravity, bool &outGrounded) const
 {
     return collideAndSlide(position, velocity, Vec3(radius, radius, radius),
                            gravity, outGrounded);
 }
 
-Vec3 CollisionSystem::sphereSlide(const Vec3 &position, const Vec3 &velocity, float radius)
+Vec3 CollisionSystem::sphereSlide(const Vec3 &position, const Vec3 &velocity, float radius) const
 {
     bool grounded;
     return sphereSlide(position, velocity, radius, Vec3(0, 0, 0), grounded);
 }
 
+// ==================== Batch Sliding ====================
+
+namespace
+{
+    const u32 AGENT_GRAIN = 8; // agentes por job; o custo de cada um varia muito
+}
+
+void CollisionSystem::collideAndSlideBatch(u32 count, const Vec3 *positions, const Vec3 *velocities,
+                                           const Vec3 *radii, const Vec3 *gravity,
+                                           Vec3 *outPositions, u8 *outGrounded) const
+{
+    // Antes de ir para os workers: o rebuild nao e thread safe. Depois
+    // disto cada agente so le o mundo e tem o seu CollisionPacket
+    updateBVH();
+
+    const Vec3 noGravity(0, 0, 0);
+    JobSystem::Instance().ParallelFor(count, AGENT_GRAIN,
+                                      [&](u32 begin, u32 end, u32)
+                                      {
+                                          for (u32 i = begin; i < end; i++)
+                                          {
+                                              bool grounded = false;
+                                              const Vec3 result =
+                                                  collideAndSlide(positions[i], velocities[i], radii[i],
+                                                                  gravity ? gravity[i] : noGravity, grounded);
+                                              outPositions[i] = result;
+                                              if (outGrounded)
+                                                  outGrounded[i] = grounded ? 1 : 0;
+                                          }
+                                      });
+}
+
 // ==================== Simple Collision Tests ====================
 
 bool CollisionSystem::pointInside(const Vec3 &point) const
@@ -426,17 +632,14 @@ bool CollisionSystem::pointInside(const Vec3 &point) const
     Vec3 direction(1, 0.707f, 0.707f); // Direção arbitrária
     int intersections = 0;
 
-    for (const auto &tri : triangles)
-    {
-        float t;
-        if (tri.intersectRay(point, direction, t))
-        {
-            if (t > 0)
-            {
-                intersections++;
-            }
-        }
-    }
+    updateBVH();
+    bvh.queryRay(point, direction, FLT_MAX,
+                 [&](u32 index, float &)
+                 {
+                     float t;
+                     if (triangles[index].intersectRay(point, direction, t) && t > 0)
+                         intersections++;
+                 });
 
     return (intersections % 2) == 1;
 }
@@ -447,21 +650,23 @@ bool CollisionSystem::rayCast(const Vec3 &origin, const Vec3 &direction,
     outInfo.foundCollision = false;
     outInfo.nearestDistance = maxDistance;
 
-    for (const auto &tri : triangles)
-    {
-        float t, u, v;
-        if (tri.intersectRay(origin, direction, t, u, v))
-        {
-            if (t > 0 && t < outInfo.nearestDistance)
-            {
-                outInfo.foundCollision = true;
-                outInfo.nearestDistance = t;
-                outInfo.intersectionPoint = origin + direction * t;
-                outInfo.intersectionNormal = tri.getNormal();
-                outInfo.triangle = &tri;
-            }
-        }
-    }
+    // Nodes por ordem de distancia; cada hit encurta o ray
+    updateBVH();
+    bvh.queryRay(origin, direction, maxDistance,
+                 [&](u32 index, float &tMax)
+                 {
+                     const Triangle &tri = triangles[index];
+                     float t, u, v;
+                     if (tri.intersectRay(origin, direction, t, u, v) && t > 0 && t < outInfo.nearestDistance)
+                     {
+                         outInfo.foundCollision = true;
+                         outInfo.nearestDistance = t;
+                         outInfo.intersectionPoint = origin + direction * t;
+                         outInfo.intersectionNormal = tri.getNormal();
+                         outInfo.triangle = &tri;
+                         tMax = t;
+                     }
+                 });
 
     return outInfo.foundCollision;
 }
@@ -476,7 +681,446 @@ bool CollisionSystem::sphereCast(const Vec3 &origin, const Vec3 &direction,
                                  float radius, float maxDistance,
                                  CollisionInfo &outInfo) const
 {
-    // Implementação simplificada
-    // TODO: Implementar swept sphere completo
-    return rayCast(origin, direction, maxDistance, outInfo);
+    outInfo = CollisionInfo();
+    const float directionLength = direction.length();
+    if (radius <= 0.0f || maxDistance <= 0.0f || directionLength < 1e-12f)
+    {
+        return false;
+    }
+
+    // O mesmo sweep do collideAndSlide, num passo só
+    const Vec3 unit = direction / directionLength;
+    const Vec3 radii(radius, radius, radius);
+    CollisionPacket packet;
+    packet.eRadius = radii;
+    packet.ePosition = origin / radius;
+    packet.eVelocity = unit * (maxDistance / radius);
+    packet.eNormalizedVelocity = unit;
+    sweepTriangles(packet);
+
+    if (!packet.foundCollision)
+    {
+        return false;
+    }
+
+    // Normal do contacto: do ponto para o centro nesse instante
+    const float distance = packet.nearestDistance * radius;
+    const Vec3 center = origin + unit * distance;
+    const Vec3 point = packet.intersectionPoint * radius;
+    Vec3 normal = center - point;
+    const float normalLength = normal.length();
+    normal = normalLength > 1e-6f ? normal / normalLength : packet.intersectionTriangle->getNormal();
+
+    outInfo.foundCollision = true;
+    outInfo.nearestDistance = distance;
+    outInfo.intersectionPoint = point;
+    outInfo.intersectionNormal = normal;
+    outInfo.triangle = packet.intersectionTriangle;
+    return true;
+}
+
+// ==================== Batch Ray Casting ====================
+
+namespace
+{
+    const u32 RAY_GRAIN = 16; // pacotes por job
+    const u32 RAY_NO_HIT = 0xFFFFFFFFu;
+    const float RAY_EPSILON = 1e-6f; // o mesmo do Triangle::intersectRay
+
+    struct SingleRay
+    {
+        float o[3];
+        float d[3];
+        float inv[3];
+        float tMax;
+        u32 slot;
+    };
+
+    void setInverse(const float *d, float *inv)
+    {
+        // Componentes a zero: slabs infinitos, como no BVH::queryRay
+        for (int axis = 0; axis < 3; axis++)
+            inv[axis] = d[axis] != 0.0f ? 1.0f / d[axis] : 1e30f;
+    }
+
+    // Entrada no node ou FLT_MAX, como o BVH::intersect
+    float slab(const BVHNode &node, const float *o, const float *inv, float tMax)
+    {
+        const float *lo = &node.min.x, *hi = &node.max.x;
+        float tNear = -FLT_MAX, tFar = FLT_MAX;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const float t1 = (lo[axis] - o[axis]) * inv[axis], t2 = (hi[axis] - o[axis]) * inv[axis];
+            tNear = std::fmax(tNear, std::fmin(t1, t2));
+            tFar = std::fmin(tFar, std::fmax(t1, t2));
+        }
+        return (tFar >= tNear && tFar >= 0.0f && tNear <= tMax) ? tNear : FLT_MAX;
+    }
+
+    // Möller-Trumbore do Triangle::intersectRay sobre o store: edge1 = e0,
+    // edge2 = v2 - v0 = -e2
+    void intersectSlot(const CollisionTriangles &store, u32 slot, SingleRay &ray)
+    {
+        const float e1x = store.e0x[slot], e1y = store.e0y[slot], e1z = store.e0z[slot];
+        const float e2x = -store.e2x[slot], e2y = -store.e2y[slot], e2z = -store.e2z[slot];
+        const float hx = ray.d[1] * e2z - ray.d[2] * e2y;
+        const float hy = ray.d[2] * e2x - ray.d[0] * e2z;
+        const float hz = ray.d[0] * e2y - ray.d[1] * e2x;
+        const float a = e1x * hx + e1y * hy + e1z * hz;
+        if (a > -RAY_EPSILON && a < RAY_EPSILON)
+            return;
+
+        const float f = 1.0f / a;
+        const float sx = ray.o[0] - store.v0x[slot], sy = ray.o[1] - store.v0y[slot], sz = ray.o[2] - store.v0z[slot];
+        const float u = f * (sx * hx + sy * hy + sz * hz);
+        if (u < 0.0f || u > 1.0f)
+            return;
+
+        const float qx = sy * e1z - sz * e1y, qy = sz * e1x - sx * e1z, qz = sx * e1y - sy * e1x;
+        const float v = f * (ray.d[0] * qx + ray.d[1] * qy + ray.d[2] * qz);
+        if (v < 0.0f || u + v > 1.0f)
+            return;
+
+        const float t = f * (e2x * qx + e2y * qy + e2z * qz);
+        if (t > RAY_EPSILON && t < ray.tMax)
+        {
+            ray.tMax = t;
+            ray.slot = slot;
+        }
+    }
+
+    // Um ray a partir de start, o filho mais perto primeiro
+    void traceSingle(const std::vector<BVHNode> &nodes, const CollisionTriangles &store, SingleRay &ray, u32 start)
+    {
+        u32 stack[BVH_STACK_SIZE];
+        float entry[BVH_STACK_SIZE];
+        u32 top = 0;
+        stack[top] = start;
+        entry[top++] = slab(nodes[start], ray.o, ray.inv, ray.tMax);
+        while (top > 0)
+        {
+            --top;
+            if (entry[top] > ray.tMax)
+                continue;
+            const BVHNode &node = nodes[stack[top]];
+            if (node.isLeaf())
+            {
+                for (u32 slot = node.first; slot < node.first + node.count; slot++)
+                    intersectSlot(store, slot, ray);
+                continue;
+            }
+
+            u32 nearChild = node.first, farChild = node.first + 1;
+            float nearT = slab(nodes[nearChild], ray.o, ray.inv, ray.tMax);
+            float farT = slab(nodes[farChild], ray.o, ray.inv, ray.tMax);
+            if (farT < nearT)
+            {
+                std::swap(nearChild, farChild);
+                std::swap(nearT, farT);
+            }
+            if (farT != FLT_MAX)
+            {
+                stack[top] = farChild;
+                entry[top++] = farT;
+            }
+            if (nearT != FLT_MAX)
+            {
+                stack[top] = nearChild;
+                entry[top++] = nearT;
+            }
+        }
+    }
+
+    void loadRay(const Ray &source, float maxDistance, SingleRay &ray)
+    {
+        ray.o[0] = source.origin.x, ray.o[1] = source.origin.y, ray.o[2] = source.origin.z;
+        ray.d[0] = source.direction.x, ray.d[1] = source.direction.y, ray.d[2] = source.direction.z;
+        setInverse(ray.d, ray.inv);
+        ray.tMax = maxDistance;
+        ray.slot = RAY_NO_HIT;
+    }
+
+#if defined(COLLISION_AVX) || defined(COLLISION_SSE)
+#define COLLISION_PACKETS 1
+
+#if defined(COLLISION_AVX)
+    typedef __m256 LaneFloat;
+    const u32 RAY_PACKET = 8;
+    inline LaneFloat laneSet(float value) { return _mm256_set1_ps(value); }
+    inline LaneFloat laneLoad(const float *p) { return _mm256_load_ps(p); }
+    inline void laneStore(float *p, LaneFloat value) { _mm256_store_ps(p, value); }
+    inline LaneFloat laneAdd(LaneFloat a, LaneFloat b) { return _mm256_add_ps(a, b); }
+    inline LaneFloat laneSub(LaneFloat a, LaneFloat b) { return _mm256_sub_ps(a, b); }
+    inline LaneFloat laneMul(LaneFloat a, LaneFloat b) { return _mm256_mul_ps(a, b); }
+    inline LaneFloat laneDiv(LaneFloat a, LaneFloat b) { return _mm256_div_ps(a, b); }
+    inline LaneFloat laneMin(LaneFloat a, LaneFloat b) { return _mm256_min_ps(a, b); }
+    inline LaneFloat laneMax(LaneFloat a, LaneFloat b) { return _mm256_max_ps(a, b); }
+    inline LaneFloat laneGreater(LaneFloat a, LaneFloat b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    inline LaneFloat laneGreaterEqual(LaneFloat a, LaneFloat b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    inline LaneFloat laneAnd(LaneFloat a, LaneFloat b) { return _mm256_and_ps(a, b); }
+    inline LaneFloat laneOr(LaneFloat a, LaneFloat b) { return _mm256_or_ps(a, b); }
+    inline LaneFloat laneSelect(LaneFloat mask, LaneFloat a, LaneFloat b) { return _mm256_blendv_ps(b, a, mask); }
+    inline u32 laneBits(LaneFloat mask) { return (u32)_mm256_movemask_ps(mask); }
+#else
+    typedef __m128 LaneFloat;
+    const u32 RAY_PACKET = 4;
+    inline LaneFloat laneSet(float value) { return _mm_set1_ps(value); }
+    inline LaneFloat laneLoad(const float *p) { return _mm_load_ps(p); }
+    inline void laneStore(float *p, LaneFloat value) { _mm_store_ps(p, value); }
+    inline LaneFloat laneAdd(LaneFloat a, LaneFloat b) { return _mm_add_ps(a, b); }
+    inline LaneFloat laneSub(LaneFloat a, LaneFloat b) { return _mm_sub_ps(a, b); }
+    inline LaneFloat laneMul(LaneFloat a, LaneFloat b) { return _mm_mul_ps(a, b); }
+    inline LaneFloat laneDiv(LaneFloat a, LaneFloat b) { return _mm_div_ps(a, b); }
+    inline LaneFloat laneMin(LaneFloat a, LaneFloat b) { return _mm_min_ps(a, b); }
+    inline LaneFloat laneMax(LaneFloat a, LaneFloat b) { return _mm_max_ps(a, b); }
+    inline LaneFloat laneGreater(LaneFloat a, LaneFloat b) { return _mm_cmpgt_ps(a, b); }
+    inline LaneFloat laneGreaterEqual(LaneFloat a, LaneFloat b) { return _mm_cmpge_ps(a, b); }
+    inline LaneFloat laneAnd(LaneFloat a, LaneFloat b) { return _mm_and_ps(a, b); }
+    inline LaneFloat laneOr(LaneFloat a, LaneFloat b) { return _mm_or_ps(a, b); }
+    inline LaneFloat laneSelect(LaneFloat mask, LaneFloat a, LaneFloat b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+    inline u32 laneBits(LaneFloat mask) { return (u32)_mm_movemask_ps(mask); }
+#endif
+
+    // Índice do bit menos significativo (bits != 0): a próxima lane ativa
+    inline u32 lowestBit(u32 bits)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, bits);
+        return (u32)index;
+#else
+        return (u32)__builtin_ctz(bits);
+#endif
+    }
+
+    // Um ray por lane; as lanes a mais do ultimo pacote ficam fora de valid
+    struct alignas(32) RayPacket
+    {
+        float ox[RAY_PACKET], oy[RAY_PACKET], oz[RAY_PACKET];
+        float dx[RAY_PACKET], dy[RAY_PACKET], dz[RAY_PACKET];
+        float ix[RAY_PACKET], iy[RAY_PACKET], iz[RAY_PACKET];
+        float tMax[RAY_PACKET];
+        u32 slot[RAY_PACKET];
+        u32 valid;
+        float direction[3]; // soma das direcoes: ordem dos filhos
+    };
+
+    // Lanes validas cujo ray entra no node antes do seu tMax
+    u32 slabPacket(const BVHNode &node, const RayPacket &packet)
+    {
+        const LaneFloat t1x = laneMul(laneSub(laneSet(node.min.x), laneLoad(packet.ox)), laneLoad(packet.ix));
+        const LaneFloat t2x = laneMul(laneSub(laneSet(node.max.x), laneLoad(packet.ox)), laneLoad(packet.ix));
+        const LaneFloat t1y = laneMul(laneSub(laneSet(node.min.y), laneLoad(packet.oy)), laneLoad(packet.iy));
+        const LaneFloat t2y = laneMul(laneSub(laneSet(node.max.y), laneLoad(packet.oy)), laneLoad(packet.iy));
+        const LaneFloat t1z = laneMul(laneSub(laneSet(node.min.z), laneLoad(packet.oz)), laneLoad(packet.iz));
+        const LaneFloat t2z = laneMul(laneSub(laneSet(node.max.z), laneLoad(packet.oz)), laneLoad(packet.iz));
+        const LaneFloat tNear =
+            laneMax(laneMax(laneMin(t1x, t2x), laneMin(t1y, t2y)), laneMin(t1z, t2z));
+        const LaneFloat tFar = laneMin(laneMin(laneMax(t1x, t2x), laneMax(t1y, t2y)), laneMax(t1z, t2z));
+        const LaneFloat hit = laneAnd(laneAnd(laneGreaterEqual(tFar, tNear), laneGreaterEqual(tFar, laneSet(0.0f))),
+                                      laneGreaterEqual(laneLoad(packet.tMax), tNear));
+        return laneBits(hit) & packet.valid;
+    }
+
+    // Möller-Trumbore de um triangulo contra o pacote todo
+    void intersectPacket(const CollisionTriangles &store, u32 slot, RayPacket &packet)
+    {
+        const LaneFloat e1x = laneSet(store.e0x[slot]), e1y = laneSet(store.e0y[slot]), e1z = laneSet(store.e0z[slot]);
+        const LaneFloat e2x = laneSet(-store.e2x[slot]), e2y = laneSet(-store.e2y[slot]), e2z = laneSet(-store.e2z[slot]);
+        const LaneFloat dx = laneLoad(packet.dx), dy = laneLoad(packet.dy), dz = laneLoad(packet.dz);
+
+        const LaneFloat hx = laneSub(laneMul(dy, e2z), laneMul(dz, e2y));
+        const LaneFloat hy = laneSub(laneMul(dz, e2x), laneMul(dx, e2z));
+        const LaneFloat hz = laneSub(laneMul(dx, e2y), laneMul(dy, e2x));
+        const LaneFloat a = laneAdd(laneAdd(laneMul(e1x, hx), laneMul(e1y, hy)), laneMul(e1z, hz));
+        LaneFloat ok = laneOr(laneGreaterEqual(a, laneSet(RAY_EPSILON)), laneGreaterEqual(laneSet(-RAY_EPSILON), a));
+        if (!(laneBits(ok) & packet.valid))
+            return;
+
+        const LaneFloat f = laneDiv(laneSet(1.0f), a);
+        const LaneFloat sx = laneSub(laneLoad(packet.ox), laneSet(store.v0x[slot]));
+        const LaneFloat sy = laneSub(laneLoad(packet.oy), laneSet(store.v0y[slot]));
+        const LaneFloat sz = laneSub(laneLoad(packet.oz), laneSet(store.v0z[slot]));
+        const LaneFloat u = laneMul(f, laneAdd(laneAdd(laneMul(sx, hx), laneMul(sy, hy)), laneMul(sz, hz)));
+
+        const LaneFloat qx = laneSub(laneMul(sy, e1z), laneMul(sz, e1y));
+        const LaneFloat qy = laneSub(laneMul(sz, e1x), laneMul(sx, e1z));
+        const LaneFloat qz = laneSub(laneMul(sx, e1y), laneMul(sy, e1x));
+        const LaneFloat v = laneMul(f, laneAdd(laneAdd(laneMul(dx, qx), laneMul(dy, qy)), laneMul(dz, qz)));
+        const LaneFloat t = laneMul(f, laneAdd(laneAdd(laneMul(e2x, qx), laneMul(e2y, qy)), laneMul(e2z, qz)));
+
+        const LaneFloat zero = laneSet(0.0f), one = laneSet(1.0f);
+        const LaneFloat tMax = laneLoad(packet.tMax);
+        ok = laneAnd(ok, laneAnd(laneGreaterEqual(u, zero), laneGreaterEqual(one, u)));
+        ok = laneAnd(ok, laneAnd(laneGreaterEqual(v, zero), laneGreaterEqual(one, laneAdd(u, v))));
+        ok = laneAnd(ok, laneAnd(laneGreater(t, laneSet(RAY_EPSILON)), laneGreater(tMax, t)));
+        u32 bits = laneBits(ok) & packet.valid;
+        if (!bits)
+            return;
+
+        laneStore(packet.tMax, laneSelect(ok, t, tMax));
+        for (; bits; bits &= bits - 1)
+            packet.slot[lowestBit(bits)] = slot;
+    }
+
+    void traceLane(const std::vector<BVHNode> &nodes, const CollisionTriangles &store, RayPacket &packet, u32 lane,
+                   u32 start)
+    {
+        SingleRay ray;
+        ray.o[0] = packet.ox[lane], ray.o[1] = packet.oy[lane], ray.o[2] = packet.oz[lane];
+        ray.d[0] = packet.dx[lane], ray.d[1] = packet.dy[lane], ray.d[2] = packet.dz[lane];
+        ray.inv[0] = packet.ix[lane], ray.inv[1] = packet.iy[lane], ray.inv[2] = packet.iz[lane];
+        ray.tMax = packet.tMax[lane];
+        ray.slot = packet.slot[lane];
+        traceSingle(nodes, store, ray, start);
+        packet.tMax[lane] = ray.tMax;
+        packet.slot[lane] = ray.slot;
+    }
+
+    // Rays com direcoes no mesmo octante visitam quase os mesmos nodes;
+    // senao o pacote so faz testes a mais
+    bool isCoherent(const RayPacket &packet)
+    {
+        u32 octant = 0xFFFFFFFFu;
+        for (u32 lane = 0; lane < RAY_PACKET; lane++)
+        {
+            if (!(packet.valid & (1u << lane)))
+                continue;
+            const u32 signs = (packet.dx[lane] < 0.0f ? 1u : 0u) | (packet.dy[lane] < 0.0f ? 2u : 0u) |
+                              (packet.dz[lane] < 0.0f ? 4u : 0u);
+            if (octant != 0xFFFFFFFFu && octant != signs)
+                return false;
+            octant = signs;
+        }
+        return true;
+    }
+
+    void tracePacket(const std::vector<BVHNode> &nodes, const CollisionTriangles &store, RayPacket &packet)
+    {
+        if (!isCoherent(packet))
+        {
+            for (u32 lane = 0; lane < RAY_PACKET; lane++)
+            {
+                if (packet.valid & (1u << lane))
+                    traceLane(nodes, store, packet, lane, 0);
+            }
+            return;
+        }
+
+        u32 stack[BVH_STACK_SIZE];
+        u32 top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const u32 index = stack[--top];
+            const BVHNode &node = nodes[index];
+            const u32 active = slabPacket(node, packet);
+            if (!active)
+                continue;
+
+            // So um ray chegou aqui: o resto da subarvore e dele
+            if (!(active & (active - 1)))
+            {
+                traceLane(nodes, store, packet, lowestBit(active), index);
+                continue;
+            }
+
+            if (node.isLeaf())
+            {
+                for (u32 slot = node.first; slot < node.first + node.count; slot++)
+                    intersectPacket(store, slot, packet);
+                continue;
+            }
+
+            // O filho mais longe na direcao do pacote entra primeiro
+            const BVHNode &left = nodes[node.first], &right = nodes[node.first + 1];
+            const float ahead = (right.min.x + right.max.x - left.min.x - left.max.x) * packet.direction[0] +
+                                (right.min.y + right.max.y - left.min.y - left.max.y) * packet.direction[1] +
+                                (right.min.z + right.max.z - left.min.z - left.max.z) * packet.direction[2];
+            stack[top++] = ahead > 0.0f ? node.first + 1 : node.first;
+            stack[top++] = ahead > 0.0f ? node.first : node.first + 1;
+        }
+    }
+#endif
+}
+
+void CollisionSystem::rayCastBatch(const Ray *rays, u32 count, float maxDistance, RayHit *outHits) const
+{
+    // Antes de ir para os workers: o rebuild nao e thread safe
+    updateBVH();
+    const std::vector<BVHNode> &nodes = bvh.getNodes();
+
+    auto writeHit = [&](u32 i, float t, u32 slot)
+    {
+        RayHit &hit = outHits[i];
+        hit = RayHit();
+        if (slot == RAY_NO_HIT)
+            return;
+        const Ray &ray = rays[i];
+        hit.hit = true;
+        hit.t = t;
+        hit.point = Vec3(ray.origin.x + ray.direction.x * t, ray.origin.y + ray.direction.y * t,
+                         ray.origin.z + ray.direction.z * t);
+        hit.normal = Vec3(store.nx[slot], store.ny[slot], store.nz[slot]);
+        hit.triangle = &triangles[store.source[slot]];
+    };
+
+#ifdef COLLISION_PACKETS
+    const u32 packets = (count + RAY_PACKET - 1) / RAY_PACKET;
+    JobSystem::Instance().ParallelFor(
+        packets, RAY_GRAIN,
+        [&](u32 begin, u32 end, u32)
+        {
+            for (u32 p = begin; p < end; p++)
+            {
+                const u32 first = p * RAY_PACKET;
+                const u32 lanes = std::min(RAY_PACKET, count - first);
+                RayPacket packet;
+                packet.valid = (1u << lanes) - 1u;
+                packet.direction[0] = packet.direction[1] = packet.direction[2] = 0.0f;
+                for (u32 lane = 0; lane < RAY_PACKET; lane++)
+                {
+                    // Lanes a mais repetem o primeiro ray
+                    SingleRay ray;
+                    loadRay(rays[first + (lane < lanes ? lane : 0)], maxDistance, ray);
+                    packet.ox[lane] = ray.o[0], packet.oy[lane] = ray.o[1], packet.oz[lane] = ray.o[2];
+                    packet.dx[lane] = ray.d[0], packet.dy[lane] = ray.d[1], packet.dz[lane] = ray.d[2];
+                    packet.ix[lane] = ray.inv[0], packet.iy[lane] = ray.inv[1], packet.iz[lane] = ray.inv[2];
+                    packet.tMax[lane] = ray.tMax;
+                    packet.slot[lane] = ray.slot;
+                    for (int axis = 0; axis < 3; axis++)
+                        packet.direction[axis] += ray.d[axis];
+                }
+
+                if (!nodes.empty())
+                    tracePacket(nodes, store, packet);
+                for (u32 lane = 0; lane < lanes; lane++)
+                    writeHit(first + lane, packet.tMax[lane], packet.slot[lane]);
+            }
+        });
+#else
+    JobSystem::Instance().ParallelFor(count, RAY_GRAIN,
+                                      [&](u32 begin, u32 end, u32)
+                                      {
+                                          for (u32 i = begin; i < end; i++)
+                                          {
+                                              SingleRay ray;
+                                              loadRay(rays[i], maxDistance, ray);
+                                              if (!nodes.empty())
+                                                  traceSingle(nodes, store, ray, 0);
+                                              writeHit(i, ray.tMax, ray.slot);
+                                          }
+                                      });
+#endif
+}
+
+void CollisionSystem::rayCastBatch(const std::vector<Ray> &rays, float maxDistance,
+                                   std::vector<RayHit> &outHits) const
+{
+    outHits.resize(rays.size());
+    if (!rays.empty())
+        rayCastBatch(rays.data(), (u32)rays.size(), maxDistance, outHits.data());
 }
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "Driver.hpp"
+#include "Frustum.hpp"
 #include "glad/glad.h"
 #include "Texture.hpp"
 #include "Shader.hpp"
@@ -84,29 +85,70 @@ void Driver::DrawMeshBuffer( MeshBuffer *meshBuffer)
     meshBuffer->Render();
 }
 
+void Driver::BindMaterial(Mesh *mesh, MeshBuffer *buffer)
+{
+    const int materialID = buffer->GetMaterial();
+    if (materialID >= 0 && materialID < (int)mesh->GetMaterialCount())
+    {
+        const u8 layer = mesh->GetMaterial(materialID)->GetLayers();
+        for (u8 i = 0; i < layer; i++)
+        {
+            const Texture *texture = mesh->GetMaterial(materialID)->GetTexture(i);
+            if (texture)
+            {
+                texture->Bind(0);
+            }
+        }
+    }
+}
+
 void Driver::DrawMesh(Mesh *mesh)
 {
     m_countMesh++;
 
-    const u32 count = mesh->GetBufferCount();
+    const u32 lod = mesh->GetLod();
+    const u32 count = mesh->GetLodBufferCount(lod);
     for (u32 i = 0; i < count; i++)
     {
-        const int materialID = mesh->GetBuffer(i)->GetMaterial();
-        if (materialID >= 0 && materialID < (int)mesh->GetMaterialCount())
+        MeshBuffer *buffer = mesh->GetLodBuffer(lod, i);
+        BindMaterial(mesh, buffer);
+        DrawMeshBuffer(buffer);
+    }
+ 
+}
+
+void Driver::DrawMesh(Mesh *mesh, const Frustum &frustum, const Mat4 &world)
+{
+    m_countMesh++;
+
+    // Escala maxima dos eixos para levar o raio da esfera
+    float scaleSq = 0.0f;
+    for (int j = 0; j < 3; j++)
+        scaleSq = Max(scaleSq, world(0, j) * world(0, j) + world(1, j) * world(1, j) + world(2, j) * world(2, j));
+    const float scale = sqrtf(scaleSq);
+
+    const u32 lod = mesh->GetLod();
+    const u32 count = mesh->GetLodBufferCount(lod);
+    for (u32 i = 0; i < count; i++)
+    {
+        MeshBuffer *buffer = mesh->GetLodBuffer(lod, i);
+
+        // Bounds so estao certos depois do Build
+        if (buffer->m_vdirty || buffer->m_idirty)
+            buffer->Build();
+
+        // Esfera primeiro (barato), depois a AABB em world space
+        const Vec3 center = world.TransformPoint(buffer->GetBoundingCenter());
+        if (!frustum.intersectsSphere(center, buffer->GetBoundingRadius() * scale) ||
+            !frustum.intersectsAABB(buffer->GetBoundingBox().transformed(world)))
         {
-            const u8 layer = mesh->GetMaterial(materialID)->GetLayers();
-            for (u8 i = 0; i < layer; i++)
-            {
-                const Texture *texture = mesh->GetMaterial(materialID)->GetTexture(i);
-                if (texture)
-                {
-                    texture->Bind(0);
-                }
-            }
+            m_countCulledMeshBuffer++;
+            continue;
         }
-        DrawMeshBuffer(mesh->GetBuffer(i));
+
+        BindMaterial(mesh, buffer);
+        DrawMeshBuffer(buffer);
     }
- 
 }
 
 void Driver::DrawElements(u32 mode, u32 count, u32 type, const void *indices)
@@ -134,6 +176,7 @@ void Driver::Reset()
 {
 
     m_countMeshBuffer = 0;
+    m_countCulledMeshBuffer = 0;
     m_countMesh = 0;
     m_countTriangle = 0;
     m_countVertex = 0;
@@ -0,0 +1,133 @@
+#include "pch.h"
+#include "Jobs.hpp"
+
+namespace
+{
+    // Threads do pool (e quem esta a correr um ParallelFor) nao submetem outro
+    thread_local bool t_insideJob = false;
+}
+
+JobSystem &JobSystem::Instance()
+{
+    static JobSystem instance;
+    return instance;
+}
+
+JobSystem::JobSystem()
+{
+    Start(0);
+}
+
+JobSystem::~JobSystem()
+{
+    Stop();
+}
+
+void JobSystem::Start(u32 threads)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+
+    m_quit = false;
+    for (u32 slot = 1; slot < threads; ++slot)
+        m_threads.emplace_back(&JobSystem::WorkerLoop, this, slot);
+}
+
+void JobSystem::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread &thread : m_threads)
+        thread.join();
+    m_threads.clear();
+}
+
+void JobSystem::SetWorkerCount(u32 count)
+{
+    std::lock_guard<std::mutex> submit(m_submit);
+    Stop();
+    Start(count);
+}
+
+void JobSystem::WorkerLoop(u32 slot)
+{
+    t_insideJob = true;
+    u32 seen = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&]
+                        { return m_quit || m_generation != seen; });
+            if (m_quit)
+                return;
+            seen = m_generation;
+        }
+
+        RunChunks(slot);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_active == 0)
+            m_done.notify_one();
+    }
+}
+
+void JobSystem::RunChunks(u32 slot)
+{
+    while (true)
+    {
+        const u32 begin = m_next.fetch_add(m_chunk);
+        if (begin >= m_count)
+            break;
+        const u32 end = begin + m_chunk < m_count ? begin + m_chunk : m_count;
+        (*m_func)(begin, end, slot);
+    }
+}
+
+void JobSystem::ParallelFor(u32 count, u32 grain, const RangeFunc &func)
+{
+    if (count == 0)
+        return;
+
+    if (grain == 0)
+        grain = 1;
+
+    if (t_insideJob || m_threads.empty() || count <= grain)
+    {
+        func(0, count, 0);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit(m_submit);
+
+    // ~4 blocos por thread para equilibrar, nunca menores que grain
+    const u32 workers = GetWorkerCount();
+    const u32 chunk = (count + workers * 4 - 1) / (workers * 4);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_func = &func;
+        m_count = count;
+        m_chunk = chunk > grain ? chunk : grain;
+        m_next = 0;
+        m_active = (u32)m_threads.size();
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    t_insideJob = true;
+    RunChunks(0);
+    t_insideJob = false;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [&]
+                { return m_active == 0; });
+    m_func = nullptr;
+}
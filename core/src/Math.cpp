@@ -1824,6 +1824,24 @@ bool BoundingBox::contains(const Vec3 &point) const
            point.z >= min.z && point.z <= max.z;
 }
 
+BoundingBox BoundingBox::transformed(const Mat4 &matrix) const
+{
+    // Arvo: cada eixo soma o menor/maior contributo de cada coluna
+    BoundingBox result;
+    for (int i = 0; i < 3; ++i)
+    {
+        result.min[i] = result.max[i] = matrix(i, 3);
+        for (int j = 0; j < 3; ++j)
+        {
+            const float a = matrix(i, j) * min[j];
+            const float b = matrix(i, j) * max[j];
+            result.min[i] += a < b ? a : b;
+            result.max[i] += a < b ? b : a;
+        }
+    }
+    return result;
+}
+
 // ==================== CSM Namespace ====================
 
 namespace CSM
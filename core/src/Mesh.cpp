@@ -5,6 +5,8 @@
 #include "Texture.hpp"
 #include "Stream.hpp"
 #include "Batch.hpp"
+#include "MeshOptimizer.hpp"
+#include "Frustum.hpp"
 #include "glad/glad.h"
 
 Material::Material()
@@ -31,14 +33,18 @@ Texture *Material::GetTexture(u32 index) const
     return nullptr;
 }
 
+bool MeshBuffer::s_shaderDecode = false;
+
 MeshBuffer::MeshBuffer()
 {
     buffer = new VertexArray();
     vb = nullptr;
     ib = nullptr;
+    m_tangentBuffer = nullptr;
 
     m_vdirty = true;
     m_idirty = true;
+    m_adjacencyDirty = true;
 }
 
 MeshBuffer::~MeshBuffer()
@@ -50,8 +56,11 @@ void MeshBuffer::Clear()
 {
     vertices.clear();
     indices.clear();
+    m_meshlets.clear();
+    m_tangents.clear();
     m_vdirty = true;
     m_idirty = true;
+    m_adjacencyDirty = true;
 }
 
 u32 MeshBuffer::AddVertex(const Vertex &v)
@@ -76,6 +85,7 @@ u32 MeshBuffer::AddVertex(float x, float y, float z, float nx, float ny, float n
 u32 MeshBuffer::AddIndex(u32 index)
 {
     m_idirty = true;
+    m_adjacencyDirty = true;
     indices.push_back(index);
     return indices.size() - 1;
 }
@@ -83,6 +93,7 @@ u32 MeshBuffer::AddIndex(u32 index)
 u32 MeshBuffer::AddFace(u32 i0, u32 i1, u32 i2)
 {
     m_idirty = true;
+    m_adjacencyDirty = true;
     indices.push_back(i0);
     indices.push_back(i1);
     indices.push_back(i2);
@@ -97,26 +108,35 @@ void MeshBuffer::SetMaterial(u32 material)
 
 void MeshBuffer::Build()
 {
+    const bool tangents = HasTangents();
 
-    if (!vb)
+    // Os buffers da GPU tem tamanho fixo: recria se o numero de vertices,
+    // de indices, a largura dos indices ou os streams mudaram
+    if (vb && (vb->SetVertexCount() != vertices.size() ||
+               (ib && (ib->GetIndexCount() != indices.size() || ib->Is16Bit() != indices.Is16Bit())) ||
+               tangents != (m_tangentBuffer != nullptr)))
     {
-        vb = buffer->AddVertexBuffer(sizeof(Vertex), vertices.size(), false);
-
-        auto *decl = buffer->GetVertexDeclaration();
-
-        decl->AddElement(0, 0, VET_FLOAT3, VES_POSITION);
-        decl->AddElement(0, 3 * sizeof(float), VET_FLOAT3, VES_NORMAL);
-        decl->AddElement(0, 6 * sizeof(float), VET_FLOAT2, VES_TEXCOORD, 0);
+        ResetGpuBuffers();
     }
 
+    if (!vb)
+        CreateVertexStreams(buffer, vb, m_tangentBuffer);
+
     if (!ib)
     {
-        ib = buffer->CreateIndexBuffer(indices.size(), false, false);
+        ib = buffer->CreateIndexBuffer(indices.size(), false, indices.Is16Bit());
     }
 
+    if (m_vdirty || m_idirty)
+        m_buildVersion++; // os SkinnedOutput das instancias ficam velhos
+
     if (m_vdirty)
     {
-        vb->SetData(vertices.data());
+        CalculateBoundingBox();
+        UploadVertices(vb, vertices.data(), (u32)vertices.size());
+        m_skinnedPose.Reset(); // o VBO voltou a bind pose
+        if (m_tangentBuffer)
+            m_tangentBuffer->SetData(m_tangents.data());
     }
 
     if (m_idirty)
@@ -130,6 +150,157 @@ void MeshBuffer::Build()
     m_vdirty = false;
 }
 
+// Layout do vertex buffer (e do stream de tangentes) no VAO dado: o do
+// proprio buffer ou o de um SkinnedOutput
+void MeshBuffer::CreateVertexStreams(VertexArray *array, VertexBuffer *&vertexBuffer,
+                                     VertexBuffer *&tangentBuffer) const
+{
+    const MeshOptimizer::VertexFormat gpu = GetGpuFormat();
+    vertexBuffer = array->AddVertexBuffer(MeshOptimizer::GetVertexStride(gpu), vertices.size(), false);
+
+    auto *decl = array->GetVertexDeclaration();
+
+    u32 offset = 0;
+    switch (gpu.position)
+    {
+    case MeshOptimizer::POSITION_HALF4:
+        decl->AddElement(0, offset, VET_HALF4, VES_POSITION);
+        offset += 4 * sizeof(u16);
+        break;
+    case MeshOptimizer::POSITION_SNORM16:
+        decl->AddElement(0, offset, VET_SHORT4N, VES_POSITION);
+        offset += 4 * sizeof(s16);
+        break;
+    default:
+        decl->AddElement(0, offset, VET_FLOAT3, VES_POSITION);
+        offset += 3 * sizeof(float);
+        break;
+    }
+
+    if (gpu.normal == MeshOptimizer::NORMAL_OCT16)
+    {
+        decl->AddElement(0, offset, VET_SHORT2N, VES_NORMAL);
+        offset += 2 * sizeof(s16);
+    }
+    else
+    {
+        decl->AddElement(0, offset, VET_FLOAT3, VES_NORMAL);
+        offset += 3 * sizeof(float);
+    }
+
+    if (gpu.texCoord == MeshOptimizer::TEXCOORD_HALF2)
+        decl->AddElement(0, offset, VET_HALF2, VES_TEXCOORD, 0);
+    else
+        decl->AddElement(0, offset, VET_FLOAT2, VES_TEXCOORD, 0);
+
+    tangentBuffer = nullptr;
+    if (HasTangents())
+    {
+        tangentBuffer = array->AddVertexBuffer(sizeof(Vec4), vertices.size(), false);
+        decl->AddElement(1, 0, VET_FLOAT4, VES_TANGENT);
+    }
+}
+
+void MeshBuffer::ResetGpuBuffers()
+{
+    delete buffer;
+    buffer = new VertexArray();
+    vb = nullptr;
+    ib = nullptr;
+    m_vdirty = true;
+    m_idirty = true;
+    m_buildVersion++; // o ib apagado estava partilhado com os SkinnedOutput
+}
+
+MeshOptimizer::VertexFormat MeshBuffer::GetGpuFormat() const
+{
+    return MeshOptimizer::GetGpuFormat(m_format, s_shaderDecode);
+}
+
+void MeshBuffer::UploadVertices(VertexBuffer *target, const Vertex *source, u32 count)
+{
+    const MeshOptimizer::VertexFormat gpu = GetGpuFormat();
+    if (gpu.IsFloat())
+    {
+        target->SetData(source);
+        return;
+    }
+
+    if (gpu.position == MeshOptimizer::POSITION_SNORM16)
+    {
+        // Os vertices mudaram (Transform, etc.) e sairam dos bounds: recalcula
+        const float limit = m_quantScale * 1.0001f;
+        for (u32 i = 0; i < count; ++i)
+        {
+            const Vertex &v = source[i];
+            if (std::fabs(v.x - m_quantCenter.x) > limit || std::fabs(v.y - m_quantCenter.y) > limit ||
+                std::fabs(v.z - m_quantCenter.z) > limit)
+            {
+                LogWarning("[MeshBuffer] Vertices outside quantization bounds, position decode changed");
+                MeshOptimizer::ComputeQuantizationBounds(source, count, m_quantCenter, m_quantScale);
+                break;
+            }
+        }
+    }
+
+    // Os vertices float continuam a ser a copia em CPU. Os skinned sobem
+    // todos os frames e reaproveitam o scratch; os estaticos libertam-no
+    m_packed.resize(count * MeshOptimizer::GetVertexStride(gpu));
+    MeshOptimizer::PackVertices(m_packed.data(), source, count, gpu, m_quantCenter, m_quantScale);
+    target->SetData(m_packed.data());
+    if (!m_isSkinned)
+        std::vector<u8>().swap(m_packed);
+}
+
+MeshOptimizer::QuantizationError MeshBuffer::SetVertexFormat(const MeshOptimizer::VertexFormat &format)
+{
+    Vec3 center;
+    float scale;
+    MeshOptimizer::ComputeQuantizationBounds(vertices.data(), vertices.size(), center, scale);
+    return SetVertexFormat(format, center, scale);
+}
+
+MeshOptimizer::QuantizationError MeshBuffer::SetVertexFormat(const MeshOptimizer::VertexFormat &format,
+                                                             const Vec3 &center, float scale)
+{
+    MeshOptimizer::VertexFormat target = format;
+    if (m_isSkinned && target.position == MeshOptimizer::POSITION_SNORM16)
+    {
+        LogWarning("[MeshBuffer] SNORM16 positions not supported on skinned buffers, using HALF4");
+        target.position = MeshOptimizer::POSITION_HALF4;
+    }
+
+    MeshOptimizer::QuantizationError report = MeshOptimizer::AnalyzeQuantization(
+        vertices.data(), m_isSkinned ? m_skinData.data() : nullptr, vertices.size(), target, center, scale);
+
+    const MeshOptimizer::VertexFormat gpuOld = GetGpuFormat();
+    const MeshOptimizer::VertexFormat gpuNew = MeshOptimizer::GetGpuFormat(target, s_shaderDecode);
+    const bool layoutChanged = MeshOptimizer::GetVertexStride(gpuNew) != MeshOptimizer::GetVertexStride(gpuOld) ||
+                               gpuNew.position != gpuOld.position || gpuNew.normal != gpuOld.normal ||
+                               gpuNew.texCoord != gpuOld.texCoord;
+
+    m_format = target;
+    m_quantCenter = center;
+    m_quantScale = scale;
+
+    if (vb && layoutChanged)
+        ResetGpuBuffers();
+    else
+        m_vdirty = true;
+
+    LogInfo("[MeshBuffer] Vertex format: %u -> %u bytes (pos %.5f, normal %.3f deg, uv %.5f, weight %.5f)",
+            report.vertexBytes, report.packedBytes, report.position, report.normal, report.texCoord, report.weight);
+
+    return report;
+}
+
+Mat4 MeshBuffer::GetPositionDecode() const
+{
+    if (GetGpuFormat().position != MeshOptimizer::POSITION_SNORM16)
+        return Mat4::Identity();
+    return Mat4::Translation(m_quantCenter) * Mat4::Scale(m_quantScale, m_quantScale, m_quantScale);
+}
+
 void MeshBuffer::Render()
 {
     if (m_idirty || m_vdirty)
@@ -139,6 +310,62 @@ void MeshBuffer::Render()
     buffer->Render(PrimitiveType::PT_TRIANGLES, indices.size());
 }
 
+bool MeshBuffer::HasMeshlets() const
+{
+    if (m_meshlets.empty())
+        return false;
+    const MeshOptimizer::Meshlet &last = m_meshlets.back();
+    return last.indexOffset + last.indexCount == indices.size();
+}
+
+u32 MeshBuffer::RenderMeshlets(const Frustum &frustum, const Vec3 &cameraPosition)
+{
+    // Skinned: os bounds sao da bind pose, nao servem. Desenha tudo sem
+    // culling e devolve 0 para o chamador saber que nao houve culling
+    if (m_isSkinned || !HasMeshlets())
+    {
+        if (!m_meshletFallbackWarned)
+        {
+            LogWarning("[MeshBuffer] RenderMeshlets without culling (%s), drawing the whole buffer",
+                       m_isSkinned ? "skinned" : "no meshlets");
+            m_meshletFallbackWarned = true;
+        }
+        Render();
+        return 0;
+    }
+
+    if (m_idirty || m_vdirty)
+    {
+        Build();
+    }
+
+    // Junta meshlets visiveis seguidos num so draw
+    u32 visible = 0;
+    u32 first = 0;
+    u32 count = 0;
+    for (const MeshOptimizer::Meshlet &meshlet : m_meshlets)
+    {
+        if (!frustum.intersectsSphere(meshlet.center, meshlet.radius) ||
+            MeshOptimizer::IsMeshletBackfacing(meshlet, cameraPosition))
+            continue;
+
+        visible++;
+        if (count > 0 && first + count == meshlet.indexOffset)
+        {
+            count += meshlet.indexCount;
+            continue;
+        }
+        if (count > 0)
+            buffer->RenderRange(PrimitiveType::PT_TRIANGLES, first, count);
+        first = meshlet.indexOffset;
+        count = meshlet.indexCount;
+    }
+    if (count > 0)
+        buffer->RenderRange(PrimitiveType::PT_TRIANGLES, first, count);
+
+    return visible;
+}
+
 void MeshBuffer::Debug(RenderBatch *batch)
 {
 
@@ -181,79 +408,118 @@ void MeshBuffer::Debug(RenderBatch *batch)
     }
 }
 
-void MeshBuffer::UpdateSkinning(Mesh *mesh)
+void MeshBuffer::UpdateSkinning(Mesh *mesh, Skinning::SkinningMode mode)
 {
-    if (!mesh)
+    Skinning::SkinningJob job;
+    if (!mesh || !PrepareSkinning(mesh->m_bonePalette, mesh, mesh->m_poseVersion, mode, job))
         return;
 
-    if (!m_isSkinned || mesh->m_boneMatrices.empty() || vertices.empty() || m_skinData.empty())
+    Skinning::RunJobs(&job, 1);
+    UploadSkinning(job);
+}
+
+bool MeshBuffer::PrepareSkinning(const std::vector<Skinning::AffineMatrix> &palette, const void *pose,
+                                 u32 poseVersion, Skinning::SkinningMode mode, Skinning::SkinningJob &job,
+                                 SkinnedOutput *output)
+{
+    if (!m_isSkinned || palette.empty() || vertices.empty() || m_skinData.size() != vertices.size())
     {
         LogWarning("Mesh not skinned or malformed!");
-        return;
+        return false;
     }
 
-    for (size_t i = 0; i < vertices.size(); i++)
-    {
-        const Vertex &original = vertices[i];
-        const VertexSkin &skin = m_skinData[i];
-
-        Vec3 finalPos(0, 0, 0);
-        Vec3 finalNormal(0, 0, 0);
+    Skinning::SkinnedPose &skinned = output ? output->pose : m_skinnedPose;
 
-        // Aplica influência de cada bone
-        for (int j = 0; j < 4; j++)
-        {
-            float weight = skin.weights[j];
-            if (weight == 0.0f)
-                continue;
-            u8 boneID = skin.boneIDs[j];
-            Bone *bone = mesh->GetBone(boneID);
-            if (!bone)
-            {
-                LogWarning("Bone not found %d ", boneID);
-                continue;
-            }
-
-            Mat4 boneMatrix = bone->GetGlobalTransform() * bone->inverseBindPose;
+    // Pose ja no VBO. Uma instancia tem de ter o VAO da geometria atual
+    if (output)
+    {
+        if (m_vdirty || m_idirty || !vb)
+            Build();
+        if (!output->array || output->sourceVersion != m_buildVersion || output->indexCount != indices.size())
+            BuildSkinnedOutput(*output);
+    }
+    else if (!vb || m_vdirty || m_idirty)
+        skinned.Reset();
+    if (skinned.Matches(pose, poseVersion, mode))
+        return false;
+    skinned.Set(pose, poseVersion, mode);
+
+    // Paleta ja calculada pelo UpdateBonePalette do dono
+    const bool tangents = mode == Skinning::SKIN_FULL && HasTangents();
+    job.vertices = vertices.data();
+    job.skin = m_skinData.data();
+    job.vertexCount = (u32)vertices.size();
+    job.bones = palette.data();
+    job.boneCount = (u32)palette.size();
+    job.tangents = tangents ? m_tangents.data() : nullptr;
+    job.mode = mode;
+    if (output)
+        return true; // destino no scratch do lote (Mesh::UpdateSkinning)
+
+    // Tudo o que realoca fica aqui, antes dos jobs
+    if (m_skinnedVertices.size() != vertices.size())
+        m_skinnedVertices = vertices;
+    if (tangents)
+        m_skinnedTangents.resize(m_tangents.size());
+
+    job.destination = m_skinnedVertices.data();
+    job.destinationTangents = tangents ? m_skinnedTangents.data() : nullptr;
+    return true;
+}
 
-            mesh->m_boneMatrices[boneID] = boneMatrix;
+void MeshBuffer::UploadSkinning(const Skinning::SkinningJob &job, SkinnedOutput *output)
+{
+    if (output)
+    {
+        output->bounds = job.bounds;
+        UploadVertices(output->vb, job.destination, job.vertexCount);
+        if (output->tangentBuffer && job.destinationTangents)
+            output->tangentBuffer->SetData(job.destinationTangents);
+        return;
+    }
 
-            // Transform position
-            Vec3 transformedPos = boneMatrix.TransformPoint(Vec3(original.x, original.y, original.z));
-            finalPos.x += transformedPos.x * weight;
-            finalPos.y += transformedPos.y * weight;
-            finalPos.z += transformedPos.z * weight;
+    if (!vb || m_vdirty || m_idirty)
+    {
+        // O Build sobe a bind pose; a pose skinned vai logo por cima
+        const Skinning::SkinnedPose skinned = m_skinnedPose;
+        Build();
+        m_skinnedPose = skinned;
+    }
 
-            // Transform normal (sem translation)
-            Vec3 transformedNormal = boneMatrix.TransformVector(Vec3(original.nx, original.ny, original.nz));
-            finalNormal.x += transformedNormal.x * weight;
-            finalNormal.y += transformedNormal.y * weight;
-            finalNormal.z += transformedNormal.z * weight;
-        }
+    // Bounds da pose atual (a esfera e a da box, sem outra passagem)
+    m_boundingBox = job.bounds;
+    m_boundingCenter = job.bounds.center();
+    m_boundingRadius = job.bounds.size().length() * 0.5f;
 
-        // Normaliza normal
-        float len = sqrt(finalNormal.x * finalNormal.x +
-                         finalNormal.y * finalNormal.y +
-                         finalNormal.z * finalNormal.z);
-        if (len > 0.0f)
-        {
-            finalNormal.x /= len;
-            finalNormal.y /= len;
-            finalNormal.z /= len;
-        }
+    UploadVertices(vb, job.destination, job.vertexCount);
+    if (m_tangentBuffer && job.destinationTangents)
+        m_tangentBuffer->SetData(job.destinationTangents);
+}
 
-        m_skinnedVertices[i].x = finalPos.x;
-        m_skinnedVertices[i].y = finalPos.y;
-        m_skinnedVertices[i].z = finalPos.z;
-        m_skinnedVertices[i].nx = finalNormal.x;
-        m_skinnedVertices[i].ny = finalNormal.y;
-        m_skinnedVertices[i].nz = finalNormal.z;
-        m_skinnedVertices[i].u = original.u;
-        m_skinnedVertices[i].v = original.v;
-    }
+SkinnedOutput::~SkinnedOutput()
+{
+    delete array;
+}
 
-    vb->SetData(m_skinnedVertices.data());
-    buffer->Build();
+void MeshBuffer::BuildSkinnedOutput(SkinnedOutput &output)
+{
+    // Mesmo layout e o mesmo ib que este buffer; os vertices vem do skinning.
+    // O Build ja correu, o ib existe e o m_buildVersion e o dele
+    delete output.array;
+    output.array = new VertexArray();
+    CreateVertexStreams(output.array, output.vb, output.tangentBuffer);
+    output.array->ShareIndexBuffer(ib);
+    if (output.tangentBuffer)
+        output.tangentBuffer->SetData(m_tangents.data());
+    output.array->Build();
+
+    output.gpuBytes = (size_t)vertices.size() * MeshOptimizer::GetVertexStride(GetGpuFormat());
+    if (output.tangentBuffer)
+        output.gpuBytes += m_tangents.size() * sizeof(Vec4);
+    output.pose.Reset();
+    output.bounds = m_boundingBox;
+    output.indexCount = (u32)indices.size();
+    output.sourceVersion = m_buildVersion;
 }
 
 void MeshBuffer::Transform(const Mat4 &matrix)
@@ -264,8 +530,18 @@ void MeshBuffer::Transform(const Mat4 &matrix)
         for (int j = 0; j < 3; ++j)
             normalMatrix(i, j) = matrix(i, j);
 
+    // Tangentes seguem a matriz (nao a inversa transposta); espelhar troca o sinal
+    const Mat3 tangentMatrix = normalMatrix;
+    const float handedness = tangentMatrix.determinant() < 0.0f ? -1.0f : 1.0f;
+
     normalMatrix = normalMatrix.inverse().transposed();
 
+    for (auto &t : m_tangents)
+    {
+        Vec3 tangent = (tangentMatrix * Vec3(t.x, t.y, t.z)).normalized();
+        t = Vec4(tangent, t.w * handedness);
+    }
+
     for (auto &v : vertices)
     {
 
@@ -283,6 +559,7 @@ void MeshBuffer::Transform(const Mat4 &matrix)
         v.nz = normal.z;
     }
 
+    m_meshlets.clear();
     m_vdirty = true;
 }
 
@@ -296,6 +573,7 @@ void MeshBuffer::TransformPositions(const Mat4 &matrix)
         v.y = pos.y;
         v.z = pos.z;
     }
+    m_meshlets.clear();
     m_vdirty = true;
 }
 
@@ -344,215 +622,241 @@ void MeshBuffer::Scale(float uniformScale)
 
 void MeshBuffer::RemoveDuplicateVertices(float threshold)
 {
-    struct VertexHash
-    {
-        size_t operator()(const Vertex &v) const
-        {
-
-            size_t h1 = std::hash<float>{}(v.x);
-            size_t h2 = std::hash<float>{}(v.y);
-            size_t h3 = std::hash<float>{}(v.z);
-            return h1 ^ (h2 << 1) ^ (h3 << 2);
-        }
-    };
-
-    struct VertexEqual
-    {
-        float threshold;
-
-        VertexEqual(float t) : threshold(t) {}
-
-        bool operator()(const Vertex &a, const Vertex &b) const
-        {
-            float dx = a.x - b.x;
-            float dy = a.y - b.y;
-            float dz = a.z - b.z;
-            float distSq = dx * dx + dy * dy + dz * dz;
-
-            if (distSq > threshold * threshold)
-                return false;
-
-            // Também compara normais e UVs
-            float dnx = a.nx - b.nx;
-            float dny = a.ny - b.ny;
-            float dnz = a.nz - b.nz;
-            float normalDistSq = dnx * dnx + dny * dny + dnz * dnz;
+    if (vertices.empty())
+        return;
 
-            if (normalDistSq > threshold * threshold)
-                return false;
+    std::vector<u32> remapTable;
+    const u32 uniqueCount = MeshOptimizer::WeldVertices(vertices.data(), (u32)vertices.size(), threshold, remapTable);
 
-            float du = a.u - b.u;
-            float dv = a.v - b.v;
-            float uvDistSq = du * du + dv * dv;
+    if (uniqueCount == vertices.size())
+        return;
 
-            return uvDistSq <= threshold * threshold;
-        }
-    };
+    // Os indices novos seguem a ordem da primeira ocorrencia,
+    // logo o primeiro vertice de cada grupo e o que fica
+    const bool hasSkin = m_skinData.size() == vertices.size();
+    const bool hasTangents = HasTangents();
 
-    std::vector<Vertex> uniqueVertices;
-    std::vector<u32> remapTable(vertices.size());
+    std::vector<Vertex> uniqueVertices(uniqueCount);
+    std::vector<VertexSkin> uniqueSkin(hasSkin ? uniqueCount : 0);
+    std::vector<Vec4> uniqueTangents(hasTangents ? uniqueCount : 0);
 
+    u32 written = 0;
     for (size_t i = 0; i < vertices.size(); ++i)
     {
-        const Vertex &v = vertices[i];
-
-        // Procura vértice similar
-        bool found = false;
-        for (size_t j = 0; j < uniqueVertices.size(); ++j)
-        {
-            if (VertexEqual(threshold)(v, uniqueVertices[j]))
-            {
-                remapTable[i] = (u32)j;
-                found = true;
-                break;
-            }
-        }
+        if (remapTable[i] != written)
+            continue;
 
-        if (!found)
-        {
-            remapTable[i] = (u32)uniqueVertices.size();
-            uniqueVertices.push_back(v);
-        }
+        uniqueVertices[written] = vertices[i];
+        if (hasSkin)
+            uniqueSkin[written] = m_skinData[i];
+        if (hasTangents)
+            uniqueTangents[written] = m_tangents[i];
+        written++;
     }
 
     // Remapeia índices
-    for (auto &idx : indices)
-    {
-        idx = remapTable[idx];
-    }
+    indices.Remap(remapTable.data());
 
     vertices = std::move(uniqueVertices);
+    if (hasTangents)
+        m_tangents = std::move(uniqueTangents);
+    if (hasSkin)
+    {
+        m_skinData = std::move(uniqueSkin);
+        m_skinnedVertices.resize(uniqueCount);
+    }
 
     m_idirty = true;
+    m_adjacencyDirty = true;
     m_vdirty = true;
 }
 
-void MeshBuffer::Optimize()
+MeshOptimizer::VertexCacheStats MeshBuffer::AnalyzeVertexCache(u32 cacheSize) const
 {
+    const std::vector<u32> source = indices.ToVector();
+    return MeshOptimizer::AnalyzeVertexCache(source.data(), (u32)source.size(), (u32)vertices.size(), cacheSize);
+}
 
-    const size_t cacheSize = 32;
-    std::vector<u32> newIndices;
-    std::vector<bool> emitted(indices.size() / 3, false);
-    std::vector<int> lastUsed(vertices.size(), -1);
+MeshOptimizer::VertexCacheResult MeshBuffer::Optimize(u32 cacheSize)
+{
+    MeshOptimizer::VertexCacheResult result;
+    if (indices.size() < 3 || vertices.empty())
+        return result;
 
-    newIndices.reserve(indices.size());
+    // Medido com o mesmo cache para o qual se otimiza
+    std::vector<u32> source = indices.ToVector();
+    result.before = MeshOptimizer::AnalyzeVertexCache(source.data(), (u32)source.size(), (u32)vertices.size(), cacheSize);
 
-    int currentTime = 0;
+    MeshOptimizer::OptimizeVertexCache(source.data(), source.data(), (u32)source.size(), (u32)vertices.size(), cacheSize);
+    indices.Assign(source);
 
-    while (newIndices.size() < indices.size())
-    {
-        int bestTriangle = -1;
-        int bestScore = -1;
+    result.after = MeshOptimizer::AnalyzeVertexCache(source.data(), (u32)source.size(), (u32)vertices.size(), cacheSize);
 
-        // Encontra o melhor triângulo para adicionar
-        for (size_t i = 0; i < indices.size() / 3; ++i)
-        {
-            if (emitted[i])
-                continue;
+    m_meshlets.clear();
+    m_idirty = true;
+    m_adjacencyDirty = true;
+    return result;
+}
 
-            u32 i0 = indices[i * 3 + 0];
-            u32 i1 = indices[i * 3 + 1];
-            u32 i2 = indices[i * 3 + 2];
+MeshOptimizer::VertexFetchStats MeshBuffer::AnalyzeVertexFetch() const
+{
+    const std::vector<u32> source = indices.ToVector();
+    return MeshOptimizer::AnalyzeVertexFetch(source.data(), (u32)source.size(), (u32)vertices.size(), sizeof(Vertex));
+}
 
-            int score = 0;
+template <typename T>
+static void RemapVertexStream(std::vector<T> &stream, const std::vector<u32> &remap)
+{
+    if (stream.size() != remap.size())
+        return;
 
-            // Pontos para vértices recentemente usados
-            if (lastUsed[i0] >= 0 && (currentTime - lastUsed[i0]) < (int)cacheSize)
-                score += 10;
-            if (lastUsed[i1] >= 0 && (currentTime - lastUsed[i1]) < (int)cacheSize)
-                score += 10;
-            if (lastUsed[i2] >= 0 && (currentTime - lastUsed[i2]) < (int)cacheSize)
-                score += 10;
+    std::vector<T> remapped(stream.size());
+    for (size_t i = 0; i < stream.size(); ++i)
+        remapped[remap[i]] = stream[i];
+    stream = std::move(remapped);
+}
 
-            if (score > bestScore)
-            {
-                bestScore = score;
-                bestTriangle = (int)i;
-            }
-        }
+MeshOptimizer::VertexFetchResult MeshBuffer::OptimizeVertexFetch()
+{
+    MeshOptimizer::VertexFetchResult result;
+    if (indices.empty() || vertices.empty())
+        return result;
 
-        // Se não encontrou nenhum, pega o primeiro não emitido
-        if (bestTriangle < 0)
-        {
-            for (size_t i = 0; i < indices.size() / 3; ++i)
-            {
-                if (!emitted[i])
-                {
-                    bestTriangle = (int)i;
-                    break;
-                }
-            }
-        }
+    result.before = AnalyzeVertexFetch();
 
-        // Adiciona o triângulo
-        if (bestTriangle >= 0)
-        {
-            u32 i0 = indices[bestTriangle * 3 + 0];
-            u32 i1 = indices[bestTriangle * 3 + 1];
-            u32 i2 = indices[bestTriangle * 3 + 2];
+    const std::vector<u32> source = indices.ToVector();
+    std::vector<u32> remap(vertices.size());
+    MeshOptimizer::OptimizeVertexFetchRemap(remap.data(), source.data(), (u32)source.size(), (u32)vertices.size());
 
-            newIndices.push_back(i0);
-            newIndices.push_back(i1);
-            newIndices.push_back(i2);
+    RemapVertexStream(vertices, remap);
+    RemapVertexStream(m_skinData, remap);
+    RemapVertexStream(m_skinnedVertices, remap);
+    RemapVertexStream(m_tangents, remap);
 
-            emitted[bestTriangle] = true;
+    indices.Remap(remap.data());
 
-            lastUsed[i0] = currentTime++;
-            lastUsed[i1] = currentTime++;
-            lastUsed[i2] = currentTime++;
-        }
-    }
+    result.after = AnalyzeVertexFetch();
 
-    indices = std::move(newIndices);
+    m_vdirty = true;
+    m_idirty = true;
+    m_adjacencyDirty = true;
+    return result;
 }
 
-void MeshBuffer::CalculateNormals(bool smooth)
+MeshOptimizer::OverdrawStats MeshBuffer::AnalyzeOverdraw() const
 {
-    if (smooth)
-    {
+    const std::vector<u32> source = indices.ToVector();
+    return MeshOptimizer::AnalyzeOverdraw(source.data(), (u32)source.size(), vertices.data(), (u32)vertices.size());
+}
 
-        for (auto &v : vertices)
-        {
-            v.nx = v.ny = v.nz = 0.0f;
-        }
+MeshOptimizer::OverdrawResult MeshBuffer::OptimizeOverdraw(float threshold)
+{
+    MeshOptimizer::OverdrawResult result;
+    if (indices.size() < 3 || vertices.empty())
+        return result;
 
-        for (size_t i = 0; i < indices.size(); i += 3)
-        {
-            u32 i0 = indices[i];
-            u32 i1 = indices[i + 1];
-            u32 i2 = indices[i + 2];
+    std::vector<u32> source = indices.ToVector();
+    result.before = MeshOptimizer::AnalyzeOverdraw(source.data(), (u32)source.size(), vertices.data(), (u32)vertices.size());
 
-            Vec3 v0(vertices[i0].x, vertices[i0].y, vertices[i0].z);
-            Vec3 v1(vertices[i1].x, vertices[i1].y, vertices[i1].z);
-            Vec3 v2(vertices[i2].x, vertices[i2].y, vertices[i2].z);
+    MeshOptimizer::OptimizeOverdraw(source.data(), source.data(), (u32)source.size(), vertices.data(), (u32)vertices.size(), threshold);
+    indices.Assign(source);
 
-            Vec3 edge1 = v1 - v0;
-            Vec3 edge2 = v2 - v0;
-            Vec3 normal = edge1.cross(edge2);
+    result.after = MeshOptimizer::AnalyzeOverdraw(source.data(), (u32)source.size(), vertices.data(), (u32)vertices.size());
 
-            vertices[i0].nx += normal.x;
-            vertices[i0].ny += normal.y;
-            vertices[i0].nz += normal.z;
+    m_meshlets.clear();
+    m_idirty = true;
+    m_adjacencyDirty = true;
+    return result;
+}
 
-            vertices[i1].nx += normal.x;
-            vertices[i1].ny += normal.y;
-            vertices[i1].nz += normal.z;
+u32 MeshBuffer::BuildMeshlets(u32 maxVertices, u32 maxTriangles)
+{
+    m_meshlets.clear();
+    if (indices.size() < 3 || vertices.empty())
+        return 0;
+
+    std::vector<u32> source = indices.ToVector();
+    MeshOptimizer::BuildMeshlets(m_meshlets, source.data(), source.data(), (u32)source.size(), vertices.data(),
+                                 (u32)vertices.size(), maxVertices, maxTriangles);
+    indices.Assign(source);
+
+    u32 totalVertices = 0;
+    u32 cones = 0;
+    for (const MeshOptimizer::Meshlet &meshlet : m_meshlets)
+    {
+        totalVertices += meshlet.vertexCount;
+        cones += meshlet.coneCutoff <= 1.0f ? 1 : 0;
+    }
 
-            vertices[i2].nx += normal.x;
-            vertices[i2].ny += normal.y;
-            vertices[i2].nz += normal.z;
-        }
+    LogInfo("[MeshBuffer] Meshlets: %zu (%.1f tris, %.1f vertices avg, %u with cone)",
+            m_meshlets.size(), (float)indices.size() / 3 / m_meshlets.size(),
+            (float)totalVertices / m_meshlets.size(), cones);
 
-        for (auto &v : vertices)
-        {
-            Vec3 n(v.nx, v.ny, v.nz);
-            n = n.normalized();
-            v.nx = n.x;
-            v.ny = n.y;
-            v.nz = n.z;
-        }
+    m_idirty = true;
+    m_adjacencyDirty = true;
+    return (u32)m_meshlets.size();
+}
+
+float MeshBuffer::Simplify(u32 targetIndexCount, float maxError)
+{
+    if (indices.size() < 3 || vertices.empty())
+        return 0.0f;
+
+    const u32 triangleCount = (u32)indices.size() / 3;
+    const VertexSkin *skin = m_skinData.size() == vertices.size() ? m_skinData.data() : nullptr;
+
+    float error = 0.0f;
+    const std::vector<u32> source = indices.ToVector();
+    std::vector<u32> result(source.size());
+    u32 count = MeshOptimizer::SimplifyMesh(result.data(), source.data(), (u32)source.size(), vertices.data(), skin,
+                                            (u32)vertices.size(), targetIndexCount, maxError, &error);
+    result.resize(count);
+
+    // Compacta: vertices usados pela ordem de uso, o resto sai
+    std::vector<u32> remap(vertices.size());
+    u32 used = MeshOptimizer::OptimizeVertexFetchRemap(remap.data(), result.data(), (u32)result.size(), (u32)vertices.size());
+
+    RemapVertexStream(vertices, remap);
+    RemapVertexStream(m_skinData, remap);
+    RemapVertexStream(m_skinnedVertices, remap);
+    RemapVertexStream(m_tangents, remap);
+    for (u32 &idx : result)
+        idx = remap[idx];
+    indices.Assign(result);
+
+    vertices.resize(used);
+    if (m_tangents.size() > used)
+        m_tangents.resize(used);
+    if (skin)
+        m_skinData.resize(used);
+    if (!m_skinnedVertices.empty())
+        m_skinnedVertices.resize(used);
+
+    LogInfo("[MeshBuffer] Simplify: %u -> %u tris, %u vertices (error %f)",
+            triangleCount, count / 3, used, error);
+
+    m_meshlets.clear();
+    m_vdirty = true;
+    m_idirty = true;
+    m_adjacencyDirty = true;
+    return error;
+}
+
+void MeshBuffer::CalculateNormals(bool smooth, MeshOptimizer::NormalWeighting weighting)
+{
+    m_tangents.clear();
+
+    if (smooth)
+    {
+        const MeshOptimizer::VertexAdjacency &adjacency = GetAdjacency();
+        const std::vector<u32> source = indices.ToVector();
+        MeshOptimizer::GenerateNormals(vertices.data(), (u32)vertices.size(), source.data(), (u32)source.size(),
+                                       adjacency, weighting);
+        m_vdirty = true;
+        return;
     }
-    else // Flat shading
+
+    // Flat shading
     {
 
         std::vector<Vertex> newVertices;
@@ -594,20 +898,92 @@ void MeshBuffer::CalculateNormals(bool smooth)
         }
 
         vertices = std::move(newVertices);
-        indices = std::move(newIndices);
+        indices.Assign(newIndices);
     }
     m_vdirty = true;
     m_idirty = true;
+    m_adjacencyDirty = true;
+}
+
+const MeshOptimizer::VertexAdjacency &MeshBuffer::GetAdjacency()
+{
+    if (m_adjacencyDirty || !m_adjacency.IsValid((u32)vertices.size(), (u32)indices.size() / 3 * 3))
+    {
+        const std::vector<u32> source = indices.ToVector();
+        MeshOptimizer::BuildVertexAdjacency(m_adjacency, source.data(), (u32)source.size(), (u32)vertices.size());
+        m_adjacencyDirty = false;
+    }
+    return m_adjacency;
+}
+
+void MeshBuffer::CalculateTangents()
+{
+    if (indices.size() < 3 || vertices.empty())
+        return;
+
+    std::vector<u32> source = indices.ToVector();
+    std::vector<u32> duplicates;
+    MeshOptimizer::GenerateTangents(m_tangents, duplicates, source.data(), (u32)source.size(), vertices.data(),
+                                    (u32)vertices.size());
+
+    // Copias dos vertices com mais de um grupo de tangentes (UVs espelhados, leques soltos)
+    if (!duplicates.empty())
+    {
+        const bool hasSkin = m_skinData.size() == vertices.size();
+        vertices.reserve(vertices.size() + duplicates.size());
+        for (u32 original : duplicates)
+        {
+            vertices.push_back(vertices[original]);
+            if (hasSkin)
+                m_skinData.push_back(m_skinData[original]);
+        }
+        if (!m_skinnedVertices.empty())
+            m_skinnedVertices.resize(vertices.size());
+        indices.Assign(source);
+        m_idirty = true;
+        m_adjacencyDirty = true;
+    }
+
+    LogInfo("[MeshBuffer] Tangents: %zu vertices (%zu split)", vertices.size(), duplicates.size());
+
+    m_vdirty = true;
+}
+
+void MeshBuffer::CalculateBoundingBox()
+{
+    if (vertices.empty())
+    {
+        m_boundingBox = BoundingBox();
+        m_boundingCenter = Vec3(0.0f);
+        m_boundingRadius = 0.0f;
+        return;
+    }
+
+    m_boundingBox.min = m_boundingBox.max = Vec3(vertices[0].x, vertices[0].y, vertices[0].z);
+    for (const Vertex &v : vertices)
+        m_boundingBox.expand(Vec3(v.x, v.y, v.z));
+
+    // Esfera centrada na box, raio ate ao vertice mais longe (<= meia diagonal)
+    m_boundingCenter = m_boundingBox.center();
+    float radiusSq = 0.0f;
+    for (const Vertex &v : vertices)
+        radiusSq = Max(radiusSq, (Vec3(v.x, v.y, v.z) - m_boundingCenter).lengthSquared());
+    m_boundingRadius = std::sqrt(radiusSq);
 }
 
 void MeshBuffer::Reverse()
 {
     // Inverte a ordem de winding de todos os triângulos
-    for (size_t i = 0; i < indices.size(); i += 3)
+    for (u32 i = 0; i + 2 < indices.size(); i += 3)
     {
-        std::swap(indices[i + 1], indices[i + 2]);
+        const u32 second = indices[i + 1];
+        indices.Set(i + 1, indices[i + 2]);
+        indices.Set(i + 2, second);
     }
+    m_meshlets.clear();
     m_vdirty = true;
+    m_idirty = true;
+    m_adjacencyDirty = true;
 }
 
 void MeshBuffer::FlipNormals()
@@ -618,6 +994,9 @@ void MeshBuffer::FlipNormals()
         v.ny = -v.ny;
         v.nz = -v.nz;
     }
+    // Mantem a bitangente: B = w * cross(N, T)
+    for (auto &t : m_tangents)
+        t.w = -t.w;
     m_vdirty = true;
 }
 
@@ -645,11 +1024,13 @@ void MeshBuffer::Merge(const MeshBuffer &other)
     vertices.insert(vertices.end(), other.vertices.begin(), other.vertices.end());
 
     // Adiciona índices com offset
-    for (u32 idx : other.indices)
+    for (u32 i = 0; i < other.indices.size(); i++)
     {
-        indices.push_back(idx + indexOffset);
+        indices.push_back(other.indices[i] + indexOffset);
     }
     m_vdirty = true;
+    m_idirty = true;
+    m_adjacencyDirty = true;
 }
 
 void MeshBuffer::GeneratePlanarUVs(const Vec3 &axis)
@@ -947,27 +1328,24 @@ MeshBuffer *Mesh::AddBuffer(u32 material)
 
 void Mesh::Render()
 {
-    for (MeshBuffer *buffer : buffers)
+    for (MeshBuffer *buffer : GetActiveBuffers())
     {
+        BindMaterial(buffer->m_material);
+        buffer->Render();
+    }
+}
 
-        const int materialID = buffer->m_material;
-        if (materialID >= 0 && materialID < (int)materials.size())
-        {
-            const u8 layer = materials[materialID]->GetLayers();
-            for (u8 i = 0; i < layer; i++)
-            {
-                const Texture *texture = materials[materialID]->GetTexture(i);
-                if (texture)
-                {
-                    texture->Bind(i);
-                }
-            }
-            buffer->Render();
-        }
-        else
-        {
-            buffer->Render();
-        }
+void Mesh::BindMaterial(u32 material) const
+{
+    if (material >= materials.size())
+        return;
+
+    const u8 layer = materials[material]->GetLayers();
+    for (u8 i = 0; i < layer; i++)
+    {
+        const Texture *texture = materials[material]->GetTexture(i);
+        if (texture)
+            texture->Bind(i);
     }
 }
 
@@ -979,6 +1357,15 @@ void Mesh::CalculateNormals()
     }
 }
 
+void Mesh::CalculateTangents()
+{
+    for (auto &buffer : buffers)
+        buffer->CalculateTangents();
+    for (MeshLod &level : m_lods)
+        for (MeshBuffer *buffer : level.buffers)
+            buffer->CalculateTangents();
+}
+
 void Mesh::SetTexture(u32 layer, Texture *texture)
 {
     for (Material *material : materials)
@@ -1016,93 +1403,420 @@ Mesh::~Mesh()
     {
         delete bone;
     }
-    m_bones.clear();
+    m_bones.clear();
+    ClearLods();
+}
+
+bool Mesh::SetBufferMaterial(u32 index, u32 material)
+{
+
+    if (material >= materials.size())
+    {
+        LogWarning("[Mesh] Invalid material index: %d", material);
+        return false;
+    }
+
+    if (index >= buffers.size() )
+    {
+        LogWarning("[Mesh] Invalid mesh buffer index: %d", index);
+        return false;
+    }
+
+    buffers[index]->SetMaterial(material);
+    return true;
+}
+
+bool Mesh::SetMaterial(u32 material)
+{
+    if (material >= materials.size())
+    {
+        LogWarning("[Mesh] Invalid material index: %d", material);
+        return false;
+    }
+    for (MeshBuffer *buffer : buffers)
+    {
+        buffer->SetMaterial(material);
+    }
+    return true;
+}
+
+void Mesh::OptimizeBuffers()
+{
+    if (buffers.empty())
+        return;
+
+    SortByMaterial();
+
+    // Buffers skinned e estaticos nao se misturam
+    std::map<std::pair<u32, bool>, std::vector<MeshBuffer *>> buffersByMaterial;
+    for (auto *buffer : buffers)
+    {
+        buffersByMaterial[{buffer->m_material, buffer->m_isSkinned}].push_back(buffer);
+    }
+
+    std::vector<MeshBuffer *> newBuffers;
+    for (auto &[key, materialBuffers] : buffersByMaterial)
+    {
+        if (materialBuffers.size() == 1)
+        {
+            newBuffers.push_back(materialBuffers[0]);
+            continue;
+        }
+
+        MeshBuffer *combined = new MeshBuffer();
+        combined->m_material = key.first;
+        combined->m_isSkinned = key.second;
+        for (auto *buffer : materialBuffers)
+        {
+            u32 vertexOffset = combined->vertices.size();
+
+            combined->vertices.insert(
+                combined->vertices.end(),
+                buffer->vertices.begin(),
+                buffer->vertices.end());
+
+            if (combined->m_isSkinned)
+            {
+                combined->m_skinData.insert(
+                    combined->m_skinData.end(),
+                    buffer->m_skinData.begin(),
+                    buffer->m_skinData.end());
+            }
+
+            for (u32 i = 0; i < buffer->indices.size(); i++)
+            {
+                combined->indices.push_back(buffer->indices[i] + vertexOffset);
+            }
+
+            delete buffer;
+        }
+
+        if (combined->m_isSkinned)
+            combined->m_skinnedVertices.resize(combined->vertices.size());
+
+        combined->m_vdirty = true;
+        combined->m_idirty = true;
+        combined->m_adjacencyDirty = true;
+        newBuffers.push_back(combined);
+    }
+
+    buffers.clear();
+
+    buffers = std::move(newBuffers);
+    m_bufferGeneration++;
+
+    SortByMaterial();
+
+    // Ordem importa: cache primeiro, overdraw mexe so em clusters, fetch no fim.
+    // Uma linha de log para o mesh todo; ACMR/ATVR somam os vertices transformados
+    // de todos os buffers, overdraw/overfetch sao medias pesadas pelos triangulos
+    MeshOptimizer::VertexCacheStats cacheBefore, cacheAfter;
+    float overdrawBefore = 0.0f, overdrawAfter = 0.0f, overfetchBefore = 0.0f, overfetchAfter = 0.0f;
+    for (auto *buffer : buffers)
+    {
+        const u32 count = buffer->GetIndexCount() / 3;
+        const MeshOptimizer::VertexCacheStats before = buffer->Optimize().before;
+
+        const MeshOptimizer::OverdrawResult overdraw = buffer->OptimizeOverdraw();
+        overdrawBefore += overdraw.before.overdraw * count;
+        overdrawAfter += overdraw.after.overdraw * count;
+
+        const MeshOptimizer::VertexFetchResult fetch = buffer->OptimizeVertexFetch();
+        overfetchBefore += fetch.before.overfetch * count;
+        overfetchAfter += fetch.after.overfetch * count;
+
+        // O overdraw devolve parte do ganho do cache; o ACMR final e medido no fim
+        const MeshOptimizer::VertexCacheStats after = buffer->AnalyzeVertexCache(MeshOptimizer::DEFAULT_CACHE_SIZE);
+
+        cacheBefore.triangleCount += before.triangleCount;
+        cacheBefore.vertexCount += before.vertexCount;
+        cacheBefore.transformedVertices += before.transformedVertices;
+        cacheAfter.triangleCount += after.triangleCount;
+        cacheAfter.vertexCount += after.vertexCount;
+        cacheAfter.transformedVertices += after.transformedVertices;
+    }
+
+    const u32 triangles = cacheAfter.triangleCount;
+    if (cacheBefore.triangleCount > 0 && cacheBefore.vertexCount > 0)
+    {
+        LogInfo("[Mesh] Optimized %zu buffers (%u tris): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, "
+                "overdraw %.3f -> %.3f, overfetch %.3f -> %.3f",
+                buffers.size(), triangles, (float)cacheBefore.transformedVertices / cacheBefore.triangleCount,
+                (float)cacheAfter.transformedVertices / triangles,
+                (float)cacheBefore.transformedVertices / cacheBefore.vertexCount,
+                (float)cacheAfter.transformedVertices / cacheAfter.vertexCount, overdrawBefore / triangles,
+                overdrawAfter / triangles, overfetchBefore / triangles, overfetchAfter / triangles);
+    }
+}
+
+// Copia os vertices (e streams) de um grupo para um buffer novo
+MeshBuffer *Mesh::CreateSplitBuffer(const MeshBuffer *source, const MeshOptimizer::IndexSplit &split)
+{
+    MeshBuffer *buffer = new MeshBuffer();
+    buffer->m_material = source->m_material;
+    buffer->m_isSkinned = source->m_isSkinned;
+    buffer->m_format = source->m_format;
+    buffer->m_quantCenter = source->m_quantCenter;
+    buffer->m_quantScale = source->m_quantScale;
+
+    const bool hasSkin = source->m_skinData.size() == source->vertices.size();
+    const bool hasTangents = source->HasTangents();
+
+    buffer->vertices.reserve(split.vertices.size());
+    for (u32 v : split.vertices)
+    {
+        buffer->vertices.push_back(source->vertices[v]);
+        if (hasSkin)
+            buffer->m_skinData.push_back(source->m_skinData[v]);
+        if (hasTangents)
+            buffer->m_tangents.push_back(source->m_tangents[v]);
+    }
+    if (!source->m_skinnedVertices.empty())
+        buffer->m_skinnedVertices.resize(buffer->vertices.size());
+
+    buffer->indices.Assign(split.indices);
+    return buffer;
+}
+
+u32 Mesh::SplitBufferList(std::vector<MeshBuffer *> &list, u32 maxVertices)
+{
+    u32 created = 0;
+    std::vector<MeshBuffer *> result;
+    std::vector<MeshOptimizer::IndexSplit> splits;
+
+    for (MeshBuffer *buffer : list)
+    {
+        if (buffer->GetVertexCount() <= maxVertices)
+        {
+            result.push_back(buffer);
+            continue;
+        }
+
+        const std::vector<u32> source = buffer->GetIndices().ToVector();
+        MeshOptimizer::SplitIndices(splits, source.data(), (u32)source.size(), buffer->GetVertexCount(), maxVertices);
+
+        for (const MeshOptimizer::IndexSplit &split : splits)
+            result.push_back(CreateSplitBuffer(buffer, split));
+
+        LogInfo("[Mesh] Split buffer: %u vertices -> %zu buffers", buffer->GetVertexCount(), splits.size());
+        created += (u32)splits.size() - 1;
+        delete buffer;
+    }
+
+    list = std::move(result);
+    return created;
+}
+
+u32 Mesh::SplitBuffers(u32 maxVertices)
+{
+    u32 created = SplitBufferList(buffers, maxVertices);
+    for (MeshLod &level : m_lods)
+        created += SplitBufferList(level.buffers, maxVertices);
+    if (created > 0)
+        m_bufferGeneration++;
+    return created;
+}
+
+u32 Mesh::GenerateLods(const std::vector<float> &ratios, float maxError)
+{
+    ClearLods();
+    if (buffers.empty())
+        return 0;
+
+    Vec3 minP(std::numeric_limits<float>::max());
+    Vec3 maxP(-std::numeric_limits<float>::max());
+    for (const MeshBuffer *buffer : buffers)
+    {
+        for (const Vertex &v : buffer->vertices)
+        {
+            minP = Vec3::Min(minP, Vec3(v.x, v.y, v.z));
+            maxP = Vec3::Max(maxP, Vec3(v.x, v.y, v.z));
+        }
+    }
+    const float absoluteError = maxError * (maxP - minP).length();
+
+    u32 baseTriangles = 0;
+    for (const MeshBuffer *buffer : buffers)
+        baseTriangles += buffer->GetIndexCount() / 3;
+
+    float previousError = 0.0f;
+    for (float ratio : ratios)
+    {
+        MeshLod *lod = AddLod(ratio, 0.0f);
+        const u32 level = (u32)m_lods.size();
+        u32 lodTriangles = 0;
+
+        // Cada nivel parte sempre do LOD 0, para o erro nao acumular
+        for (const MeshBuffer *source : buffers)
+        {
+            MeshBuffer *buffer = AddLodBuffer(level, source->m_material);
+            buffer->vertices = source->vertices;
+            buffer->indices = source->indices;
+            buffer->m_skinData = source->m_skinData;
+            buffer->m_tangents = source->m_tangents; // o Simplify compacta-as com o resto
+            buffer->m_isSkinned = source->m_isSkinned;
+            buffer->m_skinnedVertices.resize(source->m_skinnedVertices.size());
+
+            u32 target = (u32)(source->GetIndexCount() / 3 * Clamp(ratio, 0.0f, 1.0f)) * 3;
+            float error = buffer->Simplify(target, absoluteError);
+            buffer->Optimize();
+            buffer->OptimizeVertexFetch();
+
+            lod->error = Max(lod->error, error);
+            lodTriangles += buffer->GetIndexCount() / 3;
+        }
+
+        // Erro monotono para o SelectLod poder parar no primeiro que falha
+        lod->error = Max(lod->error, previousError);
+        previousError = lod->error;
+
+        LogInfo("[Mesh] LOD %u: ratio %.2f, %u -> %u tris, error %f", level, ratio, baseTriangles, lodTriangles, lod->error);
+    }
+
+    return (u32)m_lods.size();
 }
 
-bool Mesh::SetBufferMaterial(u32 index, u32 material)
+void Mesh::ClearLods()
 {
-
-    if (material >= materials.size())
+    for (MeshLod &lod : m_lods)
     {
-        LogWarning("[Mesh] Invalid material index: %d", material);
-        return false;
+        for (MeshBuffer *buffer : lod.buffers)
+            delete buffer;
     }
+    if (!m_lods.empty())
+        m_bufferGeneration++;
+    m_lods.clear();
+    m_currentLod = 0;
+}
 
-    if (index >= buffers.size() )
+MeshLod *Mesh::AddLod(float ratio, float error)
+{
+    MeshLod lod;
+    lod.ratio = ratio;
+    lod.error = error;
+    m_lods.push_back(lod);
+    return &m_lods.back();
+}
+
+MeshBuffer *Mesh::AddLodBuffer(u32 lod, u32 material)
+{
+    if (lod == 0)
+        return AddBuffer(material);
+    if (lod > m_lods.size())
     {
-        LogWarning("[Mesh] Invalid mesh buffer index: %d", index);
-        return false;
+        LogWarning("[Mesh] Invalid LOD: %u", lod);
+        return nullptr;
     }
 
-    buffers[index]->SetMaterial(material);
-    return true;
+    MeshBuffer *buffer = new MeshBuffer();
+    buffer->m_material = material;
+    m_lods[lod - 1].buffers.push_back(buffer);
+    return buffer;
 }
 
-bool Mesh::SetMaterial(u32 material)
+float Mesh::GetLodError(u32 lod) const
 {
-    if (material >= materials.size())
-    {
-        LogWarning("[Mesh] Invalid material index: %d", material);
-        return false;
-    }
-    for (MeshBuffer *buffer : buffers)
-    {
-        buffer->SetMaterial(material);
-    }
-    return true;
+    if (lod == 0 || lod > m_lods.size())
+        return 0.0f;
+    return m_lods[lod - 1].error;
 }
 
-void Mesh::OptimizeBuffers()
+size_t Mesh::GetLodBufferCount(u32 lod) const
 {
-    if (buffers.empty())
-        return;
+    if (lod == 0 || lod > m_lods.size())
+        return buffers.size();
+    return m_lods[lod - 1].buffers.size();
+}
 
-    SortByMaterial();
+MeshBuffer *Mesh::GetLodBuffer(u32 lod, size_t index) const
+{
+    if (lod == 0 || lod > m_lods.size())
+        return buffers[index];
+    return m_lods[lod - 1].buffers[index];
+}
 
-    std::map<u32, std::vector<MeshBuffer *>> buffersByMaterial;
-    for (auto *buffer : buffers)
+u32 Mesh::SelectLod(float distance, float screenHeight, float fovY, float maxPixelError) const
+{
+    if (m_lods.empty() || distance <= 0.0f)
+        return 0;
+
+    // Pixels por unidade a esta distancia
+    const float pixelsPerUnit = screenHeight / (2.0f * distance * std::tan(ToRadians(fovY) * 0.5f));
+
+    u32 lod = 0;
+    for (u32 i = 0; i < m_lods.size(); ++i)
     {
-        buffersByMaterial[buffer->m_material].push_back(buffer);
+        if (m_lods[i].error * pixelsPerUnit > maxPixelError)
+            break;
+        lod = i + 1;
     }
+    return lod;
+}
 
-    std::vector<MeshBuffer *> newBuffers;
-    for (auto &[materialId, materialBuffers] : buffersByMaterial)
+void Mesh::SetLod(u32 lod)
+{
+    m_currentLod = Min((int)lod, (int)m_lods.size());
+}
+
+MeshOptimizer::QuantizationError Mesh::SetVertexFormat(const MeshOptimizer::VertexFormat &format)
+{
+    std::vector<MeshBuffer *> all = buffers;
+    for (const MeshLod &level : m_lods)
+        all.insert(all.end(), level.buffers.begin(), level.buffers.end());
+
+    // Bounds comuns: cubo que contem os cubos de todos os buffers
+    Vec3 minP(std::numeric_limits<float>::max());
+    Vec3 maxP(-std::numeric_limits<float>::max());
+    for (MeshBuffer *buffer : all)
     {
-        if (materialBuffers.size() == 1)
-        {
-            newBuffers.push_back(materialBuffers[0]);
+        if (buffer->vertices.empty())
             continue;
-        }
-
-        MeshBuffer *combined = new MeshBuffer();
-        combined->m_material = materialId;
-        for (auto *buffer : materialBuffers)
-        {
-            u32 vertexOffset = combined->vertices.size();
-
-            combined->vertices.insert(
-                combined->vertices.end(),
-                buffer->vertices.begin(),
-                buffer->vertices.end());
-
-            for (u32 index : buffer->indices)
-            {
-                combined->indices.push_back(index + vertexOffset);
-            }
+        Vec3 center;
+        float scale;
+        MeshOptimizer::ComputeQuantizationBounds(buffer->vertices.data(), buffer->vertices.size(), center, scale);
+        minP = Vec3::Min(minP, center - Vec3(scale));
+        maxP = Vec3::Max(maxP, center + Vec3(scale));
+    }
 
-            delete buffer;
-        }
+    Vec3 center(0.0f);
+    float scale = 1.0f;
+    if (minP.x <= maxP.x)
+    {
+        center = (minP + maxP) * 0.5f;
+        Vec3 half = (maxP - minP) * 0.5f;
+        scale = Max(half.x, Max(half.y, half.z));
+    }
 
-        combined->m_vdirty = true;
-        combined->m_idirty = true;
-        newBuffers.push_back(combined);
+    MeshOptimizer::QuantizationError worst;
+    for (MeshBuffer *buffer : all)
+    {
+        MeshOptimizer::QuantizationError report = buffer->SetVertexFormat(format, center, scale);
+        worst.position = Max(worst.position, report.position);
+        worst.normal = Max(worst.normal, report.normal);
+        worst.texCoord = Max(worst.texCoord, report.texCoord);
+        worst.weight = Max(worst.weight, report.weight);
+        worst.vertexBytes += report.vertexBytes * buffer->GetVertexCount();
+        worst.packedBytes += report.packedBytes * buffer->GetVertexCount();
+        worst.skinBytes += report.skinBytes * buffer->GetVertexCount();
+        worst.packedSkinBytes += report.packedSkinBytes * buffer->GetVertexCount();
     }
 
-    buffers.clear();
+    LogInfo("[Mesh] Vertex data: %u -> %u bytes, skin %u -> %u bytes", worst.vertexBytes, worst.packedBytes,
+            worst.skinBytes, worst.packedSkinBytes);
+    return worst;
+}
 
-    buffers = std::move(newBuffers);
+Mat4 Mesh::GetPositionDecode(u32 lod, size_t index) const
+{
+    const MeshBuffer *buffer = GetLodBuffer(lod, index);
+    return buffer ? buffer->GetPositionDecode() : Mat4::Identity();
+}
 
-    SortByMaterial();
+const std::vector<MeshBuffer *> &Mesh::GetActiveBuffers() const
+{
+    if (m_currentLod == 0 || m_currentLod > m_lods.size())
+        return buffers;
+    return m_lods[m_currentLod - 1].buffers;
 }
 
 Bone *Mesh::GetBone(u32 index) const
@@ -1121,7 +1835,7 @@ Bone *Mesh::AddBone(const std::string &name)
     return bone;
 }
 
-void Mesh::UpdateSkinning()
+void Mesh::UpdateSkinning(Skinning::SkinningMode mode)
 {
     if (!IsSkinned())
     {
@@ -1129,12 +1843,155 @@ void Mesh::UpdateSkinning()
         return;
     }
 
-    for (size_t i = 0; i < buffers.size(); i++)
+    if (m_deferredSkinning)
+    {
+        m_skinningPending = true;
+        return;
+    }
+
+    std::vector<Mesh *> meshes(1, this);
+    UpdateSkinning(meshes, mode);
+}
+
+void Mesh::UpdateSkinning(const std::vector<Mesh *> &meshes, Skinning::SkinningMode mode)
+{
+    std::vector<Skinning::SkinningJob> jobs;
+    std::vector<MeshBuffer *> targets;
+
+    for (Mesh *mesh : meshes)
+    {
+        if (!mesh || !mesh->IsSkinned())
+            continue;
+
+        mesh->m_skinningPending = false;
+        mesh->UpdateBonePalette();
+
+        // So o LOD visivel precisa de skinning
+        for (MeshBuffer *buffer : mesh->GetActiveBuffers())
+        {
+            Skinning::SkinningJob job;
+            if (!buffer->PrepareSkinning(mesh->m_bonePalette, mesh, mesh->m_poseVersion, mode, job))
+                continue;
+            jobs.push_back(job);
+            targets.push_back(buffer);
+        }
+    }
+
+    RunSkinning(jobs, targets);
+}
+
+void Mesh::UpdateSkinning(SkeletonInstance *instance, Skinning::SkinningMode mode)
+{
+    if (!instance || instance->GetMesh() != this || !IsSkinned())
+    {
+        LogWarning("[Mesh] Skeleton instance does not belong to this mesh");
+        return;
+    }
+
+    std::vector<SkeletonInstance *> instances(1, instance);
+    UpdateSkinning(instances, mode);
+}
+
+std::vector<Vertex> Mesh::s_instanceVertices;
+std::vector<Vec4> Mesh::s_instanceTangents;
+
+void Mesh::UpdateSkinning(const std::vector<SkeletonInstance *> &instances, Skinning::SkinningMode mode)
+{
+    std::vector<Skinning::SkinningJob> jobs;
+    std::vector<MeshBuffer *> targets;
+    std::vector<SkinnedOutput *> outputs;
+
+    for (SkeletonInstance *instance : instances)
+    {
+        const Mesh *mesh = instance ? instance->GetMesh() : nullptr;
+        if (!mesh || !mesh->IsSkinned())
+            continue;
+
+        instance->UpdateBonePalette();
+        if (mesh->m_boneOrder.size() != mesh->m_bones.size())
+            continue; // rig por validar, a paleta nao foi calculada
+
+        // Cada instancia no seu VAO: as que nao mexeram nao repetem nada
+        for (MeshBuffer *buffer : mesh->GetActiveBuffers())
+        {
+            if (!buffer->IsSkinned())
+                continue;
+            SkinnedOutput *output = instance->AcquireOutput(buffer);
+            Skinning::SkinningJob job;
+            if (!buffer->PrepareSkinning(instance->GetBonePalette(), instance, instance->GetPoseVersion(), mode, job,
+                                         output))
+                continue;
+            jobs.push_back(job);
+            targets.push_back(buffer);
+            outputs.push_back(output);
+        }
+    }
+
+    // Destinos no scratch partilhado, reservado de uma vez antes dos jobs
+    size_t vertexTotal = 0;
+    size_t tangentTotal = 0;
+    for (const Skinning::SkinningJob &job : jobs)
+    {
+        vertexTotal += job.vertexCount;
+        if (job.tangents)
+            tangentTotal += job.vertexCount;
+    }
+    if (s_instanceVertices.size() < vertexTotal)
+        s_instanceVertices.resize(vertexTotal);
+    if (s_instanceTangents.size() < tangentTotal)
+        s_instanceTangents.resize(tangentTotal);
+
+    Vertex *vertices = s_instanceVertices.data();
+    Vec4 *tangents = s_instanceTangents.data();
+    for (Skinning::SkinningJob &job : jobs)
+    {
+        job.destination = vertices;
+        vertices += job.vertexCount;
+        if (job.tangents)
+        {
+            job.destinationTangents = tangents;
+            tangents += job.vertexCount;
+        }
+        // So a posicao e escrita: o resto do vertice sobe da bind pose
+        if (job.mode == Skinning::SKIN_POSITION_ONLY)
+            std::copy(job.vertices, job.vertices + job.vertexCount, job.destination);
+    }
+
+    RunSkinning(jobs, targets, &outputs);
+}
+
+void Mesh::Render(SkeletonInstance *instance)
+{
+    if (!instance || instance->GetMesh() != this)
+    {
+        Render();
+        return;
+    }
+
+    for (MeshBuffer *buffer : GetActiveBuffers())
     {
-        buffers[i]->UpdateSkinning(this);
+        BindMaterial(buffer->m_material);
+        const SkinnedOutput *output = instance->GetOutput(buffer);
+        if (output && output->array && output->sourceVersion == buffer->m_buildVersion)
+            output->array->Render(PrimitiveType::PT_TRIANGLES, output->indexCount);
+        else
+            buffer->Render();
     }
 }
 
+void Mesh::RunSkinning(std::vector<Skinning::SkinningJob> &jobs, const std::vector<MeshBuffer *> &targets,
+                       const std::vector<SkinnedOutput *> *outputs)
+{
+    if (jobs.empty())
+        return;
+
+    // CPU de todos os buffers primeiro, GL depois
+    Skinning::RunJobs(jobs.data(), (u32)jobs.size());
+
+    for (size_t i = 0; i < targets.size(); ++i)
+        targets[i]->UploadSkinning(jobs[i], outputs ? (*outputs)[i] : nullptr);
+}
+
 void Mesh::Debug(RenderBatch *batch)
 {
 
@@ -1172,7 +2029,102 @@ void Mesh::CalculateBoneMatrices()
            // LogInfo("Bone[%d] %s → ROOT (no parent)", i, bone->name.c_str());
         }
     }
-    m_boneMatrices.resize(m_bones.size());
+
+    // Ordem topologica (pais antes dos filhos), o ficheiro nao garante isso
+    const u32 count = (u32)m_bones.size();
+    std::vector<std::vector<u32>> children(count);
+    m_boneOrder.clear();
+    m_boneOrder.reserve(count);
+    for (u32 i = 0; i < count; i++)
+    {
+        if (m_bones[i]->parent)
+            children[m_bones[i]->parentIndex].push_back(i);
+        else
+            m_boneOrder.push_back(i);
+    }
+    for (size_t head = 0; head < m_boneOrder.size(); head++)
+    {
+        for (u32 child : children[m_boneOrder[head]])
+            m_boneOrder.push_back(child);
+    }
+
+    // Bones num ciclo (e os seus descendentes) nunca aparecem. Sobe pelos
+    // pais de cada um; ao voltar a um bone do mesmo caminho corta-se so essa
+    // ligacao, o resto da subarvore mantem os pais
+    if (m_boneOrder.size() != count)
+    {
+        std::vector<u8> state(count, 0); // 0 por ver, 1 no caminho atual, 2 resolvido
+        for (u32 index : m_boneOrder)
+            state[index] = 2;
+        std::vector<u32> path;
+        for (u32 i = 0; i < count; i++)
+        {
+            path.clear();
+            u32 current = i;
+            while (state[current] == 0)
+            {
+                state[current] = 1;
+                path.push_back(current);
+                Bone *bone = m_bones[current];
+                if (!bone->parent)
+                    break;
+                const u32 parent = (u32)bone->parentIndex;
+                if (state[parent] == 1)
+                {
+                    LogWarning("[Mesh] Bone %s closes a parent cycle, using it as root", bone->name.c_str());
+                    bone->parent = nullptr;
+                    bone->parentIndex = -1;
+                    break;
+                }
+                current = parent;
+            }
+            for (u32 index : path)
+                state[index] = 2;
+        }
+        CalculateBoneMatrices();
+        return;
+    }
+
+    m_boneGlobals.assign(count, Mat4::Identity());
+    m_boneMatrices.assign(count, Mat4::Identity());
+    MarkPoseDirty();
+}
+
+void Mesh::MarkPoseDirty()
+{
+    m_boneDirty.assign(m_bones.size(), 1);
+    m_poseDirty = true;
+}
+
+void Mesh::UpdateBonePalette()
+{
+    if (m_boneOrder.size() != m_bones.size())
+        CalculateBoneMatrices();
+
+    if (!m_poseDirty)
+        return;
+
+    m_bonePalette.resize(m_boneMatrices.size());
+
+    // Cada matriz uma vez: o pai ja esta calculado quando o filho chega.
+    // Um bone sujo suja os filhos; os outros ficam como estavam
+    for (u32 index : m_boneOrder)
+    {
+        const Bone *bone = m_bones[index];
+        if (bone->parent && m_boneDirty[bone->parentIndex])
+            m_boneDirty[index] = 1;
+        if (!m_boneDirty[index])
+            continue;
+
+        const Mat4 local = bone->GetLocalTransform();
+        m_boneGlobals[index] = bone->parent ? m_boneGlobals[bone->parentIndex] * local : local;
+        m_boneMatrices[index] = m_boneGlobals[index] * bone->inverseBindPose;
+        Skinning::ToAffine(&m_bonePalette[index], &m_boneMatrices[index], 1);
+    }
+
+    std::fill(m_boneDirty.begin(), m_boneDirty.end(), 0);
+    m_poseDirty = false;
+    ++m_poseVersion;
 }
 
 void PrintMatrix(const Mat4 &mat)
@@ -1216,14 +2168,15 @@ void Mesh::SetBoneTransform(u32 index, const Vec3 &position, const Quat &rotatio
     if (index >= m_bones.size())
         return;
 
-    if (index >= m_boneMatrices.size())
-        m_boneMatrices.resize(index + 1);
-
     // T * R * S;
     Mat4 local = (Mat4::Translation(position) * rotation.toMat4());
-    m_bones[index]->hasAnimation = true;
-    m_bones[index]->transform = local;
-    m_boneMatrices[index] = local;
+    Bone *bone = m_bones[index];
+    if (bone->hasAnimation && bone->transform == local)
+        return;
+
+    bone->hasAnimation = true;
+    bone->transform = local;
+    MarkBoneDirty(index);
 }
 
 void Mesh::SetBoneStatic(u32 index)
@@ -1231,11 +2184,9 @@ void Mesh::SetBoneStatic(u32 index)
     if (index >= m_bones.size())
         return;
 
-    if (index >= m_boneMatrices.size())
-        m_boneMatrices.resize(index + 1);
-
+    if (m_bones[index]->hasAnimation)
+        MarkBoneDirty(index);
     m_bones[index]->transform = m_bones[index]->localPose;
-    m_boneMatrices[index] = m_bones[index]->transform;
     m_bones[index]->hasAnimation = false;
 }
 
@@ -1243,11 +2194,20 @@ void Mesh::ResetBones()
 {
     for (u32 i = 0; i < m_bones.size(); i++)
     {
+        if (m_bones[i]->hasAnimation)
+            MarkBoneDirty(i);
         m_bones[i]->hasAnimation = false;
-        m_boneMatrices[i] = m_bones[i]->localPose;
     }
 }
 
+void Mesh::MarkBoneDirty(u32 index)
+{
+    if (m_boneDirty.size() != m_bones.size())
+        m_boneDirty.assign(m_bones.size(), 1);
+    m_boneDirty[index] = 1;
+    m_poseDirty = true;
+}
+
 u32 Mesh::FindBoneIndex(const std::string &name)
 {
     for (u32 i = 0; i < m_bones.size(); i++)
@@ -1282,6 +2242,8 @@ void Mesh::Clear()
         delete buffer;
     }
     buffers.clear();
+    m_bufferGeneration++;
+    ClearLods();
 }
 
 void Mesh::Build()
@@ -1290,6 +2252,11 @@ void Mesh::Build()
     {
         buffer->Build();
     }
+    for (MeshLod &lod : m_lods)
+    {
+        for (MeshBuffer *buffer : lod.buffers)
+            buffer->Build();
+    }
 }
 
 bool MeshLoader::CanLoad(const std::string &filename) const
@@ -1965,6 +2932,10 @@ bool MeshWriter::Save(const Mesh *mesh, const std::string &filename)
         WriteBufferChunk(mesh->GetBuffer(i));
     }
 
+    // LODs (leitores antigos saltam o chunk)
+    for (u32 lod = 1; lod < mesh->GetLodCount(); lod++)
+        WriteLodChunk(mesh, lod);
+
     LogInfo("[MeshWriter] Saved: %zu buffers, %zu materials, %zu bones",
             mesh->GetBufferCount(), mesh->GetMaterialCount(),
             mesh->HasSkeleton() ? mesh->GetBoneCount() : 0);
@@ -2073,15 +3044,54 @@ void MeshWriter::WriteBufferChunk(const MeshBuffer *buffer)
 
     m_stream->WriteUInt(buffer->GetMaterial());
 
+    const MeshOptimizer::VertexFormat &format = buffer->GetVertexFormat();
+    const bool quantized = !format.IsFloat() || format.weights != MeshOptimizer::WEIGHT_FLOAT;
+
     u32 flags = buffer->IsSkinned() ? BUFFER_FLAG_SKINNED : 0;
+    if (quantized)
+        flags |= BUFFER_FLAG_QUANTIZED;
+    if (buffer->HasTangents())
+        flags |= BUFFER_FLAG_TANGENTS;
     m_stream->WriteUInt(flags);
 
-    WriteVerticesChunk(buffer);
+    if (format.IsFloat())
+        WriteVerticesChunk(buffer);
+    else
+        WriteQuantizedVerticesChunk(buffer);
     WriteIndicesChunk(buffer);
 
     // Skinning
     if (flags & BUFFER_FLAG_SKINNED)
-        WriteSkinChunk(buffer);
+    {
+        if (format.weights == MeshOptimizer::WEIGHT_FLOAT)
+            WriteSkinChunk(buffer);
+        else
+            WriteQuantizedSkinChunk(buffer);
+    }
+
+    if (flags & BUFFER_FLAG_TANGENTS)
+        WriteTangentsChunk(buffer);
+
+    EndChunk(startPos);
+}
+
+void MeshWriter::WriteLodChunk(const Mesh *mesh, u32 lod)
+{
+    const MeshLod &level = mesh->m_lods[lod - 1];
+
+    long startPos;
+    BeginChunk(CHUNK_LODS, &startPos);
+
+    m_stream->WriteUInt(lod);
+    m_stream->WriteFloat(level.ratio);
+    m_stream->WriteFloat(level.error);
+
+    for (const MeshBuffer *buffer : level.buffers)
+    {
+        if (buffer->GetIndexCount() == 0 || buffer->GetVertexCount() == 0)
+            continue;
+        WriteBufferChunk(buffer);
+    }
 
     EndChunk(startPos);
 }
@@ -2111,46 +3121,124 @@ void MeshWriter::WriteVerticesChunk(const MeshBuffer *buffer)
     EndChunk(startPos);
 }
 
-void MeshWriter::WriteIndicesChunk(const MeshBuffer *buffer)
+void MeshWriter::WriteIndicesChunk(const MeshBuffer *buffer)
+{
+    long startPos;
+    BeginChunk(CHUNK_IDXS, &startPos);
+
+    const MeshOptimizer::IndexArray &indices = buffer->GetIndices();
+    const u32 numIndices = buffer->GetIndexCount() / 3 * 3;
+    m_stream->WriteUInt(numIndices);
+    m_stream->WriteUInt(indices.GetIndexSize());
+
+    if (indices.Is16Bit())
+    {
+        for (u32 i = 0; i < numIndices; i++)
+            m_stream->WriteUShort((u16)indices[i]);
+        // Mantem os chunks seguintes alinhados a 4
+        if (numIndices & 1)
+            m_stream->WriteUShort(0);
+    }
+    else
+    {
+        for (u32 i = 0; i < numIndices; i++)
+            m_stream->WriteUInt(indices[i]);
+    }
+
+    EndChunk(startPos);
+}
+
+void MeshWriter::WriteSkinChunk(const MeshBuffer *buffer)
+{
+    long startPos;
+    BeginChunk(CHUNK_SKIN, &startPos);
+
+    u32 numVertices = buffer->GetVertexCount();
+    m_stream->WriteUInt(numVertices);
+
+    const VertexSkin *skinData = buffer->GetSkinData();
+    for (u32 i = 0; i < numVertices; i++)
+    {
+        m_stream->WriteByte(skinData[i].boneIDs[0]);
+        m_stream->WriteByte(skinData[i].boneIDs[1]);
+        m_stream->WriteByte(skinData[i].boneIDs[2]);
+        m_stream->WriteByte(skinData[i].boneIDs[3]);
+
+        m_stream->WriteFloat(skinData[i].weights[0]);
+        m_stream->WriteFloat(skinData[i].weights[1]);
+        m_stream->WriteFloat(skinData[i].weights[2]);
+        m_stream->WriteFloat(skinData[i].weights[3]);
+    }
+
+    EndChunk(startPos);
+}
+
+void MeshWriter::WriteTangentsChunk(const MeshBuffer *buffer)
+{
+    long startPos;
+    BeginChunk(CHUNK_TANG, &startPos);
+
+    u32 numVertices = buffer->GetVertexCount();
+    m_stream->WriteUInt(numVertices);
+
+    const Vec4 *tangents = buffer->GetTangents();
+    for (u32 i = 0; i < numVertices; i++)
+    {
+        m_stream->WriteFloat(tangents[i].x);
+        m_stream->WriteFloat(tangents[i].y);
+        m_stream->WriteFloat(tangents[i].z);
+        m_stream->WriteFloat(tangents[i].w);
+    }
+
+    EndChunk(startPos);
+}
+
+// QVTX: count, formatos (4 x u8), center, scale, stride, vertices empacotados
+void MeshWriter::WriteQuantizedVerticesChunk(const MeshBuffer *buffer)
 {
     long startPos;
-    BeginChunk(CHUNK_IDXS, &startPos);
+    BeginChunk(CHUNK_QVTX, &startPos);
 
-    u32 numIndices = buffer->GetIndexCount();
-    m_stream->WriteUInt(numIndices);
+    const MeshOptimizer::VertexFormat &format = buffer->m_format;
+    const u32 numVertices = buffer->GetVertexCount();
+    const u32 stride = MeshOptimizer::GetVertexStride(format);
 
-    const u32 *indices = buffer->GetIndices();
-    for (u32 i = 0; i < numIndices / 3; i++)
-    {
-        m_stream->WriteUInt(indices[i * 3]);
-        m_stream->WriteUInt(indices[i * 3 + 1]);
-        m_stream->WriteUInt(indices[i * 3 + 2]);
-    }
+    m_stream->WriteUInt(numVertices);
+    m_stream->WriteByte(format.position);
+    m_stream->WriteByte(format.normal);
+    m_stream->WriteByte(format.texCoord);
+    m_stream->WriteByte(format.weights);
+    m_stream->WriteFloat(buffer->m_quantCenter.x);
+    m_stream->WriteFloat(buffer->m_quantCenter.y);
+    m_stream->WriteFloat(buffer->m_quantCenter.z);
+    m_stream->WriteFloat(buffer->m_quantScale);
+    m_stream->WriteUInt(stride);
+
+    std::vector<u8> packed(numVertices * stride);
+    MeshOptimizer::PackVertices(packed.data(), buffer->GetVertices(), numVertices, format, buffer->m_quantCenter,
+                                buffer->m_quantScale);
+    m_stream->Write(packed.data(), packed.size());
 
     EndChunk(startPos);
 }
 
-void MeshWriter::WriteSkinChunk(const MeshBuffer *buffer)
+// QSKN: count, formato dos pesos, stride, skin empacotado
+void MeshWriter::WriteQuantizedSkinChunk(const MeshBuffer *buffer)
 {
     long startPos;
-    BeginChunk(CHUNK_SKIN, &startPos);
+    BeginChunk(CHUNK_QSKN, &startPos);
 
-    u32 numVertices = buffer->GetVertexCount();
-    m_stream->WriteUInt(numVertices);
+    const MeshOptimizer::VertexFormat &format = buffer->m_format;
+    const u32 numVertices = buffer->GetVertexCount();
+    const u32 stride = MeshOptimizer::GetSkinStride(format);
 
-    const VertexSkin *skinData = buffer->GetSkinData();
-    for (u32 i = 0; i < numVertices; i++)
-    {
-        m_stream->WriteByte(skinData[i].boneIDs[0]);
-        m_stream->WriteByte(skinData[i].boneIDs[1]);
-        m_stream->WriteByte(skinData[i].boneIDs[2]);
-        m_stream->WriteByte(skinData[i].boneIDs[3]);
+    m_stream->WriteUInt(numVertices);
+    m_stream->WriteByte(format.weights);
+    m_stream->WriteUInt(stride);
 
-        m_stream->WriteFloat(skinData[i].weights[0]);
-        m_stream->WriteFloat(skinData[i].weights[1]);
-        m_stream->WriteFloat(skinData[i].weights[2]);
-        m_stream->WriteFloat(skinData[i].weights[3]);
-    }
+    std::vector<u8> packed(numVertices * stride);
+    MeshOptimizer::PackSkin(packed.data(), buffer->GetSkinData(), numVertices, format);
+    m_stream->Write(packed.data(), packed.size());
 
     EndChunk(startPos);
 }
@@ -2226,6 +3314,7 @@ bool MeshReader::Load(const std::string &filename, Mesh *mesh)
     {
         LogWarning("[MeshReader] Newer version: %d", version);
     }
+    m_version = version;
 
     // Read chunks
     while (!m_stream->IsEOF())
@@ -2250,6 +3339,10 @@ bool MeshReader::Load(const std::string &filename, Mesh *mesh)
             ReadBufferChunk(mesh, header);
             break;
 
+        case CHUNK_LODS:
+            ReadLodChunk(mesh, header);
+            break;
+
         default:
             // Skip unknown chunks
             LogWarning("[MeshReader] Unknown chunk: 0x%08X", header.id);
@@ -2369,7 +3462,39 @@ void MeshReader::ReadSkeletonChunk(Mesh *mesh, const ChunkHeader &header)
     }
 }
 
-void MeshReader::ReadBufferChunk(Mesh *mesh, const ChunkHeader &header)
+void MeshReader::ReadLodChunk(Mesh *mesh, const ChunkHeader &header)
+{
+    long endPos = m_stream->Tell() + header.length;
+
+    u32 level = m_stream->ReadUInt();
+    float ratio = m_stream->ReadFloat();
+    float error = m_stream->ReadFloat();
+
+    if (level != mesh->GetLodCount())
+    {
+        LogWarning("[MeshReader] LOD out of order: %u", level);
+        m_stream->Seek(endPos, SeekOrigin::Begin);
+        return;
+    }
+
+    mesh->AddLod(ratio, error);
+
+    while (m_stream->Tell() < endPos)
+    {
+        ChunkHeader subHeader = ReadChunkHeader();
+        long subEnd = m_stream->Tell() + subHeader.length;
+
+        if (subHeader.id == CHUNK_BUFF)
+            ReadBufferChunk(mesh, subHeader, (s32)level);
+        else
+            SkipChunk(subHeader);
+
+        if (m_stream->Tell() < subEnd)
+            m_stream->Seek(subEnd, SeekOrigin::Begin);
+    }
+}
+
+void MeshReader::ReadBufferChunk(Mesh *mesh, const ChunkHeader &header, s32 lod)
 {
     long endPos = m_stream->Tell() + header.length;
 
@@ -2377,7 +3502,7 @@ void MeshReader::ReadBufferChunk(Mesh *mesh, const ChunkHeader &header)
     u32 flags = m_stream->ReadUInt();
     (void)flags;
 
-    MeshBuffer *buffer = mesh->AddBuffer(materialIndex);
+    MeshBuffer *buffer = lod > 0 ? mesh->AddLodBuffer((u32)lod, materialIndex) : mesh->AddBuffer(materialIndex);
 
     // Read sub-chunks
     while (m_stream->Tell() < endPos)
@@ -2399,6 +3524,18 @@ void MeshReader::ReadBufferChunk(Mesh *mesh, const ChunkHeader &header)
             ReadSkinChunk(buffer, subHeader);
             break;
 
+        case CHUNK_TANG:
+            ReadTangentsChunk(buffer, subHeader);
+            break;
+
+        case CHUNK_QVTX:
+            ReadQuantizedVerticesChunk(buffer, subHeader);
+            break;
+
+        case CHUNK_QSKN:
+            ReadQuantizedSkinChunk(buffer, subHeader);
+            break;
+
         default:
             SkipChunk(subHeader);
             break;
@@ -2433,13 +3570,22 @@ void MeshReader::ReadVerticesChunk(MeshBuffer *buffer, const ChunkHeader &header
 void MeshReader::ReadIndicesChunk(MeshBuffer *buffer, const ChunkHeader &header)
 {
     u32 numIndices = m_stream->ReadUInt();
-    for (size_t i = 0; i < numIndices; i += 3)
+
+    // Antes da 1.03 os indices eram sempre u32, sem o campo da largura
+    const u32 indexSize = m_version >= 103 ? m_stream->ReadUInt() : sizeof(u32);
+    if (indexSize != sizeof(u16) && indexSize != sizeof(u32))
     {
-        u32 a = m_stream->ReadUInt();
-        u32 b = m_stream->ReadUInt();
-        u32 c = m_stream->ReadUInt();
-        buffer->AddFace(a, b, c);
+        LogError("[MeshReader] Invalid index size: %u", indexSize);
+        return;
     }
+
+    std::vector<u32> indices(numIndices);
+    for (u32 i = 0; i < numIndices; i++)
+        indices[i] = indexSize == sizeof(u16) ? m_stream->ReadUShort() : m_stream->ReadUInt();
+
+    buffer->indices.Assign(indices);
+    buffer->m_idirty = true;
+    buffer->m_adjacencyDirty = true;
 }
 
 void MeshReader::ReadSkinChunk(MeshBuffer *buffer, const ChunkHeader &header)
@@ -2465,13 +3611,109 @@ void MeshReader::ReadSkinChunk(MeshBuffer *buffer, const ChunkHeader &header)
     }
 }
 
+void MeshReader::ReadTangentsChunk(MeshBuffer *buffer, const ChunkHeader &header)
+{
+    u32 numVertices = m_stream->ReadUInt();
+
+    buffer->m_tangents.resize(numVertices);
+    for (u32 i = 0; i < numVertices; i++)
+    {
+        Vec4 &t = buffer->m_tangents[i];
+        t.x = m_stream->ReadFloat();
+        t.y = m_stream->ReadFloat();
+        t.z = m_stream->ReadFloat();
+        t.w = m_stream->ReadFloat();
+    }
+}
+
+void MeshReader::ReadQuantizedVerticesChunk(MeshBuffer *buffer, const ChunkHeader &header)
+{
+    u32 numVertices = m_stream->ReadUInt();
+
+    MeshOptimizer::VertexFormat format = buffer->m_format;
+    format.position = (MeshOptimizer::PositionFormat)m_stream->ReadByte();
+    format.normal = (MeshOptimizer::NormalFormat)m_stream->ReadByte();
+    format.texCoord = (MeshOptimizer::TexCoordFormat)m_stream->ReadByte();
+    m_stream->ReadByte(); // pesos vem no QSKN
+
+    Vec3 center;
+    center.x = m_stream->ReadFloat();
+    center.y = m_stream->ReadFloat();
+    center.z = m_stream->ReadFloat();
+    float scale = m_stream->ReadFloat();
+    u32 stride = m_stream->ReadUInt();
+
+    if (format.position > MeshOptimizer::POSITION_SNORM16 || format.normal > MeshOptimizer::NORMAL_OCT16 ||
+        format.texCoord > MeshOptimizer::TEXCOORD_HALF2 || stride != MeshOptimizer::GetVertexStride(format))
+    {
+        LogError("[MeshReader] Invalid quantized vertex format (stride %u)", stride);
+        return;
+    }
+
+    std::vector<u8> packed(numVertices * stride);
+    if (m_stream->Read(packed.data(), packed.size()) != packed.size())
+    {
+        LogError("[MeshReader] Truncated QVTX chunk");
+        return;
+    }
+
+    size_t first = buffer->vertices.size();
+    buffer->vertices.resize(first + numVertices);
+    MeshOptimizer::UnpackVertices(buffer->vertices.data() + first, packed.data(), numVertices, format, center, scale);
+
+    buffer->m_format = format;
+    buffer->m_quantCenter = center;
+    buffer->m_quantScale = scale;
+    buffer->m_vdirty = true;
+}
+
+void MeshReader::ReadQuantizedSkinChunk(MeshBuffer *buffer, const ChunkHeader &header)
+{
+    u32 numVertices = m_stream->ReadUInt();
+
+    MeshOptimizer::VertexFormat format = buffer->m_format;
+    format.weights = (MeshOptimizer::WeightFormat)m_stream->ReadByte();
+    u32 stride = m_stream->ReadUInt();
+
+    if (format.weights > MeshOptimizer::WEIGHT_UNORM8 || stride != MeshOptimizer::GetSkinStride(format))
+    {
+        LogError("[MeshReader] Invalid quantized skin format (stride %u)", stride);
+        return;
+    }
+
+    std::vector<u8> packed(numVertices * stride);
+    if (m_stream->Read(packed.data(), packed.size()) != packed.size())
+    {
+        LogError("[MeshReader] Truncated QSKN chunk");
+        return;
+    }
+
+    buffer->m_skinData.resize(numVertices);
+    buffer->m_isSkinned = true;
+    buffer->m_skinnedVertices.resize(numVertices);
+    MeshOptimizer::UnpackSkin(buffer->m_skinData.data(), packed.data(), numVertices, format);
+
+    buffer->m_format.weights = format.weights;
+}
+
 bool Animation::Load(const std::string &filename)
+{
+    FileStream stream;
+    if (!stream.Open(filename, "rb"))
+    {
+        LogError("[Animation] Failed to open: %s", filename.c_str());
+        return false;
+    }
+    return Load(&stream);
+}
+
+bool Animation::Load(Stream *stream)
 {
     m_currentTime = 0.0f;
     m_ticksPerSecond = 25.0f;
 
     AnimReader reader;
-    AnimReader::FrameAnimation *frameAnim = reader.Load(filename);
+    AnimReader::FrameAnimation *frameAnim = reader.Load(stream);
     if (!frameAnim)
         return false;
 
@@ -2486,6 +3728,10 @@ bool Animation::Load(const std::string &filename)
         m_channels[i].boneName = frameAnim->channels[i].boneName;
         m_channels[i].boneIndex = (u32)-1;
         m_channels[i].keyframes = frameAnim->channels[i].keyframes;
+        m_channels[i].positionTimes = frameAnim->channels[i].positionTimes;
+        m_channels[i].positions = frameAnim->channels[i].positions;
+        m_channels[i].rotationTimes = frameAnim->channels[i].rotationTimes;
+        m_channels[i].rotations = frameAnim->channels[i].rotations;
     }
 
     delete frameAnim;
@@ -2508,16 +3754,18 @@ void Animation::Sample(float time)
     if (!m_mesh || m_channels.empty())
         return;
 
-    for (const auto &channel : m_channels)
+    m_cursors.resize(m_channels.size());
+    for (size_t c = 0; c < m_channels.size(); c++)
     {
+        const AnimationChannel &channel = m_channels[c];
         if (channel.boneIndex == (u32)-1)
         {
             LogWarning("Bone not found: %s", channel.boneName.c_str());
             continue;
         }
 
-        Vec3 pos = InterpolatePosition(channel, time);
-        Quat rot = InterpolateRotation(channel, time);
+        Vec3 pos = InterpolatePosition(channel, time, &m_cursors[c]);
+        Quat rot = InterpolateRotation(channel, time, &m_cursors[c]);
         m_mesh->SetBoneTransform(channel.boneIndex, pos, rot);
     }
     m_mesh->UpdateSkinning();
@@ -2546,8 +3794,105 @@ AnimationChannel *Animation::FindChannel(const std::string &name)
     return nullptr;
 }
 
-Vec3 Animation::InterpolatePosition(const AnimationChannel &ch, float time)
+AnimationChannel *Animation::AddChannel(const std::string &boneName)
+{
+    m_channels.push_back(AnimationChannel());
+    m_channels.back().boneName = boneName;
+    m_channels.back().boneIndex = m_mesh ? m_mesh->FindBoneIndex(boneName) : (u32)-1;
+    return &m_channels.back();
+}
+
+namespace
+{
+    // O mesmo que o Quat::Slerp prepara por sample, feito uma vez por
+    // intervalo. A avancar no clip a chave i ja estava descompactada
+    void CacheRotationKeys(const AnimationChannel &ch, u32 i, AnimationCursor &state)
+    {
+        const Quat q0 = state.rotationCacheKey != (u32)-1 && state.rotationCacheKey + 1 == i
+                            ? state.rotationCache[1]
+                            : ch.rotations[i].Unpack().normalized();
+        Quat q1 = ch.rotations[i + 1].Unpack().normalized();
+
+        float dot = Quat::Dot(q0, q1);
+        if (dot < 0.0f)
+        {
+            q1 = -q1;
+            dot = -dot;
+        }
+
+        state.rotationCacheKey = i;
+        state.rotationCache[0] = q0;
+        state.rotationCache[1] = q1;
+        state.rotationCacheAngle = 0.0f;
+        if (dot <= 0.9995f)
+        {
+            state.rotationCacheAngle = std::acos(dot);
+            state.rotationCache[2] = (q1 - q0 * dot).normalized();
+        }
+    }
+}
+
+u32 Animation::FindKey(const float *times, size_t stride, u32 count, u32 &cursor, float time)
+{
+    auto key = [times, stride](u32 i)
+    { return *(const float *)((const u8 *)times + i * stride); };
+    const u32 last = count - 1;
+
+    // Fora do clip (ou NaN) fica na ultima chave, como antes
+    if (!(time >= key(0) && time <= key(last)))
+        return (u32)-1;
+
+    u32 i = cursor < last ? cursor : 0;
+    if (time >= key(i) && time <= key(i + 1))
+        return i;
+    if (i + 2 <= last && time >= key(i + 1) && time <= key(i + 2))
+        return cursor = i + 1;
+    if (i > 0 && time >= key(i - 1) && time <= key(i))
+        return cursor = i - 1;
+
+    // Primeira chave > time; a anterior abre o intervalo
+    u32 lo = 1, hi = last;
+    while (lo < hi)
+    {
+        const u32 mid = (lo + hi) / 2;
+        if (key(mid) < time)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return cursor = lo - 1;
+}
+
+Vec3 Animation::InterpolatePosition(const AnimationChannel &ch, float time, AnimationCursor *cursor) const
 {
+    AnimationCursor scratch;
+    AnimationCursor &state = cursor ? *cursor : scratch;
+
+    const s32 baked = IsBaked() ? GetChannelIndex(ch) : -1;
+    if (baked >= 0)
+    {
+        u32 row0, row1;
+        float factor;
+        GetBakedRows(time, row0, row1, factor);
+        const size_t stride = m_channels.size();
+        return Vec3::Lerp(m_bakedPositions[row0 * stride + baked], m_bakedPositions[row1 * stride + baked], factor);
+    }
+
+    if (ch.IsCompressed())
+    {
+        const u32 count = (u32)ch.positions.size();
+        if (count == 1)
+            return ch.positions[0];
+
+        const u32 i = FindKey(ch.positionTimes.data(), sizeof(float), count, state.key, time);
+        if (i == (u32)-1)
+            return ch.positions.back();
+
+        const float t0 = ch.positionTimes[i];
+        const float t1 = ch.positionTimes[i + 1];
+        return Vec3::Lerp(ch.positions[i], ch.positions[i + 1], t1 > t0 ? (time - t0) / (t1 - t0) : 0.0f);
+    }
+
     if (ch.keyframes.empty())
     {
 
@@ -2559,47 +3904,76 @@ Vec3 Animation::InterpolatePosition(const AnimationChannel &ch, float time)
 
         return ch.keyframes[0].position;
     }
-    for (size_t i = 0; i < ch.keyframes.size() - 1; i++)
-    {
-        float t0 = ch.keyframes[i].time;
-        float t1 = ch.keyframes[i + 1].time;
 
-        if (time >= t0 && time <= t1)
-        {
-            float factor = (time - t0) / (t1 - t0);
-            const Vec3 &p0 = ch.keyframes[i].position;
-            const Vec3 &p1 = ch.keyframes[i + 1].position;
-            return Vec3::Lerp(p0, p1, factor);
-        }
-    }
+    const u32 i = FindKey(&ch.keyframes[0].time, sizeof(AnimationKeyframe), (u32)ch.keyframes.size(), state.key, time);
+    if (i == (u32)-1)
+        return ch.keyframes.back().position;
 
-    return ch.keyframes.back().position;
+    float t0 = ch.keyframes[i].time;
+    float t1 = ch.keyframes[i + 1].time;
+    float factor = t1 > t0 ? (time - t0) / (t1 - t0) : 0.0f; // chaves repetidas
+    const Vec3 &p0 = ch.keyframes[i].position;
+    const Vec3 &p1 = ch.keyframes[i + 1].position;
+    return Vec3::Lerp(p0, p1, factor);
 }
 
-Quat Animation::InterpolateRotation(const AnimationChannel &ch, float time)
+Quat Animation::InterpolateRotation(const AnimationChannel &ch, float time, AnimationCursor *cursor) const
 {
+    AnimationCursor scratch;
+    AnimationCursor &state = cursor ? *cursor : scratch;
+
+    const s32 baked = IsBaked() ? GetChannelIndex(ch) : -1;
+    if (baked >= 0)
+    {
+        u32 row0, row1;
+        float factor;
+        GetBakedRows(time, row0, row1, factor);
+        const size_t stride = m_channels.size();
+        return Quat::Lerp(m_bakedRotations[row0 * stride + baked], m_bakedRotations[row1 * stride + baked], factor)
+            .normalized();
+    }
+
+    if (ch.IsCompressed())
+    {
+        const u32 count = (u32)ch.rotations.size();
+        if (count == 1)
+            return ch.rotations[0].Unpack();
+
+        const u32 i = FindKey(ch.rotationTimes.data(), sizeof(float), count, state.rotationKey, time);
+        if (i == (u32)-1)
+            return ch.rotations.back().Unpack();
+
+        if (state.rotationCacheKey != i)
+            CacheRotationKeys(ch, i, state);
+
+        const float t0 = ch.rotationTimes[i];
+        const float t1 = ch.rotationTimes[i + 1];
+        const float factor = t1 > t0 ? (time - t0) / (t1 - t0) : 0.0f;
+        if (state.rotationCacheAngle == 0.0f)
+            return Quat::Nlerp(state.rotationCache[0], state.rotationCache[1], factor);
+
+        const float theta = state.rotationCacheAngle * factor;
+        return state.rotationCache[0] * std::cos(theta) + state.rotationCache[2] * std::sin(theta);
+    }
+
     if (ch.keyframes.empty())
         return Quat(0, 0, 0, 1);
 
     if (ch.keyframes.size() == 1)
         return ch.keyframes[0].rotation;
 
-    for (size_t i = 0; i < ch.keyframes.size() - 1; i++)
-    {
-        float t0 = ch.keyframes[i].time;
-        float t1 = ch.keyframes[i + 1].time;
-
-        if (time >= t0 && time <= t1)
-        {
-            float factor = (time - t0) / (t1 - t0);
+    // O mesmo cursor serve as duas: posicao e rotacao pedem o mesmo tempo
+    const u32 i = FindKey(&ch.keyframes[0].time, sizeof(AnimationKeyframe), (u32)ch.keyframes.size(), state.key, time);
+    if (i == (u32)-1)
+        return ch.keyframes.back().rotation;
 
-            const Quat &q0 = ch.keyframes[i].rotation;
-            const Quat &q1 = ch.keyframes[i + 1].rotation;
-            return Quat::Slerp(q0, q1, factor);
-        }
-    }
+    float t0 = ch.keyframes[i].time;
+    float t1 = ch.keyframes[i + 1].time;
+    float factor = t1 > t0 ? (time - t0) / (t1 - t0) : 0.0f;
 
-    return ch.keyframes.back().rotation;
+    const Quat &q0 = ch.keyframes[i].rotation;
+    const Quat &q1 = ch.keyframes[i + 1].rotation;
+    return Quat::Slerp(q0, q1, factor);
 }
 
 AnimReader::FrameAnimation *AnimReader::Load(const std::string &filename)
@@ -2611,7 +3985,14 @@ AnimReader::FrameAnimation *AnimReader::Load(const std::string &filename)
         return nullptr;
     }
 
-    m_stream = &stream;
+    FrameAnimation *animation = Load(&stream);
+    stream.Close();
+    return animation;
+}
+
+AnimReader::FrameAnimation *AnimReader::Load(Stream *stream)
+{
+    m_stream = stream;
     m_stream->SetBigEndian(false);
 
     // Read magic + version
@@ -2621,14 +4002,12 @@ AnimReader::FrameAnimation *AnimReader::Load(const std::string &filename)
     if (magic != ANIM_MAGIC)
     {
         LogError("[AnimReader] Invalid magic: 0x%08X", magic);
-        stream.Close();
         return nullptr;
     }
 
-    if (version != ANIM_VERSION)
+    if (version < 100 || version > ANIM_VERSION)
     {
         LogError("[AnimReader] Invalid version: %d", version);
-        stream.Close();
         return nullptr;
     }
 
@@ -2655,7 +4034,6 @@ AnimReader::FrameAnimation *AnimReader::Load(const std::string &filename)
             {
                 LogError("[AnimReader] Failed to read INFO chunk");
                 delete animation;
-                stream.Close();
                 return nullptr;
             }
         }
@@ -2666,7 +4044,18 @@ AnimReader::FrameAnimation *AnimReader::Load(const std::string &filename)
             {
                 LogError("[AnimReader] Failed to read CHAN chunk");
                 delete animation;
-                stream.Close();
+                return nullptr;
+            }
+
+            animation->channels.push_back(channel);
+        }
+        else if (chunkId == ANIM_CHUNK_CCHN)
+        {
+            Channel channel;
+            if (!ReadCompressedChannelChunk(channel))
+            {
+                LogError("[AnimReader] Failed to read CCHN chunk");
+                delete animation;
                 return nullptr;
             }
 
@@ -2681,8 +4070,6 @@ AnimReader::FrameAnimation *AnimReader::Load(const std::string &filename)
         m_stream->Seek(nextChunkPos, SeekOrigin::Begin);
     }
 
-    stream.Close();
-
     LogInfo("[AnimReader] Loaded animation: %s (%d channels, %.2f seconds)", animation->name.c_str(), animation->channels.size(), animation->duration);
 
     return animation;
@@ -2746,3 +4133,160 @@ bool AnimReader::ReadChannelChunk(Channel &channel)
 
     return true;
 }
+
+bool AnimReader::ReadCompressedChannelChunk(Channel &channel)
+{
+    channel.boneName = m_stream->ReadCString();
+
+    // Posicoes: tempos e depois os valores (float3)
+    u32 numPositions = m_stream->ReadUInt();
+    if (numPositions == 0)
+        return false;
+    channel.positionTimes.resize(numPositions);
+    channel.positions.resize(numPositions);
+    for (u32 i = 0; i < numPositions; i++)
+        channel.positionTimes[i] = m_stream->ReadFloat();
+    for (u32 i = 0; i < numPositions; i++)
+    {
+        channel.positions[i].x = m_stream->ReadFloat();
+        channel.positions[i].y = m_stream->ReadFloat();
+        channel.positions[i].z = m_stream->ReadFloat();
+    }
+
+    // Rotacoes: tempos e depois 3 u16 por chave (smallest-three)
+    u32 numRotations = m_stream->ReadUInt();
+    if (numRotations == 0)
+        return false;
+    channel.rotationTimes.resize(numRotations);
+    channel.rotations.resize(numRotations);
+    for (u32 i = 0; i < numRotations; i++)
+        channel.rotationTimes[i] = m_stream->ReadFloat();
+    for (u32 i = 0; i < numRotations; i++)
+    {
+        channel.rotations[i].data[0] = m_stream->ReadUShort();
+        channel.rotations[i].data[1] = m_stream->ReadUShort();
+        channel.rotations[i].data[2] = m_stream->ReadUShort();
+    }
+
+    return true;
+}
+
+bool AnimWriter::Save(const Animation *animation, const std::string &filename)
+{
+    FileStream stream(filename, "wb");
+    if (!stream.IsOpen())
+    {
+        LogError("[AnimWriter] Failed to open: %s", filename.c_str());
+        return false;
+    }
+
+    m_stream = &stream;
+    m_stream->SetBigEndian(false);
+
+    m_stream->WriteUInt(ANIM_MAGIC);
+    m_stream->WriteUInt(ANIM_VERSION);
+
+    WriteInfoChunk(animation);
+    for (const AnimationChannel &channel : animation->m_channels)
+    {
+        if (channel.IsCompressed())
+            WriteCompressedChannelChunk(channel);
+        else
+            WriteChannelChunk(channel);
+    }
+
+    LogInfo("[AnimWriter] Saved: %s (%zu channels, %zu bytes of keys)", animation->m_name.c_str(),
+            animation->m_channels.size(), animation->GetMemorySize());
+    return true;
+}
+
+void AnimWriter::BeginChunk(u32 chunkId, long *posOut)
+{
+    m_stream->WriteUInt(chunkId);
+    m_stream->WriteUInt(0); // placeholder
+    *posOut = m_stream->Tell();
+}
+
+void AnimWriter::EndChunk(long startPos)
+{
+    long currentPos = m_stream->Tell();
+    u32 length = currentPos - startPos;
+
+    m_stream->Seek(startPos - 4, SeekOrigin::Begin);
+    m_stream->WriteUInt(length);
+    m_stream->Seek(currentPos, SeekOrigin::Begin);
+}
+
+void AnimWriter::WriteInfoChunk(const Animation *animation)
+{
+    long startPos;
+    BeginChunk(ANIM_CHUNK_INFO, &startPos);
+
+    // Name (64 bytes fixed)
+    char name[64] = {};
+    strncpy(name, animation->m_name.c_str(), 63);
+    m_stream->Write(name, 64);
+
+    m_stream->WriteFloat(animation->m_duration);
+    m_stream->WriteFloat(animation->m_ticksPerSecond);
+    m_stream->WriteUInt((u32)animation->m_channels.size());
+
+    EndChunk(startPos);
+}
+
+void AnimWriter::WriteChannelChunk(const AnimationChannel &channel)
+{
+    long startPos;
+    BeginChunk(ANIM_CHUNK_CHAN, &startPos);
+
+    m_stream->WriteCString(channel.boneName);
+    m_stream->WriteUInt((u32)channel.keyframes.size());
+    for (const AnimationKeyframe &key : channel.keyframes)
+    {
+        m_stream->WriteFloat(key.time);
+        m_stream->WriteFloat(key.position.x);
+        m_stream->WriteFloat(key.position.y);
+        m_stream->WriteFloat(key.position.z);
+        m_stream->WriteFloat(key.rotation.x);
+        m_stream->WriteFloat(key.rotation.y);
+        m_stream->WriteFloat(key.rotation.z);
+        m_stream->WriteFloat(key.rotation.w);
+
+        // Scale
+        m_stream->WriteFloat(1.0f);
+        m_stream->WriteFloat(1.0f);
+        m_stream->WriteFloat(1.0f);
+    }
+
+    EndChunk(startPos);
+}
+
+void AnimWriter::WriteCompressedChannelChunk(const AnimationChannel &channel)
+{
+    long startPos;
+    BeginChunk(ANIM_CHUNK_CCHN, &startPos);
+
+    m_stream->WriteCString(channel.boneName);
+
+    m_stream->WriteUInt((u32)channel.positions.size());
+    for (float time : channel.positionTimes)
+        m_stream->WriteFloat(time);
+    for (const Vec3 &position : channel.positions)
+    {
+        m_stream->WriteFloat(position.x);
+        m_stream->WriteFloat(position.y);
+        m_stream->WriteFloat(position.z);
+    }
+
+    m_stream->WriteUInt((u32)channel.rotations.size());
+    for (float time : channel.rotationTimes)
+        m_stream->WriteFloat(time);
+    for (const PackedQuat &rotation : channel.rotations)
+    {
+        m_stream->WriteUShort(rotation.data[0]);
+        m_stream->WriteUShort(rotation.data[1]);
+        m_stream->WriteUShort(rotation.data[2]);
+    }
+
+    EndChunk(startPos);
+}
@@ -0,0 +1,2231 @@
+#include "pch.h"
+#include "Mesh.hpp"
+#include "MeshOptimizer.hpp"
+#include "Jobs.hpp"
+#include <cfloat>
+
+namespace
+{
+    const u32 INVALID_INDEX = (u32)-1;
+
+    u32 NextPowerOfTwo(u32 v)
+    {
+        u32 p = 1;
+        while (p < v)
+            p <<= 1;
+        return p;
+    }
+
+    // Hash grid com open addressing: celula -> lista (ordenada) de vertices unicos
+    class SpatialHashGrid
+    {
+    public:
+        SpatialHashGrid(u32 expectedItems, float cellSize)
+            : m_invCellSize(1.0f / cellSize)
+        {
+            u32 capacity = NextPowerOfTwo(Max((int)expectedItems * 2, 16));
+            m_mask = capacity - 1;
+            m_cells.resize(capacity);
+        }
+
+        void GetCell(float x, float y, float z, s64 &cx, s64 &cy, s64 &cz) const
+        {
+            cx = (s64)std::floor(x * m_invCellSize);
+            cy = (s64)std::floor(y * m_invCellSize);
+            cz = (s64)std::floor(z * m_invCellSize);
+        }
+
+        // Primeiro item da celula (ou INVALID_INDEX)
+        u32 Find(s64 cx, s64 cy, s64 cz) const
+        {
+            u32 slot = Hash(cx, cy, cz) & m_mask;
+            while (true)
+            {
+                const Cell &cell = m_cells[slot];
+                if (cell.head == INVALID_INDEX)
+                    return INVALID_INDEX;
+                if (cell.x == cx && cell.y == cy && cell.z == cz)
+                    return cell.head;
+                slot = (slot + 1) & m_mask;
+            }
+        }
+
+        void Insert(s64 cx, s64 cy, s64 cz, u32 item)
+        {
+            if (item >= m_next.size())
+                m_next.resize(item + 1, INVALID_INDEX);
+
+            u32 slot = Hash(cx, cy, cz) & m_mask;
+            while (true)
+            {
+                Cell &cell = m_cells[slot];
+                if (cell.head == INVALID_INDEX)
+                {
+                    cell.x = cx;
+                    cell.y = cy;
+                    cell.z = cz;
+                    cell.head = item;
+                    cell.tail = item;
+                    m_used++;
+                    break;
+                }
+                if (cell.x == cx && cell.y == cy && cell.z == cz)
+                {
+                    // Mantem a lista em ordem crescente
+                    m_next[cell.tail] = item;
+                    cell.tail = item;
+                    break;
+                }
+                slot = (slot + 1) & m_mask;
+            }
+
+            if (m_used * 2 > m_cells.size())
+                Grow();
+        }
+
+        u32 Next(u32 item) const { return m_next[item]; }
+
+    private:
+        struct Cell
+        {
+            s64 x = 0, y = 0, z = 0;
+            u32 head = INVALID_INDEX;
+            u32 tail = INVALID_INDEX;
+        };
+
+        std::vector<Cell> m_cells;
+        std::vector<u32> m_next;
+        u32 m_mask = 0;
+        u32 m_used = 0;
+        float m_invCellSize;
+
+        static u32 Hash(s64 x, s64 y, s64 z)
+        {
+            u64 h = (u64)x * 73856093ull ^ (u64)y * 19349663ull ^ (u64)z * 83492791ull;
+            return (u32)(h ^ (h >> 32));
+        }
+
+        void Grow()
+        {
+            std::vector<Cell> old = std::move(m_cells);
+            m_cells.assign(old.size() * 2, Cell());
+            m_mask = (u32)m_cells.size() - 1;
+            for (const Cell &cell : old)
+            {
+                if (cell.head == INVALID_INDEX)
+                    continue;
+                u32 slot = Hash(cell.x, cell.y, cell.z) & m_mask;
+                while (m_cells[slot].head != INVALID_INDEX)
+                    slot = (slot + 1) & m_mask;
+                m_cells[slot] = cell;
+            }
+        }
+    };
+
+    inline bool VerticesEqual(const Vertex &a, const Vertex &b, float thresholdSq)
+    {
+        float dx = a.x - b.x;
+        float dy = a.y - b.y;
+        float dz = a.z - b.z;
+        if (dx * dx + dy * dy + dz * dz > thresholdSq)
+            return false;
+
+        float dnx = a.nx - b.nx;
+        float dny = a.ny - b.ny;
+        float dnz = a.nz - b.nz;
+        if (dnx * dnx + dny * dny + dnz * dnz > thresholdSq)
+            return false;
+
+        float du = a.u - b.u;
+        float dv = a.v - b.v;
+        return du * du + dv * dv <= thresholdSq;
+    }
+}
+
+u32 MeshOptimizer::WeldVertices(const Vertex *vertices, u32 vertexCount, float threshold, std::vector<u32> &remap)
+{
+    remap.assign(vertexCount, INVALID_INDEX);
+    if (vertexCount == 0)
+        return 0;
+
+    // threshold 0 = so vertices exactamente iguais, qualquer celula serve.
+    // A celula e um pouco maior que o threshold para o arredondamento do
+    // floor nunca empurrar um vizinho valido para fora das 27 celulas.
+    const float cellSize = threshold > 0.0f ? threshold * 1.001f : 1.0f;
+    const float thresholdSq = threshold > 0.0f ? threshold * threshold : 0.0f;
+
+    SpatialHashGrid grid(vertexCount, cellSize);
+
+    // uniqueSource[j] = vertice original que representa o unico j
+    std::vector<u32> uniqueSource;
+    uniqueSource.reserve(vertexCount);
+
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        const Vertex &v = vertices[i];
+
+        s64 cx, cy, cz;
+        grid.GetCell(v.x, v.y, v.z, cx, cy, cz);
+
+        // Procura o menor indice unico compativel nas celulas vizinhas
+        u32 best = INVALID_INDEX;
+        for (s64 dz = -1; dz <= 1; ++dz)
+            for (s64 dy = -1; dy <= 1; ++dy)
+                for (s64 dx = -1; dx <= 1; ++dx)
+                {
+                    for (u32 j = grid.Find(cx + dx, cy + dy, cz + dz); j != INVALID_INDEX && j < best; j = grid.Next(j))
+                    {
+                        if (VerticesEqual(v, vertices[uniqueSource[j]], thresholdSq))
+                        {
+                            best = j;
+                            break;
+                        }
+                    }
+                }
+
+        if (best != INVALID_INDEX)
+        {
+            remap[i] = best;
+            continue;
+        }
+
+        u32 newIndex = (u32)uniqueSource.size();
+        uniqueSource.push_back(i);
+        grid.Insert(cx, cy, cz, newIndex);
+        remap[i] = newIndex;
+    }
+
+    return (u32)uniqueSource.size();
+}
+
+MeshOptimizer::VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const u32 *indices, u32 indexCount, u32 vertexCount, u32 cacheSize)
+{
+    VertexCacheStats stats;
+    stats.triangleCount = indexCount / 3;
+    stats.vertexCount = vertexCount;
+
+    if (indexCount == 0 || vertexCount == 0 || cacheSize == 0)
+        return stats;
+
+    // Timestamp de entrada no FIFO: um vertice esta no cache se entrou
+    // ha menos de cacheSize misses
+    std::vector<u32> timestamps(vertexCount, 0);
+    u32 time = cacheSize + 1;
+
+    for (u32 i = 0; i < indexCount; ++i)
+    {
+        u32 index = indices[i];
+        if (time - timestamps[index] > cacheSize)
+        {
+            timestamps[index] = time++;
+            stats.transformedVertices++;
+        }
+    }
+
+    stats.acmr = stats.triangleCount ? (float)stats.transformedVertices / stats.triangleCount : 0.0f;
+    stats.atvr = (float)stats.transformedVertices / vertexCount;
+    return stats;
+}
+
+namespace
+{
+    // Constantes do artigo do Forsyth
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRI_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+    const u32 MAX_VALENCE = 32;
+
+    struct ForsythTables
+    {
+        float cache[MeshOptimizer::MAX_CACHE_SIZE + 3];
+        float valence[MAX_VALENCE + 1];
+
+        explicit ForsythTables(u32 cacheSize)
+        {
+            for (u32 i = 0; i < MeshOptimizer::MAX_CACHE_SIZE + 3; ++i)
+            {
+                if (i < 3)
+                    cache[i] = LAST_TRI_SCORE;
+                else if (i < cacheSize)
+                {
+                    float scaler = 1.0f / (float)(cacheSize - 3);
+                    cache[i] = std::pow(1.0f - (float)(i - 3) * scaler, CACHE_DECAY_POWER);
+                }
+                else
+                    cache[i] = 0.0f;
+            }
+
+            valence[0] = 0.0f;
+            for (u32 i = 1; i <= MAX_VALENCE; ++i)
+                valence[i] = VALENCE_BOOST_SCALE * std::pow((float)i, -VALENCE_BOOST_POWER);
+        }
+
+        float Score(s32 cachePosition, u32 liveTriangles) const
+        {
+            if (liveTriangles == 0)
+                return -1.0f; // ja nao e usado por nenhum triangulo
+
+            float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+            return score + valence[Min((int)liveTriangles, (int)MAX_VALENCE)];
+        }
+    };
+}
+
+void MeshOptimizer::OptimizeVertexCache(u32 *destination, const u32 *indices, u32 indexCount, u32 vertexCount, u32 cacheSize)
+{
+    const u32 triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0)
+        return;
+
+    cacheSize = (u32)Clamp((int)cacheSize, 4, (int)MAX_CACHE_SIZE);
+    const ForsythTables tables(cacheSize);
+
+    // Adjacencia vertice -> triangulos; as listas encolhem com os emitidos
+    VertexAdjacency adjacency;
+    BuildVertexAdjacency(adjacency, indices, triangleCount * 3, vertexCount);
+    const std::vector<u32> &offsets = adjacency.offsets;
+
+    std::vector<u32> liveTriangles(vertexCount);
+    for (u32 v = 0; v < vertexCount; ++v)
+        liveTriangles[v] = adjacency.GetFaceCount(v);
+
+    // Copia local: destination pode apontar para indices
+    std::vector<u32> source(indices, indices + triangleCount * 3);
+
+    std::vector<s32> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (u32 v = 0; v < vertexCount; ++v)
+        vertexScore[v] = tables.Score(-1, liveTriangles[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    for (u32 t = 0; t < triangleCount; ++t)
+    {
+        const u32 *tri = &source[t * 3];
+        triangleScore[t] = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+
+    u32 cache[MAX_CACHE_SIZE + 3];
+    u32 newCache[MAX_CACHE_SIZE + 3];
+    u32 cacheCount = 0;
+
+    u32 inputCursor = 0;
+    u32 written = 0;
+
+    // Primeiro triangulo: o de maior score
+    s32 current = 0;
+    for (u32 t = 1; t < triangleCount; ++t)
+        if (triangleScore[t] > triangleScore[current])
+            current = (s32)t;
+
+    while (current >= 0)
+    {
+        const u32 *tri = &source[current * 3];
+
+        destination[written * 3 + 0] = tri[0];
+        destination[written * 3 + 1] = tri[1];
+        destination[written * 3 + 2] = tri[2];
+        written++;
+        emitted[current] = true;
+
+        // Remove o triangulo das listas de adjacencia dos seus vertices
+        for (u32 k = 0; k < 3; ++k)
+        {
+            u32 v = tri[k];
+            u32 *begin = &adjacency.faces[offsets[v]];
+            u32 count = liveTriangles[v];
+            for (u32 j = 0; j < count; ++j)
+            {
+                if (begin[j] == (u32)current)
+                {
+                    begin[j] = begin[count - 1];
+                    break;
+                }
+            }
+            liveTriangles[v]--;
+        }
+
+        // Novo cache LRU: triangulo atual a frente, resto empurrado
+        u32 newCount = 0;
+        newCache[newCount++] = tri[0];
+        if (tri[1] != tri[0])
+            newCache[newCount++] = tri[1];
+        if (tri[2] != tri[0] && tri[2] != tri[1])
+            newCache[newCount++] = tri[2];
+        for (u32 i = 0; i < cacheCount; ++i)
+        {
+            u32 v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                newCache[newCount++] = v;
+        }
+
+        // Vertices que saem do cache
+        for (u32 i = cacheSize; i < newCount; ++i)
+        {
+            u32 v = newCache[i];
+            cachePosition[v] = -1;
+            vertexScore[v] = tables.Score(-1, liveTriangles[v]);
+        }
+
+        cacheCount = Min((int)newCount, (int)cacheSize);
+        for (u32 i = 0; i < cacheCount; ++i)
+        {
+            u32 v = newCache[i];
+            cache[i] = v;
+            cachePosition[v] = (s32)i;
+            vertexScore[v] = tables.Score((s32)i, liveTriangles[v]);
+        }
+
+        // Re-pontua so os triangulos que tocam o cache e escolhe o melhor
+        current = -1;
+        float bestScore = -1.0f;
+        for (u32 i = 0; i < cacheCount; ++i)
+        {
+            u32 v = cache[i];
+            const u32 *begin = &adjacency.faces[offsets[v]];
+            for (u32 j = 0; j < liveTriangles[v]; ++j)
+            {
+                u32 t = begin[j];
+                const u32 *other = &source[t * 3];
+                float score = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+                triangleScore[t] = score;
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    current = (s32)t;
+                }
+            }
+        }
+
+        // Dead end: segue para o proximo triangulo por emitir na ordem original
+        if (current < 0)
+        {
+            while (inputCursor < triangleCount && emitted[inputCursor])
+                inputCursor++;
+            if (inputCursor < triangleCount)
+                current = (s32)inputCursor;
+        }
+    }
+}
+
+MeshOptimizer::VertexFetchStats MeshOptimizer::AnalyzeVertexFetch(const u32 *indices, u32 indexCount, u32 vertexCount, u32 vertexSize)
+{
+    VertexFetchStats stats;
+    if (indexCount == 0 || vertexCount == 0 || vertexSize == 0)
+        return stats;
+
+    const u32 CACHE_LINE = 64;
+    const u32 CACHE_LINES = 256; // 16KB
+
+    std::vector<bool> used(vertexCount, false);
+    u32 usedCount = 0;
+
+    u32 tags[CACHE_LINES];
+    for (u32 i = 0; i < CACHE_LINES; ++i)
+        tags[i] = INVALID_INDEX;
+
+    for (u32 i = 0; i < indexCount; ++i)
+    {
+        u32 index = indices[i];
+        if (!used[index])
+        {
+            used[index] = true;
+            usedCount++;
+        }
+
+        u32 first = (index * vertexSize) / CACHE_LINE;
+        u32 last = (index * vertexSize + vertexSize - 1) / CACHE_LINE;
+        for (u32 line = first; line <= last; ++line)
+        {
+            u32 slot = line % CACHE_LINES;
+            if (tags[slot] != line)
+            {
+                tags[slot] = line;
+                stats.bytesFetched += CACHE_LINE;
+            }
+        }
+    }
+
+    stats.overfetch = (float)stats.bytesFetched / (float)(usedCount * vertexSize);
+    return stats;
+}
+
+u32 MeshOptimizer::OptimizeVertexFetchRemap(u32 *remap, const u32 *indices, u32 indexCount, u32 vertexCount)
+{
+    for (u32 v = 0; v < vertexCount; ++v)
+        remap[v] = INVALID_INDEX;
+
+    u32 next = 0;
+    for (u32 i = 0; i < indexCount; ++i)
+    {
+        u32 index = indices[i];
+        if (remap[index] == INVALID_INDEX)
+            remap[index] = next++;
+    }
+
+    const u32 usedCount = next;
+    for (u32 v = 0; v < vertexCount; ++v)
+        if (remap[v] == INVALID_INDEX)
+            remap[v] = next++;
+
+    return usedCount;
+}
+
+namespace
+{
+    const int OVERDRAW_GRID = 256;
+
+    // Rasteriza com depth test e conta quantas vezes cada pixel e sombreado
+    void RasterizeView(const std::vector<Vec3> &positions, const u32 *indices, u32 indexCount, int axis, float sign,
+                       std::vector<float> &depth, u32 &covered, u32 &shaded)
+    {
+        const int ua = (axis + 1) % 3;
+        const int va = (axis + 2) % 3;
+
+        std::fill(depth.begin(), depth.end(), FLT_MAX);
+
+        for (u32 i = 0; i + 2 < indexCount; i += 3)
+        {
+            const Vec3 &p0 = positions[indices[i]];
+            const Vec3 &p1 = positions[indices[i + 1]];
+            const Vec3 &p2 = positions[indices[i + 2]];
+
+            // Backface culling: a camara olha na direcao axis * sign
+            Vec3 normal = (p1 - p0).cross(p2 - p0);
+            const float facing = (axis == 0 ? normal.x : axis == 1 ? normal.y : normal.z) * sign;
+            if (facing >= 0.0f)
+                continue;
+
+            float u[3] = {p0[ua], p1[ua], p2[ua]};
+            float v[3] = {p0[va], p1[va], p2[va]};
+            float z[3] = {p0[axis] * sign, p1[axis] * sign, p2[axis] * sign};
+
+            float area = (u[1] - u[0]) * (v[2] - v[0]) - (u[2] - u[0]) * (v[1] - v[0]);
+            if (area == 0.0f)
+                continue;
+            const float invArea = 1.0f / area;
+
+            int minX = Max((int)std::floor(Min(u[0], Min(u[1], u[2]))), 0);
+            int maxX = Min((int)std::ceil(Max(u[0], Max(u[1], u[2]))), OVERDRAW_GRID - 1);
+            int minY = Max((int)std::floor(Min(v[0], Min(v[1], v[2]))), 0);
+            int maxY = Min((int)std::ceil(Max(v[0], Max(v[1], v[2]))), OVERDRAW_GRID - 1);
+
+            for (int y = minY; y <= maxY; ++y)
+            {
+                const float py = (float)y + 0.5f;
+                for (int x = minX; x <= maxX; ++x)
+                {
+                    const float px = (float)x + 0.5f;
+
+                    float w0 = ((u[1] - px) * (v[2] - py) - (u[2] - px) * (v[1] - py)) * invArea;
+                    float w1 = ((u[2] - px) * (v[0] - py) - (u[0] - px) * (v[2] - py)) * invArea;
+                    float w2 = 1.0f - w0 - w1;
+                    if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                        continue;
+
+                    float d = w0 * z[0] + w1 * z[1] + w2 * z[2];
+                    float &stored = depth[y * OVERDRAW_GRID + x];
+                    if (d < stored)
+                    {
+                        if (stored == FLT_MAX)
+                            covered++;
+                        stored = d;
+                        shaded++;
+                    }
+                }
+            }
+        }
+    }
+}
+
+MeshOptimizer::OverdrawStats MeshOptimizer::AnalyzeOverdraw(const u32 *indices, u32 indexCount, const Vertex *vertices, u32 vertexCount)
+{
+    OverdrawStats stats;
+    if (indexCount < 3 || vertexCount == 0)
+        return stats;
+
+    // Normaliza a mesh para a grelha, mantendo as proporcoes
+    Vec3 minP(FLT_MAX), maxP(-FLT_MAX);
+    for (u32 v = 0; v < vertexCount; ++v)
+    {
+        Vec3 p(vertices[v].x, vertices[v].y, vertices[v].z);
+        minP = Vec3::Min(minP, p);
+        maxP = Vec3::Max(maxP, p);
+    }
+    Vec3 extent = maxP - minP;
+    float maxExtent = Max(extent.x, Max(extent.y, extent.z));
+    float scale = maxExtent > 0.0f ? (float)OVERDRAW_GRID / maxExtent : 0.0f;
+
+    std::vector<Vec3> positions(vertexCount);
+    for (u32 v = 0; v < vertexCount; ++v)
+        positions[v] = (Vec3(vertices[v].x, vertices[v].y, vertices[v].z) - minP) * scale;
+
+    std::vector<float> depth(OVERDRAW_GRID * OVERDRAW_GRID);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        RasterizeView(positions, indices, indexCount, axis, 1.0f, depth, stats.pixelsCovered, stats.pixelsShaded);
+        RasterizeView(positions, indices, indexCount, axis, -1.0f, depth, stats.pixelsCovered, stats.pixelsShaded);
+    }
+
+    stats.overdraw = stats.pixelsCovered ? (float)stats.pixelsShaded / stats.pixelsCovered : 0.0f;
+    return stats;
+}
+
+void MeshOptimizer::OptimizeOverdraw(u32 *destination, const u32 *indices, u32 indexCount, const Vertex *vertices, u32 vertexCount,
+                                     float threshold)
+{
+    const u32 triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0)
+        return;
+
+    const u32 CACHE_SIZE = 16;
+    const u32 MIN_CLUSTER = 8;
+
+    std::vector<u32> source(indices, indices + triangleCount * 3);
+
+    // Misses por triangulo num FIFO; cada reset invalida o cache todo
+    std::vector<u32> timestamps(vertexCount, 0);
+    u32 time = CACHE_SIZE + 1;
+    auto simulate = [&](u32 t)
+    {
+        u32 misses = 0;
+        for (u32 k = 0; k < 3; ++k)
+        {
+            u32 v = source[t * 3 + k];
+            if (time - timestamps[v] > CACHE_SIZE)
+            {
+                timestamps[v] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    };
+    auto reset = [&]()
+    { time += CACHE_SIZE + 1; };
+
+    // Hard boundaries: triangulos em que os 3 vertices falham o cache.
+    // Cortar ai nao custa nada ao ACMR.
+    std::vector<u32> hard;
+    std::vector<u32> misses(triangleCount);
+    for (u32 t = 0; t < triangleCount; ++t)
+    {
+        misses[t] = simulate(t);
+        if (t == 0 || misses[t] == 3)
+            hard.push_back(t);
+    }
+    hard.push_back(triangleCount);
+
+    // Soft boundaries: parte cada cluster enquanto o ACMR local ficar
+    // abaixo de threshold * ACMR do cluster
+    std::vector<u32> clusters;
+    for (size_t h = 0; h + 1 < hard.size(); ++h)
+    {
+        const u32 start = hard[h];
+        const u32 end = hard[h + 1];
+
+        u32 clusterMisses = 0;
+        for (u32 t = start; t < end; ++t)
+            clusterMisses += misses[t];
+        const float limit = threshold * (float)clusterMisses / (float)(end - start);
+
+        reset();
+        clusters.push_back(start);
+        u32 softStart = start;
+        u32 softMisses = 0;
+        for (u32 t = start; t < end; ++t)
+        {
+            softMisses += simulate(t);
+            u32 count = t - softStart + 1;
+            if (t + 1 < end && count >= MIN_CLUSTER && (float)softMisses / (float)count <= limit)
+            {
+                clusters.push_back(t + 1);
+                reset();
+                softStart = t + 1;
+                softMisses = 0;
+            }
+        }
+    }
+    const u32 clusterCount = (u32)clusters.size();
+    clusters.push_back(triangleCount);
+
+    // Centroide e normal (pesados pela area) de cada cluster e da mesh
+    std::vector<Vec3> centroids(clusterCount);
+    std::vector<Vec3> normals(clusterCount);
+    Vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+
+    for (u32 c = 0; c < clusterCount; ++c)
+    {
+        Vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (u32 t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            const Vertex &a = vertices[source[t * 3 + 0]];
+            const Vertex &b = vertices[source[t * 3 + 1]];
+            const Vertex &d = vertices[source[t * 3 + 2]];
+            Vec3 p0(a.x, a.y, a.z), p1(b.x, b.y, b.z), p2(d.x, d.y, d.z);
+
+            Vec3 n = (p1 - p0).cross(p2 - p0);
+            float triArea = n.length();
+            centroid += (p0 + p1 + p2) * (triArea / 3.0f);
+            normal += n;
+            area += triArea;
+        }
+
+        meshCentroid += centroid;
+        meshArea += area;
+        centroids[c] = area > 0.0f ? centroid / area : centroid;
+        normals[c] = normal.length() > 0.0f ? normal.normalized() : normal;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Clusters mais virados para fora primeiro: tapam os de dentro
+    std::vector<float> sortKey(clusterCount);
+    std::vector<u32> order(clusterCount);
+    for (u32 c = 0; c < clusterCount; ++c)
+    {
+        sortKey[c] = (centroids[c] - meshCentroid).dot(normals[c]);
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&sortKey](u32 a, u32 b)
+                     { return sortKey[a] > sortKey[b]; });
+
+    u32 written = 0;
+    for (u32 c : order)
+    {
+        for (u32 t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            destination[written++] = source[t * 3 + 0];
+            destination[written++] = source[t * 3 + 1];
+            destination[written++] = source[t * 3 + 2];
+        }
+    }
+}
+
+namespace
+{
+    // Quadrica simetrica 4x4 (10 termos) + peso acumulado (area)
+    struct Quadric
+    {
+        double a2 = 0, b2 = 0, c2 = 0, ab = 0, ac = 0, bc = 0;
+        double ad = 0, bd = 0, cd = 0, d2 = 0;
+        double weight = 0;
+
+        void AddPlane(double a, double b, double c, double d, double w)
+        {
+            a2 += a * a * w;
+            b2 += b * b * w;
+            c2 += c * c * w;
+            ab += a * b * w;
+            ac += a * c * w;
+            bc += b * c * w;
+            ad += a * d * w;
+            bd += b * d * w;
+            cd += c * d * w;
+            d2 += d * d * w;
+            weight += w;
+        }
+
+        void Add(const Quadric &q)
+        {
+            a2 += q.a2;
+            b2 += q.b2;
+            c2 += q.c2;
+            ab += q.ab;
+            ac += q.ac;
+            bc += q.bc;
+            ad += q.ad;
+            bd += q.bd;
+            cd += q.cd;
+            d2 += q.d2;
+            weight += q.weight;
+        }
+
+        // Soma das distancias ao quadrado aos planos (pesada)
+        double Evaluate(const Vec3 &p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double r = a2 * x * x + b2 * y * y + c2 * z * z;
+            r += 2.0 * (ab * x * y + ac * x * z + bc * y * z);
+            r += 2.0 * (ad * x + bd * y + cd * z);
+            r += d2;
+            return r < 0.0 ? 0.0 : r;
+        }
+    };
+
+    // Distancia L1 entre duas distribuicoes de pesos (0 = iguais, 2 = disjuntas)
+    float SkinDistance(const VertexSkin &a, const VertexSkin &b)
+    {
+        u8 bones[8];
+        float wa[8] = {0};
+        float wb[8] = {0};
+        int count = 0;
+
+        auto slot = [&](u8 id)
+        {
+            for (int i = 0; i < count; ++i)
+                if (bones[i] == id)
+                    return i;
+            bones[count] = id;
+            return count++;
+        };
+
+        for (int i = 0; i < 4; ++i)
+            wa[slot(a.boneIDs[i])] += a.weights[i];
+        for (int i = 0; i < 4; ++i)
+            wb[slot(b.boneIDs[i])] += b.weights[i];
+
+        float distance = 0.0f;
+        for (int i = 0; i < count; ++i)
+            distance += std::fabs(wa[i] - wb[i]);
+        return distance;
+    }
+
+    struct Collapse
+    {
+        u32 from;
+        u32 to;
+        float cost;
+    };
+}
+
+u32 MeshOptimizer::SimplifyMesh(u32 *destination, const u32 *indices, u32 indexCount, const Vertex *vertices, const VertexSkin *skin,
+                                u32 vertexCount, u32 targetIndexCount, float targetError, float *resultError)
+{
+    indexCount -= indexCount % 3;
+    if (resultError)
+        *resultError = 0.0f;
+    if (indexCount == 0 || vertexCount == 0)
+        return 0;
+
+    // Vertices com a mesma posicao (wedges) partilham um id de posicao
+    std::vector<u32> order(vertexCount);
+    for (u32 v = 0; v < vertexCount; ++v)
+        order[v] = v;
+    std::sort(order.begin(), order.end(), [vertices](u32 a, u32 b)
+              {
+                  const Vertex &va = vertices[a];
+                  const Vertex &vb = vertices[b];
+                  if (va.x != vb.x)
+                      return va.x < vb.x;
+                  if (va.y != vb.y)
+                      return va.y < vb.y;
+                  if (va.z != vb.z)
+                      return va.z < vb.z;
+                  return a < b;
+              });
+
+    std::vector<u32> positionOf(vertexCount);
+    std::vector<u32> nextWedge(vertexCount); // lista circular de wedges por posicao
+    std::vector<u32> firstWedge;
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        const Vertex &v = vertices[order[i]];
+        const Vertex *prev = i > 0 ? &vertices[order[i - 1]] : nullptr;
+        if (!prev || prev->x != v.x || prev->y != v.y || prev->z != v.z)
+        {
+            firstWedge.push_back(order[i]);
+            nextWedge[order[i]] = order[i];
+        }
+        else
+        {
+            u32 first = firstWedge.back();
+            nextWedge[order[i]] = nextWedge[first];
+            nextWedge[first] = order[i];
+        }
+        positionOf[order[i]] = (u32)firstWedge.size() - 1;
+    }
+    const u32 positionCount = (u32)firstWedge.size();
+
+    std::vector<Vec3> positions(positionCount);
+    for (u32 p = 0; p < positionCount; ++p)
+    {
+        const Vertex &v = vertices[firstWedge[p]];
+        positions[p] = Vec3(v.x, v.y, v.z);
+    }
+
+    // Copia sem triangulos degenerados
+    std::vector<u32> current;
+    current.reserve(indexCount);
+    for (u32 i = 0; i < indexCount; i += 3)
+    {
+        u32 pa = positionOf[indices[i]], pb = positionOf[indices[i + 1]], pc = positionOf[indices[i + 2]];
+        if (pa == pb || pb == pc || pa == pc)
+            continue;
+        current.insert(current.end(), indices + i, indices + i + 3);
+    }
+
+    // Bordas abertas e arestas nao-manifold prendem os vertices
+    std::vector<bool> locked(positionCount, false);
+    {
+        std::vector<u64> edges;
+        edges.reserve(current.size());
+        for (size_t i = 0; i < current.size(); i += 3)
+            for (u32 k = 0; k < 3; ++k)
+            {
+                u64 a = positionOf[current[i + k]];
+                u64 b = positionOf[current[i + (k + 1) % 3]];
+                edges.push_back((a << 32) | b);
+            }
+        std::sort(edges.begin(), edges.end());
+
+        for (size_t i = 0; i < edges.size(); ++i)
+        {
+            u64 a = edges[i] >> 32;
+            u64 b = edges[i] & 0xFFFFFFFFu;
+            bool duplicated = (i > 0 && edges[i - 1] == edges[i]) || (i + 1 < edges.size() && edges[i + 1] == edges[i]);
+            bool hasReverse = std::binary_search(edges.begin(), edges.end(), (b << 32) | a);
+            if (duplicated || !hasReverse)
+                locked[a] = locked[b] = true;
+        }
+    }
+
+    // Quadricas por posicao, pesadas pela area
+    std::vector<Quadric> quadrics(positionCount);
+    for (size_t i = 0; i < current.size(); i += 3)
+    {
+        u32 p0 = positionOf[current[i]], p1 = positionOf[current[i + 1]], p2 = positionOf[current[i + 2]];
+        Vec3 n = (positions[p1] - positions[p0]).cross(positions[p2] - positions[p0]);
+        float length = n.length();
+        if (length <= 0.0f)
+            continue;
+        n /= length;
+        double d = -(double)n.dot(positions[p0]);
+        double area = length * 0.5;
+        quadrics[p0].AddPlane(n.x, n.y, n.z, d, area);
+        quadrics[p1].AddPlane(n.x, n.y, n.z, d, area);
+        quadrics[p2].AddPlane(n.x, n.y, n.z, d, area);
+    }
+
+    const double errorLimit = (double)targetError * (double)targetError;
+    double maxError = 0.0;
+
+    std::vector<u32> offsets(positionCount + 1);
+    std::vector<u32> adjacency;
+    std::vector<u32> collapseRemap(vertexCount);
+    std::vector<u32> partner(vertexCount);
+    std::vector<bool> touched(positionCount);
+    std::vector<Collapse> candidates;
+
+    const u32 MAX_PASSES = 100;
+    for (u32 pass = 0; pass < MAX_PASSES && current.size() > targetIndexCount; ++pass)
+    {
+        const u32 triangleCount = (u32)current.size() / 3;
+
+        // Adjacencia posicao -> triangulos (CSR)
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (u32 i = 0; i < triangleCount * 3; ++i)
+            offsets[positionOf[current[i]] + 1]++;
+        for (u32 p = 0; p < positionCount; ++p)
+            offsets[p + 1] += offsets[p];
+        adjacency.resize(triangleCount * 3);
+        {
+            std::vector<u32> fill(offsets.begin(), offsets.end() - 1);
+            for (u32 t = 0; t < triangleCount; ++t)
+                for (u32 k = 0; k < 3; ++k)
+                    adjacency[fill[positionOf[current[t * 3 + k]]]++] = t;
+        }
+
+        // Candidatos: as duas direcoes de cada aresta
+        candidates.clear();
+        for (u32 t = 0; t < triangleCount; ++t)
+        {
+            for (u32 k = 0; k < 3; ++k)
+            {
+                u32 pa = positionOf[current[t * 3 + k]];
+                u32 pb = positionOf[current[t * 3 + (k + 1) % 3]];
+                const u32 dirs[2][2] = {{pa, pb}, {pb, pa}};
+                for (const auto &dir : dirs)
+                {
+                    if (locked[dir[0]])
+                        continue;
+                    Quadric q = quadrics[dir[0]];
+                    q.Add(quadrics[dir[1]]);
+                    double cost = q.weight > 0.0 ? q.Evaluate(positions[dir[1]]) / q.weight : 0.0;
+                    candidates.push_back({dir[0], dir[1], (float)cost});
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse &a, const Collapse &b)
+                  { return a.cost < b.cost; });
+
+        for (u32 v = 0; v < vertexCount; ++v)
+            collapseRemap[v] = v;
+        std::fill(touched.begin(), touched.end(), false);
+
+        const u32 trianglesToRemove = (u32)(current.size() - targetIndexCount) / 3;
+        u32 removed = 0;
+        u32 collapses = 0;
+
+        for (const Collapse &c : candidates)
+        {
+            if (removed >= trianglesToRemove || c.cost > errorLimit)
+                break;
+            if (touched[c.from] || touched[c.to])
+                continue;
+
+            const u32 *adjBegin = &adjacency[offsets[c.from]];
+            const u32 adjCount = offsets[c.from + 1] - offsets[c.from];
+            bool valid = true;
+
+            // Cada wedge de 'from' precisa de um unico parceiro em 'to' ligado
+            // por uma aresta; senao o colapso rasgava um seam
+            u32 w = firstWedge[c.from];
+            do
+            {
+                u32 found = INVALID_INDEX;
+                bool used = false;
+                for (u32 j = 0; j < adjCount && valid; ++j)
+                {
+                    const u32 *tri = &current[adjBegin[j] * 3];
+                    if (tri[0] != w && tri[1] != w && tri[2] != w)
+                        continue;
+                    used = true;
+                    for (u32 k = 0; k < 3; ++k)
+                    {
+                        if (positionOf[tri[k]] != c.to)
+                            continue;
+                        if (found == INVALID_INDEX)
+                            found = tri[k];
+                        else if (found != tri[k])
+                            valid = false;
+                    }
+                }
+                if (used && found == INVALID_INDEX)
+                    valid = false;
+                if (valid && skin && found != INVALID_INDEX && SkinDistance(skin[w], skin[found]) > MAX_SKIN_DISTANCE)
+                    valid = false;
+                partner[w] = found;
+                w = nextWedge[w];
+            } while (valid && w != firstWedge[c.from]);
+
+            if (!valid)
+                continue;
+
+            // Nao deixa triangulos virar do avesso
+            u32 collapsed = 0;
+            for (u32 j = 0; j < adjCount && valid; ++j)
+            {
+                const u32 *tri = &current[adjBegin[j] * 3];
+                u32 p[3] = {positionOf[tri[0]], positionOf[tri[1]], positionOf[tri[2]]};
+                if (p[0] == c.to || p[1] == c.to || p[2] == c.to)
+                {
+                    collapsed++;
+                    continue;
+                }
+                Vec3 before = (positions[p[1]] - positions[p[0]]).cross(positions[p[2]] - positions[p[0]]);
+                Vec3 q[3];
+                for (u32 k = 0; k < 3; ++k)
+                    q[k] = p[k] == c.from ? positions[c.to] : positions[p[k]];
+                Vec3 after = (q[1] - q[0]).cross(q[2] - q[0]);
+                if (before.dot(after) <= 0.0f)
+                    valid = false;
+            }
+            if (!valid)
+                continue;
+
+            w = firstWedge[c.from];
+            do
+            {
+                if (partner[w] != INVALID_INDEX)
+                    collapseRemap[w] = partner[w];
+                w = nextWedge[w];
+            } while (w != firstWedge[c.from]);
+
+            quadrics[c.to].Add(quadrics[c.from]);
+
+            // Vizinhos ficam presos ate ao proximo pass (custos desatualizados)
+            for (u32 j = 0; j < adjCount; ++j)
+            {
+                const u32 *tri = &current[adjBegin[j] * 3];
+                for (u32 k = 0; k < 3; ++k)
+                    touched[positionOf[tri[k]]] = true;
+            }
+
+            maxError = std::max(maxError, (double)c.cost);
+            removed += collapsed;
+            collapses++;
+        }
+
+        if (collapses == 0)
+            break;
+
+        u32 written = 0;
+        for (u32 i = 0; i < triangleCount * 3; i += 3)
+        {
+            u32 a = collapseRemap[current[i]], b = collapseRemap[current[i + 1]], d = collapseRemap[current[i + 2]];
+            u32 pa = positionOf[a], pb = positionOf[b], pd = positionOf[d];
+            if (pa == pb || pb == pd || pa == pd)
+                continue;
+            current[written++] = a;
+            current[written++] = b;
+            current[written++] = d;
+        }
+        current.resize(written);
+    }
+
+    std::copy(current.begin(), current.end(), destination);
+    if (resultError)
+        *resultError = (float)std::sqrt(maxError);
+    return (u32)current.size();
+}
+
+namespace
+{
+    Vec3 TriangleNormal(const Vertex *vertices, const u32 *tri)
+    {
+        const Vertex &a = vertices[tri[0]];
+        const Vertex &b = vertices[tri[1]];
+        const Vertex &c = vertices[tri[2]];
+        Vec3 p0(a.x, a.y, a.z), p1(b.x, b.y, b.z), p2(c.x, c.y, c.z);
+        Vec3 n = (p1 - p0).cross(p2 - p0);
+        float length = n.length();
+        return length > 0.0f ? n / length : Vec3(0.0f);
+    }
+
+    // Esfera de Ritter: aproximada, no maximo ~5% maior que a minima
+    void ComputeBoundingSphere(const Vertex *vertices, const std::vector<u32> &points, Vec3 &center, float &radius)
+    {
+        auto position = [vertices](u32 v)
+        { return Vec3(vertices[v].x, vertices[v].y, vertices[v].z); };
+
+        Vec3 p0 = position(points[0]);
+        Vec3 p1 = p0;
+        float best = -1.0f;
+        for (u32 v : points)
+        {
+            float d = (position(v) - p0).lengthSquared();
+            if (d > best)
+            {
+                best = d;
+                p1 = position(v);
+            }
+        }
+        Vec3 p2 = p1;
+        best = -1.0f;
+        for (u32 v : points)
+        {
+            float d = (position(v) - p1).lengthSquared();
+            if (d > best)
+            {
+                best = d;
+                p2 = position(v);
+            }
+        }
+
+        center = (p1 + p2) * 0.5f;
+        radius = (p2 - p1).length() * 0.5f;
+
+        for (u32 v : points)
+        {
+            Vec3 p = position(v);
+            float d = (p - center).length();
+            if (d > radius)
+            {
+                float newRadius = (radius + d) * 0.5f;
+                center += (p - center) * ((newRadius - radius) / d);
+                radius = newRadius;
+            }
+        }
+    }
+
+    void ComputeMeshletBounds(MeshOptimizer::Meshlet &meshlet, const u32 *indices, const Vertex *vertices,
+                              std::vector<u32> &points)
+    {
+        points.assign(indices + meshlet.indexOffset, indices + meshlet.indexOffset + meshlet.indexCount);
+        std::sort(points.begin(), points.end());
+        points.erase(std::unique(points.begin(), points.end()), points.end());
+
+        ComputeBoundingSphere(vertices, points, meshlet.center, meshlet.radius);
+
+        // Eixo do cone = media das normais; cutoff vem da normal mais afastada
+        Vec3 axis(0.0f);
+        for (u32 i = 0; i < meshlet.indexCount; i += 3)
+            axis += TriangleNormal(vertices, indices + meshlet.indexOffset + i);
+
+        meshlet.coneAxis = Vec3(0.0f);
+        meshlet.coneApex = meshlet.center;
+        meshlet.coneCutoff = 2.0f;
+
+        float axisLength = axis.length();
+        if (axisLength <= 0.0f)
+            return;
+        axis /= axisLength;
+
+        float minDot = 1.0f;
+        for (u32 i = 0; i < meshlet.indexCount; i += 3)
+        {
+            Vec3 n = TriangleNormal(vertices, indices + meshlet.indexOffset + i);
+            if (n.lengthSquared() > 0.0f)
+                minDot = Min(minDot, n.dot(axis));
+        }
+
+        // Normais a mais de ~84 graus do eixo: o cone nao serve para nada
+        if (minDot <= 0.1f)
+            return;
+
+        // Apex atras de todos os planos dos triangulos, ao longo do eixo
+        float maxT = 0.0f;
+        for (u32 i = 0; i < meshlet.indexCount; i += 3)
+        {
+            const u32 *tri = indices + meshlet.indexOffset + i;
+            Vec3 n = TriangleNormal(vertices, tri);
+            float dn = n.dot(axis);
+            if (dn <= 0.0f)
+                continue;
+            const Vertex &a = vertices[tri[0]];
+            float t = (meshlet.center - Vec3(a.x, a.y, a.z)).dot(n) / dn;
+            maxT = Max(maxT, t);
+        }
+
+        meshlet.coneAxis = axis;
+        meshlet.coneApex = meshlet.center - axis * maxT;
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+u32 MeshOptimizer::BuildMeshlets(std::vector<Meshlet> &meshlets, u32 *destination, const u32 *indices, u32 indexCount,
+                                 const Vertex *vertices, u32 vertexCount, u32 maxVertices, u32 maxTriangles)
+{
+    meshlets.clear();
+    const u32 triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0)
+        return 0;
+
+    maxVertices = Max((int)maxVertices, 3);
+    maxTriangles = Max((int)maxTriangles, 1);
+
+    std::vector<u32> source(indices, indices + triangleCount * 3);
+
+    VertexAdjacency adjacency;
+    BuildVertexAdjacency(adjacency, source.data(), triangleCount * 3, vertexCount);
+    const std::vector<u32> &offsets = adjacency.offsets;
+
+    std::vector<Vec3> normals(triangleCount);
+    std::vector<Vec3> centroids(triangleCount);
+    for (u32 t = 0; t < triangleCount; ++t)
+    {
+        const u32 *tri = &source[t * 3];
+        normals[t] = TriangleNormal(vertices, tri);
+        centroids[t] = Vec3(vertices[tri[0]].x + vertices[tri[1]].x + vertices[tri[2]].x,
+                            vertices[tri[0]].y + vertices[tri[1]].y + vertices[tri[2]].y,
+                            vertices[tri[0]].z + vertices[tri[1]].z + vertices[tri[2]].z) /
+                       3.0f;
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<u32> inMeshlet(vertexCount, INVALID_INDEX); // id do meshlet que tem o vertice
+    std::vector<u32> meshletVertices;
+    meshletVertices.reserve(maxVertices);
+
+    u32 written = 0;
+    u32 seedCursor = 0;
+
+    while (true)
+    {
+        while (seedCursor < triangleCount && emitted[seedCursor])
+            seedCursor++;
+        if (seedCursor >= triangleCount)
+            break;
+
+        const u32 id = (u32)meshlets.size();
+        Meshlet meshlet;
+        meshlet.indexOffset = written;
+        meshletVertices.clear();
+        Vec3 normalSum(0.0f);
+        Vec3 positionSum(0.0f);
+
+        s32 current = (s32)seedCursor;
+        while (current >= 0)
+        {
+            const u32 *tri = &source[current * 3];
+            for (u32 k = 0; k < 3; ++k)
+            {
+                if (inMeshlet[tri[k]] != id)
+                {
+                    inMeshlet[tri[k]] = id;
+                    meshletVertices.push_back(tri[k]);
+                    positionSum += Vec3(vertices[tri[k]].x, vertices[tri[k]].y, vertices[tri[k]].z);
+                }
+                destination[written++] = tri[k];
+            }
+            emitted[current] = true;
+            meshlet.indexCount += 3;
+            normalSum += normals[current];
+
+            if (meshlet.indexCount / 3 >= maxTriangles)
+                break;
+
+            // Melhor vizinho: menos vertices novos, depois mais alinhado e
+            // mais perto do centro (clusters compactos enchem melhor)
+            Vec3 axis = normalSum.lengthSquared() > 0.0f ? normalSum.normalized() : normalSum;
+            Vec3 centroid = positionSum / (float)meshletVertices.size();
+            float radius = 0.0f;
+            for (u32 v : meshletVertices)
+                radius = Max(radius, (Vec3(vertices[v].x, vertices[v].y, vertices[v].z) - centroid).lengthSquared());
+            const float invRadius = radius > 0.0f ? 1.0f / std::sqrt(radius) : 0.0f;
+            current = -1;
+            float bestScore = FLT_MAX;
+            for (u32 v : meshletVertices)
+            {
+                for (u32 j = offsets[v]; j < offsets[v + 1]; ++j)
+                {
+                    u32 t = adjacency.faces[j];
+                    if (emitted[t])
+                        continue;
+
+                    const u32 *other = &source[t * 3];
+                    u32 extra = 0;
+                    for (u32 k = 0; k < 3; ++k)
+                        extra += inMeshlet[other[k]] != id ? 1 : 0;
+                    if (meshletVertices.size() + extra > maxVertices)
+                        continue;
+
+                    float spread = 1.0f - normals[t].dot(axis);
+                    float distance = (centroids[t] - centroid).length() * invRadius;
+                    float score = (float)extra + spread + 0.5f * distance;
+                    if (score < bestScore)
+                    {
+                        bestScore = score;
+                        current = (s32)t;
+                    }
+                }
+            }
+        }
+
+        meshlet.vertexCount = (u32)meshletVertices.size();
+        meshlets.push_back(meshlet);
+    }
+
+    std::vector<u32> points;
+    for (Meshlet &meshlet : meshlets)
+        ComputeMeshletBounds(meshlet, destination, vertices, points);
+
+    return (u32)meshlets.size();
+}
+
+bool MeshOptimizer::IsMeshletBackfacing(const Meshlet &meshlet, const Vec3 &cameraPosition)
+{
+    if (meshlet.coneCutoff > 1.0f)
+        return false;
+
+    Vec3 view = meshlet.coneApex - cameraPosition;
+    float length = view.length();
+    if (length <= 0.0f)
+        return false;
+    return view.dot(meshlet.coneAxis) >= meshlet.coneCutoff * length;
+}
+
+u16 MeshOptimizer::EncodeHalf(float value)
+{
+    u32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    const u32 sign = (bits >> 16) & 0x8000;
+    const u32 floatExponent = (bits >> 23) & 0xFF;
+    u32 mantissa = bits & 0x7FFFFF;
+
+    if (floatExponent == 0xFF) // inf / nan
+        return (u16)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+
+    const s32 exponent = (s32)floatExponent - 127 + 15;
+    if (exponent >= 31)
+        return (u16)(sign | 0x7C00);
+
+    if (exponent <= 0)
+    {
+        // Denormal (ou zero)
+        if (exponent < -10)
+            return (u16)sign;
+        mantissa |= 0x800000;
+        const u32 shift = (u32)(14 - exponent);
+        u32 half = mantissa >> shift;
+        const u32 remainder = mantissa & ((1u << shift) - 1);
+        const u32 middle = 1u << (shift - 1);
+        if (remainder > middle || (remainder == middle && (half & 1)))
+            half++;
+        return (u16)(sign | half);
+    }
+
+    // Arredonda para o par mais proximo; o carry pode subir o expoente (correto)
+    u32 half = sign | ((u32)exponent << 10) | (mantissa >> 13);
+    const u32 remainder = mantissa & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        half++;
+    return (u16)half;
+}
+
+float MeshOptimizer::DecodeHalf(u16 value)
+{
+    const u32 sign = (u32)(value & 0x8000) << 16;
+    u32 exponent = (value >> 10) & 0x1F;
+    u32 mantissa = value & 0x3FF;
+    u32 bits;
+
+    if (exponent == 0)
+    {
+        if (mantissa == 0)
+        {
+            bits = sign;
+        }
+        else
+        {
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400))
+            {
+                mantissa <<= 1;
+                exponent--;
+            }
+            mantissa &= 0x3FF;
+            bits = sign | (exponent << 23) | (mantissa << 13);
+        }
+    }
+    else if (exponent == 31)
+    {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+namespace
+{
+    inline float SignNotZero(float v) { return v >= 0.0f ? 1.0f : -1.0f; }
+
+    inline s16 EncodeSnorm16(float v)
+    {
+        return (s16)std::lround(Clamp(v, -1.0f, 1.0f) * 32767.0f);
+    }
+
+    inline float DecodeSnorm16(s16 v)
+    {
+        return Max((float)v / 32767.0f, -1.0f);
+    }
+
+    struct VertexLayout
+    {
+        u32 position;
+        u32 normal;
+        u32 texCoord;
+        u32 stride;
+    };
+
+    VertexLayout GetLayout(const MeshOptimizer::VertexFormat &format)
+    {
+        VertexLayout layout;
+        layout.position = 0;
+        layout.normal = layout.position + (format.position == MeshOptimizer::POSITION_FLOAT3 ? 12 : 8);
+        layout.texCoord = layout.normal + (format.normal == MeshOptimizer::NORMAL_FLOAT3 ? 12 : 4);
+        layout.stride = layout.texCoord + (format.texCoord == MeshOptimizer::TEXCOORD_FLOAT2 ? 8 : 4);
+        return layout;
+    }
+
+    u32 WeightMax(MeshOptimizer::WeightFormat format)
+    {
+        return format == MeshOptimizer::WEIGHT_UNORM16 ? 65535u : 255u;
+    }
+}
+
+void MeshOptimizer::EncodeOctahedral(const Vec3 &normal, s16 out[2])
+{
+    const float l1 = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    if (l1 <= 0.0f)
+    {
+        out[0] = out[1] = 0;
+        return;
+    }
+
+    float x = normal.x / l1;
+    float y = normal.y / l1;
+
+    // Hemisferio de baixo dobra-se sobre os cantos do quadrado
+    if (normal.z < 0.0f)
+    {
+        const float fx = (1.0f - std::fabs(y)) * SignNotZero(x);
+        const float fy = (1.0f - std::fabs(x)) * SignNotZero(y);
+        x = fx;
+        y = fy;
+    }
+
+    // Entre as 4 combinacoes floor/ceil fica a que descodifica mais perto
+    const Vec3 n = normal / normal.length();
+    const float fx = std::floor(Clamp(x, -1.0f, 1.0f) * 32767.0f);
+    const float fy = std::floor(Clamp(y, -1.0f, 1.0f) * 32767.0f);
+    float best = -2.0f;
+    for (int i = 0; i < 4; ++i)
+    {
+        s16 candidate[2] = {(s16)Clamp(fx + (float)(i & 1), -32767.0f, 32767.0f),
+                            (s16)Clamp(fy + (float)(i >> 1), -32767.0f, 32767.0f)};
+        const float cosine = DecodeOctahedral(candidate).dot(n);
+        if (cosine > best)
+        {
+            best = cosine;
+            out[0] = candidate[0];
+            out[1] = candidate[1];
+        }
+    }
+}
+
+Vec3 MeshOptimizer::DecodeOctahedral(const s16 in[2])
+{
+    float x = DecodeSnorm16(in[0]);
+    float y = DecodeSnorm16(in[1]);
+    const float z = 1.0f - std::fabs(x) - std::fabs(y);
+
+    if (z < 0.0f)
+    {
+        const float fx = (1.0f - std::fabs(y)) * SignNotZero(x);
+        const float fy = (1.0f - std::fabs(x)) * SignNotZero(y);
+        x = fx;
+        y = fy;
+    }
+
+    return Vec3(x, y, z).normalized();
+}
+
+void MeshOptimizer::QuantizeWeights(const float weights[4], u32 maxValue, u32 out[4])
+{
+    float sum = 0.0f;
+    for (int i = 0; i < 4; ++i)
+        sum += Max(weights[i], 0.0f);
+
+    if (sum <= 0.0f)
+    {
+        out[0] = out[1] = out[2] = out[3] = 0;
+        return;
+    }
+
+    float error[4];
+    u32 total = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        const float scaled = Max(weights[i], 0.0f) / sum * (float)maxValue;
+        out[i] = (u32)std::lround(scaled);
+        error[i] = scaled - (float)out[i];
+        total += out[i];
+    }
+
+    // Acerta a soma no peso que ficou mais longe
+    while (total != maxValue)
+    {
+        int best = -1;
+        for (int i = 0; i < 4; ++i)
+        {
+            if (total > maxValue && out[i] == 0)
+                continue;
+            if (best < 0 || (total < maxValue ? error[i] > error[best] : error[i] < error[best]))
+                best = i;
+        }
+        if (total < maxValue)
+        {
+            out[best]++;
+            error[best] -= 1.0f;
+            total++;
+        }
+        else
+        {
+            out[best]--;
+            error[best] += 1.0f;
+            total--;
+        }
+    }
+}
+
+u32 MeshOptimizer::GetVertexStride(const VertexFormat &format)
+{
+    return GetLayout(format).stride;
+}
+
+MeshOptimizer::VertexFormat MeshOptimizer::GetGpuFormat(const VertexFormat &format, bool shaderDecode)
+{
+    VertexFormat gpu = format;
+    if (!shaderDecode)
+    {
+        if (gpu.position == POSITION_SNORM16)
+            gpu.position = POSITION_HALF4;
+        if (gpu.normal == NORMAL_OCT16)
+            gpu.normal = NORMAL_FLOAT3;
+    }
+    return gpu;
+}
+
+// Inverso do EncodeOctahedral e da escala do ComputeQuantizationBounds
+const char *MeshOptimizer::VERTEX_DECODE_GLSL =
+    "vec3 decodeOctNormal(vec2 e)\n"
+    "{\n"
+    "    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));\n"
+    "    if (n.z < 0.0)\n"
+    "        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+    "    return normalize(n);\n"
+    "}\n"
+    "vec3 decodePosition(vec4 p, mat4 positionDecode)\n"
+    "{\n"
+    "    return (positionDecode * vec4(p.xyz, 1.0)).xyz;\n"
+    "}\n";
+
+u32 MeshOptimizer::GetSkinStride(const VertexFormat &format)
+{
+    switch (format.weights)
+    {
+    case WEIGHT_UNORM16:
+        return 4 + 4 * sizeof(u16);
+    case WEIGHT_UNORM8:
+        return 4 + 4;
+    default:
+        return 4 + 4 * sizeof(float);
+    }
+}
+
+void MeshOptimizer::ComputeQuantizationBounds(const Vertex *vertices, u32 vertexCount, Vec3 &center, float &scale)
+{
+    center = Vec3(0.0f);
+    scale = 1.0f;
+    if (vertexCount == 0)
+        return;
+
+    Vec3 minP(vertices[0].x, vertices[0].y, vertices[0].z);
+    Vec3 maxP = minP;
+    for (u32 v = 1; v < vertexCount; ++v)
+    {
+        Vec3 p(vertices[v].x, vertices[v].y, vertices[v].z);
+        minP = Vec3::Min(minP, p);
+        maxP = Vec3::Max(maxP, p);
+    }
+
+    center = (minP + maxP) * 0.5f;
+    Vec3 half = (maxP - minP) * 0.5f;
+    scale = Max(half.x, Max(half.y, half.z));
+    if (scale <= 0.0f)
+        scale = 1.0f;
+}
+
+void MeshOptimizer::PackVertices(u8 *destination, const Vertex *vertices, u32 vertexCount, const VertexFormat &format,
+                                 const Vec3 &center, float scale)
+{
+    const VertexLayout layout = GetLayout(format);
+    const float invScale = 1.0f / scale;
+
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        const Vertex &v = vertices[i];
+        u8 *out = destination + i * layout.stride;
+
+        switch (format.position)
+        {
+        case POSITION_HALF4:
+        {
+            u16 p[4] = {EncodeHalf(v.x), EncodeHalf(v.y), EncodeHalf(v.z), 0x3C00};
+            std::memcpy(out + layout.position, p, sizeof(p));
+            break;
+        }
+        case POSITION_SNORM16:
+        {
+            s16 p[4] = {EncodeSnorm16((v.x - center.x) * invScale), EncodeSnorm16((v.y - center.y) * invScale),
+                        EncodeSnorm16((v.z - center.z) * invScale), 32767};
+            std::memcpy(out + layout.position, p, sizeof(p));
+            break;
+        }
+        default:
+        {
+            float p[3] = {v.x, v.y, v.z};
+            std::memcpy(out + layout.position, p, sizeof(p));
+            break;
+        }
+        }
+
+        if (format.normal == NORMAL_OCT16)
+        {
+            s16 n[2];
+            EncodeOctahedral(Vec3(v.nx, v.ny, v.nz), n);
+            std::memcpy(out + layout.normal, n, sizeof(n));
+        }
+        else
+        {
+            float n[3] = {v.nx, v.ny, v.nz};
+            std::memcpy(out + layout.normal, n, sizeof(n));
+        }
+
+        if (format.texCoord == TEXCOORD_HALF2)
+        {
+            u16 uv[2] = {EncodeHalf(v.u), EncodeHalf(v.v)};
+            std::memcpy(out + layout.texCoord, uv, sizeof(uv));
+        }
+        else
+        {
+            float uv[2] = {v.u, v.v};
+            std::memcpy(out + layout.texCoord, uv, sizeof(uv));
+        }
+    }
+}
+
+void MeshOptimizer::UnpackVertices(Vertex *destination, const u8 *data, u32 vertexCount, const VertexFormat &format,
+                                   const Vec3 &center, float scale)
+{
+    const VertexLayout layout = GetLayout(format);
+
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        Vertex &v = destination[i];
+        const u8 *in = data + i * layout.stride;
+
+        switch (format.position)
+        {
+        case POSITION_HALF4:
+        {
+            u16 p[4];
+            std::memcpy(p, in + layout.position, sizeof(p));
+            v.x = DecodeHalf(p[0]);
+            v.y = DecodeHalf(p[1]);
+            v.z = DecodeHalf(p[2]);
+            break;
+        }
+        case POSITION_SNORM16:
+        {
+            s16 p[4];
+            std::memcpy(p, in + layout.position, sizeof(p));
+            v.x = DecodeSnorm16(p[0]) * scale + center.x;
+            v.y = DecodeSnorm16(p[1]) * scale + center.y;
+            v.z = DecodeSnorm16(p[2]) * scale + center.z;
+            break;
+        }
+        default:
+        {
+            float p[3];
+            std::memcpy(p, in + layout.position, sizeof(p));
+            v.x = p[0];
+            v.y = p[1];
+            v.z = p[2];
+            break;
+        }
+        }
+
+        if (format.normal == NORMAL_OCT16)
+        {
+            s16 n[2];
+            std::memcpy(n, in + layout.normal, sizeof(n));
+            Vec3 normal = DecodeOctahedral(n);
+            v.nx = normal.x;
+            v.ny = normal.y;
+            v.nz = normal.z;
+        }
+        else
+        {
+            float n[3];
+            std::memcpy(n, in + layout.normal, sizeof(n));
+            v.nx = n[0];
+            v.ny = n[1];
+            v.nz = n[2];
+        }
+
+        if (format.texCoord == TEXCOORD_HALF2)
+        {
+            u16 uv[2];
+            std::memcpy(uv, in + layout.texCoord, sizeof(uv));
+            v.u = DecodeHalf(uv[0]);
+            v.v = DecodeHalf(uv[1]);
+        }
+        else
+        {
+            float uv[2];
+            std::memcpy(uv, in + layout.texCoord, sizeof(uv));
+            v.u = uv[0];
+            v.v = uv[1];
+        }
+    }
+}
+
+void MeshOptimizer::PackSkin(u8 *destination, const VertexSkin *skin, u32 vertexCount, const VertexFormat &format)
+{
+    const u32 stride = GetSkinStride(format);
+
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        u8 *out = destination + i * stride;
+        std::memcpy(out, skin[i].boneIDs, 4);
+
+        if (format.weights == WEIGHT_FLOAT)
+        {
+            std::memcpy(out + 4, skin[i].weights, 4 * sizeof(float));
+            continue;
+        }
+
+        u32 q[4];
+        QuantizeWeights(skin[i].weights, WeightMax(format.weights), q);
+        for (int j = 0; j < 4; ++j)
+        {
+            if (format.weights == WEIGHT_UNORM16)
+            {
+                u16 w = (u16)q[j];
+                std::memcpy(out + 4 + j * sizeof(u16), &w, sizeof(w));
+            }
+            else
+            {
+                out[4 + j] = (u8)q[j];
+            }
+        }
+    }
+}
+
+void MeshOptimizer::UnpackSkin(VertexSkin *destination, const u8 *data, u32 vertexCount, const VertexFormat &format)
+{
+    const u32 stride = GetSkinStride(format);
+    const float invMax = 1.0f / (float)WeightMax(format.weights);
+
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        const u8 *in = data + i * stride;
+        std::memcpy(destination[i].boneIDs, in, 4);
+
+        for (int j = 0; j < 4; ++j)
+        {
+            if (format.weights == WEIGHT_FLOAT)
+            {
+                std::memcpy(&destination[i].weights[j], in + 4 + j * sizeof(float), sizeof(float));
+            }
+            else if (format.weights == WEIGHT_UNORM16)
+            {
+                u16 w;
+                std::memcpy(&w, in + 4 + j * sizeof(u16), sizeof(w));
+                destination[i].weights[j] = (float)w * invMax;
+            }
+            else
+            {
+                destination[i].weights[j] = (float)in[4 + j] * invMax;
+            }
+        }
+    }
+}
+
+MeshOptimizer::QuantizationError MeshOptimizer::AnalyzeQuantization(const Vertex *vertices, const VertexSkin *skin, u32 vertexCount,
+                                                                    const VertexFormat &format)
+{
+    Vec3 center;
+    float scale;
+    ComputeQuantizationBounds(vertices, vertexCount, center, scale);
+    return AnalyzeQuantization(vertices, skin, vertexCount, format, center, scale);
+}
+
+MeshOptimizer::QuantizationError MeshOptimizer::AnalyzeQuantization(const Vertex *vertices, const VertexSkin *skin, u32 vertexCount,
+                                                                    const VertexFormat &format, const Vec3 &center, float scale)
+{
+    QuantizationError report;
+    report.vertexBytes = sizeof(Vertex);
+    report.packedBytes = GetVertexStride(format);
+    report.skinBytes = skin ? sizeof(VertexSkin) : 0;
+    report.packedSkinBytes = skin ? GetSkinStride(format) : 0;
+
+    if (vertexCount == 0)
+        return report;
+
+    std::vector<u8> packed(vertexCount * report.packedBytes);
+    std::vector<Vertex> decoded(vertexCount);
+    PackVertices(packed.data(), vertices, vertexCount, format, center, scale);
+    UnpackVertices(decoded.data(), packed.data(), vertexCount, format, center, scale);
+
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        const Vertex &a = vertices[i];
+        const Vertex &b = decoded[i];
+
+        report.position = Max(report.position, (Vec3(a.x, a.y, a.z) - Vec3(b.x, b.y, b.z)).length());
+
+        Vec3 na(a.nx, a.ny, a.nz);
+        Vec3 nb(b.nx, b.ny, b.nz);
+        if (na.lengthSquared() > 0.0f && nb.lengthSquared() > 0.0f)
+        {
+            // atan2 em vez de acos: acos em float nao resolve angulos < ~0.03 graus
+            na = na.normalized();
+            nb = nb.normalized();
+            float angle = std::atan2(na.cross(nb).length(), na.dot(nb));
+            report.normal = Max(report.normal, angle * 180.0f / Pi);
+        }
+
+        report.texCoord = Max(report.texCoord, Max(std::fabs(a.u - b.u), std::fabs(a.v - b.v)));
+    }
+
+    if (skin)
+    {
+        std::vector<u8> packedSkin(vertexCount * report.packedSkinBytes);
+        std::vector<VertexSkin> decodedSkin(vertexCount);
+        PackSkin(packedSkin.data(), skin, vertexCount, format);
+        UnpackSkin(decodedSkin.data(), packedSkin.data(), vertexCount, format);
+
+        for (u32 i = 0; i < vertexCount; ++i)
+            for (int j = 0; j < 4; ++j)
+                report.weight = Max(report.weight, std::fabs(skin[i].weights[j] - decodedSkin[i].weights[j]));
+    }
+
+    return report;
+}
+
+// ============================================================================
+// INDICES 16 BITS
+// ============================================================================
+
+u32 MeshOptimizer::SplitIndices(std::vector<IndexSplit> &splits, const u32 *indices, u32 indexCount, u32 vertexCount,
+                                u32 maxVertices)
+{
+    splits.clear();
+    const u32 triangleCount = indexCount / 3;
+    if (triangleCount == 0 || maxVertices < 3)
+        return 0;
+
+    // local[v] so vale se stamp[v] for o grupo atual
+    std::vector<u32> local(vertexCount, 0);
+    std::vector<u32> stamp(vertexCount, ~0u);
+
+    splits.emplace_back();
+    for (u32 t = 0; t < triangleCount; ++t)
+    {
+        const u32 *tri = indices + t * 3;
+
+        u32 added = 0;
+        for (u32 k = 0; k < 3; ++k)
+        {
+            const u32 group = (u32)splits.size() - 1;
+            if (stamp[tri[k]] != group && (k < 1 || tri[k] != tri[0]) && (k < 2 || tri[k] != tri[1]))
+                added++;
+        }
+
+        if (splits.back().vertices.size() + added > maxVertices)
+            splits.emplace_back();
+
+        IndexSplit &split = splits.back();
+        const u32 group = (u32)splits.size() - 1;
+        for (u32 k = 0; k < 3; ++k)
+        {
+            const u32 v = tri[k];
+            if (stamp[v] != group)
+            {
+                stamp[v] = group;
+                local[v] = (u32)split.vertices.size();
+                split.vertices.push_back(v);
+            }
+            split.indices.push_back(local[v]);
+        }
+    }
+
+    return (u32)splits.size();
+}
+
+// ============================================================================
+// ADJACENCIA E NORMAIS
+// ============================================================================
+
+void MeshOptimizer::BuildVertexAdjacency(VertexAdjacency &adjacency, const u32 *indices, u32 indexCount, u32 vertexCount)
+{
+    const u32 triangleCount = indexCount / 3;
+
+    adjacency.offsets.assign(vertexCount + 1, 0);
+    adjacency.faces.resize(triangleCount * 3);
+
+    for (u32 i = 0; i < triangleCount * 3; ++i)
+        adjacency.offsets[indices[i] + 1]++;
+    for (u32 v = 0; v < vertexCount; ++v)
+        adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+    std::vector<u32> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (u32 t = 0; t < triangleCount; ++t)
+        for (u32 k = 0; k < 3; ++k)
+            adjacency.faces[fill[indices[t * 3 + k]]++] = t;
+}
+
+namespace
+{
+    const u32 NORMAL_GRAIN = 4096;
+
+    inline Vec3 VertexPosition(const Vertex &v) { return Vec3(v.x, v.y, v.z); }
+}
+
+void MeshOptimizer::GenerateNormals(Vertex *vertices, u32 vertexCount, const u32 *indices, u32 indexCount,
+                                    const VertexAdjacency &adjacency, NormalWeighting weighting)
+{
+    const u32 triangleCount = indexCount / 3;
+    if (vertexCount == 0 || !adjacency.IsValid(vertexCount, triangleCount * 3))
+        return;
+
+    JobSystem &jobs = JobSystem::Instance();
+
+    // Normal de cada face; em AREA fica com o comprimento = 2x a area
+    std::vector<Vec3> faceNormals(triangleCount);
+    jobs.ParallelFor(triangleCount, NORMAL_GRAIN, [&](u32 begin, u32 end, u32)
+                     {
+        for (u32 t = begin; t < end; ++t)
+        {
+            const u32 *tri = indices + t * 3;
+            const Vec3 p0 = VertexPosition(vertices[tri[0]]);
+            Vec3 n = (VertexPosition(vertices[tri[1]]) - p0).cross(VertexPosition(vertices[tri[2]]) - p0);
+            if (weighting == NORMAL_WEIGHT_ANGLE)
+            {
+                const float len = n.length();
+                n = len > 0.0f ? n / len : Vec3(0.0f);
+            }
+            faceNormals[t] = n;
+        } });
+
+    // Gather: cada vertice soma as suas faces pela ordem da adjacencia
+    // (resultado igual com qualquer numero de threads)
+    jobs.ParallelFor(vertexCount, NORMAL_GRAIN, [&](u32 begin, u32 end, u32)
+                     {
+        for (u32 v = begin; v < end; ++v)
+        {
+            Vec3 sum(0.0f);
+            const u32 *faces = adjacency.GetFaces(v);
+            const u32 count = adjacency.GetFaceCount(v);
+
+            for (u32 j = 0; j < count; ++j)
+            {
+                const u32 t = faces[j];
+                if (weighting == NORMAL_WEIGHT_AREA)
+                {
+                    sum += faceNormals[t];
+                    continue;
+                }
+
+                // Canto do triangulo que e este vertice
+                const u32 *tri = indices + t * 3;
+                const u32 corner = tri[0] == v ? 0 : (tri[1] == v ? 1 : 2);
+                const Vec3 p = VertexPosition(vertices[v]);
+                Vec3 e1 = VertexPosition(vertices[tri[(corner + 1) % 3]]) - p;
+                Vec3 e2 = VertexPosition(vertices[tri[(corner + 2) % 3]]) - p;
+                const float l1 = e1.length();
+                const float l2 = e2.length();
+                if (l1 <= 0.0f || l2 <= 0.0f)
+                    continue;
+                const float angle = std::acos(Clamp(e1.dot(e2) / (l1 * l2), -1.0f, 1.0f));
+                sum += faceNormals[t] * angle;
+            }
+
+            const float len = sum.length();
+            if (len > 0.0f)
+                sum /= len;
+
+            vertices[v].nx = sum.x;
+            vertices[v].ny = sum.y;
+            vertices[v].nz = sum.z;
+        } });
+}
+
+// ============================================================================
+// TANGENTES
+// ============================================================================
+
+namespace
+{
+    const u32 TANGENT_GRAIN = 2048; // triangulos por bloco
+
+    Vec3 AnyPerpendicular(const Vec3 &n)
+    {
+        Vec3 axis = std::fabs(n.x) < 0.9f ? Vec3(1, 0, 0) : Vec3(0, 1, 0);
+        Vec3 t = axis - n * n.dot(axis);
+        float len = t.length();
+        return len > 0.0f ? t / len : Vec3(1, 0, 0);
+    }
+
+    Vec3 ProjectOnPlane(const Vec3 &v, const Vec3 &n)
+    {
+        return v - n * n.dot(v);
+    }
+
+    Vec3 SafeNormalize(const Vec3 &v)
+    {
+        float len = v.length();
+        return len > 1e-20f ? v / len : Vec3(0.0f);
+    }
+}
+
+void MeshOptimizer::GenerateTangents(std::vector<Vec4> &tangents, std::vector<u32> &duplicates, u32 *indices,
+                                     u32 indexCount, const Vertex *vertices, u32 vertexCount)
+{
+    duplicates.clear();
+    tangents.assign(vertexCount, Vec4(1.0f, 0.0f, 0.0f, 1.0f));
+    if (vertexCount == 0 || indexCount < 3)
+        return;
+
+    const u32 faceCount = indexCount / 3;
+    std::vector<s8> faceSign(faceCount, 0);
+
+    // xyz = tangente * angulo do canto, w = angulo; cada bloco de triangulos
+    // so escreve nos seus cantos (memoria O(indices), nao O(threads * vertices))
+    std::vector<Vec4> corners(faceCount * 3);
+
+    JobSystem &jobs = JobSystem::Instance();
+
+    // 1) Tangente de cada triangulo distribuida pelos cantos
+    jobs.ParallelFor(faceCount, TANGENT_GRAIN, [&](u32 begin, u32 end, u32)
+                     {
+        for (u32 f = begin; f < end; ++f)
+        {
+            const u32 *tri = indices + f * 3;
+            const Vertex &a = vertices[tri[0]];
+            const Vertex &b = vertices[tri[1]];
+            const Vertex &c = vertices[tri[2]];
+
+            const Vec3 p0(a.x, a.y, a.z);
+            const Vec3 d1 = Vec3(b.x, b.y, b.z) - p0;
+            const Vec3 d2 = Vec3(c.x, c.y, c.z) - p0;
+            const float t21x = b.u - a.u, t21y = b.v - a.v;
+            const float t31x = c.u - a.u, t31y = c.v - a.v;
+
+            const float signedArea = t21x * t31y - t21y * t31x;
+            Vec3 os = d1 * t31y - d2 * t21y;
+            if (signedArea == 0.0f || os.lengthSquared() == 0.0f)
+                continue; // UVs degenerados: fica com o que os vizinhos derem
+
+            const bool orientation = signedArea > 0.0f;
+            faceSign[f] = orientation ? 1 : -1;
+            os = os * (orientation ? 1.0f : -1.0f);
+
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                const Vertex &v = vertices[tri[corner]];
+                const Vertex &next = vertices[tri[(corner + 1) % 3]];
+                const Vertex &prev = vertices[tri[(corner + 2) % 3]];
+                const Vec3 n = SafeNormalize(Vec3(v.nx, v.ny, v.nz));
+                const Vec3 p(v.x, v.y, v.z);
+
+                const Vec3 t = SafeNormalize(ProjectOnPlane(os, n));
+                const Vec3 e1 = SafeNormalize(ProjectOnPlane(Vec3(next.x, next.y, next.z) - p, n));
+                const Vec3 e2 = SafeNormalize(ProjectOnPlane(Vec3(prev.x, prev.y, prev.z) - p, n));
+                const float angle = std::acos(Clamp(e1.dot(e2), -1.0f, 1.0f));
+
+                corners[f * 3 + corner] = Vec4(t * angle, angle);
+            }
+        } });
+
+    // 2) Cantos de cada vertice (CSR, pela ordem dos cantos)
+    std::vector<u32> offsets(vertexCount + 1, 0);
+    std::vector<u32> vertexCorners(faceCount * 3);
+    for (u32 i = 0; i < faceCount * 3; ++i)
+        offsets[indices[i] + 1]++;
+    for (u32 v = 0; v < vertexCount; ++v)
+        offsets[v + 1] += offsets[v];
+    {
+        std::vector<u32> fill(offsets.begin(), offsets.end() - 1);
+        for (u32 i = 0; i < faceCount * 3; ++i)
+            vertexCorners[fill[indices[i]]++] = i;
+    }
+
+    // 3) Grupos do Mikk: dois cantos do mesmo vertice juntam-se quando as
+    // faces partilham uma aresta que passa pelo vertice (percorrida em
+    // sentidos opostos, winding coerente) e tem a mesma orientacao UV.
+    // Cada grupo e um vertice de saida; os cantos de faces degeneradas
+    // ficam no grupo 0 (o vertice original). groupOf e indexado pela CSR
+    std::vector<u32> groupOf(faceCount * 3, 0);
+    std::vector<u32> groupCount(vertexCount, 1);
+    jobs.ParallelFor(vertexCount, TANGENT_GRAIN * 4, [&](u32 begin, u32 end, u32)
+                     {
+        std::vector<u32> parent;
+        std::vector<u32> ordinal;
+        std::vector<std::pair<u32, u32>> edges; // (outro vertice, canto local * 2 + 1 se a aresta entra)
+        auto root = [&parent](u32 i)
+        {
+            while (parent[i] != i)
+                i = parent[i] = parent[parent[i]];
+            return i;
+        };
+
+        for (u32 v = begin; v < end; ++v)
+        {
+            const u32 first = offsets[v];
+            const u32 count = offsets[v + 1] - first;
+            parent.resize(count);
+            edges.clear();
+            for (u32 i = 0; i < count; ++i)
+            {
+                parent[i] = i;
+                const u32 corner = vertexCorners[first + i];
+                const u32 face = corner / 3;
+                if (faceSign[face] == 0)
+                    continue;
+                const u32 c = corner % 3;
+                edges.push_back(std::make_pair(indices[face * 3 + (c + 1) % 3], i * 2));
+                edges.push_back(std::make_pair(indices[face * 3 + (c + 2) % 3], i * 2 + 1));
+            }
+            std::sort(edges.begin(), edges.end());
+
+            // Normalmente 2 entradas por aresta; nao-manifold pode ter mais
+            for (size_t a = 0; a < edges.size(); ++a)
+            {
+                for (size_t b = a + 1; b < edges.size() && edges[b].first == edges[a].first; ++b)
+                {
+                    const u32 i = edges[a].second >> 1, j = edges[b].second >> 1;
+                    if ((edges[a].second & 1) == (edges[b].second & 1) ||
+                        faceSign[vertexCorners[first + i] / 3] != faceSign[vertexCorners[first + j] / 3])
+                        continue;
+                    parent[root(i)] = root(j);
+                }
+            }
+
+            ordinal.assign(count, ~0u);
+            u32 groups = 0;
+            for (u32 i = 0; i < count; ++i)
+            {
+                if (faceSign[vertexCorners[first + i] / 3] == 0)
+                    continue;
+                u32 &group = ordinal[root(i)];
+                if (group == ~0u)
+                    group = groups++;
+                groupOf[first + i] = group;
+            }
+            groupCount[v] = std::max(groups, 1u);
+        } });
+
+    // Grupo 0 fica no vertice; os outros vao para copias no fim
+    std::vector<u32> firstCopy(vertexCount);
+    for (u32 v = 0; v < vertexCount; ++v)
+    {
+        firstCopy[v] = vertexCount + (u32)duplicates.size();
+        for (u32 g = 1; g < groupCount[v]; ++g)
+            duplicates.push_back(v);
+    }
+
+    // 4) Soma por grupo, reescreve os cantos das copias e normaliza; sem
+    // contribuicoes fica um vetor qualquer perpendicular a normal. Cada
+    // vertice so escreve nos seus cantos e nas suas copias
+    tangents.resize(vertexCount + duplicates.size());
+    auto resolve = [&](u32 source, const Vec4 &sum, float sign) -> Vec4
+    {
+        const Vertex &v = vertices[source];
+        const Vec3 n = SafeNormalize(Vec3(v.nx, v.ny, v.nz));
+        Vec3 t = SafeNormalize(Vec3(sum.x, sum.y, sum.z));
+        if (t.lengthSquared() == 0.0f)
+            t = AnyPerpendicular(n.lengthSquared() > 0.0f ? n : Vec3(0, 0, 1));
+        return Vec4(t, sign);
+    };
+
+    jobs.ParallelFor(vertexCount, TANGENT_GRAIN * 4, [&](u32 begin, u32 end, u32)
+                     {
+        std::vector<Vec4> sums;
+        std::vector<s8> signs;
+        for (u32 v = begin; v < end; ++v)
+        {
+            const u32 groups = groupCount[v];
+            sums.assign(groups, Vec4());
+            signs.assign(groups, 1);
+            for (u32 k = offsets[v]; k < offsets[v + 1]; ++k)
+            {
+                const u32 corner = vertexCorners[k];
+                const s8 sign = faceSign[corner / 3];
+                if (sign == 0)
+                    continue;
+                const u32 g = groupOf[k];
+                sums[g] += corners[corner];
+                signs[g] = sign;
+                if (g > 0)
+                    indices[corner] = firstCopy[v] + g - 1;
+            }
+
+            for (u32 g = 0; g < groups; ++g)
+                tangents[g == 0 ? v : firstCopy[v] + g - 1] = resolve(v, sums[g], (float)signs[g]);
+        } });
+}
@@ -0,0 +1,157 @@
+#include "pch.h"
+#include "Mesh.hpp"
+#include "Utils.hpp"
+#include <atomic>
+
+namespace
+{
+    // Partilhado por todas as instancias: duas poses nunca tem a mesma versao
+    std::atomic<u32> g_instancePoseVersion{0};
+}
+
+SkeletonInstance::SkeletonInstance(const Mesh *mesh) : m_mesh(mesh)
+{
+    Resize();
+}
+
+SkeletonInstance::~SkeletonInstance()
+{
+    ReleaseOutputs();
+}
+
+SkinnedOutput *SkeletonInstance::GetOutput(const MeshBuffer *buffer) const
+{
+    // Um buffer apagado pode ter deixado o endereco a um buffer novo
+    if (!m_mesh || m_outputGeneration != m_mesh->m_bufferGeneration)
+        return nullptr;
+
+    auto it = m_outputs.find(buffer);
+    return it != m_outputs.end() ? it->second : nullptr;
+}
+
+SkinnedOutput *SkeletonInstance::AcquireOutput(const MeshBuffer *buffer)
+{
+    if (m_mesh && m_outputGeneration != m_mesh->m_bufferGeneration)
+    {
+        ReleaseOutputs();
+        m_outputGeneration = m_mesh->m_bufferGeneration;
+    }
+
+    SkinnedOutput *&output = m_outputs[buffer];
+    if (!output)
+        output = new SkinnedOutput();
+    return output;
+}
+
+void SkeletonInstance::ReleaseOutputs()
+{
+    for (auto &entry : m_outputs)
+        delete entry.second;
+    m_outputs.clear();
+}
+
+void SkeletonInstance::Resize()
+{
+    const u32 count = m_mesh ? (u32)m_mesh->m_bones.size() : 0;
+    m_positions.assign(count, Vec3(0.0f, 0.0f, 0.0f));
+    m_rotations.assign(count, Quat());
+    m_animated.assign(count, 0);
+    m_globals.assign(count, Mat4::Identity());
+    m_palette.resize(count);
+    MarkPoseDirty();
+}
+
+void SkeletonInstance::SetBoneTransform(u32 index, const Vec3 &position, const Quat &rotation)
+{
+    if (index >= m_positions.size())
+        return;
+
+    if (m_animated[index] && m_positions[index] == position && m_rotations[index] == rotation)
+        return;
+
+    m_positions[index] = position;
+    m_rotations[index] = rotation;
+    m_animated[index] = 1;
+    MarkBoneDirty(index);
+}
+
+void SkeletonInstance::SetBoneStatic(u32 index)
+{
+    if (index >= m_animated.size() || !m_animated[index])
+        return;
+
+    m_animated[index] = 0;
+    MarkBoneDirty(index);
+}
+
+void SkeletonInstance::ResetBones()
+{
+    for (u32 i = 0; i < m_animated.size(); i++)
+        SetBoneStatic(i);
+}
+
+void SkeletonInstance::MarkPoseDirty()
+{
+    m_boneDirty.assign(m_positions.size(), 1);
+    m_poseDirty = true;
+}
+
+void SkeletonInstance::MarkBoneDirty(u32 index)
+{
+    m_boneDirty[index] = 1;
+    m_poseDirty = true;
+}
+
+void SkeletonInstance::UpdateBonePalette()
+{
+    if (!m_mesh)
+        return;
+
+    // O rig mudou (bones novos ou recarregados)
+    if (m_positions.size() != m_mesh->m_bones.size())
+        Resize();
+    // O rig e partilhado e so se le: a ordem e do load/CalculateBoneMatrices
+    if (m_mesh->m_boneOrder.size() != m_mesh->m_bones.size())
+    {
+        LogWarning("[SkeletonInstance] Bone order is stale, call CalculateBoneMatrices after editing the rig");
+        return;
+    }
+
+    if (!m_poseDirty)
+        return;
+
+    // Mesma ordem e propagacao do Mesh::UpdateBonePalette; do rig so se le
+    // a hierarquia, a localPose e a inverseBindPose
+    const std::vector<Bone *> &bones = m_mesh->m_bones;
+    for (u32 index : m_mesh->m_boneOrder)
+    {
+        const Bone *bone = bones[index];
+        if (bone->parent && m_boneDirty[bone->parentIndex])
+            m_boneDirty[index] = 1;
+        if (!m_boneDirty[index])
+            continue;
+
+        const Mat4 local = m_animated[index]
+                               ? Mat4::Translation(m_positions[index]) * m_rotations[index].toMat4()
+                               : bone->localPose;
+        m_globals[index] = bone->parent ? m_globals[bone->parentIndex] * local : local;
+        const Mat4 matrix = m_globals[index] * bone->inverseBindPose;
+        Skinning::ToAffine(&m_palette[index], &matrix, 1);
+    }
+
+    std::fill(m_boneDirty.begin(), m_boneDirty.end(), 0);
+    m_poseDirty = false;
+    m_poseVersion = ++g_instancePoseVersion;
+}
+
+size_t SkeletonInstance::GetMemorySize() const
+{
+    size_t outputs = 0;
+    for (const auto &entry : m_outputs)
+    {
+        outputs += sizeof(SkinnedOutput) + entry.second->gpuBytes;
+    }
+    return sizeof(SkeletonInstance) + m_positions.capacity() * sizeof(Vec3) + m_rotations.capacity() * sizeof(Quat) +
+           m_animated.capacity() + m_boneDirty.capacity() + m_globals.capacity() * sizeof(Mat4) +
+           m_palette.capacity() * sizeof(Skinning::AffineMatrix) + outputs;
+}
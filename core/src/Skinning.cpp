@@ -0,0 +1,470 @@
+#include "pch.h"
+#include "Skinning.hpp"
+#include "Mesh.hpp"
+#include "Jobs.hpp"
+#include <cfloat>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SKINNING_AVX 1
+#endif
+
+#if defined(__SSE3__)
+#include <pmmintrin.h>
+#define SKINNING_SSE 1
+#endif
+
+void Skinning::ToAffine(AffineMatrix *destination, const Mat4 *matrices, u32 count)
+{
+    for (u32 i = 0; i < count; ++i)
+    {
+        for (int row = 0; row < 3; ++row)
+            for (int col = 0; col < 4; ++col)
+                destination[i].m[row * 4 + col] = matrices[i](row, col);
+    }
+}
+
+// ============================================================================
+// ESCALAR
+// ============================================================================
+
+namespace
+{
+    // Mistura as 4 matrizes do vertice; ids invalidos pesam zero
+    inline void BlendScalar(const Skinning::AffineMatrix *bones, u32 boneCount, const VertexSkin &skin, float out[12])
+    {
+        for (int k = 0; k < 12; ++k)
+            out[k] = 0.0f;
+
+        for (int j = 0; j < 4; ++j)
+        {
+            const u32 id = skin.boneIDs[j];
+            const bool valid = id < boneCount;
+            const float weight = valid ? skin.weights[j] : 0.0f;
+            const float *m = bones[valid ? id : 0].m;
+            for (int k = 0; k < 12; ++k)
+                out[k] += weight * m[k];
+        }
+    }
+
+    inline Vec3 TransformPointScalar(const float m[12], float x, float y, float z)
+    {
+        return Vec3(m[0] * x + m[1] * y + m[2] * z + m[3],
+                    m[4] * x + m[5] * y + m[6] * z + m[7],
+                    m[8] * x + m[9] * y + m[10] * z + m[11]);
+    }
+
+    inline Vec3 TransformVectorScalar(const float m[12], float x, float y, float z)
+    {
+        return Vec3(m[0] * x + m[1] * y + m[2] * z,
+                    m[4] * x + m[5] * y + m[6] * z,
+                    m[8] * x + m[9] * y + m[10] * z);
+    }
+
+    inline Vec3 NormalizeOrZero(const Vec3 &v)
+    {
+        const float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+        return length > 0.0f ? v / length : v;
+    }
+
+    inline BoundingBox EmptyBounds()
+    {
+        return BoundingBox(Vec3(FLT_MAX), Vec3(-FLT_MAX));
+    }
+}
+
+BoundingBox Skinning::SkinVerticesScalar(Vertex *destination, const Vertex *vertices, const VertexSkin *skin,
+                                         u32 vertexCount, const AffineMatrix *bones, u32 boneCount,
+                                         Vec4 *destinationTangents, const Vec4 *tangents)
+{
+    if (vertexCount == 0 || boneCount == 0)
+        return BoundingBox();
+
+    const bool hasTangents = destinationTangents && tangents;
+    BoundingBox bounds = EmptyBounds();
+
+    float m[12];
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        const Vertex &source = vertices[i];
+        BlendScalar(bones, boneCount, skin[i], m);
+
+        const Vec3 position = TransformPointScalar(m, source.x, source.y, source.z);
+        const Vec3 normal = NormalizeOrZero(TransformVectorScalar(m, source.nx, source.ny, source.nz));
+
+        if (hasTangents)
+        {
+            const Vec4 &t = tangents[i];
+            destinationTangents[i] = Vec4(NormalizeOrZero(TransformVectorScalar(m, t.x, t.y, t.z)), t.w);
+        }
+
+        bounds.min = Vec3::Min(bounds.min, position);
+        bounds.max = Vec3::Max(bounds.max, position);
+
+        Vertex &out = destination[i];
+        out.u = source.u;
+        out.v = source.v;
+        out.x = position.x;
+        out.y = position.y;
+        out.z = position.z;
+        out.nx = normal.x;
+        out.ny = normal.y;
+        out.nz = normal.z;
+    }
+
+    return bounds;
+}
+
+BoundingBox Skinning::SkinPositionsScalar(Vertex *destination, const Vertex *vertices, const VertexSkin *skin,
+                                          u32 vertexCount, const AffineMatrix *bones, u32 boneCount)
+{
+    if (vertexCount == 0 || boneCount == 0)
+        return BoundingBox();
+
+    BoundingBox bounds = EmptyBounds();
+
+    float m[12];
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        BlendScalar(bones, boneCount, skin[i], m);
+        const Vec3 position = TransformPointScalar(m, vertices[i].x, vertices[i].y, vertices[i].z);
+
+        bounds.min = Vec3::Min(bounds.min, position);
+        bounds.max = Vec3::Max(bounds.max, position);
+
+        destination[i].x = position.x;
+        destination[i].y = position.y;
+        destination[i].z = position.z;
+    }
+
+    return bounds;
+}
+
+// ============================================================================
+// SSE3 / AVX
+// Cada vertice (ou cada lane de 128 bits no AVX) guarda as 3 linhas da
+// matriz misturada; o produto com (x, y, z, 1) sai com dois hadd.
+// ============================================================================
+
+#ifdef SKINNING_SSE
+
+namespace
+{
+    inline __m128 MaskXYZ()
+    {
+        return _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    }
+
+    // (x, y, z, 1)
+    inline __m128 LoadPoint(const float *xyz)
+    {
+        return _mm_or_ps(_mm_and_ps(_mm_loadu_ps(xyz), MaskXYZ()), _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f));
+    }
+
+    // (x, y, z, 0)
+    inline __m128 LoadDirection(const float *xyz)
+    {
+        return _mm_and_ps(_mm_loadu_ps(xyz), MaskXYZ());
+    }
+
+    inline void BlendSse(const Skinning::AffineMatrix *bones, u32 boneCount, const VertexSkin &skin,
+                         __m128 &r0, __m128 &r1, __m128 &r2)
+    {
+        r0 = r1 = r2 = _mm_setzero_ps();
+        for (int j = 0; j < 4; ++j)
+        {
+            const u32 id = skin.boneIDs[j];
+            const bool valid = id < boneCount;
+            const __m128 weight = _mm_set1_ps(valid ? skin.weights[j] : 0.0f);
+            const float *m = bones[valid ? id : 0].m;
+            r0 = _mm_add_ps(r0, _mm_mul_ps(weight, _mm_load_ps(m)));
+            r1 = _mm_add_ps(r1, _mm_mul_ps(weight, _mm_load_ps(m + 4)));
+            r2 = _mm_add_ps(r2, _mm_mul_ps(weight, _mm_load_ps(m + 8)));
+        }
+    }
+
+    // (dot(r0, v), dot(r1, v), dot(r2, v), 0)
+    inline __m128 TransformSse(__m128 r0, __m128 r1, __m128 r2, __m128 v)
+    {
+        const __m128 xy = _mm_hadd_ps(_mm_mul_ps(r0, v), _mm_mul_ps(r1, v));
+        const __m128 z = _mm_hadd_ps(_mm_mul_ps(r2, v), _mm_setzero_ps());
+        return _mm_hadd_ps(xy, z);
+    }
+
+    inline __m128 NormalizeSse(__m128 v)
+    {
+        __m128 lengthSq = _mm_mul_ps(v, v);
+        lengthSq = _mm_hadd_ps(lengthSq, lengthSq);
+        lengthSq = _mm_hadd_ps(lengthSq, lengthSq);
+        const __m128 length = _mm_sqrt_ps(lengthSq);
+        const __m128 nonZero = _mm_cmpgt_ps(length, _mm_setzero_ps());
+        return _mm_or_ps(_mm_and_ps(nonZero, _mm_div_ps(v, length)), _mm_andnot_ps(nonZero, v));
+    }
+
+    // Escreve x..nz e copia u, v (pode ser o mesmo vertice que a origem)
+    inline void StoreVertex(Vertex &destination, const Vertex &source, __m128 position, __m128 normal)
+    {
+        const __m128 zx = _mm_shuffle_ps(position, normal, _MM_SHUFFLE(0, 0, 2, 2)); // pz pz nx nx
+        const __m128 low = _mm_shuffle_ps(position, zx, _MM_SHUFFLE(2, 0, 1, 0));    // px py pz nx
+        const __m128 uv = _mm_castpd_ps(_mm_load_sd((const double *)&source.u));    // u v 0 0
+        const __m128 high = _mm_shuffle_ps(normal, uv, _MM_SHUFFLE(1, 0, 2, 1));     // ny nz u v
+        _mm_storeu_ps(&destination.x, low);
+        _mm_storeu_ps(&destination.ny, high);
+    }
+
+    inline void StorePosition(Vertex &destination, __m128 position)
+    {
+        _mm_storel_pi((__m64 *)&destination.x, position);
+        _mm_store_ss(&destination.z, _mm_movehl_ps(position, position));
+    }
+
+    inline void StoreTangent(Vec4 &destination, const Vec4 &source, __m128 tangent)
+    {
+        const __m128 mask = MaskXYZ();
+        _mm_storeu_ps(&destination.x, _mm_or_ps(_mm_and_ps(mask, tangent), _mm_andnot_ps(mask, _mm_loadu_ps(&source.x))));
+    }
+
+    inline BoundingBox ToBounds(__m128 minimum, __m128 maximum)
+    {
+        alignas(16) float low[4], high[4];
+        _mm_store_ps(low, minimum);
+        _mm_store_ps(high, maximum);
+        return BoundingBox(Vec3(low[0], low[1], low[2]), Vec3(high[0], high[1], high[2]));
+    }
+
+    template <bool POSITION_ONLY>
+    inline void SkinOneSse(Vertex *destination, const Vertex *vertices, const VertexSkin *skin, u32 i,
+                           const Skinning::AffineMatrix *bones, u32 boneCount, Vec4 *destinationTangents,
+                           const Vec4 *tangents, __m128 &minimum, __m128 &maximum)
+    {
+        __m128 r0, r1, r2;
+        BlendSse(bones, boneCount, skin[i], r0, r1, r2);
+
+        const __m128 position = TransformSse(r0, r1, r2, LoadPoint(&vertices[i].x));
+        minimum = _mm_min_ps(minimum, position);
+        maximum = _mm_max_ps(maximum, position);
+
+        if (POSITION_ONLY)
+        {
+            StorePosition(destination[i], position);
+            return;
+        }
+
+        if (tangents)
+        {
+            const __m128 tangent = NormalizeSse(TransformSse(r0, r1, r2, LoadDirection(&tangents[i].x)));
+            StoreTangent(destinationTangents[i], tangents[i], tangent);
+        }
+
+        const __m128 normal = NormalizeSse(TransformSse(r0, r1, r2, LoadDirection(&vertices[i].nx)));
+        StoreVertex(destination[i], vertices[i], position, normal);
+    }
+
+#ifdef SKINNING_AVX
+    inline __m256 Pair(__m128 low, __m128 high)
+    {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+    }
+
+    inline __m128 Low(__m256 v) { return _mm256_castps256_ps128(v); }
+    inline __m128 High(__m256 v) { return _mm256_extractf128_ps(v, 1); }
+
+    inline void BlendAvx(const Skinning::AffineMatrix *bones, u32 boneCount, const VertexSkin &a, const VertexSkin &b,
+                         __m256 &r0, __m256 &r1, __m256 &r2)
+    {
+        r0 = r1 = r2 = _mm256_setzero_ps();
+        for (int j = 0; j < 4; ++j)
+        {
+            const u32 idA = a.boneIDs[j];
+            const u32 idB = b.boneIDs[j];
+            const bool validA = idA < boneCount;
+            const bool validB = idB < boneCount;
+            const float weightA = validA ? a.weights[j] : 0.0f;
+            const float weightB = validB ? b.weights[j] : 0.0f;
+            const __m256 weight = _mm256_setr_ps(weightA, weightA, weightA, weightA, weightB, weightB, weightB, weightB);
+            const float *ma = bones[validA ? idA : 0].m;
+            const float *mb = bones[validB ? idB : 0].m;
+            r0 = _mm256_add_ps(r0, _mm256_mul_ps(weight, Pair(_mm_load_ps(ma), _mm_load_ps(mb))));
+            r1 = _mm256_add_ps(r1, _mm256_mul_ps(weight, Pair(_mm_load_ps(ma + 4), _mm_load_ps(mb + 4))));
+            r2 = _mm256_add_ps(r2, _mm256_mul_ps(weight, Pair(_mm_load_ps(ma + 8), _mm_load_ps(mb + 8))));
+        }
+    }
+
+    // hadd do AVX trabalha dentro de cada lane de 128 bits: um vertice por lane
+    inline __m256 TransformAvx(__m256 r0, __m256 r1, __m256 r2, __m256 v)
+    {
+        const __m256 xy = _mm256_hadd_ps(_mm256_mul_ps(r0, v), _mm256_mul_ps(r1, v));
+        const __m256 z = _mm256_hadd_ps(_mm256_mul_ps(r2, v), _mm256_setzero_ps());
+        return _mm256_hadd_ps(xy, z);
+    }
+
+    inline __m256 NormalizeAvx(__m256 v)
+    {
+        __m256 lengthSq = _mm256_mul_ps(v, v);
+        lengthSq = _mm256_hadd_ps(lengthSq, lengthSq);
+        lengthSq = _mm256_hadd_ps(lengthSq, lengthSq);
+        const __m256 length = _mm256_sqrt_ps(lengthSq);
+        const __m256 nonZero = _mm256_cmp_ps(length, _mm256_setzero_ps(), _CMP_GT_OQ);
+        return _mm256_blendv_ps(v, _mm256_div_ps(v, length), nonZero);
+    }
+
+    template <bool POSITION_ONLY>
+    inline void SkinPairAvx(Vertex *destination, const Vertex *vertices, const VertexSkin *skin, u32 i,
+                            const Skinning::AffineMatrix *bones, u32 boneCount, Vec4 *destinationTangents,
+                            const Vec4 *tangents, __m128 &minimum, __m128 &maximum)
+    {
+        __m256 r0, r1, r2;
+        BlendAvx(bones, boneCount, skin[i], skin[i + 1], r0, r1, r2);
+
+        const __m256 position = TransformAvx(r0, r1, r2, Pair(LoadPoint(&vertices[i].x), LoadPoint(&vertices[i + 1].x)));
+        minimum = _mm_min_ps(minimum, _mm_min_ps(Low(position), High(position)));
+        maximum = _mm_max_ps(maximum, _mm_max_ps(Low(position), High(position)));
+
+        if (POSITION_ONLY)
+        {
+            StorePosition(destination[i], Low(position));
+            StorePosition(destination[i + 1], High(position));
+            return;
+        }
+
+        if (tangents)
+        {
+            const __m256 tangent = NormalizeAvx(TransformAvx(
+                r0, r1, r2, Pair(LoadDirection(&tangents[i].x), LoadDirection(&tangents[i + 1].x))));
+            StoreTangent(destinationTangents[i], tangents[i], Low(tangent));
+            StoreTangent(destinationTangents[i + 1], tangents[i + 1], High(tangent));
+        }
+
+        const __m256 normal = NormalizeAvx(TransformAvx(
+            r0, r1, r2, Pair(LoadDirection(&vertices[i].nx), LoadDirection(&vertices[i + 1].nx))));
+        StoreVertex(destination[i], vertices[i], Low(position), Low(normal));
+        StoreVertex(destination[i + 1], vertices[i + 1], High(position), High(normal));
+    }
+#endif
+
+    template <bool POSITION_ONLY>
+    BoundingBox SkinSimd(Vertex *destination, const Vertex *vertices, const VertexSkin *skin, u32 vertexCount,
+                         const Skinning::AffineMatrix *bones, u32 boneCount, Vec4 *destinationTangents,
+                         const Vec4 *tangents)
+    {
+        if (vertexCount == 0 || boneCount == 0)
+            return BoundingBox();
+
+        if (!destinationTangents)
+            tangents = nullptr;
+
+        __m128 minimum = _mm_set1_ps(FLT_MAX);
+        __m128 maximum = _mm_set1_ps(-FLT_MAX);
+
+        u32 i = 0;
+#ifdef SKINNING_AVX
+        for (; i + 2 <= vertexCount; i += 2)
+            SkinPairAvx<POSITION_ONLY>(destination, vertices, skin, i, bones, boneCount, destinationTangents, tangents,
+                                       minimum, maximum);
+#endif
+        for (; i < vertexCount; ++i)
+            SkinOneSse<POSITION_ONLY>(destination, vertices, skin, i, bones, boneCount, destinationTangents, tangents,
+                                      minimum, maximum);
+
+        return ToBounds(minimum, maximum);
+    }
+}
+
+#endif
+
+BoundingBox Skinning::SkinVertices(Vertex *destination, const Vertex *vertices, const VertexSkin *skin,
+                                   u32 vertexCount, const AffineMatrix *bones, u32 boneCount,
+                                   Vec4 *destinationTangents, const Vec4 *tangents)
+{
+#ifdef SKINNING_SSE
+    return SkinSimd<false>(destination, vertices, skin, vertexCount, bones, boneCount, destinationTangents, tangents);
+#else
+    return SkinVerticesScalar(destination, vertices, skin, vertexCount, bones, boneCount, destinationTangents, tangents);
+#endif
+}
+
+BoundingBox Skinning::SkinPositions(Vertex *destination, const Vertex *vertices, const VertexSkin *skin,
+                                    u32 vertexCount, const AffineMatrix *bones, u32 boneCount)
+{
+#ifdef SKINNING_SSE
+    return SkinSimd<true>(destination, vertices, skin, vertexCount, bones, boneCount, nullptr, nullptr);
+#else
+    return SkinPositionsScalar(destination, vertices, skin, vertexCount, bones, boneCount);
+#endif
+}
+
+// ============================================================================
+// JOBS
+// ============================================================================
+
+namespace
+{
+    struct SkinningRange
+    {
+        u32 job;
+        u32 begin;
+        u32 end;
+        BoundingBox bounds;
+    };
+
+    BoundingBox SkinRange(const Skinning::SkinningJob &job, u32 begin, u32 end)
+    {
+        const u32 count = end - begin;
+        if (job.mode == Skinning::SKIN_POSITION_ONLY)
+            return Skinning::SkinPositions(job.destination + begin, job.vertices + begin, job.skin + begin, count,
+                                           job.bones, job.boneCount);
+
+        const bool tangents = job.destinationTangents && job.tangents;
+        return Skinning::SkinVertices(job.destination + begin, job.vertices + begin, job.skin + begin, count,
+                                      job.bones, job.boneCount, tangents ? job.destinationTangents + begin : nullptr,
+                                      tangents ? job.tangents + begin : nullptr);
+    }
+}
+
+void Skinning::RunJobs(SkinningJob *jobs, u32 count, u32 grain)
+{
+    if (grain == 0)
+        grain = SKINNING_GRAIN;
+
+    std::vector<SkinningRange> ranges;
+    for (u32 j = 0; j < count; ++j)
+    {
+        jobs[j].bounds = BoundingBox();
+        for (u32 begin = 0; begin < jobs[j].vertexCount; begin += grain)
+        {
+            const u32 end = begin + grain < jobs[j].vertexCount ? begin + grain : jobs[j].vertexCount;
+            ranges.push_back({j, begin, end, BoundingBox()});
+        }
+    }
+
+    // Cada bloco escreve so nos seus vertices, sem locks
+    JobSystem::Instance().ParallelFor((u32)ranges.size(), 1, [&](u32 begin, u32 end, u32)
+                                      {
+                                          for (u32 r = begin; r < end; ++r)
+                                              ranges[r].bounds = SkinRange(jobs[ranges[r].job], ranges[r].begin, ranges[r].end);
+                                      });
+
+    // Os blocos de cada job sao contiguos e vem por ordem
+    for (size_t r = 0; r < ranges.size(); ++r)
+    {
+        SkinningJob &job = jobs[ranges[r].job];
+        if (ranges[r].begin == 0)
+        {
+            job.bounds = ranges[r].bounds;
+            continue;
+        }
+        job.bounds.min = Vec3::Min(job.bounds.min, ranges[r].bounds.min);
+        job.bounds.max = Vec3::Max(job.bounds.max, ranges[r].bounds.max);
+    }
+}
+
+const char *Skinning::GetKernelName()
+{
+#ifdef SKINNING_AVX
+    return "AVX";
+#elif defined(SKINNING_SSE)
+    return "SSE3";
+#else
+    return "scalar";
+#endif
+}
@@ -133,6 +133,12 @@ bool Triangle::intersectRay(const Vec3 &rayOrigin, const Vec3 &rayDirection) con
     return intersectRay(rayOrigin, rayDirection, t, u, v);
 }
 
+bool Triangle::intersectRay(const Vec3 &rayOrigin, const Vec3 &rayDirection, float &outT) const
+{
+    float u, v;
+    return intersectRay(rayOrigin, rayDirection, outT, u, v);
+}
+
 Vec3 Triangle::closestPoint(const Vec3 &point) const
 {
     // Projetar ponto no plano do triângulo
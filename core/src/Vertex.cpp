@@ -63,14 +63,18 @@ u32 VertexElement::GetSize() const
         4,                 // VET_COLOR
         sizeof(short) * 2, // VET_SHORT2
         sizeof(short) * 4, // VET_SHORT4
-        4                  // VET_UBYTE4
+        4,                 // VET_UBYTE4
+        sizeof(short) * 2, // VET_SHORT2N
+        sizeof(short) * 4, // VET_SHORT4N
+        sizeof(short) * 2, // VET_HALF2
+        sizeof(short) * 4  // VET_HALF4
     };
     return sizes[type];
 }
 
 u32 VertexElement::GetComponentCount() const
 {
-    static const u32 counts[] = {1, 2, 3, 4, 4, 2, 4, 4};
+    static const u32 counts[] = {1, 2, 3, 4, 4, 2, 4, 4, 2, 4, 2, 4};
     return counts[type];
 }
 
@@ -88,7 +92,12 @@ u32 VertexElement::GetType() const
         return GL_UNSIGNED_BYTE;
     case VET_SHORT2:
     case VET_SHORT4:
+    case VET_SHORT2N:
+    case VET_SHORT4N:
         return GL_SHORT;
+    case VET_HALF2:
+    case VET_HALF4:
+        return GL_HALF_FLOAT;
     default:
         return GL_FLOAT;
     }
@@ -96,7 +105,7 @@ u32 VertexElement::GetType() const
 
 bool VertexElement::ShouldNormalize() const
 {
-    return type == VET_COLOR || type == VET_UBYTE4;
+    return type == VET_COLOR || type == VET_UBYTE4 || type == VET_SHORT2N || type == VET_SHORT4N;
 }
 
 // ============================================================================
@@ -350,6 +359,7 @@ VertexArray::VertexArray()
     : m_vao(0)
     , m_vertexDeclaration(nullptr)
     , m_indexBuffer(nullptr)
+    , m_ownsIndexBuffer(true)
     , m_isBuilt(false)
     , m_needsRebuild(false)
 {
@@ -380,14 +390,26 @@ IndexBuffer* VertexArray::CreateIndexBuffer(u32 iCount, bool dynamic, bool use16
 {
     if (m_indexBuffer)
     {
-        delete m_indexBuffer;
+        if (m_ownsIndexBuffer)
+            delete m_indexBuffer;
         m_needsRebuild = true;
     }
 
     m_indexBuffer = new IndexBuffer(iCount, dynamic, use16Bit);
+    m_ownsIndexBuffer = true;
     return m_indexBuffer;
 }
 
+void VertexArray::ShareIndexBuffer(IndexBuffer *indexBuffer)
+{
+    if (m_indexBuffer && m_ownsIndexBuffer)
+        delete m_indexBuffer;
+
+    m_indexBuffer = indexBuffer;
+    m_ownsIndexBuffer = false;
+    m_needsRebuild = true;
+}
+
 void VertexArray::Release()
 {
     if (!IsValid())
@@ -407,7 +429,8 @@ void VertexArray::Release()
     }
 
     delete m_vertexDeclaration;
-    delete m_indexBuffer;
+    if (m_ownsIndexBuffer)
+        delete m_indexBuffer;
 }
 
 void VertexArray::Build()
@@ -519,6 +542,11 @@ void VertexArray::ensureBuilt() const
 }
 
 void VertexArray::Render(PrimitiveType type, u32 count) const
+{
+    RenderRange(type, 0, count);
+}
+
+void VertexArray::RenderRange(PrimitiveType type, u32 first, u32 count) const
 {
     if (!IsValid() || m_vertexBuffers.empty() || count == 0)
     {
@@ -549,12 +577,13 @@ void VertexArray::Render(PrimitiveType type, u32 count) const
     if (m_indexBuffer && m_indexBuffer->IsValid())
     {
         const GLenum idxType = m_indexBuffer->GetIndexType();
-        Driver::Instance().DrawElements(glMode, count, idxType, nullptr);
+        const size_t indexSize = idxType == GL_UNSIGNED_SHORT ? sizeof(u16) : sizeof(u32);
+        Driver::Instance().DrawElements(glMode, count, idxType, (const void *)(first * indexSize));
         //CHECK_GL_ERROR(glDrawElements(glMode, count, idxType, nullptr));
     }
     else
     {
-        Driver::Instance().DrawArrays(glMode, 0, count);
+        Driver::Instance().DrawArrays(glMode, first, count);
         //CHECK_GL_ERROR(glDrawArrays(glMode, 0, count));
     }
 
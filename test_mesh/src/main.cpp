@@ -0,0 +1,4009 @@
+#include "Core.hpp"
+#include "MeshOptimizer.hpp"
+#include "Jobs.hpp"
+#include "Skinning.hpp"
+#include "Frustum.hpp"
+#include "Collision.hpp"
+
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <map>
+#include <iterator>
+
+#define TEST(name)                             \
+    std::cout << "Testing " << name << "... "; \
+    TestsPassed++
+#define ASSERT_EQ(a, b)                                                                \
+    if ((a) != (b))                                                                    \
+    {                                                                                  \
+        std::cout << "FAILED\n  Expected: " << (b) << "\n  Got: " << (a) << std::endl; \
+        TestsFailed++;                                                                 \
+    }                                                                                  \
+    else                                                                               \
+    {                                                                                  \
+        std::cout << "OK" << std::endl;                                                \
+    }
+#define ASSERT_NEAR(a, b, eps)                                                         \
+    if (fabs((a) - (b)) > (eps))                                                       \
+    {                                                                                  \
+        std::cout << "FAILED\n  Expected: " << (b) << "\n  Got: " << (a) << std::endl; \
+        TestsFailed++;                                                                 \
+    }                                                                                  \
+    else                                                                               \
+    {                                                                                  \
+        std::cout << "OK" << std::endl;                                                \
+    }
+#define ASSERT_TRUE(cond)                   \
+    if (!(cond))                            \
+    {                                       \
+        std::cout << "FAILED" << std::endl; \
+        TestsFailed++;                      \
+    }                                       \
+    else                                    \
+    {                                       \
+        std::cout << "OK" << std::endl;     \
+    }
+
+int TestsPassed = 0;
+int TestsFailed = 0;
+
+class Timer
+{
+public:
+    Timer() : m_start(std::chrono::high_resolution_clock::now()) {}
+
+    double Elapsed() const
+    {
+        auto now = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(now - m_start).count();
+    }
+
+private:
+    std::chrono::high_resolution_clock::time_point m_start;
+};
+
+// ============================================================================
+// GL NULO
+// Os testes correm sem contexto, mas o MeshBuffer cria o VAO no construtor.
+// Sem GL carregado, as funcoes do Vertex.cpp passam a stubs que so dao
+// handles e contam os bytes vivos em buffers (a memoria de GPU nos testes)
+// ============================================================================
+
+namespace NullGL
+{
+    GLuint nextHandle = 0;
+    GLuint bound[2] = {0, 0}; // GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER
+    std::map<GLuint, size_t> sizes;
+
+    size_t LiveBytes()
+    {
+        size_t total = 0;
+        for (std::map<GLuint, size_t>::const_iterator it = sizes.begin(); it != sizes.end(); ++it)
+            total += it->second;
+        return total;
+    }
+
+    int Slot(GLenum target) { return target == GL_ELEMENT_ARRAY_BUFFER ? 1 : 0; }
+
+    void APIENTRY GenHandles(GLsizei n, GLuint *handles)
+    {
+        for (GLsizei i = 0; i < n; i++)
+            handles[i] = ++nextHandle;
+    }
+    void APIENTRY DeleteHandles(GLsizei n, const GLuint *handles)
+    {
+        for (GLsizei i = 0; i < n; i++)
+            sizes.erase(handles[i]);
+    }
+    void APIENTRY BindBuffer(GLenum target, GLuint handle) { bound[Slot(target)] = handle; }
+    void APIENTRY BufferData(GLenum target, GLsizeiptr size, const void *, GLenum)
+    {
+        if (bound[Slot(target)])
+            sizes[bound[Slot(target)]] = (size_t)size;
+    }
+    void APIENTRY BufferSubData(GLenum, GLintptr, GLsizeiptr, const void *) {}
+    void APIENTRY BindVertexArray(GLuint) {}
+    void APIENTRY GetIntegerv(GLenum, GLint *data) { *data = 16; }
+    GLenum APIENTRY GetError() { return GL_NO_ERROR; }
+    void APIENTRY VertexAttribArray(GLuint) {}
+    void APIENTRY VertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void *) {}
+    void APIENTRY VertexAttribIPointer(GLuint, GLint, GLenum, GLsizei, const void *) {}
+    void APIENTRY VertexAttribDivisor(GLuint, GLuint) {}
+    void APIENTRY DrawElements(GLenum, GLsizei, GLenum, const void *) {}
+    void APIENTRY DrawArrays(GLenum, GLint, GLsizei) {}
+    void APIENTRY DrawElementsInstanced(GLenum, GLsizei, GLenum, const void *, GLsizei) {}
+    void APIENTRY DrawArraysInstanced(GLenum, GLint, GLsizei, GLsizei) {}
+
+    // So instala se nao houver GL de verdade
+    void Install()
+    {
+        if (glad_glGenVertexArrays)
+            return;
+        glad_glGenVertexArrays = GenHandles;
+        glad_glDeleteVertexArrays = DeleteHandles;
+        glad_glBindVertexArray = BindVertexArray;
+        glad_glGenBuffers = GenHandles;
+        glad_glDeleteBuffers = DeleteHandles;
+        glad_glBindBuffer = BindBuffer;
+        glad_glBufferData = BufferData;
+        glad_glBufferSubData = BufferSubData;
+        glad_glGetIntegerv = GetIntegerv;
+        glad_glGetError = GetError;
+        glad_glEnableVertexAttribArray = VertexAttribArray;
+        glad_glDisableVertexAttribArray = VertexAttribArray;
+        glad_glVertexAttribPointer = VertexAttribPointer;
+        glad_glVertexAttribIPointer = VertexAttribIPointer;
+        glad_glVertexAttribDivisor = VertexAttribDivisor;
+        glad_glDrawElements = DrawElements;
+        glad_glDrawArrays = DrawArrays;
+        glad_glDrawElementsInstanced = DrawElementsInstanced;
+        glad_glDrawArraysInstanced = DrawArraysInstanced;
+    }
+}
+
+// Grelha de quads sem partilha de vertices (como um scan/export nao indexado)
+void BuildSoupGrid(int size, std::vector<Vertex> &vertices, std::vector<u32> &indices)
+{
+    vertices.clear();
+    indices.clear();
+
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            u32 base = (u32)vertices.size();
+            const int cx[4] = {x, x + 1, x + 1, x};
+            const int cy[4] = {y, y, y + 1, y + 1};
+            for (int i = 0; i < 4; i++)
+            {
+                float px = (float)cx[i];
+                float pz = (float)cy[i];
+                float py = std::sin(px * 0.1f) * std::cos(pz * 0.1f);
+                vertices.push_back({px, py, pz, 0, 1, 0, px / size, pz / size});
+            }
+            indices.push_back(base);
+            indices.push_back(base + 2);
+            indices.push_back(base + 1);
+            indices.push_back(base);
+            indices.push_back(base + 3);
+            indices.push_back(base + 2);
+        }
+    }
+}
+
+// Leitura minima do formato .mesh (so BUFF/VRTS/IDXS/SKIN), sem GL
+struct RawBuffer
+{
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    std::vector<VertexSkin> skin;
+};
+
+bool LoadRawMesh(const std::string &filename, std::vector<RawBuffer> &buffers)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+        return false;
+
+    auto readU32 = [&file]()
+    {
+        u32 v = 0;
+        file.read((char *)&v, 4);
+        return v;
+    };
+
+    if (readU32() != MESH_MAGIC)
+        return false;
+    const u32 version = readU32();
+
+    while (file)
+    {
+        u32 id = readU32();
+        u32 length = readU32();
+        if (!file)
+            break;
+        std::streamoff end = (std::streamoff)file.tellg() + length;
+
+        if (id == CHUNK_BUFF)
+        {
+            RawBuffer buffer;
+            readU32(); // material
+            readU32(); // flags
+            while (file && file.tellg() < end)
+            {
+                u32 subId = readU32();
+                u32 subLength = readU32();
+                std::streamoff subEnd = (std::streamoff)file.tellg() + subLength;
+                u32 count = readU32();
+                if (subId == CHUNK_VRTS)
+                {
+                    buffer.vertices.resize(count);
+                    file.read((char *)buffer.vertices.data(), count * sizeof(Vertex));
+                }
+                else if (subId == CHUNK_IDXS)
+                {
+                    const u32 indexSize = version >= 103 ? readU32() : 4;
+                    buffer.indices.resize(count);
+                    for (u32 i = 0; i < count; i++)
+                    {
+                        u32 index = 0;
+                        file.read((char *)&index, indexSize);
+                        buffer.indices[i] = index;
+                    }
+                }
+                else if (subId == CHUNK_SKIN)
+                {
+                    buffer.skin.resize(count);
+                    for (u32 i = 0; i < count; i++)
+                    {
+                        file.read((char *)buffer.skin[i].boneIDs, 4);
+                        file.read((char *)buffer.skin[i].weights, 16);
+                    }
+                }
+                file.seekg(subEnd);
+            }
+            buffers.push_back(buffer);
+        }
+        file.seekg(end);
+    }
+    return !buffers.empty();
+}
+
+// Lista de triangulos normalizada (rodada para o menor indice e ordenada)
+std::vector<u32> SortedTriangles(const std::vector<u32> &indices)
+{
+    std::vector<std::array<u32, 3>> tris;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        std::array<u32, 3> t = {indices[i], indices[i + 1], indices[i + 2]};
+        while (t[0] > t[1] || t[0] > t[2])
+            t = {t[1], t[2], t[0]};
+        tris.push_back(t);
+    }
+    std::sort(tris.begin(), tris.end());
+
+    std::vector<u32> result;
+    for (const auto &t : tris)
+        result.insert(result.end(), t.begin(), t.end());
+    return result;
+}
+
+// Grelha indexada (vertices partilhados) com triangulos baralhados
+void BuildShuffledGrid(int size, std::vector<Vertex> &vertices, std::vector<u32> &indices)
+{
+    vertices.clear();
+    indices.clear();
+
+    for (int y = 0; y <= size; y++)
+        for (int x = 0; x <= size; x++)
+            vertices.push_back({(float)x, 0, (float)y, 0, 1, 0, (float)x / size, (float)y / size});
+
+    std::vector<std::array<u32, 3>> tris;
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            u32 i0 = y * (size + 1) + x;
+            u32 i1 = i0 + 1;
+            u32 i2 = i0 + size + 1;
+            u32 i3 = i2 + 1;
+            tris.push_back({i0, i2, i1});
+            tris.push_back({i1, i2, i3});
+        }
+    }
+
+    // LCG fixo para ser reproduzivel
+    u32 seed = 12345;
+    for (size_t i = tris.size() - 1; i > 0; i--)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        std::swap(tris[i], tris[seed % (i + 1)]);
+    }
+
+    for (const auto &t : tris)
+        indices.insert(indices.end(), t.begin(), t.end());
+}
+
+// Esfera UV com triangulos baralhados (fechada, tem overdraw real)
+void BuildShuffledSphere(int rings, int sectors, std::vector<Vertex> &vertices, std::vector<u32> &indices)
+{
+    vertices.clear();
+    indices.clear();
+
+    for (int r = 0; r <= rings; r++)
+    {
+        float phi = 3.14159265f * r / rings;
+        for (int s = 0; s <= sectors; s++)
+        {
+            float theta = 2.0f * 3.14159265f * s / sectors;
+            float x = std::sin(phi) * std::cos(theta);
+            float y = std::cos(phi);
+            float z = std::sin(phi) * std::sin(theta);
+            vertices.push_back({x, y, z, x, y, z, (float)s / sectors, (float)r / rings});
+        }
+    }
+
+    std::vector<std::array<u32, 3>> tris;
+    for (int r = 0; r < rings; r++)
+    {
+        for (int s = 0; s < sectors; s++)
+        {
+            u32 i0 = r * (sectors + 1) + s;
+            u32 i1 = i0 + 1;
+            u32 i2 = i0 + sectors + 1;
+            u32 i3 = i2 + 1;
+            tris.push_back({i0, i1, i2});
+            tris.push_back({i1, i3, i2});
+        }
+    }
+
+    u32 seed = 777;
+    for (size_t i = tris.size() - 1; i > 0; i--)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        std::swap(tris[i], tris[seed % (i + 1)]);
+    }
+
+    for (const auto &t : tris)
+        indices.insert(indices.end(), t.begin(), t.end());
+}
+
+// Grelha indexada em ordem normal, com as UVs do lado direito deslocadas a
+// partir de seamColumn (cria um seam: vertices duplicados nessa coluna)
+void BuildSeamGrid(int size, int seamColumn, std::vector<Vertex> &vertices, std::vector<u32> &indices)
+{
+    vertices.clear();
+    indices.clear();
+
+    const int columns = size + 2; // coluna do seam duplicada
+    auto vertexIndex = [&](int x, int y, bool right)
+    {
+        int column = x < seamColumn || (x == seamColumn && !right) ? x : x + 1;
+        return (u32)(y * columns + column);
+    };
+
+    for (int y = 0; y <= size; y++)
+    {
+        for (int column = 0; column < columns; column++)
+        {
+            int x = column <= seamColumn ? column : column - 1;
+            float offset = column <= seamColumn ? 0.0f : 10.0f;
+            vertices.push_back({(float)x, 0, (float)y, 0, 1, 0, (float)x / size + offset, (float)y / size});
+        }
+    }
+
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            bool right = x >= seamColumn;
+            u32 i0 = vertexIndex(x, y, right);
+            u32 i1 = vertexIndex(x + 1, y, right);
+            u32 i2 = vertexIndex(x, y + 1, right);
+            u32 i3 = vertexIndex(x + 1, y + 1, right);
+            indices.insert(indices.end(), {i0, i2, i1, i1, i2, i3});
+        }
+    }
+}
+
+// Esfera com vertices partilhados (sem seam nos polos nem na costura)
+void BuildWeldedSphere(int rings, int sectors, std::vector<Vertex> &vertices, std::vector<u32> &indices)
+{
+    BuildShuffledSphere(rings, sectors, vertices, indices);
+
+    std::vector<u32> remap;
+    std::vector<Vertex> positionsOnly = vertices;
+    for (auto &v : positionsOnly)
+        v.nx = v.ny = v.nz = v.u = v.v = 0.0f;
+    u32 count = MeshOptimizer::WeldVertices(positionsOnly.data(), (u32)positionsOnly.size(), 0.0001f, remap);
+
+    std::vector<Vertex> welded(count);
+    for (size_t i = 0; i < vertices.size(); i++)
+        welded[remap[i]] = vertices[i];
+    vertices = welded;
+
+    std::vector<u32> result;
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        u32 a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+        if (a != b && b != c && a != c)
+            result.insert(result.end(), {a, b, c});
+    }
+    indices = result;
+}
+
+// Copia vertices/indices para um buffer do Mesh (com o GL nulo nos testes)
+MeshBuffer *AddFilledBuffer(Mesh &mesh, const std::vector<Vertex> &vertices, const std::vector<u32> &indices)
+{
+    MeshBuffer *buffer = mesh.AddBuffer(0);
+    for (const Vertex &v : vertices)
+        buffer->AddVertex(v);
+    for (u32 index : indices)
+        buffer->AddIndex(index);
+    return buffer;
+}
+
+// ============================================================================
+// WELD
+// ============================================================================
+
+// Implementacao antiga do MeshBuffer::RemoveDuplicateVertices (O(n^2)), para comparar
+u32 ReferenceWeld(const std::vector<Vertex> &vertices, float threshold, std::vector<u32> &remap)
+{
+    std::vector<Vertex> unique;
+    remap.resize(vertices.size());
+    const float t2 = threshold * threshold;
+
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const Vertex &a = vertices[i];
+        bool found = false;
+        for (size_t j = 0; j < unique.size(); ++j)
+        {
+            const Vertex &b = unique[j];
+            float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+            if (dx * dx + dy * dy + dz * dz > t2)
+                continue;
+            float dnx = a.nx - b.nx, dny = a.ny - b.ny, dnz = a.nz - b.nz;
+            if (dnx * dnx + dny * dny + dnz * dnz > t2)
+                continue;
+            float du = a.u - b.u, dv = a.v - b.v;
+            if (du * du + dv * dv > t2)
+                continue;
+            remap[i] = (u32)j;
+            found = true;
+            break;
+        }
+        if (!found)
+        {
+            remap[i] = (u32)unique.size();
+            unique.push_back(a);
+        }
+    }
+    return (u32)unique.size();
+}
+
+void TestWeld()
+{
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    BuildSoupGrid(8, vertices, indices);
+
+    std::vector<u32> remap;
+    u32 count = MeshOptimizer::WeldVertices(vertices.data(), (u32)vertices.size(), 0.0001f, remap);
+
+    TEST("Weld soup grid");
+    ASSERT_EQ(count, (u32)(9 * 9));
+
+    TEST("Weld matches reference");
+    std::vector<u32> reference;
+    ReferenceWeld(vertices, 0.0001f, reference);
+    ASSERT_TRUE(remap == reference);
+
+    // UVs diferentes nao podem ser soldados
+    TEST("Weld keeps UV seams");
+    std::vector<Vertex> seam = {{0, 0, 0, 0, 1, 0, 0, 0}, {0, 0, 0, 0, 1, 0, 1, 0}, {0, 0, 0, 0, 1, 0, 0, 0}};
+    count = MeshOptimizer::WeldVertices(seam.data(), (u32)seam.size(), 0.001f, remap);
+    ASSERT_EQ(count, (u32)2);
+
+    TEST("Weld remap of seam");
+    ASSERT_TRUE(remap[0] == 0 && remap[1] == 1 && remap[2] == 0);
+
+    TEST("Weld exact (threshold 0)");
+    count = MeshOptimizer::WeldVertices(vertices.data(), (u32)vertices.size(), 0.0f, remap);
+    ASSERT_EQ(count, (u32)(9 * 9));
+}
+
+void BenchWeld()
+{
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    BuildSoupGrid(100, vertices, indices);
+
+    std::vector<u32> remap, reference;
+
+    Timer t0;
+    u32 fast = MeshOptimizer::WeldVertices(vertices.data(), (u32)vertices.size(), 0.0001f, remap);
+    double fastMs = t0.Elapsed();
+
+    Timer t1;
+    u32 slow = ReferenceWeld(vertices, 0.0001f, reference);
+    double slowMs = t1.Elapsed();
+
+    std::cout << "  Weld " << vertices.size() << " -> " << fast << " vertices: hash grid "
+              << fastMs << " ms, O(n^2) " << slowMs << " ms" << std::endl;
+
+    TEST("Bench weld results match");
+    ASSERT_TRUE(fast == slow && remap == reference);
+}
+
+// ============================================================================
+// VERTEX CACHE
+// ============================================================================
+
+void TestVertexCache()
+{
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    BuildShuffledGrid(32, vertices, indices);
+    const u32 vertexCount = (u32)vertices.size();
+
+    MeshOptimizer::VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(indices.data(), (u32)indices.size(), vertexCount, 16);
+
+    TEST("Cache stats triangle count");
+    ASSERT_EQ(before.triangleCount, (u32)(32 * 32 * 2));
+
+    std::vector<u32> optimized(indices.size());
+    MeshOptimizer::OptimizeVertexCache(optimized.data(), indices.data(), (u32)indices.size(), vertexCount);
+
+    TEST("Cache optimize keeps triangles");
+    ASSERT_TRUE(SortedTriangles(optimized) == SortedTriangles(indices));
+
+    MeshOptimizer::VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(optimized.data(), (u32)optimized.size(), vertexCount, 16);
+
+    TEST("Cache optimize lowers ACMR");
+    ASSERT_TRUE(after.acmr < before.acmr * 0.6f);
+
+    TEST("Cache optimize ATVR near 1");
+    ASSERT_TRUE(after.atvr < 1.5f);
+
+    // in-place
+    std::vector<u32> inplace = indices;
+    MeshOptimizer::OptimizeVertexCache(inplace.data(), inplace.data(), (u32)inplace.size(), vertexCount);
+    TEST("Cache optimize in place");
+    ASSERT_TRUE(inplace == optimized);
+
+    // triangulos degenerados nao podem rebentar o cache simulado
+    std::vector<u32> degenerate = {0, 0, 1, 1, 2, 2, 0, 1, 2};
+    std::vector<u32> out(degenerate.size());
+    MeshOptimizer::OptimizeVertexCache(out.data(), degenerate.data(), (u32)degenerate.size(), 3);
+    TEST("Cache optimize degenerate");
+    ASSERT_TRUE(SortedTriangles(out) == SortedTriangles(degenerate));
+
+    TEST("Cache stats single triangle");
+    MeshOptimizer::VertexCacheStats one = MeshOptimizer::AnalyzeVertexCache(degenerate.data() + 6, 3, 3, 16);
+    ASSERT_NEAR(one.acmr, 3.0f, 0.0001f);
+}
+
+void BenchVertexCache(const char *filename)
+{
+    std::vector<RawBuffer> buffers;
+    if (!LoadRawMesh(filename, buffers))
+    {
+        std::cout << "  (skip " << filename << ")" << std::endl;
+        return;
+    }
+
+    for (size_t b = 0; b < buffers.size(); b++)
+    {
+        const RawBuffer &buffer = buffers[b];
+        const u32 vertexCount = (u32)buffer.vertices.size();
+        const u32 indexCount = (u32)buffer.indices.size();
+        if (indexCount == 0)
+            continue;
+
+        std::vector<u32> optimized(indexCount);
+        Timer t;
+        MeshOptimizer::OptimizeVertexCache(optimized.data(), buffer.indices.data(), indexCount, vertexCount);
+        double ms = t.Elapsed();
+
+        MeshOptimizer::VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(buffer.indices.data(), indexCount, vertexCount, 16);
+        MeshOptimizer::VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(optimized.data(), indexCount, vertexCount, 16);
+
+        std::cout << "  " << filename << " [" << b << "] " << before.triangleCount << " tris: ACMR "
+                  << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr
+                  << " (" << ms << " ms)" << std::endl;
+
+        TEST("Bench cache not worse");
+        ASSERT_TRUE(after.acmr <= before.acmr + 0.01f);
+    }
+}
+
+// ============================================================================
+// VERTEX FETCH / OVERDRAW
+// ============================================================================
+
+void TestVertexFetch()
+{
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    BuildShuffledGrid(32, vertices, indices);
+    const u32 vertexCount = (u32)vertices.size();
+
+    MeshOptimizer::OptimizeVertexCache(indices.data(), indices.data(), (u32)indices.size(), vertexCount);
+
+    // Baralha os vertices para estragar a localidade
+    std::vector<u32> shuffle(vertexCount);
+    for (u32 i = 0; i < vertexCount; i++)
+        shuffle[i] = i;
+    u32 seed = 99;
+    for (u32 i = vertexCount - 1; i > 0; i--)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        std::swap(shuffle[i], shuffle[seed % (i + 1)]);
+    }
+    std::vector<Vertex> shuffled(vertexCount);
+    for (u32 i = 0; i < vertexCount; i++)
+        shuffled[shuffle[i]] = vertices[i];
+    for (auto &idx : indices)
+        idx = shuffle[idx];
+
+    MeshOptimizer::VertexFetchStats before = MeshOptimizer::AnalyzeVertexFetch(indices.data(), (u32)indices.size(), vertexCount, sizeof(Vertex));
+
+    std::vector<u32> remap(vertexCount);
+    u32 used = MeshOptimizer::OptimizeVertexFetchRemap(remap.data(), indices.data(), (u32)indices.size(), vertexCount);
+
+    TEST("Fetch remap all used");
+    ASSERT_EQ(used, vertexCount);
+
+    std::vector<Vertex> optimized(vertexCount);
+    std::vector<bool> hit(vertexCount, false);
+    bool permutation = true;
+    for (u32 i = 0; i < vertexCount; i++)
+    {
+        permutation = permutation && !hit[remap[i]];
+        hit[remap[i]] = true;
+        optimized[remap[i]] = shuffled[i];
+    }
+    TEST("Fetch remap is permutation");
+    ASSERT_TRUE(permutation);
+
+    std::vector<u32> remapped(indices.size());
+    bool samePositions = true;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        remapped[i] = remap[indices[i]];
+        const Vertex &a = shuffled[indices[i]];
+        const Vertex &b = optimized[remapped[i]];
+        samePositions = samePositions && a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+    TEST("Fetch remap keeps geometry");
+    ASSERT_TRUE(samePositions);
+
+    TEST("Fetch first use order");
+    ASSERT_TRUE(remapped[0] == 0 && remapped[1] <= 1);
+
+    MeshOptimizer::VertexFetchStats after = MeshOptimizer::AnalyzeVertexFetch(remapped.data(), (u32)remapped.size(), vertexCount, sizeof(Vertex));
+    TEST("Fetch lowers overfetch");
+    ASSERT_TRUE(after.overfetch < before.overfetch && after.overfetch < 1.5f);
+
+    // vertices nao usados vao para o fim
+    std::vector<u32> partial = {3, 1, 3};
+    std::vector<u32> small(5);
+    used = MeshOptimizer::OptimizeVertexFetchRemap(small.data(), partial.data(), 3, 5);
+    TEST("Fetch unused at end");
+    ASSERT_TRUE(used == 2 && small[3] == 0 && small[1] == 1 && small[0] == 2 && small[2] == 3 && small[4] == 4);
+}
+
+void TestOverdraw()
+{
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    BuildShuffledSphere(24, 48, vertices, indices);
+    const u32 vertexCount = (u32)vertices.size();
+    const u32 indexCount = (u32)indices.size();
+
+    // Duas esferas concentricas: a de dentro fica tapada pela de fora
+    for (u32 v = 0; v < vertexCount; v++)
+    {
+        Vertex inner = vertices[v];
+        inner.x *= 0.5f;
+        inner.y *= 0.5f;
+        inner.z *= 0.5f;
+        vertices.push_back(inner);
+    }
+    for (u32 i = 0; i < indexCount; i++)
+        indices.push_back(indices[i] + vertexCount);
+    // a de dentro primeiro, pior caso
+    std::rotate(indices.begin(), indices.begin() + indexCount, indices.end());
+
+    MeshOptimizer::OptimizeVertexCache(indices.data(), indices.data(), (u32)indices.size(), (u32)vertices.size());
+
+    MeshOptimizer::OverdrawStats before = MeshOptimizer::AnalyzeOverdraw(indices.data(), (u32)indices.size(), vertices.data(), (u32)vertices.size());
+    MeshOptimizer::VertexCacheStats cacheBefore = MeshOptimizer::AnalyzeVertexCache(indices.data(), (u32)indices.size(), (u32)vertices.size(), 16);
+
+    TEST("Overdraw covers pixels");
+    ASSERT_TRUE(before.pixelsCovered > 0 && before.overdraw >= 1.0f);
+
+    std::vector<u32> optimized(indices.size());
+    MeshOptimizer::OptimizeOverdraw(optimized.data(), indices.data(), (u32)indices.size(), vertices.data(), (u32)vertices.size());
+
+    TEST("Overdraw keeps triangles");
+    ASSERT_TRUE(SortedTriangles(optimized) == SortedTriangles(indices));
+
+    MeshOptimizer::OverdrawStats after = MeshOptimizer::AnalyzeOverdraw(optimized.data(), (u32)optimized.size(), vertices.data(), (u32)vertices.size());
+    MeshOptimizer::VertexCacheStats cacheAfter = MeshOptimizer::AnalyzeVertexCache(optimized.data(), (u32)optimized.size(), (u32)vertices.size(), 16);
+
+    std::cout << "  overdraw " << before.overdraw << " -> " << after.overdraw << ", ACMR "
+              << cacheBefore.acmr << " -> " << cacheAfter.acmr << std::endl;
+
+    TEST("Overdraw reduced");
+    ASSERT_TRUE(after.overdraw < before.overdraw);
+
+    TEST("Overdraw same coverage");
+    ASSERT_EQ(after.pixelsCovered, before.pixelsCovered);
+
+    TEST("Overdraw ACMR within threshold");
+    ASSERT_TRUE(cacheAfter.acmr <= cacheBefore.acmr * 1.05f + 0.05f);
+}
+
+void BenchVertexFetch(const char *filename)
+{
+    std::vector<RawBuffer> buffers;
+    if (!LoadRawMesh(filename, buffers))
+    {
+        std::cout << "  (skip " << filename << ")" << std::endl;
+        return;
+    }
+
+    for (size_t b = 0; b < buffers.size(); b++)
+    {
+        RawBuffer &buffer = buffers[b];
+        const u32 vertexCount = (u32)buffer.vertices.size();
+        const u32 indexCount = (u32)buffer.indices.size();
+        if (indexCount == 0)
+            continue;
+
+        MeshOptimizer::OverdrawStats overdrawBefore = MeshOptimizer::AnalyzeOverdraw(buffer.indices.data(), indexCount, buffer.vertices.data(), vertexCount);
+
+        Timer t;
+        MeshOptimizer::OptimizeVertexCache(buffer.indices.data(), buffer.indices.data(), indexCount, vertexCount);
+        MeshOptimizer::OptimizeOverdraw(buffer.indices.data(), buffer.indices.data(), indexCount, buffer.vertices.data(), vertexCount);
+        double ms = t.Elapsed();
+
+        MeshOptimizer::OverdrawStats overdrawAfter = MeshOptimizer::AnalyzeOverdraw(buffer.indices.data(), indexCount, buffer.vertices.data(), vertexCount);
+        MeshOptimizer::VertexFetchStats before = MeshOptimizer::AnalyzeVertexFetch(buffer.indices.data(), indexCount, vertexCount, sizeof(Vertex));
+
+        std::vector<u32> remap(vertexCount);
+        MeshOptimizer::OptimizeVertexFetchRemap(remap.data(), buffer.indices.data(), indexCount, vertexCount);
+        for (auto &idx : buffer.indices)
+            idx = remap[idx];
+
+        MeshOptimizer::VertexFetchStats after = MeshOptimizer::AnalyzeVertexFetch(buffer.indices.data(), indexCount, vertexCount, sizeof(Vertex));
+
+        std::cout << "  " << filename << " [" << b << "] overdraw " << overdrawBefore.overdraw << " -> "
+                  << overdrawAfter.overdraw << " (" << ms << " ms), overfetch " << before.overfetch << " -> "
+                  << after.overfetch << std::endl;
+
+        TEST("Bench fetch not worse");
+        ASSERT_TRUE(after.overfetch <= before.overfetch + 0.01f);
+    }
+}
+
+// ============================================================================
+// SIMPLIFY
+// ============================================================================
+
+void TestSimplify()
+{
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    BuildWeldedSphere(32, 64, vertices, indices);
+    const u32 vertexCount = (u32)vertices.size();
+    const u32 target = (u32)(indices.size() / 4 / 3) * 3;
+
+    std::vector<u32> result(indices.size());
+    float error = 0.0f;
+    u32 count = MeshOptimizer::SimplifyMesh(result.data(), indices.data(), (u32)indices.size(), vertices.data(), nullptr,
+                                            vertexCount, target, 1.0f, &error);
+    result.resize(count);
+
+    TEST("Simplify sphere reaches target");
+    ASSERT_TRUE(count <= target && count > 0);
+
+    TEST("Simplify sphere error bounded");
+    ASSERT_TRUE(error > 0.0f && error < 0.05f);
+
+    bool valid = true;
+    for (size_t i = 0; i < result.size(); i += 3)
+        valid = valid && result[i] < vertexCount && result[i] != result[i + 1] && result[i + 1] != result[i + 2] && result[i] != result[i + 2];
+    TEST("Simplify no degenerate triangles");
+    ASSERT_TRUE(valid);
+
+    // Limite de erro 0: uma esfera nao tem colapsos gratis
+    count = MeshOptimizer::SimplifyMesh(result.data(), indices.data(), (u32)indices.size(), vertices.data(), nullptr,
+                                        vertexCount, target, 0.0f, &error);
+    TEST("Simplify respects error limit");
+    ASSERT_EQ(count, (u32)indices.size());
+
+    // Plano com seam de UV: nenhum triangulo pode misturar os dois lados
+    BuildSeamGrid(16, 8, vertices, indices);
+    result.resize(indices.size());
+    count = MeshOptimizer::SimplifyMesh(result.data(), indices.data(), (u32)indices.size(), vertices.data(), nullptr,
+                                        (u32)vertices.size(), 6, 1.0f, &error);
+    result.resize(count);
+
+    TEST("Simplify flat grid collapses");
+    ASSERT_TRUE(count < indices.size() / 4);
+
+    bool seamKept = true;
+    bool seamUsed = false;
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        bool right0 = vertices[result[i]].u >= 5.0f;
+        bool right1 = vertices[result[i + 1]].u >= 5.0f;
+        bool right2 = vertices[result[i + 2]].u >= 5.0f;
+        seamKept = seamKept && right0 == right1 && right1 == right2;
+        for (u32 k = 0; k < 3; k++)
+            seamUsed = seamUsed || vertices[result[i + k]].x == 8.0f;
+    }
+    TEST("Simplify keeps UV seam");
+    ASSERT_TRUE(seamKept && seamUsed);
+
+    // Cantos estao na borda, ficam presos
+    bool cornersKept[4] = {false, false, false, false};
+    for (u32 idx : result)
+    {
+        const Vertex &v = vertices[idx];
+        if ((v.x == 0 || v.x == 16) && (v.z == 0 || v.z == 16))
+            cornersKept[(v.x == 16 ? 1 : 0) + (v.z == 16 ? 2 : 0)] = true;
+    }
+    TEST("Simplify keeps border");
+    ASSERT_TRUE(cornersKept[0] && cornersKept[1] && cornersKept[2] && cornersKept[3]);
+
+    // Skin: um vertice no meio com outro osso nao pode desaparecer
+    BuildShuffledGrid(16, vertices, indices);
+    std::vector<VertexSkin> skin(vertices.size());
+    for (auto &sk : skin)
+        sk = {{0, 0, 0, 0}, {1.0f, 0, 0, 0}};
+    const u32 middle = 8 * 17 + 8;
+    skin[middle] = {{1, 0, 0, 0}, {1.0f, 0, 0, 0}};
+
+    result.resize(indices.size());
+    count = MeshOptimizer::SimplifyMesh(result.data(), indices.data(), (u32)indices.size(), vertices.data(), skin.data(),
+                                        (u32)vertices.size(), 6, 1.0f, &error);
+    result.resize(count);
+
+    TEST("Simplify keeps skin weights");
+    ASSERT_TRUE(std::find(result.begin(), result.end(), middle) != result.end());
+
+    count = MeshOptimizer::SimplifyMesh(result.data(), indices.data(), (u32)indices.size(), vertices.data(), nullptr,
+                                        (u32)vertices.size(), 6, 1.0f, &error);
+    result.resize(count);
+    TEST("Simplify without skin removes it");
+    ASSERT_TRUE(std::find(result.begin(), result.end(), middle) == result.end());
+
+    TEST("LOD buffers keep their tangents");
+    {
+        Mesh mesh;
+        BuildWeldedSphere(16, 32, vertices, indices);
+        AddFilledBuffer(mesh, vertices, indices)->CalculateTangents();
+        std::vector<float> ratios;
+        ratios.push_back(0.5f);
+        ratios.push_back(0.25f);
+        mesh.GenerateLods(ratios, 0.05f);
+
+        bool kept = mesh.GetLodCount() == 3;
+        for (u32 lod = 1; lod < mesh.GetLodCount(); lod++)
+        {
+            const MeshBuffer *buffer = mesh.GetLodBuffer(lod, 0);
+            kept = kept && buffer->HasTangents() && buffer->GetIndexCount() < indices.size();
+            for (u32 i = 0; kept && i < buffer->GetVertexCount(); i++)
+            {
+                const Vertex &v = buffer->GetVertices()[i];
+                const Vec4 &t = buffer->GetTangents()[i];
+                kept = std::fabs(t.x * v.nx + t.y * v.ny + t.z * v.nz) < 0.01f && std::fabs(t.w) == 1.0f;
+            }
+        }
+        ASSERT_TRUE(kept);
+    }
+}
+
+void BenchSimplify(const char *filename)
+{
+    std::vector<RawBuffer> buffers;
+    if (!LoadRawMesh(filename, buffers))
+    {
+        std::cout << "  (skip " << filename << ")" << std::endl;
+        return;
+    }
+
+    const float ratios[] = {0.5f, 0.25f, 0.1f};
+    for (size_t b = 0; b < buffers.size(); b++)
+    {
+        const RawBuffer &buffer = buffers[b];
+        const u32 indexCount = (u32)buffer.indices.size();
+        if (indexCount == 0)
+            continue;
+
+        const VertexSkin *skin = buffer.skin.size() == buffer.vertices.size() ? buffer.skin.data() : nullptr;
+        std::vector<u32> result(indexCount);
+
+        for (float ratio : ratios)
+        {
+            u32 target = (u32)(indexCount / 3 * ratio) * 3;
+            float error = 0.0f;
+
+            Timer t;
+            u32 count = MeshOptimizer::SimplifyMesh(result.data(), buffer.indices.data(), indexCount, buffer.vertices.data(), skin,
+                                                    (u32)buffer.vertices.size(), target, 1e10f, &error);
+            double ms = t.Elapsed();
+
+            std::cout << "  " << filename << " [" << b << "] ratio " << ratio << ": " << indexCount / 3 << " -> "
+                      << count / 3 << " tris, error " << error << " (" << ms << " ms)" << std::endl;
+        }
+
+        TEST("Bench simplify reduces");
+        u32 count = MeshOptimizer::SimplifyMesh(result.data(), buffer.indices.data(), indexCount, buffer.vertices.data(), skin,
+                                                (u32)buffer.vertices.size(), indexCount / 2, 1e10f);
+        ASSERT_TRUE(count < indexCount * 3 / 4);
+    }
+}
+
+// ============================================================================
+// MESHLETS
+// ============================================================================
+
+void TestMeshlets()
+{
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    BuildWeldedSphere(32, 64, vertices, indices);
+    MeshOptimizer::OptimizeVertexCache(indices.data(), indices.data(), (u32)indices.size(), (u32)vertices.size());
+
+    std::vector<MeshOptimizer::Meshlet> meshlets;
+    std::vector<u32> result(indices.size());
+    u32 count = MeshOptimizer::BuildMeshlets(meshlets, result.data(), indices.data(), (u32)indices.size(), vertices.data(),
+                                             (u32)vertices.size());
+
+    TEST("Meshlets built");
+    ASSERT_TRUE(count > 0 && count == meshlets.size());
+
+    TEST("Meshlets keep triangles");
+    ASSERT_TRUE(SortedTriangles(result) == SortedTriangles(indices));
+
+    bool limits = true, contiguous = true, contained = true;
+    u32 offset = 0;
+    float avgTriangles = 0.0f;
+    for (const auto &m : meshlets)
+    {
+        std::vector<u32> unique(result.begin() + m.indexOffset, result.begin() + m.indexOffset + m.indexCount);
+        std::sort(unique.begin(), unique.end());
+        unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+        limits = limits && m.vertexCount == unique.size() && m.vertexCount <= MeshOptimizer::MESHLET_MAX_VERTICES &&
+                 m.indexCount / 3 <= MeshOptimizer::MESHLET_MAX_TRIANGLES;
+        contiguous = contiguous && m.indexOffset == offset;
+        offset += m.indexCount;
+        avgTriangles += m.indexCount / 3;
+
+        for (u32 v : unique)
+        {
+            Vec3 p(vertices[v].x, vertices[v].y, vertices[v].z);
+            contained = contained && (p - m.center).length() <= m.radius * 1.0001f + 1e-5f;
+        }
+    }
+    avgTriangles /= meshlets.size();
+
+    TEST("Meshlets respect limits");
+    ASSERT_TRUE(limits);
+
+    TEST("Meshlets contiguous");
+    ASSERT_TRUE(contiguous && offset == result.size());
+
+    TEST("Meshlets sphere contains vertices");
+    ASSERT_TRUE(contained);
+
+    TEST("Meshlets well filled");
+    ASSERT_TRUE(avgTriangles > 70.0f);
+
+    // Se o cone diz que esta de costas, todos os triangulos tem de estar
+    u32 seed = 4242;
+    auto random = [&seed]()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / (float)(1 << 24) * 2.0f - 1.0f;
+    };
+
+    bool conservative = true;
+    u32 culled = 0, tested = 0;
+    for (int c = 0; c < 64; c++)
+    {
+        Vec3 camera = Vec3(random(), random(), random()).normalized() * (1.5f + 3.0f * (random() + 1.0f));
+        for (const auto &m : meshlets)
+        {
+            tested++;
+            if (!MeshOptimizer::IsMeshletBackfacing(m, camera))
+                continue;
+            culled++;
+            for (u32 i = 0; i < m.indexCount; i += 3)
+            {
+                const Vertex &a = vertices[result[m.indexOffset + i]];
+                const Vertex &b = vertices[result[m.indexOffset + i + 1]];
+                const Vertex &d = vertices[result[m.indexOffset + i + 2]];
+                Vec3 p0(a.x, a.y, a.z), p1(b.x, b.y, b.z), p2(d.x, d.y, d.z);
+                Vec3 n = (p1 - p0).cross(p2 - p0);
+                conservative = conservative && n.dot(p0 - camera) >= -1e-5f;
+            }
+        }
+    }
+
+    TEST("Meshlet cone is conservative");
+    ASSERT_TRUE(conservative);
+
+    std::cout << "  sphere: " << meshlets.size() << " meshlets, " << avgTriangles << " tris avg, backface culled "
+              << (100.0f * culled / tested) << "%" << std::endl;
+
+    TEST("Meshlet cone culls something");
+    ASSERT_TRUE(culled > tested / 5);
+}
+
+void BenchMeshlets(const char *filename)
+{
+    std::vector<RawBuffer> buffers;
+    if (!LoadRawMesh(filename, buffers))
+    {
+        std::cout << "  (skip " << filename << ")" << std::endl;
+        return;
+    }
+
+    for (size_t b = 0; b < buffers.size(); b++)
+    {
+        RawBuffer &buffer = buffers[b];
+        const u32 indexCount = (u32)buffer.indices.size();
+        if (indexCount == 0)
+            continue;
+
+        std::vector<MeshOptimizer::Meshlet> meshlets;
+        Timer t;
+        MeshOptimizer::BuildMeshlets(meshlets, buffer.indices.data(), buffer.indices.data(), indexCount,
+                                     buffer.vertices.data(), (u32)buffer.vertices.size());
+        double ms = t.Elapsed();
+
+        Vec3 center(0.0f);
+        float radius = 0.0f;
+        for (const auto &m : meshlets)
+            center += m.center;
+        center /= (float)meshlets.size();
+        for (const auto &m : meshlets)
+            radius = Max(radius, (m.center - center).length() + m.radius);
+
+        // Camara a olhar de frente e de lado: percentagem de triangulos rejeitados pelo cone
+        const Vec3 cameras[] = {center + Vec3(0, 0, 3 * radius), center + Vec3(3 * radius, 0, 0)};
+        for (const Vec3 &camera : cameras)
+        {
+            u32 culledTriangles = 0;
+            for (const auto &m : meshlets)
+                if (MeshOptimizer::IsMeshletBackfacing(m, camera))
+                    culledTriangles += m.indexCount / 3;
+
+            std::cout << "  " << filename << " [" << b << "] " << meshlets.size() << " meshlets (" << ms
+                      << " ms), backface culled " << (100.0f * culledTriangles / (indexCount / 3)) << "% tris" << std::endl;
+        }
+
+        TEST("Bench meshlets built");
+        ASSERT_TRUE(meshlets.size() >= indexCount / 3 / MeshOptimizer::MESHLET_MAX_TRIANGLES);
+    }
+}
+
+void TestQuantization()
+{
+    std::cout << std::endl
+              << "--- Quantization ---" << std::endl;
+
+    TEST("Half exact values");
+    {
+        bool ok = true;
+        const float values[] = {0.0f, 1.0f, -2.0f, 0.5f, 65504.0f, 0.25f};
+        for (float v : values)
+            ok = ok && MeshOptimizer::DecodeHalf(MeshOptimizer::EncodeHalf(v)) == v;
+        ASSERT_TRUE(ok);
+    }
+
+    TEST("Half relative error");
+    {
+        float worst = 0.0f;
+        for (float v = 0.001f; v < 1000.0f; v *= 1.37f)
+            worst = Max(worst, std::fabs(MeshOptimizer::DecodeHalf(MeshOptimizer::EncodeHalf(v)) - v) / v);
+        ASSERT_TRUE(worst <= 1.0f / 2048.0f);
+    }
+
+    TEST("Half overflow and denormals");
+    {
+        const float tiny = MeshOptimizer::DecodeHalf(MeshOptimizer::EncodeHalf(1e-6f));
+        ASSERT_TRUE(std::isinf(MeshOptimizer::DecodeHalf(MeshOptimizer::EncodeHalf(1e6f))) && tiny > 0.0f &&
+                    std::fabs(tiny - 1e-6f) < 6e-8f);
+    }
+
+    TEST("Octahedral normals");
+    {
+        std::vector<Vertex> vertices;
+        std::vector<u32> indices;
+        BuildWeldedSphere(32, 64, vertices, indices);
+        float worst = 0.0f;
+        for (const Vertex &v : vertices)
+        {
+            Vec3 n = Vec3(v.nx, v.ny, v.nz).normalized();
+            s16 encoded[2];
+            MeshOptimizer::EncodeOctahedral(n, encoded);
+            Vec3 d = MeshOptimizer::DecodeOctahedral(encoded);
+            worst = Max(worst, std::atan2(n.cross(d).length(), n.dot(d)) * 180.0f / Pi);
+        }
+        ASSERT_TRUE(worst < 0.01f);
+    }
+
+    TEST("Octahedral poles");
+    {
+        s16 encoded[2];
+        MeshOptimizer::EncodeOctahedral(Vec3(0, 0, -1), encoded);
+        ASSERT_NEAR(MeshOptimizer::DecodeOctahedral(encoded).z, -1.0f, 1e-4f);
+    }
+
+    TEST("Weights sum preserved");
+    {
+        bool ok = true;
+        const float sets[][4] = {{1, 0, 0, 0}, {0.333f, 0.333f, 0.334f, 0}, {0.25f, 0.25f, 0.25f, 0.25f}, {0.7f, 0.2f, 0.05f, 0.05f},
+                                 {0.1f, 0.1f, 0.1f, 0.1f}};
+        for (const auto &w : sets)
+        {
+            for (u32 maxValue : {255u, 65535u})
+            {
+                u32 q[4];
+                MeshOptimizer::QuantizeWeights(w, maxValue, q);
+                ok = ok && q[0] + q[1] + q[2] + q[3] == maxValue;
+            }
+        }
+        ASSERT_TRUE(ok);
+    }
+
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    BuildWeldedSphere(16, 32, vertices, indices);
+    for (Vertex &v : vertices)
+    {
+        v.x = v.x * 10.0f + 100.0f;
+        v.y = v.y * 10.0f - 50.0f;
+        v.z = v.z * 10.0f;
+    }
+
+    MeshOptimizer::VertexFormat compact;
+    compact.position = MeshOptimizer::POSITION_SNORM16;
+    compact.normal = MeshOptimizer::NORMAL_OCT16;
+    compact.texCoord = MeshOptimizer::TEXCOORD_HALF2;
+    compact.weights = MeshOptimizer::WEIGHT_UNORM8;
+
+    TEST("Compact stride");
+    ASSERT_EQ(MeshOptimizer::GetVertexStride(compact), 16u);
+
+    TEST("GPU format without shader decode");
+    {
+        MeshOptimizer::VertexFormat gpu = MeshOptimizer::GetGpuFormat(compact, false);
+        MeshOptimizer::VertexFormat full = MeshOptimizer::GetGpuFormat(compact, true);
+        ASSERT_TRUE(gpu.position == MeshOptimizer::POSITION_HALF4 && gpu.normal == MeshOptimizer::NORMAL_FLOAT3 &&
+                    gpu.texCoord == MeshOptimizer::TEXCOORD_HALF2 && MeshOptimizer::GetVertexStride(gpu) == 24u &&
+                    full.position == compact.position && full.normal == compact.normal);
+    }
+
+    TEST("Float format is identity");
+    {
+        MeshOptimizer::VertexFormat format;
+        std::vector<u8> packed(vertices.size() * MeshOptimizer::GetVertexStride(format));
+        std::vector<Vertex> decoded(vertices.size());
+        MeshOptimizer::PackVertices(packed.data(), vertices.data(), (u32)vertices.size(), format, Vec3(0.0f), 1.0f);
+        MeshOptimizer::UnpackVertices(decoded.data(), packed.data(), (u32)vertices.size(), format, Vec3(0.0f), 1.0f);
+        ASSERT_TRUE(std::memcmp(decoded.data(), vertices.data(), vertices.size() * sizeof(Vertex)) == 0 &&
+                    packed.size() == vertices.size() * sizeof(Vertex));
+    }
+
+    TEST("SNORM16 position error");
+    {
+        MeshOptimizer::QuantizationError error =
+            MeshOptimizer::AnalyzeQuantization(vertices.data(), nullptr, (u32)vertices.size(), compact);
+        // meia unidade de quantizacao por eixo, escala 10
+        ASSERT_TRUE(error.position <= 10.0f / 32767.0f * 0.5f * 1.75f && error.normal < 0.01f && error.texCoord < 1e-3f);
+    }
+
+    TEST("HALF4 far from origin loses precision");
+    {
+        MeshOptimizer::VertexFormat half = compact;
+        half.position = MeshOptimizer::POSITION_HALF4;
+        MeshOptimizer::QuantizationError error =
+            MeshOptimizer::AnalyzeQuantization(vertices.data(), nullptr, (u32)vertices.size(), half);
+        MeshOptimizer::QuantizationError snorm =
+            MeshOptimizer::AnalyzeQuantization(vertices.data(), nullptr, (u32)vertices.size(), compact);
+        ASSERT_TRUE(error.position > snorm.position);
+    }
+
+    TEST("Skin pack roundtrip");
+    {
+        std::vector<VertexSkin> skin(vertices.size());
+        for (size_t i = 0; i < skin.size(); i++)
+        {
+            float a = (float)(i % 7) / 7.0f;
+            skin[i] = {{(u8)(i % 60), (u8)(i % 3), 2, 3}, {1.0f - a, a * 0.6f, a * 0.4f, 0.0f}};
+        }
+        std::vector<u8> packed(skin.size() * MeshOptimizer::GetSkinStride(compact));
+        std::vector<VertexSkin> decoded(skin.size());
+        MeshOptimizer::PackSkin(packed.data(), skin.data(), (u32)skin.size(), compact);
+        MeshOptimizer::UnpackSkin(decoded.data(), packed.data(), (u32)skin.size(), compact);
+
+        bool ok = true;
+        float worst = 0.0f;
+        for (size_t i = 0; i < skin.size(); i++)
+        {
+            float sum = 0.0f;
+            for (int j = 0; j < 4; j++)
+            {
+                ok = ok && decoded[i].boneIDs[j] == skin[i].boneIDs[j];
+                worst = Max(worst, std::fabs(decoded[i].weights[j] - skin[i].weights[j]));
+                sum += decoded[i].weights[j];
+            }
+            ok = ok && std::fabs(sum - 1.0f) < 1e-5f;
+        }
+        ASSERT_TRUE(ok && worst <= 1.0f / 255.0f);
+    }
+}
+
+void BenchQuantization(const char *filename)
+{
+    std::vector<RawBuffer> buffers;
+    if (!LoadRawMesh(filename, buffers))
+    {
+        std::cout << "  (skip " << filename << ")" << std::endl;
+        return;
+    }
+
+    MeshOptimizer::VertexFormat formats[2];
+    formats[0].position = MeshOptimizer::POSITION_HALF4;
+    formats[0].normal = MeshOptimizer::NORMAL_OCT16;
+    formats[0].texCoord = MeshOptimizer::TEXCOORD_HALF2;
+    formats[0].weights = MeshOptimizer::WEIGHT_UNORM8;
+    formats[1] = formats[0];
+    formats[1].position = MeshOptimizer::POSITION_SNORM16;
+    const char *names[] = {"half4/oct16/half2/u8", "snorm16/oct16/half2/u8"};
+
+    for (int f = 0; f < 2; f++)
+    {
+        u32 bytes = 0;
+        u32 packedBytes = 0;
+        MeshOptimizer::QuantizationError worst;
+        Timer t;
+        for (const RawBuffer &buffer : buffers)
+        {
+            const u32 count = (u32)buffer.vertices.size();
+            MeshOptimizer::QuantizationError error = MeshOptimizer::AnalyzeQuantization(
+                buffer.vertices.data(), buffer.skin.empty() ? nullptr : buffer.skin.data(), count, formats[f]);
+            bytes += (error.vertexBytes + error.skinBytes) * count;
+            packedBytes += (error.packedBytes + error.packedSkinBytes) * count;
+            worst.position = Max(worst.position, error.position);
+            worst.normal = Max(worst.normal, error.normal);
+            worst.texCoord = Max(worst.texCoord, error.texCoord);
+            worst.weight = Max(worst.weight, error.weight);
+        }
+        double ms = t.Elapsed();
+
+        std::cout << "  " << filename << " " << names[f] << ": " << bytes << " -> " << packedBytes << " bytes ("
+                  << (100.0f * packedBytes / Max((float)bytes, 1.0f)) << "%), pos " << worst.position << ", normal "
+                  << worst.normal << " deg, uv " << worst.texCoord << ", weight " << worst.weight << " (" << ms
+                  << " ms)" << std::endl;
+
+        TEST("Bench quantization shrinks");
+        ASSERT_TRUE(packedBytes < bytes && worst.normal < 0.05f);
+    }
+}
+
+void TestTangents()
+{
+    std::cout << std::endl
+              << "--- Tangents ---" << std::endl;
+
+    // Plano XZ, normal +Y, u = x, v = z: T = +X e B = w * cross(N, T) = +Z
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    BuildShuffledGrid(16, vertices, indices);
+
+    std::vector<Vec4> tangents;
+    std::vector<u32> duplicates;
+    MeshOptimizer::GenerateTangents(tangents, duplicates, indices.data(), (u32)indices.size(), vertices.data(),
+                                    (u32)vertices.size());
+
+    TEST("Tangents count");
+    ASSERT_EQ(tangents.size(), vertices.size());
+
+    TEST("Tangents no split on plain grid");
+    ASSERT_EQ(duplicates.size(), (size_t)0);
+
+    TEST("Tangents follow +u");
+    {
+        bool ok = true;
+        for (const Vec4 &t : tangents)
+        {
+            Vec3 b = Vec3(0, 1, 0).cross(Vec3(t.x, t.y, t.z)) * t.w;
+            ok = ok && std::fabs(t.x - 1.0f) < 1e-4f && b.z > 0.999f;
+        }
+        ASSERT_TRUE(ok);
+    }
+
+    // UVs espelhados em x = 8: a coluna do meio tem de ser separada
+    const int size = 16;
+    for (Vertex &v : vertices)
+        v.u = std::fabs(v.x - size / 2) / size;
+    const u32 originalCount = (u32)vertices.size();
+    MeshOptimizer::GenerateTangents(tangents, duplicates, indices.data(), (u32)indices.size(), vertices.data(),
+                                    (u32)vertices.size());
+
+    TEST("Tangents split mirrored seam");
+    ASSERT_EQ(duplicates.size(), (size_t)(size + 1));
+
+    TEST("Tangents mirrored halves");
+    {
+        bool ok = tangents.size() == originalCount + duplicates.size();
+        for (size_t i = 0; ok && i < indices.size(); i += 3)
+        {
+            float cx = 0.0f;
+            for (int c = 0; c < 3; c++)
+            {
+                u32 index = indices[i + c];
+                cx += vertices[index < originalCount ? index : duplicates[index - originalCount]].x;
+            }
+            const float expected = cx / 3.0f < size / 2 ? -1.0f : 1.0f;
+            for (int c = 0; c < 3; c++)
+            {
+                const Vec4 &t = tangents[indices[i + c]];
+                ok = ok && std::fabs(t.x - expected) < 1e-4f && t.w == -expected;
+            }
+        }
+        ASSERT_TRUE(ok);
+    }
+
+    // Esfera: unitarias e perpendiculares a normal
+    BuildWeldedSphere(24, 48, vertices, indices);
+    MeshOptimizer::GenerateTangents(tangents, duplicates, indices.data(), (u32)indices.size(), vertices.data(),
+                                    (u32)vertices.size());
+
+    TEST("Tangents orthonormal on sphere");
+    {
+        bool ok = true;
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            Vec3 n = Vec3(vertices[i].nx, vertices[i].ny, vertices[i].nz).normalized();
+            Vec3 t(tangents[i].x, tangents[i].y, tangents[i].z);
+            ok = ok && std::fabs(t.length() - 1.0f) < 1e-4f && std::fabs(t.dot(n)) < 1e-3f &&
+                 std::fabs(std::fabs(tangents[i].w) - 1.0f) < 1e-6f;
+        }
+        ASSERT_TRUE(ok);
+    }
+
+    // Dois triangulos que so partilham o vertice 0, com u em +X num e em +Z
+    // no outro: sem aresta comum sao dois grupos do Mikk, nao uma media
+    TEST("Tangents split fans without a shared edge");
+    {
+        vertices.clear();
+        vertices.push_back({0, 0, 0, 0, 1, 0, 0.0f, 0.0f});
+        vertices.push_back({0, 0, 1, 0, 1, 0, 0.0f, 1.0f});
+        vertices.push_back({1, 0, 0, 0, 1, 0, 1.0f, 0.0f});
+        vertices.push_back({0, 0, -1, 0, 1, 0, 1.0f, 0.0f});
+        vertices.push_back({-1, 0, 0, 0, 1, 0, 0.0f, 1.0f});
+        indices.clear();
+        indices.insert(indices.end(), {0, 1, 2, 0, 3, 4});
+        MeshOptimizer::GenerateTangents(tangents, duplicates, indices.data(), (u32)indices.size(), vertices.data(),
+                                        (u32)vertices.size());
+        const Vec4 &first = tangents[indices[0]];
+        const Vec4 &second = tangents[indices[3]];
+        ASSERT_TRUE(duplicates.size() == 1 && duplicates[0] == 0 && indices[0] != indices[3] &&
+                    std::fabs(first.x - 1.0f) < 1e-4f && std::fabs(second.z + 1.0f) < 1e-4f);
+    }
+
+    // Inverter o winding nao muda o mapeamento das UVs; so o FlipNormals
+    // troca o sinal para manter B = w * cross(N, T)
+    TEST("Reverse keeps the tangent sign");
+    {
+        Mesh mesh;
+        BuildShuffledGrid(8, vertices, indices);
+        MeshBuffer *buffer = AddFilledBuffer(mesh, vertices, indices);
+        buffer->CalculateTangents();
+        const std::vector<Vec4> before(buffer->GetTangents(), buffer->GetTangents() + buffer->GetVertexCount());
+        buffer->Reverse();
+        bool kept = buffer->HasTangents();
+        for (u32 i = 0; kept && i < buffer->GetVertexCount(); i++)
+            kept = buffer->GetTangents()[i].w == before[i].w;
+        buffer->FlipNormals();
+        bool flipped = true;
+        for (u32 i = 0; flipped && i < buffer->GetVertexCount(); i++)
+            flipped = buffer->GetTangents()[i].w == -before[i].w;
+        ASSERT_TRUE(kept && flipped);
+    }
+}
+
+void BenchTangents(const char *filename)
+{
+    std::vector<RawBuffer> buffers;
+    if (!LoadRawMesh(filename, buffers))
+    {
+        std::cout << "  (skip " << filename << ")" << std::endl;
+        return;
+    }
+
+    // Pelo menos 4 threads para exercitar os acumuladores mesmo com 1 core
+    JobSystem &jobs = JobSystem::Instance();
+    const u32 threads = (u32)Max((int)jobs.GetWorkerCount(), 4);
+
+    for (size_t b = 0; b < buffers.size(); b++)
+    {
+        RawBuffer &buffer = buffers[b];
+        std::vector<u32> indices[2] = {buffer.indices, buffer.indices};
+        std::vector<Vec4> tangents[2];
+        std::vector<u32> duplicates[2];
+        double ms[2];
+
+        for (int run = 0; run < 2; run++)
+        {
+            jobs.SetWorkerCount(run == 0 ? 1 : threads);
+            Timer t;
+            MeshOptimizer::GenerateTangents(tangents[run], duplicates[run], indices[run].data(), (u32)indices[run].size(),
+                                            buffer.vertices.data(), (u32)buffer.vertices.size());
+            ms[run] = t.Elapsed();
+        }
+
+        float worst = 0.0f;
+        for (size_t i = 0; i < tangents[0].size() && i < tangents[1].size(); i++)
+            worst = Max(worst, (tangents[0][i] - tangents[1][i]).length());
+
+        std::cout << "  " << filename << " [" << b << "] " << buffer.vertices.size() << " vertices, "
+                  << duplicates[1].size() << " split: 1 thread " << ms[0] << " ms, " << threads << " threads " << ms[1]
+                  << " ms" << std::endl;
+
+        TEST("Bench tangents threads agree");
+        ASSERT_TRUE(duplicates[0] == duplicates[1] && indices[0] == indices[1] && worst < 1e-3f);
+    }
+
+    jobs.SetWorkerCount(0);
+}
+
+// ============================================================================
+// BOUNDS
+// ============================================================================
+
+void TestBounds()
+{
+    std::cout << std::endl
+              << "--- Bounds ---" << std::endl;
+
+    BoundingBox box(Vec3(-1, -2, -3), Vec3(4, 5, 6));
+    Mat4 world = Mat4::Translation(10, 0, -5) * Mat4::RotationYDeg(30.0f) * Mat4::Scale(2, 1, 0.5f);
+    BoundingBox result = box.transformed(world);
+
+    // Referencia: os 8 cantos transformados
+    BoundingBox reference;
+    for (int c = 0; c < 8; c++)
+    {
+        Vec3 corner((c & 1) ? box.max.x : box.min.x, (c & 2) ? box.max.y : box.min.y, (c & 4) ? box.max.z : box.min.z);
+        Vec3 p = world.TransformPoint(corner);
+        if (c == 0)
+            reference.min = reference.max = p;
+        else
+            reference.expand(p);
+    }
+
+    TEST("Transformed AABB matches corners");
+    ASSERT_TRUE((result.min - reference.min).length() < 1e-4f && (result.max - reference.max).length() < 1e-4f);
+
+    TEST("Transformed AABB translation only");
+    {
+        BoundingBox moved = box.transformed(Mat4::Translation(1, 2, 3));
+        ASSERT_TRUE(moved.min == Vec3(0, 0, 0) && moved.max == Vec3(5, 7, 9));
+    }
+
+    // Camara na origem a olhar para -Z
+    Mat4 viewProj = Mat4::PerspectiveDeg(60.0f, 1.0f, 0.1f, 100.0f) *
+                    Mat4::LookAt(Vec3(0, 0, 0), Vec3(0, 0, -1), Vec3(0, 1, 0));
+    Frustum frustum;
+    frustum.extractFromMatrix(viewProj);
+
+    TEST("Frustum keeps box in front");
+    ASSERT_TRUE(frustum.intersectsAABB(box.transformed(Mat4::Translation(0, 0, -20))));
+
+    TEST("Frustum culls box behind");
+    ASSERT_TRUE(!frustum.intersectsAABB(box.transformed(Mat4::Translation(0, 0, 20))));
+}
+
+// ============================================================================
+// NORMAIS
+// ============================================================================
+
+// Implementacao antiga do MeshBuffer::CalculateNormals (scatter serie, pesada por area)
+void ReferenceNormals(std::vector<Vertex> &vertices, const std::vector<u32> &indices)
+{
+    for (auto &v : vertices)
+        v.nx = v.ny = v.nz = 0.0f;
+
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        Vertex &a = vertices[indices[i]];
+        Vertex &b = vertices[indices[i + 1]];
+        Vertex &c = vertices[indices[i + 2]];
+        Vec3 normal = (Vec3(b.x, b.y, b.z) - Vec3(a.x, a.y, a.z)).cross(Vec3(c.x, c.y, c.z) - Vec3(a.x, a.y, a.z));
+        for (Vertex *v : {&a, &b, &c})
+        {
+            v->nx += normal.x;
+            v->ny += normal.y;
+            v->nz += normal.z;
+        }
+    }
+
+    for (auto &v : vertices)
+    {
+        Vec3 n = Vec3(v.nx, v.ny, v.nz).normalized();
+        v.nx = n.x;
+        v.ny = n.y;
+        v.nz = n.z;
+    }
+}
+
+float WorstNormalDelta(const std::vector<Vertex> &a, const std::vector<Vertex> &b)
+{
+    float worst = 0.0f;
+    for (size_t i = 0; i < a.size(); i++)
+        worst = Max(worst, (Vec3(a[i].nx, a[i].ny, a[i].nz) - Vec3(b[i].nx, b[i].ny, b[i].nz)).length());
+    return worst;
+}
+
+void TestNormals()
+{
+    std::cout << std::endl
+              << "--- Normals ---" << std::endl;
+
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    BuildWeldedSphere(24, 32, vertices, indices);
+    const u32 vertexCount = (u32)vertices.size();
+    const u32 indexCount = (u32)indices.size();
+
+    MeshOptimizer::VertexAdjacency adjacency;
+    MeshOptimizer::BuildVertexAdjacency(adjacency, indices.data(), indexCount, vertexCount);
+
+    TEST("Adjacency is valid");
+    ASSERT_TRUE(adjacency.IsValid(vertexCount, indexCount));
+
+    TEST("Adjacency lists every corner");
+    {
+        bool ok = true;
+        for (u32 t = 0; t < indexCount / 3 && ok; t++)
+        {
+            for (u32 k = 0; k < 3; k++)
+            {
+                const u32 v = indices[t * 3 + k];
+                const u32 *faces = adjacency.GetFaces(v);
+                if (std::find(faces, faces + adjacency.GetFaceCount(v), t) == faces + adjacency.GetFaceCount(v))
+                    ok = false;
+            }
+        }
+        ASSERT_TRUE(ok);
+    }
+
+    std::vector<Vertex> reference = vertices;
+    ReferenceNormals(reference, indices);
+
+    std::vector<Vertex> area = vertices;
+    MeshOptimizer::GenerateNormals(area.data(), vertexCount, indices.data(), indexCount, adjacency);
+
+    TEST("Area normals match serial scatter");
+    ASSERT_TRUE(WorstNormalDelta(area, reference) < 1e-5f);
+
+    // Na esfera a normal e a posicao
+    TEST("Angle normals point outwards");
+    {
+        std::vector<Vertex> angle = vertices;
+        MeshOptimizer::GenerateNormals(angle.data(), vertexCount, indices.data(), indexCount, adjacency,
+                                       MeshOptimizer::NORMAL_WEIGHT_ANGLE);
+        float worst = 0.0f;
+        for (const Vertex &v : angle)
+            worst = Max(worst, (Vec3(v.nx, v.ny, v.nz) - Vec3(v.x, v.y, v.z).normalized()).length());
+        ASSERT_TRUE(worst < 0.02f);
+    }
+
+    // Canto de um cubo: a face +Z partida em 2 triangulos nao deve puxar a normal
+    std::vector<Vertex> corner = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0, 0, 1}};
+    std::vector<u32> cornerIndices = {0, 1, 2, 0, 2, 3, 0, 4, 1, 0, 3, 4};
+    MeshOptimizer::BuildVertexAdjacency(adjacency, cornerIndices.data(), (u32)cornerIndices.size(), (u32)corner.size());
+
+    const Vec3 diagonal = Vec3(1, 1, 1).normalized();
+
+    TEST("Angle weighting ignores triangulation");
+    {
+        std::vector<Vertex> angle = corner;
+        MeshOptimizer::GenerateNormals(angle.data(), (u32)angle.size(), cornerIndices.data(), (u32)cornerIndices.size(),
+                                       adjacency, MeshOptimizer::NORMAL_WEIGHT_ANGLE);
+        ASSERT_TRUE((Vec3(angle[0].nx, angle[0].ny, angle[0].nz) - diagonal).length() < 1e-4f);
+    }
+
+    TEST("Area weighting favours the larger face");
+    {
+        std::vector<Vertex> weighted = corner;
+        MeshOptimizer::GenerateNormals(weighted.data(), (u32)weighted.size(), cornerIndices.data(),
+                                       (u32)cornerIndices.size(), adjacency);
+        ASSERT_TRUE(weighted[0].nz > weighted[0].nx + 0.1f);
+    }
+}
+
+void BenchNormals(const char *filename)
+{
+    std::vector<RawBuffer> buffers;
+    if (!LoadRawMesh(filename, buffers))
+    {
+        std::cout << "  (skip " << filename << ")" << std::endl;
+        return;
+    }
+
+    JobSystem &jobs = JobSystem::Instance();
+    const u32 threads = (u32)Max((int)jobs.GetWorkerCount(), 4);
+
+    for (size_t b = 0; b < buffers.size(); b++)
+    {
+        RawBuffer &buffer = buffers[b];
+        const u32 vertexCount = (u32)buffer.vertices.size();
+        const u32 indexCount = (u32)buffer.indices.size();
+
+        std::vector<Vertex> reference = buffer.vertices;
+        Timer tr;
+        ReferenceNormals(reference, buffer.indices);
+        double msReference = tr.Elapsed();
+
+        MeshOptimizer::VertexAdjacency adjacency;
+        Timer ta;
+        MeshOptimizer::BuildVertexAdjacency(adjacency, buffer.indices.data(), indexCount, vertexCount);
+        double msAdjacency = ta.Elapsed();
+
+        std::vector<Vertex> result[2] = {buffer.vertices, buffer.vertices};
+        double ms[2];
+        for (int run = 0; run < 2; run++)
+        {
+            jobs.SetWorkerCount(run == 0 ? 1 : threads);
+            Timer t;
+            MeshOptimizer::GenerateNormals(result[run].data(), vertexCount, buffer.indices.data(), indexCount, adjacency);
+            ms[run] = t.Elapsed();
+        }
+
+        std::cout << "  " << filename << " [" << b << "] " << vertexCount << " vertices: scatter " << msReference
+                  << " ms, adjacency " << msAdjacency << " ms, gather 1 thread " << ms[0] << " ms, " << threads
+                  << " threads " << ms[1] << " ms" << std::endl;
+
+        TEST("Bench normals match scatter");
+        ASSERT_TRUE(WorstNormalDelta(result[0], reference) < 1e-4f && WorstNormalDelta(result[1], result[0]) == 0.0f);
+    }
+
+    jobs.SetWorkerCount(0);
+}
+
+// ============================================================================
+// INDICES 16 BITS
+// ============================================================================
+
+void TestIndices()
+{
+    std::cout << std::endl
+              << "--- 16-bit indices ---" << std::endl;
+
+    MeshOptimizer::IndexArray indices;
+    indices.push_back(0);
+    indices.push_back(65535);
+    indices.push_back(7);
+
+    TEST("Small indices stay 16-bit");
+    ASSERT_TRUE(indices.Is16Bit() && indices.GetMemorySize() == 6 && indices[1] == 65535);
+
+    indices.push_back(65536);
+    TEST("Large index widens to 32-bit");
+    ASSERT_TRUE(!indices.Is16Bit() && indices.size() == 4 && indices[0] == 0 && indices[1] == 65535 &&
+                indices[2] == 7 && indices[3] == 65536);
+
+    TEST("Remap narrows back to 16-bit");
+    {
+        std::vector<u32> table(65537, 0);
+        table[65535] = 1;
+        table[7] = 2;
+        table[65536] = 3;
+        indices.Remap(table.data());
+        ASSERT_TRUE(indices.Is16Bit() && indices.ToVector() == std::vector<u32>({0, 1, 2, 3}));
+    }
+
+    TEST("Set widens when needed");
+    {
+        indices.Set(2, 100000);
+        ASSERT_TRUE(!indices.Is16Bit() && indices[2] == 100000 && indices[3] == 3);
+    }
+
+    // Grelha com ~40k vertices partida em grupos de 10000
+    std::vector<Vertex> vertices;
+    std::vector<u32> source;
+    BuildShuffledGrid(200, vertices, source);
+    const u32 maxVertices = 10000;
+
+    std::vector<MeshOptimizer::IndexSplit> splits;
+    const u32 count = MeshOptimizer::SplitIndices(splits, source.data(), (u32)source.size(), (u32)vertices.size(),
+                                                  maxVertices);
+
+    TEST("Split creates several groups");
+    ASSERT_TRUE(count >= (u32)vertices.size() / maxVertices && count == splits.size());
+
+    TEST("Split groups respect the vertex limit");
+    {
+        bool ok = true;
+        for (const MeshOptimizer::IndexSplit &split : splits)
+        {
+            ok = ok && split.vertices.size() <= maxVertices;
+            for (u32 index : split.indices)
+                ok = ok && index < split.vertices.size();
+        }
+        ASSERT_TRUE(ok);
+    }
+
+    TEST("Split keeps every triangle in order");
+    {
+        std::vector<u32> rebuilt;
+        for (const MeshOptimizer::IndexSplit &split : splits)
+            for (u32 index : split.indices)
+                rebuilt.push_back(split.vertices[index]);
+        ASSERT_TRUE(rebuilt == source);
+    }
+
+    TEST("Small buffer is a single group");
+    {
+        MeshOptimizer::SplitIndices(splits, source.data(), (u32)source.size(), (u32)vertices.size());
+        ASSERT_TRUE(splits.size() == 1 && splits[0].vertices.size() == vertices.size());
+    }
+}
+
+void BenchIndices(const char *filename)
+{
+    std::vector<RawBuffer> buffers;
+    if (!LoadRawMesh(filename, buffers))
+    {
+        std::cout << "  (skip " << filename << ")" << std::endl;
+        return;
+    }
+
+    for (size_t b = 0; b < buffers.size(); b++)
+    {
+        const RawBuffer &buffer = buffers[b];
+
+        MeshOptimizer::IndexArray indices;
+        Timer t;
+        indices.Assign(buffer.indices);
+        double ms = t.Elapsed();
+
+        std::cout << "  " << filename << " [" << b << "] " << buffer.indices.size() << " indices: "
+                  << buffer.indices.size() * sizeof(u32) << " -> " << indices.GetMemorySize() << " bytes ("
+                  << ms << " ms)" << std::endl;
+
+        TEST("Bench indices use 16 bits");
+        ASSERT_TRUE(indices.Is16Bit() && indices.ToVector() == buffer.indices);
+    }
+}
+
+// ============================================================================
+// SKELETON
+// ============================================================================
+
+// Esqueleto em arvore com os pais guardados depois dos filhos (como alguns exporters)
+void BuildShuffledSkeleton(Mesh &mesh, u32 boneCount)
+{
+    std::vector<s32> parents(boneCount, -1);
+    for (u32 i = 1; i < boneCount; i++)
+        parents[i] = (s32)((i - 1) / 2);
+
+    // Inverte a ordem: o bone i do ficheiro e o boneCount-1-i da arvore
+    for (u32 i = 0; i < boneCount; i++)
+    {
+        const u32 tree = boneCount - 1 - i;
+        Bone *bone = mesh.AddBone("bone" + std::to_string(i));
+        bone->parentIndex = parents[tree] < 0 ? -1 : (s32)(boneCount - 1 - parents[tree]);
+        bone->localPose = Mat4::Translation(0.1f * (float)(tree % 3), 0.5f, 0.0f) *
+                          Mat4::RotationYDeg(7.0f * (float)tree) * Mat4::RotationXDeg(3.0f);
+        bone->inverseBindPose = Mat4::Translation(0.0f, -0.5f * (float)(tree % 5), 0.1f);
+    }
+    mesh.CalculateBoneMatrices();
+}
+
+float WorstMatrixDelta(const Mat4 &a, const Mat4 &b)
+{
+    float worst = 0.0f;
+    for (int i = 0; i < 16; i++)
+        worst = Max(worst, std::fabs(a.m[i] - b.m[i]));
+    return worst;
+}
+
+void TestBonePalette()
+{
+    std::cout << std::endl
+              << "--- Bone palette ---" << std::endl;
+
+    Mesh mesh;
+    BuildShuffledSkeleton(mesh, 31);
+    mesh.SetBoneTransform(5, Vec3(0.0f, 1.0f, 0.0f), Quat::FromAxisAngle(Vec3(0, 0, 1), 0.3f));
+    mesh.UpdateBonePalette();
+
+    TEST("Palette matches recursive globals");
+    {
+        float worst = 0.0f;
+        for (u32 i = 0; i < mesh.GetBoneCount(); i++)
+        {
+            const Bone *bone = mesh.GetBone(i);
+            worst = Max(worst, WorstMatrixDelta(mesh.GetBoneGlobals()[i], bone->GetGlobalTransform()));
+            worst = Max(worst, WorstMatrixDelta(mesh.GetBoneMatrices()[i],
+                                                bone->GetGlobalTransform() * bone->inverseBindPose));
+        }
+        ASSERT_TRUE(worst < 1e-4f);
+    }
+
+    TEST("Palette follows new bone transforms");
+    {
+        mesh.SetBoneTransform(0, Vec3(2.0f, 0.0f, 0.0f), Quat::Identity());
+        mesh.UpdateBonePalette();
+        ASSERT_TRUE(WorstMatrixDelta(mesh.GetBoneGlobals()[0], mesh.GetBone(0)->GetGlobalTransform()) < 1e-4f);
+    }
+
+    TEST("Unchanged pose keeps the palette version");
+    {
+        const u32 version = mesh.GetPoseVersion();
+        mesh.SetBoneTransform(0, Vec3(2.0f, 0.0f, 0.0f), Quat::Identity());
+        mesh.UpdateBonePalette();
+        mesh.UpdateBonePalette();
+        ASSERT_TRUE(mesh.GetPoseVersion() == version);
+    }
+
+    TEST("Dirty bone updates its subtree only");
+    {
+        // Um bone a meio da arvore: os filhos seguem, o resto nao muda
+        const u32 version = mesh.GetPoseVersion();
+        const std::vector<Mat4> before = mesh.GetBoneGlobals();
+        mesh.SetBoneTransform(20, Vec3(0.0f, 0.3f, 0.0f), Quat::FromAxisAngle(Vec3(1, 0, 0), 0.5f));
+        mesh.UpdateBonePalette();
+
+        float worst = 0.0f;
+        u32 changed = 0;
+        for (u32 i = 0; i < mesh.GetBoneCount(); i++)
+        {
+            const Bone *bone = mesh.GetBone(i);
+            worst = Max(worst, WorstMatrixDelta(mesh.GetBoneGlobals()[i], bone->GetGlobalTransform()));
+            if (WorstMatrixDelta(mesh.GetBoneGlobals()[i], before[i]) > 0.0f)
+                changed++;
+        }
+        ASSERT_TRUE(mesh.GetPoseVersion() == version + 1 && worst < 1e-4f && changed > 1 &&
+                    changed < mesh.GetBoneCount());
+    }
+
+    TEST("Reset bones dirties the pose");
+    {
+        const u32 version = mesh.GetPoseVersion();
+        mesh.ResetBones();
+        mesh.UpdateBonePalette();
+        const u32 reset = mesh.GetPoseVersion();
+        mesh.ResetBones();
+        mesh.UpdateBonePalette();
+        ASSERT_TRUE(reset == version + 1 && mesh.GetPoseVersion() == reset &&
+                    WorstMatrixDelta(mesh.GetBoneGlobals()[5], mesh.GetBone(5)->GetGlobalTransform()) < 1e-4f);
+    }
+
+    TEST("Parent cycle falls back to root");
+    {
+        Mesh broken;
+        Bone *a = broken.AddBone("a");
+        Bone *b = broken.AddBone("b");
+        a->parentIndex = 1;
+        b->parentIndex = 0;
+        broken.CalculateBoneMatrices();
+        broken.UpdateBonePalette();
+        ASSERT_TRUE(broken.GetBoneMatrices().size() == 2 && (a->parent == nullptr || b->parent == nullptr));
+    }
+
+    TEST("Parent cycle breaks one link only");
+    {
+        // a <-> b em ciclo, c filho de b, d filho de c: so um corte
+        Mesh broken;
+        Bone *a = broken.AddBone("a");
+        Bone *b = broken.AddBone("b");
+        Bone *c = broken.AddBone("c");
+        Bone *d = broken.AddBone("d");
+        a->parentIndex = 1;
+        b->parentIndex = 0;
+        c->parentIndex = 1;
+        d->parentIndex = 2;
+        broken.CalculateBoneMatrices();
+        const u32 roots = (a->parent == nullptr) + (b->parent == nullptr) + (c->parent == nullptr) +
+                          (d->parent == nullptr);
+        ASSERT_TRUE(roots == 1 && c->parent == b && d->parent == c && broken.GetBoneMatrices().size() == 4);
+    }
+}
+
+void BenchBonePalette()
+{
+    // 60 bones, 15000 vertices com 4 influencias (como um personagem medio)
+    Mesh mesh;
+    BuildShuffledSkeleton(mesh, 60);
+    const u32 influences = 15000 * 4;
+
+    Timer tn;
+    Mat4 sink;
+    for (u32 i = 0; i < influences; i++)
+    {
+        const Bone *bone = mesh.GetBone(i % mesh.GetBoneCount());
+        sink = bone->GetGlobalTransform() * bone->inverseBindPose;
+    }
+    double msNaive = tn.Elapsed();
+
+    const int frames = 100;
+    Timer tp;
+    for (int f = 0; f < frames; f++)
+    {
+        mesh.MarkPoseDirty();
+        mesh.UpdateBonePalette();
+    }
+    double msPalette = tp.Elapsed() / frames;
+
+    // Personagem parado: a pose repete-se e a paleta nao e recalculada
+    for (u32 b = 0; b < mesh.GetBoneCount(); b++)
+        mesh.SetBoneTransform(b, Vec3(0.0f, 0.5f, 0.0f), Quat::Identity());
+    mesh.UpdateBonePalette();
+    const u32 idleVersion = mesh.GetPoseVersion();
+    Timer ti;
+    for (int f = 0; f < frames; f++)
+    {
+        for (u32 b = 0; b < mesh.GetBoneCount(); b++)
+            mesh.SetBoneTransform(b, Vec3(0.0f, 0.5f, 0.0f), Quat::Identity());
+        mesh.UpdateBonePalette();
+    }
+    double msIdle = ti.Elapsed() / frames;
+    const bool idleKept = mesh.GetPoseVersion() == idleVersion;
+    mesh.ResetBones();
+    mesh.UpdateBonePalette();
+
+    std::cout << "  Bone palette 60 bones: per influence " << msNaive << " ms, once per frame " << msPalette
+              << " ms (" << msNaive / Max((float)msPalette, 1e-6f) << "x), idle pose " << msIdle << " ms" << std::endl;
+
+    TEST("Bench idle pose keeps its palette");
+    ASSERT_TRUE(idleKept);
+
+    TEST("Bench palette matches per influence");
+    ASSERT_TRUE(WorstMatrixDelta(sink, mesh.GetBoneMatrices()[(influences - 1) % mesh.GetBoneCount()]) < 1e-4f);
+}
+
+// Pesos pseudo-aleatorios com alguns zeros e, no fim, um id fora da paleta
+void BuildRandomSkin(u32 vertexCount, u32 boneCount, std::vector<VertexSkin> &skin)
+{
+    skin.resize(vertexCount);
+    u32 state = 12345;
+    auto next = [&state]()
+    {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    };
+
+    for (u32 i = 0; i < vertexCount; i++)
+    {
+        VertexSkin &s = skin[i];
+        const u32 used = 1 + next() % 4;
+        float total = 0.0f;
+        for (u32 j = 0; j < 4; j++)
+        {
+            s.boneIDs[j] = (u8)(next() % boneCount);
+            s.weights[j] = j < used ? 0.1f + (float)(next() % 100) / 100.0f : 0.0f;
+            total += s.weights[j];
+        }
+        for (u32 j = 0; j < 4; j++)
+            s.weights[j] /= total;
+    }
+    skin[vertexCount - 1].boneIDs[3] = 255;
+}
+
+// Implementacao antiga do MeshBuffer::UpdateSkinning (Mat4 por influencia)
+void ReferenceSkin(std::vector<Vertex> &destination, const std::vector<Vertex> &vertices,
+                   const std::vector<VertexSkin> &skin, const std::vector<Mat4> &bones)
+{
+    destination = vertices;
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex &v = vertices[i];
+        Vec3 position(0.0f), normal(0.0f);
+        for (int j = 0; j < 4; j++)
+        {
+            if (skin[i].weights[j] == 0.0f || skin[i].boneIDs[j] >= bones.size())
+                continue;
+            const Mat4 &m = bones[skin[i].boneIDs[j]];
+            position += m.TransformPoint(Vec3(v.x, v.y, v.z)) * skin[i].weights[j];
+            normal += m.TransformVector(Vec3(v.nx, v.ny, v.nz)) * skin[i].weights[j];
+        }
+        normal = normal.normalized();
+        destination[i].x = position.x;
+        destination[i].y = position.y;
+        destination[i].z = position.z;
+        destination[i].nx = normal.x;
+        destination[i].ny = normal.y;
+        destination[i].nz = normal.z;
+    }
+}
+
+float WorstVertexDelta(const std::vector<Vertex> &a, const std::vector<Vertex> &b)
+{
+    float worst = 0.0f;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        worst = Max(worst, (Vec3(a[i].x, a[i].y, a[i].z) - Vec3(b[i].x, b[i].y, b[i].z)).length());
+        worst = Max(worst, (Vec3(a[i].nx, a[i].ny, a[i].nz) - Vec3(b[i].nx, b[i].ny, b[i].nz)).length());
+        worst = Max(worst, std::fabs(a[i].u - b[i].u) + std::fabs(a[i].v - b[i].v));
+    }
+    return worst;
+}
+
+void BuildSkinningPalette(u32 boneCount, std::vector<Mat4> &bones, std::vector<Skinning::AffineMatrix> &palette)
+{
+    bones.resize(boneCount);
+    for (u32 b = 0; b < boneCount; b++)
+        bones[b] = Mat4::Translation(0.1f * b, -0.2f * (b % 3), 0.05f * b) * Mat4::RotationYDeg(11.0f * b) *
+                   Mat4::RotationZDeg(5.0f * (b % 7));
+    palette.resize(boneCount);
+    Skinning::ToAffine(palette.data(), bones.data(), boneCount);
+}
+
+void TestSkinning()
+{
+    std::cout << std::endl
+              << "--- Skinning (" << Skinning::GetKernelName() << ") ---" << std::endl;
+
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    BuildWeldedSphere(12, 16, vertices, indices);
+    vertices.push_back(vertices[0]); // numero impar para o resto do AVX
+    for (size_t i = 0; i < vertices.size(); i++)
+        vertices[i].u = (float)i / vertices.size();
+    const u32 vertexCount = (u32)vertices.size();
+
+    std::vector<Mat4> bones;
+    std::vector<Skinning::AffineMatrix> palette;
+    BuildSkinningPalette(20, bones, palette);
+
+    std::vector<VertexSkin> skin;
+    BuildRandomSkin(vertexCount, 20, skin);
+
+    std::vector<Vertex> reference;
+    ReferenceSkin(reference, vertices, skin, bones);
+
+    TEST("Scalar kernel matches Mat4 skinning");
+    {
+        std::vector<Vertex> result(vertexCount);
+        Skinning::SkinVerticesScalar(result.data(), vertices.data(), skin.data(), vertexCount, palette.data(), 20);
+        ASSERT_TRUE(WorstVertexDelta(result, reference) < 1e-4f);
+    }
+
+    std::vector<Vertex> simd(vertexCount);
+    BoundingBox bounds = Skinning::SkinVertices(simd.data(), vertices.data(), skin.data(), vertexCount,
+                                                palette.data(), 20);
+
+    TEST("SIMD kernel matches Mat4 skinning");
+    ASSERT_TRUE(WorstVertexDelta(simd, reference) < 1e-4f);
+
+    TEST("SIMD kernel bounds cover the pose");
+    {
+        BoundingBox expected(Vec3(reference[0].x, reference[0].y, reference[0].z),
+                             Vec3(reference[0].x, reference[0].y, reference[0].z));
+        for (const Vertex &v : reference)
+            expected.expand(Vec3(v.x, v.y, v.z));
+        ASSERT_TRUE((bounds.min - expected.min).length() < 1e-4f && (bounds.max - expected.max).length() < 1e-4f);
+    }
+
+    TEST("Position-only keeps normals and uvs");
+    {
+        std::vector<Vertex> positions = vertices;
+        Skinning::SkinPositions(positions.data(), vertices.data(), skin.data(), vertexCount, palette.data(), 20);
+        bool ok = true;
+        for (u32 i = 0; i < vertexCount; i++)
+        {
+            ok = ok && (Vec3(positions[i].x, positions[i].y, positions[i].z) -
+                        Vec3(reference[i].x, reference[i].y, reference[i].z)).length() < 1e-4f;
+            ok = ok && positions[i].nx == vertices[i].nx && positions[i].u == vertices[i].u;
+        }
+        ASSERT_TRUE(ok);
+    }
+
+    TEST("SIMD tangents match scalar");
+    {
+        std::vector<Vec4> tangents(vertexCount), scalarOut(vertexCount), simdOut(vertexCount);
+        for (u32 i = 0; i < vertexCount; i++)
+            tangents[i] = Vec4(Vec3(-vertices[i].z, 0.0f, vertices[i].x).normalized(), i % 2 ? 1.0f : -1.0f);
+        std::vector<Vertex> a(vertexCount), b(vertexCount);
+        Skinning::SkinVerticesScalar(a.data(), vertices.data(), skin.data(), vertexCount, palette.data(), 20,
+                                     scalarOut.data(), tangents.data());
+        Skinning::SkinVertices(b.data(), vertices.data(), skin.data(), vertexCount, palette.data(), 20,
+                               simdOut.data(), tangents.data());
+        float worst = 0.0f;
+        for (u32 i = 0; i < vertexCount; i++)
+            worst = Max(worst, (scalarOut[i] - simdOut[i]).length());
+        ASSERT_TRUE(worst < 1e-5f);
+    }
+
+    // Varios "personagens" partidos em blocos pequenos, com 4 workers
+    JobSystem &jobs = JobSystem::Instance();
+    jobs.SetWorkerCount(4);
+    const u32 characters = 5;
+    std::vector<std::vector<Vertex> > crowd(characters, std::vector<Vertex>(vertexCount));
+    std::vector<Skinning::SkinningJob> crowdJobs(characters);
+    for (u32 c = 0; c < characters; c++)
+    {
+        Skinning::SkinningJob &job = crowdJobs[c];
+        job.destination = crowd[c].data();
+        job.vertices = vertices.data();
+        job.skin = skin.data();
+        job.vertexCount = vertexCount - c * 7; // tamanhos diferentes
+        job.bones = palette.data();
+        job.boneCount = 20;
+        job.mode = c % 2 ? Skinning::SKIN_POSITION_ONLY : Skinning::SKIN_FULL;
+    }
+    Skinning::RunJobs(crowdJobs.data(), characters, 37);
+    jobs.SetWorkerCount(0);
+
+    TEST("Parallel jobs match serial kernel");
+    {
+        bool ok = true;
+        for (u32 c = 0; c < characters; c++)
+        {
+            const u32 count = crowdJobs[c].vertexCount;
+            for (u32 i = 0; i < count; i++)
+                ok = ok && (Vec3(crowd[c][i].x, crowd[c][i].y, crowd[c][i].z) -
+                            Vec3(simd[i].x, simd[i].y, simd[i].z)).length() < 1e-5f;
+            ok = ok && (c % 2 == 1 || crowd[c][0].nx == simd[0].nx);
+        }
+        ASSERT_TRUE(ok);
+    }
+
+    TEST("Parallel jobs merge bounds per job");
+    {
+        bool ok = true;
+        for (u32 c = 0; c < characters; c++)
+        {
+            const u32 count = crowdJobs[c].vertexCount;
+            BoundingBox expected = Skinning::SkinPositions(crowd[c].data(), vertices.data(), skin.data(), count,
+                                                           palette.data(), 20);
+            ok = ok && (crowdJobs[c].bounds.min - expected.min).length() < 1e-5f &&
+                 (crowdJobs[c].bounds.max - expected.max).length() < 1e-5f;
+        }
+        ASSERT_TRUE(ok);
+    }
+
+    TEST("Skinned pose resets with the bind pose");
+    {
+        // O mesmo ciclo do MeshBuffer: skin a pose 3, vertices sujos (o
+        // Build sobe a bind pose e faz Reset), skin outra vez a pose 3
+        int owner = 0;
+        Skinning::SkinnedPose vbo;
+        const bool first = !vbo.Matches(&owner, 3, Skinning::SKIN_FULL);
+        vbo.Set(&owner, 3, Skinning::SKIN_FULL);
+        const bool cached = vbo.Matches(&owner, 3, Skinning::SKIN_POSITION_ONLY);
+        vbo.Reset();
+        const bool again = !vbo.Matches(&owner, 3, Skinning::SKIN_FULL);
+        vbo.Set(&owner, 3, Skinning::SKIN_POSITION_ONLY);
+        ASSERT_TRUE(first && cached && again && !vbo.Matches(&owner, 3, Skinning::SKIN_FULL) &&
+                    !vbo.Matches(&owner, 4, Skinning::SKIN_POSITION_ONLY));
+    }
+}
+
+void BenchSkinning(const char *filename)
+{
+    std::vector<RawBuffer> buffers;
+    if (!LoadRawMesh(filename, buffers))
+    {
+        std::cout << "  (skip " << filename << ")" << std::endl;
+        return;
+    }
+
+    // idle.mesh nao traz SKIN: pesos sinteticos sobre 60 bones
+    const std::vector<Vertex> &vertices = buffers[0].vertices;
+    const u32 vertexCount = (u32)vertices.size();
+    std::vector<Mat4> bones;
+    std::vector<Skinning::AffineMatrix> palette;
+    BuildSkinningPalette(60, bones, palette);
+    std::vector<VertexSkin> skin;
+    BuildRandomSkin(vertexCount, 60, skin);
+
+    std::vector<Vertex> reference, result(vertexCount);
+    const int runs = 20;
+
+    Timer tr;
+    for (int r = 0; r < runs; r++)
+        ReferenceSkin(reference, vertices, skin, bones);
+    const double msReference = tr.Elapsed() / runs;
+
+    Timer ts;
+    for (int r = 0; r < runs; r++)
+        Skinning::SkinVerticesScalar(result.data(), vertices.data(), skin.data(), vertexCount, palette.data(), 60);
+    const double msScalar = ts.Elapsed() / runs;
+
+    Timer tv;
+    for (int r = 0; r < runs; r++)
+        Skinning::SkinVertices(result.data(), vertices.data(), skin.data(), vertexCount, palette.data(), 60);
+    const double msSimd = tv.Elapsed() / runs;
+
+    std::vector<Vertex> positions = vertices;
+    Timer tp;
+    for (int r = 0; r < runs; r++)
+        Skinning::SkinPositions(positions.data(), vertices.data(), skin.data(), vertexCount, palette.data(), 60);
+    const double msPositions = tp.Elapsed() / runs;
+
+    auto rate = [vertexCount](double ms)
+    { return vertexCount / (ms * 1000.0); };
+    std::cout << "  Skinning " << vertexCount << " vertices (Mvertices/s): Mat4 " << rate(msReference)
+              << ", scalar 3x4 " << rate(msScalar) << ", " << Skinning::GetKernelName() << " " << rate(msSimd)
+              << ", " << Skinning::GetKernelName() << " position-only " << rate(msPositions) << std::endl;
+
+    TEST("Bench skinning matches reference");
+    ASSERT_TRUE(WorstVertexDelta(result, reference) < 1e-3f);
+}
+
+void BenchCrowdSkinning(const char *filename)
+{
+    std::vector<RawBuffer> buffers;
+    if (!LoadRawMesh(filename, buffers))
+    {
+        std::cout << "  (skip " << filename << ")" << std::endl;
+        return;
+    }
+
+    // 50 personagens com o mesmo mesh e paletas diferentes
+    const u32 characters = 50;
+    const std::vector<Vertex> &vertices = buffers[0].vertices;
+    const u32 vertexCount = (u32)vertices.size();
+    std::vector<VertexSkin> skin;
+    BuildRandomSkin(vertexCount, 60, skin);
+
+    std::vector<std::vector<Skinning::AffineMatrix> > palettes(characters);
+    std::vector<std::vector<Vertex> > results[2];
+    results[0].assign(characters, vertices);
+    results[1].assign(characters, vertices);
+    for (u32 c = 0; c < characters; c++)
+    {
+        std::vector<Mat4> bones;
+        BuildSkinningPalette(60, bones, palettes[c]);
+    }
+
+    JobSystem &jobs = JobSystem::Instance();
+    const u32 threads = (u32)Max((int)jobs.GetWorkerCount(), 4);
+    const int runs = 5;
+    double ms[2];
+    for (int run = 0; run < 2; run++)
+    {
+        std::vector<Skinning::SkinningJob> crowd(characters);
+        for (u32 c = 0; c < characters; c++)
+        {
+            crowd[c].destination = results[run][c].data();
+            crowd[c].vertices = vertices.data();
+            crowd[c].skin = skin.data();
+            crowd[c].vertexCount = vertexCount;
+            crowd[c].bones = palettes[c].data();
+            crowd[c].boneCount = 60;
+        }
+
+        jobs.SetWorkerCount(run == 0 ? 1 : threads);
+        Timer t;
+        for (int r = 0; r < runs; r++)
+            Skinning::RunJobs(crowd.data(), characters);
+        ms[run] = t.Elapsed() / runs;
+    }
+    jobs.SetWorkerCount(0);
+
+    std::cout << "  Crowd " << characters << " x " << vertexCount << " vertices: 1 thread " << ms[0] << " ms, "
+              << threads << " threads " << ms[1] << " ms" << std::endl;
+
+    TEST("Bench crowd threads match serial");
+    {
+        float worst = 0.0f;
+        for (u32 c = 0; c < characters; c++)
+            worst = Max(worst, WorstVertexDelta(results[1][c], results[0][c]));
+        ASSERT_TRUE(worst == 0.0f);
+    }
+}
+
+// ============================================================================
+// ANIMATION
+// ============================================================================
+
+// Implementacao antiga do Animation::InterpolatePosition/Rotation (procura linear)
+Vec3 ReferencePosition(const AnimationChannel &ch, float time)
+{
+    for (size_t i = 0; i + 1 < ch.keyframes.size(); i++)
+    {
+        float t0 = ch.keyframes[i].time;
+        float t1 = ch.keyframes[i + 1].time;
+        if (time >= t0 && time <= t1)
+            return Vec3::Lerp(ch.keyframes[i].position, ch.keyframes[i + 1].position, (time - t0) / (t1 - t0));
+    }
+    return ch.keyframes.back().position;
+}
+
+Quat ReferenceRotation(const AnimationChannel &ch, float time)
+{
+    for (size_t i = 0; i + 1 < ch.keyframes.size(); i++)
+    {
+        float t0 = ch.keyframes[i].time;
+        float t1 = ch.keyframes[i + 1].time;
+        if (time >= t0 && time <= t1)
+            return Quat::Slerp(ch.keyframes[i].rotation, ch.keyframes[i + 1].rotation, (time - t0) / (t1 - t0));
+    }
+    return ch.keyframes.back().rotation;
+}
+
+// Chaves com intervalos irregulares, a primeira depois de 0
+void BuildTestClip(Animation &anim, u32 channels, u32 keys)
+{
+    for (u32 c = 0; c < channels; c++)
+    {
+        AnimationChannel *channel = anim.AddChannel("bone" + std::to_string(c));
+        float time = 0.5f;
+        for (u32 k = 0; k < keys; k++)
+        {
+            AnimationKeyframe key;
+            key.time = time;
+            key.position = Vec3((float)k, std::sin((float)k * 0.3f), (float)c);
+            key.rotation = Quat::FromAxisAngle(Vec3(0, 1, 0), 0.05f * (float)k + 0.1f * (float)c);
+            channel->keyframes.push_back(key);
+            time += 0.25f + 0.5f * (float)((k * 7 + c) % 5) / 4.0f;
+        }
+    }
+}
+
+// Pior diferenca entre o sample (com um cursor por channel, como um layer)
+// e a procura linear nos tempos dados
+float WorstSampleDelta(Animation &anim, const std::vector<float> &times)
+{
+    float worst = 0.0f;
+    std::vector<AnimationCursor> cursors(anim.GetChannelCount());
+    for (float time : times)
+    {
+        for (u32 c = 0; c < anim.GetChannelCount(); c++)
+        {
+            const AnimationChannel &channel = *anim.GetChannel(c);
+            const Quat q = anim.InterpolateRotation(channel, time, &cursors[c]);
+            const Quat r = ReferenceRotation(channel, time);
+            worst = Max(worst, (anim.InterpolatePosition(channel, time, &cursors[c]) -
+                                ReferencePosition(channel, time)).length());
+            worst = Max(worst, std::fabs(q.x - r.x) + std::fabs(q.y - r.y) + std::fabs(q.z - r.z) +
+                                   std::fabs(q.w - r.w));
+        }
+    }
+    return worst;
+}
+
+void TestKeyframeCursor()
+{
+    std::cout << std::endl
+              << "--- Keyframe cursor ---" << std::endl;
+
+    Animation anim;
+    BuildTestClip(anim, 4, 40);
+    const float end = anim.GetChannel(0)->keyframes.back().time;
+
+    std::vector<float> forward, backward, blend, seeks;
+    for (float t = 0.0f; t <= end + 1.0f; t += 0.1f)
+        forward.push_back(t);
+    backward.assign(forward.rbegin(), forward.rend());
+    for (size_t i = 0; i < forward.size(); i++)
+    {
+        blend.push_back(forward[i]);
+        blend.push_back(end - forward[i] * 0.5f);
+    }
+    for (u32 i = 0; i < 500; i++)
+        seeks.push_back((float)((i * 7919u) % 1000u) / 1000.0f * (end + 1.0f));
+
+    TEST("Cursor matches linear scan playing forward");
+    ASSERT_TRUE(WorstSampleDelta(anim, forward) < 1e-5f);
+
+    TEST("Cursor matches linear scan playing backwards");
+    ASSERT_TRUE(WorstSampleDelta(anim, backward) < 1e-5f);
+
+    TEST("Cursor matches linear scan when blending two times");
+    ASSERT_TRUE(WorstSampleDelta(anim, blend) < 1e-5f);
+
+    TEST("Cursor matches linear scan on random seeks");
+    ASSERT_TRUE(WorstSampleDelta(anim, seeks) < 1e-5f);
+
+    // Dois personagens no mesmo clip, um para a frente e outro para tras:
+    // cada um fica com o seu cursor e o clip nao muda
+    TEST("Characters sharing a clip keep their own cursors");
+    {
+        const Animation &shared = anim;
+        const u32 channels = shared.GetChannelCount();
+        std::vector<AnimationCursor> first(channels), second(channels);
+        std::vector<Vec3> positions(channels);
+        std::vector<Quat> rotations(channels);
+        float worst = 0.0f;
+        for (size_t i = 0; i < forward.size(); i++)
+        {
+            shared.SamplePose(forward[i], positions.data(), rotations.data(), first.data());
+            for (u32 c = 0; c < channels; c++)
+                worst = Max(worst, (positions[c] - ReferencePosition(*anim.GetChannel(c), forward[i])).length());
+            shared.SamplePose(backward[i], positions.data(), rotations.data(), second.data());
+            for (u32 c = 0; c < channels; c++)
+                worst = Max(worst, (positions[c] - ReferencePosition(*anim.GetChannel(c), backward[i])).length());
+        }
+        const std::vector<AnimationKeyframe> &keys = anim.GetChannel(0)->keyframes;
+        ASSERT_TRUE(worst < 1e-5f && first[0].key == keys.size() - 2 && second[0].key == 0);
+    }
+
+    TEST("Samples outside the clip use the last key");
+    {
+        const AnimationChannel &channel = *anim.GetChannel(1);
+        ASSERT_TRUE(anim.InterpolatePosition(channel, end + 5.0f) == channel.keyframes.back().position &&
+                    anim.InterpolatePosition(channel, 0.0f) == channel.keyframes.back().position);
+    }
+
+    TEST("Repeated key times do not produce NaN");
+    {
+        AnimationChannel *channel = anim.AddChannel("repeated");
+        AnimationKeyframe key;
+        key.time = 1.0f;
+        channel->keyframes.push_back(key);
+        channel->keyframes.push_back(key);
+        key.time = 2.0f;
+        key.position = Vec3(1, 0, 0);
+        channel->keyframes.push_back(key);
+        const Vec3 p = anim.InterpolatePosition(*channel, 1.0f);
+        ASSERT_TRUE(p.x == p.x && p == Vec3(0, 0, 0));
+    }
+}
+
+void BenchKeyframeCursor(const char *filename)
+{
+    Animation anim;
+    std::ifstream probe(filename);
+    if (!probe || !anim.Load(filename))
+    {
+        std::cout << "  (skip " << filename << ")" << std::endl;
+        return;
+    }
+
+    u32 keys = 0;
+    for (u32 c = 0; c < anim.GetChannelCount(); c++)
+        keys = std::max(keys, (u32)anim.GetChannel(c)->keyframes.size());
+
+    // Playback a 60 fps durante o clip todo, todos os channels
+    const float step = anim.GetTicksPerSecond() / 60.0f;
+    std::vector<float> times;
+    for (float t = 0.0f; t <= anim.GetDuration(); t += step)
+        times.push_back(t);
+    std::vector<float> seeks(times.size());
+    for (size_t i = 0; i < seeks.size(); i++)
+        seeks[i] = times[(i * 7919u) % times.size()];
+
+    Vec3 sink(0.0f);
+    Timer tl;
+    for (float time : times)
+        for (u32 c = 0; c < anim.GetChannelCount(); c++)
+        {
+            sink += ReferencePosition(*anim.GetChannel(c), time);
+            sink += Vec3(ReferenceRotation(*anim.GetChannel(c), time).w);
+        }
+    const double msLinear = tl.Elapsed();
+
+    std::vector<AnimationCursor> cursors(anim.GetChannelCount());
+    Timer tc;
+    for (float time : times)
+        for (u32 c = 0; c < anim.GetChannelCount(); c++)
+        {
+            sink += anim.InterpolatePosition(*anim.GetChannel(c), time, &cursors[c]);
+            sink += Vec3(anim.InterpolateRotation(*anim.GetChannel(c), time, &cursors[c]).w);
+        }
+    const double msCursor = tc.Elapsed();
+
+    Timer ts;
+    for (float time : seeks)
+        for (u32 c = 0; c < anim.GetChannelCount(); c++)
+        {
+            sink += anim.InterpolatePosition(*anim.GetChannel(c), time, &cursors[c]);
+            sink += Vec3(anim.InterpolateRotation(*anim.GetChannel(c), time, &cursors[c]).w);
+        }
+    const double msSeek = ts.Elapsed();
+
+    std::cout << "  " << filename << " " << anim.GetChannelCount() << " channels, " << keys << " keys, "
+              << times.size() << " frames: linear " << msLinear << " ms, cursor " << msCursor
+              << " ms, random seeks " << msSeek << " ms" << std::endl;
+    volatile float keep = sink.x;
+    (void)keep;
+
+    TEST("Bench cursor matches linear scan");
+    ASSERT_TRUE(WorstSampleDelta(anim, times) < 1e-5f && WorstSampleDelta(anim, seeks) < 1e-5f);
+}
+
+// Angulo entre duas rotacoes pela corda (o acos do dot perde os angulos pequenos)
+float RotationDelta(const Quat &a, const Quat &b)
+{
+    const Quat qa = a.normalized();
+    Quat qb = b.normalized();
+    if (Quat::Dot(qa, qb) < 0.0f)
+        qb = -qb;
+    return 4.0f * std::asin(Min((qa - qb).length() * 0.5f, 1.0f));
+}
+
+// Pior erro de posicao e de rotacao (radianos) entre dois clips nos tempos dados
+void WorstClipError(Animation &a, Animation &b, const std::vector<float> &times, float &position, float &rotation)
+{
+    position = 0.0f;
+    rotation = 0.0f;
+    for (float time : times)
+    {
+        for (u32 c = 0; c < a.GetChannelCount(); c++)
+        {
+            const AnimationChannel &ca = *a.GetChannel(c);
+            const AnimationChannel &cb = *b.GetChannel(c);
+            position = Max(position, (a.InterpolatePosition(ca, time) - b.InterpolatePosition(cb, time)).length());
+            rotation = Max(rotation, RotationDelta(a.InterpolateRotation(ca, time), b.InterpolateRotation(cb, time)));
+        }
+    }
+}
+
+void TestClipCompression()
+{
+    std::cout << std::endl
+              << "--- Clip compression ---" << std::endl;
+
+    TEST("Smallest-three quaternion round trip");
+    {
+        float worst = 0.0f;
+        for (u32 i = 0; i < 1000; i++)
+        {
+            const Vec3 axis = Vec3(std::sin((float)i), std::cos((float)i * 1.3f), std::sin((float)i * 0.7f) + 0.1f);
+            const Quat q = Quat::FromAxisAngle(axis.normalized(), (float)i * 0.0131f - 6.0f);
+            const Quat r = PackedQuat::Pack(q).Unpack();
+            worst = Max(worst, RotationDelta(q, r));
+        }
+        ASSERT_TRUE(worst < 2e-4f && sizeof(PackedQuat) == 6);
+    }
+
+    // Canal 0 parado, canal 1 em linha reta, canal 2 com curva
+    Animation raw;
+    const char *names[3] = {"still", "linear", "curve"};
+    for (u32 c = 0; c < 3; c++)
+    {
+        AnimationChannel *channel = raw.AddChannel(names[c]);
+        for (u32 k = 0; k < 100; k++)
+        {
+            AnimationKeyframe key;
+            key.time = (float)k;
+            if (c == 1)
+            {
+                key.position = Vec3((float)k * 0.1f, 0.0f, 0.0f);
+                key.rotation = Quat::FromAxisAngle(Vec3(0, 1, 0), 0.3f);
+            }
+            else if (c == 2)
+            {
+                key.position = Vec3(std::sin((float)k * 0.1f), std::cos((float)k * 0.07f), 0.0f);
+                key.rotation = Quat::FromAxisAngle(Vec3(0, 0, 1), (float)k * 0.05f);
+            }
+            channel->keyframes.push_back(key);
+        }
+    }
+
+    Animation compressed = raw;
+    AnimationCompression settings;
+    compressed.Compress(settings);
+
+    TEST("Constant tracks keep one key");
+    {
+        const AnimationChannel &still = *compressed.GetChannel(0);
+        ASSERT_TRUE(compressed.IsCompressed() && still.positions.size() == 1 && still.rotations.size() == 1);
+    }
+
+    TEST("Linear track reduces to its end keys");
+    {
+        const AnimationChannel &linear = *compressed.GetChannel(1);
+        ASSERT_TRUE(linear.positions.size() == 2 && linear.rotations.size() == 1);
+    }
+
+    std::vector<float> times;
+    for (float t = -1.0f; t <= 100.0f; t += 0.05f)
+        times.push_back(t);
+
+    TEST("Compressed clip stays within tolerance");
+    {
+        float position, rotation;
+        WorstClipError(raw, compressed, times, position, rotation);
+        ASSERT_TRUE(position <= settings.positionTolerance * 1.01f && rotation <= settings.rotationTolerance + 2e-4f);
+    }
+
+    TEST("Compressed rotations match slerp in any order");
+    {
+        // Para tras e aos saltos: o par de chaves em cache no cursor tem de
+        // acompanhar, e outro cursor no mesmo clip nao lhe mexe
+        const AnimationChannel &curve = *compressed.GetChannel(2);
+        AnimationCursor cursor, other;
+        float worst = 0.0f;
+        for (size_t n = 0; n < times.size(); n++)
+        {
+            const float time = times[(n * 37) % times.size()];
+            if (time < 0.0f || time > curve.rotationTimes.back())
+                continue;
+            u32 i = 0;
+            while (i + 2 < curve.rotationTimes.size() && curve.rotationTimes[i + 1] < time)
+                i++;
+            const float t0 = curve.rotationTimes[i], t1 = curve.rotationTimes[i + 1];
+            const Quat r = Quat::Slerp(curve.rotations[i].Unpack(), curve.rotations[i + 1].Unpack(),
+                                       (time - t0) / (t1 - t0));
+            const Quat q = compressed.InterpolateRotation(curve, time, &cursor);
+            compressed.InterpolateRotation(curve, curve.rotationTimes.back() - time, &other);
+            worst = Max(worst, 1.0f - std::fabs(Quat::Dot(q, r)));
+        }
+        ASSERT_TRUE(worst < 1e-6f && curve.rotations.size() > 2);
+    }
+
+    TEST("Compressed clip uses less memory");
+    ASSERT_TRUE(compressed.GetMemorySize() * 4 < raw.GetMemorySize());
+
+    TEST("CCHN chunk round trip");
+    {
+        const char *path = "/tmp/phoenix_test_clip.anim";
+        AnimWriter writer;
+        Animation loaded;
+        bool ok = writer.Save(&compressed, path) && loaded.Load(path) && loaded.IsCompressed() &&
+                  loaded.GetChannelCount() == compressed.GetChannelCount() &&
+                  loaded.GetMemorySize() == compressed.GetMemorySize();
+        if (ok)
+        {
+            float position, rotation;
+            WorstClipError(compressed, loaded, times, position, rotation);
+            ok = position == 0.0f && rotation < 1e-3f;
+        }
+        std::remove(path);
+        ASSERT_TRUE(ok);
+    }
+}
+
+void BenchClipCompression(const char *filename)
+{
+    Animation raw;
+    std::ifstream probe(filename);
+    if (!probe || !raw.Load(filename))
+    {
+        std::cout << "  (skip " << filename << ")" << std::endl;
+        return;
+    }
+
+    Animation compressed = raw;
+    Timer tc;
+    compressed.Compress();
+    const double msCompress = tc.Elapsed();
+
+    u32 positionKeys = 0, rotationKeys = 0, constant = 0;
+    for (u32 c = 0; c < compressed.GetChannelCount(); c++)
+    {
+        const AnimationChannel &channel = *compressed.GetChannel(c);
+        positionKeys += (u32)channel.positions.size();
+        rotationKeys += (u32)channel.rotations.size();
+        constant += (channel.positions.size() == 1) + (channel.rotations.size() == 1);
+    }
+
+    const float step = raw.GetTicksPerSecond() / 60.0f;
+    std::vector<float> times;
+    for (float t = 0.0f; t <= raw.GetDuration(); t += step)
+        times.push_back(t);
+
+    Vec3 sink(0.0f);
+    Timer tr;
+    for (float time : times)
+        for (u32 c = 0; c < raw.GetChannelCount(); c++)
+            sink += raw.InterpolatePosition(*raw.GetChannel(c), time) +
+                    Vec3(raw.InterpolateRotation(*raw.GetChannel(c), time).w);
+    const double msRaw = tr.Elapsed();
+
+    Timer ts;
+    for (float time : times)
+        for (u32 c = 0; c < compressed.GetChannelCount(); c++)
+            sink += compressed.InterpolatePosition(*compressed.GetChannel(c), time) +
+                    Vec3(compressed.InterpolateRotation(*compressed.GetChannel(c), time).w);
+    const double msCompressed = ts.Elapsed();
+    volatile float keep = sink.x;
+    (void)keep;
+
+    float position, rotation;
+    WorstClipError(raw, compressed, times, position, rotation);
+
+    std::cout << "  " << filename << " " << raw.GetMemorySize() << " -> " << compressed.GetMemorySize() << " bytes ("
+              << (float)raw.GetMemorySize() / Max((float)compressed.GetMemorySize(), 1.0f) << "x), " << positionKeys
+              << " position + " << rotationKeys << " rotation keys, " << constant << " constant tracks, error "
+              << position << " / " << rotation << " rad (" << msCompress << " ms); sample raw " << msRaw
+              << " ms, compressed " << msCompressed << " ms" << std::endl;
+
+    TEST("Bench compressed clip within tolerance");
+    ASSERT_TRUE(position <= AnimationCompression().positionTolerance * 1.01f &&
+                rotation <= AnimationCompression().rotationTolerance + 2e-4f);
+}
+
+void TestBakedPose()
+{
+    std::cout << std::endl
+              << "--- Baked pose ---" << std::endl;
+
+    Animation anim;
+    BuildTestClip(anim, 6, 40);
+    const float end = anim.GetChannel(0)->keyframes.back().time;
+    anim.SetDuration(end);
+    anim.SetTicksPerSecond(25.0f);
+    const u32 channels = anim.GetChannelCount();
+
+    std::vector<float> seeks;
+    for (u32 i = 0; i < 300; i++)
+        seeks.push_back((float)((i * 7919u) % 1000u) / 1000.0f * end);
+
+    // Referencia antes de fazer bake
+    std::vector<Vec3> exactPositions(channels);
+    std::vector<Quat> exactRotations(channels);
+    std::vector<Vec3> positions(channels);
+    std::vector<Quat> rotations(channels);
+    const size_t rawBytes = anim.GetMemorySize();
+
+    const float rate = 25.0f * 8.0f;
+    anim.Bake(rate);
+
+    TEST("Baked rows match the tracks");
+    {
+        Animation exact = anim;
+        exact.Unbake();
+        float worst = 0.0f;
+        for (float t = 0.0f; t <= end; t += 25.0f / rate)
+        {
+            exact.SamplePose(t, exactPositions.data(), exactRotations.data());
+            anim.SamplePose(t, positions.data(), rotations.data());
+            for (u32 c = 0; c < channels; c++)
+                worst = Max(worst, Max((positions[c] - exactPositions[c]).length(),
+                                       RotationDelta(rotations[c], exactRotations[c])));
+        }
+        ASSERT_TRUE(anim.IsBaked() && worst < 1e-3f);
+    }
+
+    TEST("Baked pose matches per-channel sample");
+    {
+        float worst = 0.0f;
+        for (float t : seeks)
+        {
+            anim.SamplePose(t, positions.data(), rotations.data());
+            for (u32 c = 0; c < channels; c++)
+            {
+                const AnimationChannel &channel = *anim.GetChannel(c);
+                worst = Max(worst, (positions[c] - anim.InterpolatePosition(channel, t)).length());
+                worst = Max(worst, RotationDelta(rotations[c], anim.InterpolateRotation(channel, t)));
+            }
+        }
+        ASSERT_TRUE(worst < 1e-5f);
+    }
+
+    TEST("Baked rotations stay normalized between rows");
+    {
+        float worst = 0.0f;
+        for (float t : seeks)
+        {
+            anim.SamplePose(t + 0.37f * 25.0f / rate, positions.data(), rotations.data());
+            for (u32 c = 0; c < channels; c++)
+                worst = Max(worst, std::fabs(rotations[c].length() - 1.0f));
+        }
+        ASSERT_TRUE(worst < 1e-5f);
+    }
+
+    TEST("Baked sample clamps outside the clip");
+    {
+        std::vector<Vec3> first(channels), last(channels);
+        std::vector<Quat> scratch(channels);
+        anim.SamplePose(0.0f, first.data(), scratch.data());
+        anim.SamplePose(end * 2.0f, last.data(), scratch.data());
+        anim.SamplePose(-3.0f, positions.data(), rotations.data());
+        bool ok = positions[2] == first[2];
+        anim.SamplePose(std::nanf(""), positions.data(), rotations.data());
+        ok = ok && positions[2] == first[2] && last[2] == anim.InterpolatePosition(*anim.GetChannel(2), end * 3.0f);
+        ASSERT_TRUE(ok);
+    }
+
+    TEST("Bake with a fractional row count");
+    {
+        // 0..10 linear a 0.25 linhas por tick: 2.5 intervalos, 4 linhas
+        Animation linear;
+        AnimationChannel *channel = linear.AddChannel("linear");
+        for (u32 k = 0; k <= 10; k++)
+        {
+            AnimationKeyframe key;
+            key.time = (float)k;
+            key.position = Vec3((float)k, 0.0f, 0.0f);
+            channel->keyframes.push_back(key);
+        }
+        linear.SetDuration(10.0f);
+        linear.SetTicksPerSecond(1.0f);
+        linear.Bake(0.25f);
+
+        const float times[] = {0.0f, 3.0f, 9.0f, 9.5f, 10.0f};
+        float worst = 0.0f;
+        for (float t : times)
+        {
+            linear.SamplePose(t, positions.data(), rotations.data());
+            worst = Max(worst, std::fabs(positions[0].x - t));
+        }
+        ASSERT_TRUE(linear.IsBaked() && worst < 1e-4f);
+    }
+
+    TEST("Unbake restores exact sampling");
+    {
+        const size_t bakedBytes = anim.GetMemorySize();
+        anim.Unbake();
+        ASSERT_TRUE(!anim.IsBaked() && bakedBytes > rawBytes && anim.GetMemorySize() == rawBytes &&
+                    WorstSampleDelta(anim, seeks) < 1e-5f);
+    }
+}
+
+void BenchBakedPose(const char *filename)
+{
+    Animation anim;
+    std::ifstream probe(filename);
+    if (!probe || !anim.Load(filename))
+    {
+        std::cout << "  (skip " << filename << ")" << std::endl;
+        return;
+    }
+
+    const u32 channels = anim.GetChannelCount();
+    std::vector<Vec3> positions(channels);
+    std::vector<Quat> rotations(channels);
+    std::vector<Vec3> exactPositions(channels);
+    std::vector<Quat> exactRotations(channels);
+
+    // Varias passagens de playback a 60 fps
+    const float step = anim.GetTicksPerSecond() / 60.0f;
+    std::vector<float> times;
+    for (int pass = 0; pass < 10; pass++)
+        for (float t = 0.0f; t <= anim.GetDuration(); t += step)
+            times.push_back(t);
+
+    Vec3 sink(0.0f);
+    const size_t rawBytes = anim.GetMemorySize();
+    Timer tr;
+    for (float time : times)
+    {
+        anim.SamplePose(time, positions.data(), rotations.data());
+        sink += positions[channels / 2];
+    }
+    const double msRaw = tr.Elapsed();
+
+    Animation exact = anim;
+    anim.Bake(30.0f);
+    Timer tb;
+    for (float time : times)
+    {
+        anim.SamplePose(time, positions.data(), rotations.data());
+        sink += positions[channels / 2];
+    }
+    const double msBaked = tb.Elapsed();
+    volatile float keep = sink.x;
+    (void)keep;
+
+    float worst = 0.0f;
+    for (size_t i = 0; i < times.size(); i += 7)
+    {
+        exact.SamplePose(times[i], exactPositions.data(), exactRotations.data());
+        anim.SamplePose(times[i], positions.data(), rotations.data());
+        for (u32 c = 0; c < channels; c++)
+            worst = Max(worst, RotationDelta(rotations[c], exactRotations[c]));
+    }
+
+    std::cout << "  " << filename << " " << times.size() << " poses: tracks " << msRaw << " ms, baked 30 fps "
+              << msBaked << " ms (" << msRaw / Max((float)msBaked, 1e-6f) << "x), " << rawBytes << " -> "
+              << anim.GetMemorySize() << " bytes, rotation error " << worst << " rad" << std::endl;
+
+    TEST("Bench baked pose follows the clip");
+    ASSERT_TRUE(anim.IsBaked() && worst < 0.05f);
+}
+
+// Clip com a mesma pose em todos os bones do mesh
+Animation *BuildPoseClip(const Mesh &mesh, const Vec3 &position, const Quat &rotation)
+{
+    Animation *anim = new Animation();
+    anim->SetDuration(10.0f);
+    for (u32 b = 0; b < mesh.GetBoneCount(); b++)
+    {
+        AnimationChannel *channel = anim->AddChannel(mesh.GetBone(b)->name);
+        AnimationKeyframe key;
+        key.position = position;
+        key.rotation = rotation;
+        channel->keyframes.push_back(key);
+        key.time = 10.0f;
+        channel->keyframes.push_back(key);
+    }
+    return anim;
+}
+
+bool BoneFollows(const Mesh &mesh, u32 bone, const Vec3 &position, const Quat &rotation)
+{
+    const Mat4 expected = Mat4::Translation(position) * rotation.toMat4();
+    return WorstMatrixDelta(mesh.GetBone(bone)->transform, expected) < 1e-4f;
+}
+
+void TestAnimatorBlend()
+{
+    std::cout << std::endl
+              << "--- Animator blend ---" << std::endl;
+
+    Mesh mesh;
+    BuildShuffledSkeleton(mesh, 15);
+    const Vec3 posA(1.0f, 0.0f, 0.0f), posB(0.0f, 2.0f, 0.0f);
+    const Quat rotA = Quat::Identity(), rotB = Quat::FromAxisAngle(Vec3(0, 1, 0), 0.8f);
+
+    // Bone 13 do ficheiro e o no 1 da arvore: metade do esqueleto
+    const u32 root = 13;
+    std::vector<bool> inSubtree(mesh.GetBoneCount(), false);
+    for (u32 b = 0; b < mesh.GetBoneCount(); b++)
+        for (s32 p = (s32)b; p >= 0; p = mesh.GetBone(p)->parentIndex)
+            if ((u32)p == root)
+                inSubtree[b] = true;
+
+    TEST("Masked layer only drives its subtree");
+    {
+        Animator animator(&mesh);
+        AnimationLayer *base = animator.AddLayer();
+        base->AddAnimation("a", BuildPoseClip(mesh, posA, rotA));
+        base->Play("a", PlayMode::Loop, 0.0f);
+        AnimationLayer *upper = animator.AddLayer();
+        upper->AddAnimation("b", BuildPoseClip(mesh, posB, rotB));
+        upper->Play("b", PlayMode::Loop, 0.0f);
+        upper->SetBoneMask(mesh.GetBone(root)->name);
+        animator.Update(0.016f);
+
+        bool ok = true;
+        u32 masked = 0;
+        for (u32 b = 0; b < mesh.GetBoneCount(); b++)
+        {
+            ok = ok && (inSubtree[b] ? BoneFollows(mesh, b, posB, rotB) : BoneFollows(mesh, b, posA, rotA));
+            masked += inSubtree[b] ? 1 : 0;
+        }
+        ASSERT_TRUE(ok && masked > 1 && masked < mesh.GetBoneCount());
+    }
+
+    TEST("Layer weight blends the poses");
+    {
+        Animator animator(&mesh);
+        AnimationLayer *base = animator.AddLayer();
+        base->AddAnimation("a", BuildPoseClip(mesh, posA, rotA));
+        base->Play("a", PlayMode::Loop, 0.0f);
+        AnimationLayer *over = animator.AddLayer();
+        over->AddAnimation("b", BuildPoseClip(mesh, posB, rotB));
+        over->Play("b", PlayMode::Loop, 0.0f);
+        over->SetWeight(0.5f);
+        animator.Update(0.016f);
+        ASSERT_TRUE(BoneFollows(mesh, 3, Vec3::Lerp(posA, posB, 0.5f), Quat::Slerp(rotA, rotB, 0.5f)));
+    }
+
+    TEST("Animator skins once per update");
+    {
+        Animator animator(&mesh);
+        for (int l = 0; l < 3; l++)
+        {
+            AnimationLayer *layer = animator.AddLayer();
+            layer->AddAnimation("a", BuildPoseClip(mesh, posA + Vec3((float)l, 0.0f, 0.0f), rotB));
+            layer->Play("a", PlayMode::Loop, 0.0f);
+        }
+        const u32 version = mesh.GetPoseVersion();
+        animator.Update(0.016f);
+        const u32 changed = mesh.GetPoseVersion();
+        animator.Update(0.016f);
+        ASSERT_TRUE(changed == version + 1 && mesh.GetPoseVersion() == changed &&
+                    BoneFollows(mesh, 0, posA + Vec3(2.0f, 0.0f, 0.0f), rotB));
+    }
+
+    TEST("Cross-fade blends both clips by bone");
+    {
+        Animator animator(&mesh);
+        AnimationLayer *layer = animator.AddLayer();
+        layer->AddAnimation("a", BuildPoseClip(mesh, posA, rotA));
+        layer->AddAnimation("b", BuildPoseClip(mesh, posB, rotB));
+        layer->Play("a", PlayMode::Loop, 0.0f);
+        animator.Update(0.016f);
+        layer->Play("b", PlayMode::Loop, 1.0f);
+        animator.Update(0.5f);
+        const bool half = BoneFollows(mesh, 7, Vec3::Lerp(posA, posB, 0.5f), Quat::Slerp(rotA, rotB, 0.5f));
+        animator.Update(0.6f);
+        ASSERT_TRUE(half && BoneFollows(mesh, 7, posB, rotB));
+    }
+}
+
+void TestSkeletonInstance()
+{
+    std::cout << std::endl
+              << "--- Skeleton instance ---" << std::endl;
+
+    Mesh mesh;
+    BuildShuffledSkeleton(mesh, 40);
+    const Vec3 posA(1.0f, 0.0f, 0.0f), posB(0.0f, 2.0f, 0.0f);
+    const Quat rotA = Quat::FromAxisAngle(Vec3(1, 0, 0), 0.3f), rotB = Quat::FromAxisAngle(Vec3(0, 1, 0), 0.8f);
+
+    TEST("Instance pose matches the mesh pose");
+    {
+        SkeletonInstance instance(&mesh);
+        for (u32 b = 0; b < mesh.GetBoneCount(); b += 3)
+        {
+            mesh.SetBoneTransform(b, posA, rotA);
+            instance.SetBoneTransform(b, posA, rotA);
+        }
+        mesh.UpdateBonePalette();
+        instance.UpdateBonePalette();
+        float worst = 0.0f;
+        for (u32 b = 0; b < mesh.GetBoneCount(); b++)
+            worst = std::max(worst, WorstMatrixDelta(mesh.GetBoneGlobals()[b], instance.GetBoneGlobals()[b]));
+        mesh.ResetBones();
+        mesh.UpdateBonePalette();
+        ASSERT_TRUE(worst < 1e-5f && instance.GetBonePalette().size() == mesh.GetBoneCount());
+    }
+
+    TEST("Instances keep independent poses");
+    {
+        SkeletonInstance a(&mesh), b(&mesh);
+        a.SetBoneTransform(5, posA, rotA);
+        b.SetBoneTransform(5, posB, rotB);
+        a.UpdateBonePalette();
+        b.UpdateBonePalette();
+        const u32 versionA = a.GetPoseVersion();
+        b.SetBoneStatic(5);
+        b.UpdateBonePalette();
+        a.UpdateBonePalette();
+        const Mat4 &localA = a.GetBoneGlobals()[5];
+        const Mat4 expected = mesh.GetBone(5)->parent ? mesh.GetBoneGlobals()[mesh.GetBone(5)->parentIndex] *
+                                                            Mat4::Translation(posA) * rotA.toMat4()
+                                                      : Mat4::Translation(posA) * rotA.toMat4();
+        ASSERT_TRUE(a.GetPoseVersion() == versionA && b.GetPoseVersion() != versionA &&
+                    WorstMatrixDelta(localA, expected) < 1e-5f &&
+                    WorstMatrixDelta(b.GetBoneGlobals()[5], mesh.GetBoneGlobals()[5]) < 1e-5f);
+    }
+
+    TEST("Instance memory scales with bone count");
+    {
+        // Mesma geometria; o mesh grande tem 4x os bones e 2x os indices
+        std::vector<Vertex> vertices;
+        std::vector<u32> indices;
+        std::vector<VertexSkin> skin;
+        BuildShuffledGrid(16, vertices, indices);
+        BuildRandomSkin((u32)vertices.size(), 10, skin);
+        std::vector<u32> doubled(indices);
+        doubled.insert(doubled.end(), indices.begin(), indices.end());
+
+        Mesh small, large;
+        BuildShuffledSkeleton(small, 10);
+        BuildShuffledSkeleton(large, 40);
+        AddFilledBuffer(small, vertices, indices)->SetSkinData(skin);
+        AddFilledBuffer(large, vertices, doubled)->SetSkinData(skin);
+        small.Build();
+        large.Build();
+
+        // Medido com a pose ja na GPU (o que o Render(instance) desenha),
+        // com os VBOs da instancia. O Render precisa do Driver, que o GL
+        // nulo nao tem
+        SkeletonInstance a(&small), b(&large);
+        a.SetBoneTransform(0, posA, rotA);
+        b.SetBoneTransform(0, posA, rotA);
+        const size_t before = NullGL::LiveBytes();
+        small.UpdateSkinning(&a);
+        const size_t gpuA = NullGL::LiveBytes() - before;
+        large.UpdateSkinning(&b);
+        const size_t gpuB = NullGL::LiveBytes() - before - gpuA;
+
+        const SkinnedOutput *output = b.GetOutput(large.GetBuffer(0));
+        const size_t perBone = (b.GetMemorySize() - a.GetMemorySize()) / 30;
+        ASSERT_TRUE(output && gpuA > 0 && gpuA == gpuB && output->gpuBytes == gpuB &&
+                    b.GetMemorySize() > a.GetMemorySize() && a.GetMemorySize() > gpuA && perBone < 256);
+        std::cout << "  " << b.GetMemorySize() << " bytes for " << large.GetBoneCount() << " bones ("
+                  << gpuB << " in VBOs), " << perBone << " per bone" << std::endl;
+    }
+
+    TEST("ClearLods drops the instance outputs");
+    {
+        Mesh lodMesh;
+        BuildShuffledSkeleton(lodMesh, 8);
+        std::vector<Vertex> vertices;
+        std::vector<u32> indices;
+        std::vector<VertexSkin> skin;
+        BuildShuffledGrid(16, vertices, indices);
+        BuildRandomSkin((u32)vertices.size(), 8, skin);
+        AddFilledBuffer(lodMesh, vertices, indices)->SetSkinData(skin);
+        lodMesh.GenerateLods(std::vector<float>(1, 0.5f), 0.05f);
+        lodMesh.SetLod(1);
+
+        SkeletonInstance instance(&lodMesh);
+        instance.SetBoneTransform(0, posA, rotA);
+        lodMesh.UpdateSkinning(&instance);
+        const MeshBuffer *lodBuffer = lodMesh.GetLodBuffer(1, 0);
+        const bool skinned = instance.GetOutput(lodBuffer) != nullptr;
+
+        // O endereco do buffer apagado pode voltar num buffer novo
+        lodMesh.ClearLods();
+        const bool dropped = instance.GetOutput(lodBuffer) == nullptr;
+        instance.SetBoneTransform(0, posB, rotB);
+        lodMesh.UpdateSkinning(&instance);
+        ASSERT_TRUE(skinned && dropped && instance.GetOutput(lodMesh.GetBuffer(0)) != nullptr);
+    }
+
+    TEST("Animator drives an instance with shared clips");
+    {
+        Animation *clip = BuildPoseClip(mesh, posB, rotB);
+        const u32 version = mesh.GetPoseVersion();
+        SkeletonInstance first(&mesh), second(&mesh);
+        {
+            Animator animatorA(&mesh), animatorB(&mesh);
+            animatorA.SetInstance(&first);
+            animatorB.SetInstance(&second);
+            animatorA.AddLayer()->AddAnimation("b", clip, false);
+            animatorB.AddLayer()->AddAnimation("b", clip, false);
+            animatorA.GetLayer(0)->Play("b", PlayMode::Loop, 0.0f);
+            animatorA.Update(0.016f);
+        }
+        first.UpdateBonePalette();
+        second.UpdateBonePalette();
+        const Mat4 root = Mat4::Translation(posB) * rotB.toMat4();
+        u32 rootBone = 0;
+        while (mesh.GetBone(rootBone)->parent)
+            rootBone++;
+        ASSERT_TRUE(mesh.GetPoseVersion() == version && !mesh.GetBone(rootBone)->hasAnimation &&
+                    WorstMatrixDelta(first.GetBoneGlobals()[rootBone], root) < 1e-5f &&
+                    WorstMatrixDelta(second.GetBoneGlobals()[rootBone], mesh.GetBoneGlobals()[rootBone]) < 1e-5f &&
+                    clip->GetChannelCount() == mesh.GetBoneCount());
+        delete clip;
+    }
+}
+
+void TestAnimationLibrary(const char *filename)
+{
+    std::cout << std::endl
+              << "--- Animation library: " << filename << " ---" << std::endl;
+
+    std::ifstream probe(filename);
+    if (!probe.good())
+    {
+        std::cout << "  (skip: file not found)" << std::endl;
+        return;
+    }
+    probe.close();
+
+    // Dois esqueletos com os bones do clip em ordens diferentes
+    Animation reference;
+    reference.Load(filename);
+    const u32 channels = reference.GetChannelCount();
+    Mesh meshA, meshB;
+    for (u32 c = 0; c < channels; c++)
+    {
+        meshA.AddBone(reference.GetChannel(c)->boneName);
+        meshB.AddBone(reference.GetChannel(channels - 1 - c)->boneName);
+    }
+    meshA.CalculateBoneMatrices();
+    meshB.CalculateBoneMatrices();
+
+    AnimationLibrary &library = AnimationLibrary::Instance();
+    const size_t before = library.GetCount();
+    std::vector<AnimationLayer *> layers;
+    Animation *shared = nullptr;
+    bool same = true;
+    for (u32 i = 0; i < 100; i++)
+    {
+        layers.push_back(new AnimationLayer(i % 2 ? &meshB : &meshA));
+        Animation *anim = layers.back()->LoadAnimation("idle", filename);
+        shared = shared ? shared : anim;
+        same = same && anim == shared;
+    }
+
+    TEST("100 layers share one parsed clip");
+    ASSERT_TRUE(same && shared && library.GetCount() == before + 1 && library.GetRefCount(shared) == 100);
+    std::cout << "  one copy: " << library.GetMemorySize() / 1024 << " KB for 100 layers" << std::endl;
+
+    TEST("Same content under another path is shared");
+    {
+        const char *path = "/tmp/phoenix_library_copy.anim";
+        {
+            std::ifstream source(filename, std::ios::binary);
+            std::ofstream copy(path, std::ios::binary);
+            copy << source.rdbuf();
+        }
+        AnimationLayer layer(&meshA);
+        Animation *anim = layer.LoadAnimation("copy", path);
+        std::remove(path);
+        ASSERT_TRUE(anim == shared && library.GetRefCount(shared) == 101);
+    }
+
+    TEST("Shared content survives the first file being deleted");
+    {
+        // O clip partilhado e reconhecido pelo digest, sem reler o primeiro ficheiro
+        const char *first = "/tmp/phoenix_library_first.anim";
+        const char *second = "/tmp/phoenix_library_second.anim";
+        std::vector<char> bytes;
+        {
+            std::ifstream source(filename, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(source), std::istreambuf_iterator<char>());
+            bytes.push_back(0); // conteudo que nenhum clip carregado tem
+            std::ofstream(first, std::ios::binary).write(bytes.data(), (std::streamsize)bytes.size());
+        }
+        Animation *a = library.Acquire(first);
+        std::remove(first);
+        std::ofstream(second, std::ios::binary).write(bytes.data(), (std::streamsize)bytes.size());
+        Animation *b = library.Acquire(second);
+        std::remove(second);
+        ASSERT_TRUE(a && a != shared && b == a && library.GetRefCount(a) == 2);
+        library.Release(a);
+        library.Release(b);
+    }
+
+    TEST("Bone binding is per skeleton");
+    {
+        layers[0]->Play("idle", PlayMode::Loop, 0.0f);
+        layers[1]->Play("idle", PlayMode::Loop, 0.0f);
+        layers[0]->Update(0.1f);
+        layers[1]->Update(0.1f);
+        float worst = 0.0f;
+        for (u32 b = 0; b < channels; b++)
+        {
+            const Bone *bone = meshA.GetBone(b);
+            worst = std::max(worst, WorstMatrixDelta(bone->transform, meshB.GetBone(channels - 1 - b)->transform));
+        }
+        ASSERT_TRUE(channels > 0 && worst < 1e-5f && meshA.GetBone(0)->hasAnimation &&
+                    shared->GetChannel(0)->boneIndex == (u32)-1);
+    }
+
+    TEST("UnloadAll keeps clips in use");
+    {
+        library.UnloadAll();
+        ASSERT_TRUE(library.GetCount() == before + 1 && library.GetRefCount(shared) == 100 &&
+                    shared->GetChannelCount() == channels);
+    }
+
+    TEST("Last release frees the clip");
+    {
+        for (AnimationLayer *layer : layers)
+            delete layer;
+        ASSERT_TRUE(library.GetCount() == before && library.GetRefCount(shared) == 0);
+    }
+}
+
+// Terreno da BuildSoupGrid mais triangulos soltos por cima (props)
+void BuildCollisionLevel(int size, u32 props, std::vector<Triangle> &triangles)
+{
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    BuildSoupGrid(size, vertices, indices);
+    triangles.clear();
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        const Vertex &a = vertices[indices[i]], &b = vertices[indices[i + 1]], &c = vertices[indices[i + 2]];
+        triangles.push_back(Triangle(Vec3(a.x, a.y, a.z), Vec3(b.x, b.y, b.z), Vec3(c.x, c.y, c.z)));
+    }
+
+    u32 state = 777;
+    auto next = [&state]()
+    {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) / 16777216.0f;
+    };
+    for (u32 i = 0; i < props; i++)
+    {
+        const Vec3 center(next() * size, 1.0f + next() * 4.0f, next() * size);
+        triangles.push_back(Triangle(center, center + Vec3(next() - 0.5f, next(), next() - 0.5f),
+                                     center + Vec3(next() - 0.5f, next() - 0.5f, next())));
+    }
+}
+
+// Scan linear, como o rayCast antes da BVH
+bool ReferenceRayCast(const std::vector<Triangle> &triangles, const Vec3 &origin, const Vec3 &direction,
+                      float maxDistance, float &outT)
+{
+    bool found = false;
+    outT = maxDistance;
+    for (const Triangle &tri : triangles)
+    {
+        float t, u, v;
+        if (tri.intersectRay(origin, direction, t, u, v) && t > 0 && t < outT)
+        {
+            outT = t;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void BuildTestRays(int size, u32 count, std::vector<Vec3> &origins, std::vector<Vec3> &directions)
+{
+    u32 state = 4242;
+    auto next = [&state]()
+    {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) / 16777216.0f;
+    };
+    origins.resize(count);
+    directions.resize(count);
+    for (u32 i = 0; i < count; i++)
+    {
+        origins[i] = Vec3(next() * size, 2.0f + next() * 6.0f, next() * size);
+        // Metade para baixo (chao), metade quase horizontal (linha de vista)
+        const float down = i % 2 ? -1.0f : -0.05f;
+        directions[i] = Vec3(next() - 0.5f, down, next() - 0.5f).normalized();
+    }
+}
+
+void TestCollisionBVH()
+{
+    std::cout << std::endl
+              << "--- Collision BVH ---" << std::endl;
+
+    std::vector<Triangle> triangles;
+    BuildCollisionLevel(40, 500, triangles);
+    CollisionSystem world;
+    world.addTriangles(triangles);
+
+    std::vector<Vec3> origins, directions;
+    BuildTestRays(40, 2000, origins, directions);
+
+    TEST("Ray casts match the linear scan");
+    {
+        u32 mismatches = 0, hits = 0;
+        for (size_t i = 0; i < origins.size(); i++)
+        {
+            CollisionInfo info;
+            float t;
+            const bool expected = ReferenceRayCast(triangles, origins[i], directions[i], 100.0f, t);
+            const bool found = world.rayCast(origins[i], directions[i], 100.0f, info);
+            if (found != expected || (found && std::fabs(info.nearestDistance - t) > 1e-5f))
+                mismatches++;
+            hits += found ? 1 : 0;
+        }
+        ASSERT_TRUE(mismatches == 0 && hits > origins.size() / 2);
+    }
+
+    TEST("Parallel build gives the same hits");
+    {
+        JobSystem &jobs = JobSystem::Instance();
+        jobs.SetWorkerCount(4);
+        CollisionSystem parallel;
+        parallel.addTriangles(triangles);
+        bool same = true;
+        for (size_t i = 0; i < origins.size(); i++)
+        {
+            CollisionInfo a, b;
+            const bool hitA = world.rayCast(origins[i], directions[i], 100.0f, a);
+            const bool hitB = parallel.rayCast(origins[i], directions[i], 100.0f, b);
+            same = same && hitA == hitB && a.nearestDistance == b.nearestDistance;
+        }
+        jobs.SetWorkerCount(0);
+        ASSERT_TRUE(same);
+    }
+
+    TEST("Point inside a closed box");
+    {
+        // Cubo unitario, 12 triangulos
+        const Vec3 c[8] = {Vec3(0, 0, 0), Vec3(1, 0, 0), Vec3(1, 1, 0), Vec3(0, 1, 0),
+                           Vec3(0, 0, 1), Vec3(1, 0, 1), Vec3(1, 1, 1), Vec3(0, 1, 1)};
+        const int faces[6][4] = {{0, 1, 2, 3}, {5, 4, 7, 6}, {4, 0, 3, 7}, {1, 5, 6, 2}, {3, 2, 6, 7}, {4, 5, 1, 0}};
+        CollisionSystem box;
+        for (const auto &f : faces)
+        {
+            box.addTriangle(Triangle(c[f[0]], c[f[1]], c[f[2]]));
+            box.addTriangle(Triangle(c[f[0]], c[f[2]], c[f[3]]));
+        }
+        ASSERT_TRUE(box.pointInside(Vec3(0.4f, 0.3f, 0.6f)) && !box.pointInside(Vec3(1.5f, 0.5f, 0.5f)) &&
+                    !box.pointInside(Vec3(-0.2f, 0.1f, 0.3f)));
+    }
+
+    TEST("Ellipsoid rests on the floor at its radius");
+    {
+        CollisionSystem floor;
+        floor.addTriangle(Triangle(Vec3(-50, 0, -50), Vec3(-50, 0, 50), Vec3(50, 0, 50)));
+        floor.addTriangle(Triangle(Vec3(-50, 0, -50), Vec3(50, 0, 50), Vec3(50, 0, -50)));
+        const Vec3 radius(0.5f, 2.0f, 0.5f);
+        Vec3 position(0.0f, 3.0f, 0.0f);
+        bool grounded = false;
+        for (int frame = 0; frame < 60; frame++)
+            position = floor.collideAndSlide(position, Vec3(0.05f, 0.0f, 0.0f), radius, Vec3(0, -0.2f, 0), grounded);
+        ASSERT_TRUE(grounded && std::fabs(position.y - radius.y) < 0.01f && position.x > 2.9f);
+    }
+
+    TEST("Slide stops at a wall");
+    {
+        CollisionSystem walls;
+        walls.addTriangles(triangles);
+        walls.addTriangle(Triangle(Vec3(20, -5, 0), Vec3(20, -5, 40), Vec3(20, 10, 40)));
+        walls.addTriangle(Triangle(Vec3(20, -5, 0), Vec3(20, 10, 40), Vec3(20, 10, 0)));
+        Vec3 position(15.0f, 3.0f, 20.5f);
+        for (int frame = 0; frame < 100; frame++)
+            position = walls.sphereSlide(position, Vec3(0.2f, 0.0f, 0.0f), 0.5f);
+        ASSERT_TRUE(position.x < 19.5f + 0.01f && position.x > 19.0f);
+    }
+}
+
+void TestCollisionTriangles()
+{
+    std::cout << std::endl
+              << "--- Collision triangles (" << CollisionTriangles::getKernelName() << ") ---" << std::endl;
+
+    std::vector<Triangle> triangles;
+    BuildCollisionLevel(20, 300, triangles);
+    std::vector<u32> order(triangles.size());
+    for (u32 i = 0; i < order.size(); i++)
+        order[i] = (u32)order.size() - 1 - i;
+    CollisionTriangles store;
+    store.build(triangles, order);
+
+    u32 state = 99;
+    auto next = [&state]()
+    {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) / 16777216.0f;
+    };
+
+    TEST("Precomputed planes and barycentrics match Triangle");
+    {
+        float worst = 0.0f;
+        for (u32 i = 0; i < store.size(); i++)
+        {
+            const Triangle &tri = triangles[store.source[i]];
+            const Plane3D plane = tri.getPlane();
+            const Vec3 point = tri.v0 * 0.2f + tri.v1 * 0.3f + tri.v2 * 0.5f + Vec3(next(), next(), next()) * 0.1f;
+            const Vec3 bary = tri.getBarycentricCoords(point);
+            const Vec3 p = point - tri.v0;
+            const float v = p.x * store.bux[i] + p.y * store.buy[i] + p.z * store.buz[i];
+            const float w = p.x * store.bwx[i] + p.y * store.bwy[i] + p.z * store.bwz[i];
+            worst = std::max(worst, std::fabs(v - bary.y) + std::fabs(w - bary.z));
+            worst = std::max(worst, std::fabs(store.nx[i] - plane.normal.x) + std::fabs(store.ny[i] - plane.normal.y) +
+                                        std::fabs(store.nz[i] - plane.normal.z) + std::fabs(store.d[i] - plane.d));
+            worst = std::max(worst, std::fabs(store.invEdge1[i] * (tri.v2 - tri.v1).lengthSquared() - 1.0f));
+        }
+        ASSERT_TRUE(worst < 1e-4f);
+    }
+
+    TEST("SIMD plane reject matches the scalar test");
+    {
+        u32 mismatches = 0, rejected = 0, total = 0;
+        for (int sweep = 0; sweep < 200; sweep++)
+        {
+            const Vec3 from(next() * 20.0f, next() * 6.0f - 1.0f, next() * 20.0f);
+            const Vec3 to = from + Vec3(next() - 0.5f, next() - 0.5f, next() - 0.5f) * 2.0f;
+            const Vec3 radius(0.3f + next(), 0.3f + next() * 2.0f, 0.3f + next());
+            for (u32 first = 0; first < store.size(); first += COLLISION_LANES)
+            {
+                const u32 count = std::min(COLLISION_LANES, store.size() - first);
+                const u32 mask = store.planeCandidates(first, count, from, to, radius);
+                for (u32 lane = 0; lane < count; lane++)
+                {
+                    const u32 i = first + lane;
+                    const float d0 = store.nx[i] * from.x + store.ny[i] * from.y + store.nz[i] * from.z + store.d[i];
+                    const float d1 = store.nx[i] * to.x + store.ny[i] * to.y + store.nz[i] * to.z + store.d[i];
+                    const Vec3 scaled(store.nx[i] * radius.x, store.ny[i] * radius.y, store.nz[i] * radius.z);
+                    const float reach = scaled.length();
+                    // Longe das fronteiras, onde a folga e o arredondamento nao contam
+                    const bool out = (d0 > reach * 1.01f && d1 > reach * 1.01f) ||
+                                     (d0 < -reach * 1.01f && d1 < -reach * 1.01f);
+                    const bool in = !((d0 > reach * 0.99f && d1 > reach * 0.99f) ||
+                                      (d0 < -reach * 0.99f && d1 < -reach * 0.99f));
+                    const bool candidate = (mask >> lane) & 1u;
+                    if ((out && candidate) || (in && !candidate))
+                        mismatches++;
+                    rejected += candidate ? 0 : 1;
+                    total++;
+                }
+            }
+        }
+        ASSERT_TRUE(mismatches == 0 && rejected > total / 2);
+    }
+}
+
+void BenchCollisionBVH()
+{
+    std::cout << std::endl
+              << "--- Collision BVH benchmark ---" << std::endl;
+
+    std::vector<Triangle> triangles;
+    BuildCollisionLevel(300, 20000, triangles);
+    std::vector<Vec3> origins, directions;
+    BuildTestRays(300, 2000, origins, directions);
+
+    Timer buildTimer;
+    CollisionSystem world;
+    world.addTriangles(triangles);
+    CollisionInfo warm;
+    world.rayCast(origins[0], directions[0], 1.0f, warm);
+    const double buildMs = buildTimer.Elapsed();
+
+    Timer linearTimer;
+    u32 linearHits = 0;
+    for (u32 i = 0; i < 200; i++)
+    {
+        float t;
+        linearHits += ReferenceRayCast(triangles, origins[i], directions[i], 100.0f, t) ? 1 : 0;
+    }
+    const double linearMs = linearTimer.Elapsed() * (double)origins.size() / 200.0;
+
+    Timer rayTimer;
+    u32 hits = 0;
+    for (size_t i = 0; i < origins.size(); i++)
+    {
+        CollisionInfo info;
+        hits += world.rayCast(origins[i], directions[i], 100.0f, info) ? 1 : 0;
+    }
+    const double rayMs = rayTimer.Elapsed();
+
+    Timer slideTimer;
+    volatile float keep = 0.0f;
+    for (u32 i = 0; i < 500; i++)
+    {
+        bool grounded;
+        const Vec3 p = world.sphereSlide(origins[i], Vec3(0.3f, 0.0f, 0.2f), 0.5f, Vec3(0, -0.3f, 0), grounded);
+        keep = keep + p.y;
+    }
+    const double slideMs = slideTimer.Elapsed();
+
+    Timer castTimer;
+    u32 castHits = 0;
+    for (size_t i = 0; i < origins.size(); i++)
+    {
+        CollisionInfo info;
+        castHits += world.sphereCast(origins[i], directions[i], 0.5f, 100.0f, info) ? 1 : 0;
+    }
+    const double castMs = castTimer.Elapsed();
+    (void)keep;
+
+    std::cout << "  " << triangles.size() << " triangles, build " << buildMs << " ms" << std::endl;
+    std::cout << "  " << origins.size() << " rays: linear ~" << linearMs << " ms, BVH " << rayMs << " ms ("
+              << linearMs / std::max(rayMs, 1e-3) << "x, " << hits << " hits, " << linearHits << "/200 linear)"
+              << std::endl;
+    std::cout << "  500 slides with gravity (" << CollisionTriangles::getKernelName() << " plane reject): " << slideMs
+              << " ms" << std::endl;
+    std::cout << "  " << origins.size() << " sphere casts (r 0.5): " << castMs << " ms, " << castHits << " hits"
+              << std::endl;
+}
+
+// Leque de rays a partir de um ponto, linha a linha: pacotes coerentes
+void BuildCameraRays(int size, u32 width, u32 height, std::vector<Ray> &rays)
+{
+    const Vec3 eye(size * 0.5f, 12.0f, -2.0f);
+    rays.clear();
+    for (u32 y = 0; y < height; y++)
+    {
+        for (u32 x = 0; x < width; x++)
+        {
+            const float u = (float)x / width - 0.5f, v = (float)y / height;
+            rays.push_back(Ray(eye, Vec3(u * 1.2f, -0.1f - v * 0.8f, 1.0f)));
+        }
+    }
+}
+
+void TestCollisionRayBatch()
+{
+    std::cout << std::endl
+              << "--- Collision ray batch ---" << std::endl;
+
+    std::vector<Triangle> triangles;
+    BuildCollisionLevel(40, 500, triangles);
+    CollisionSystem world;
+    world.addTriangles(triangles);
+
+    // Rays soltos (pacotes incoerentes) e um leque (pacotes coerentes);
+    // 2003 e 1601 deixam um ultimo pacote incompleto
+    std::vector<Vec3> origins, directions;
+    BuildTestRays(40, 2003, origins, directions);
+    std::vector<Ray> scattered, camera;
+    for (size_t i = 0; i < origins.size(); i++)
+        scattered.push_back(Ray(origins[i], directions[i]));
+    BuildCameraRays(40, 67, 24, camera);
+    camera.push_back(camera[100]);
+
+    auto countMismatches = [&](const std::vector<Ray> &rays, const std::vector<RayHit> &hits, u32 &outHits)
+    {
+        u32 mismatches = 0;
+        outHits = 0;
+        for (size_t i = 0; i < rays.size(); i++)
+        {
+            CollisionInfo info;
+            const bool found = world.rayCast(rays[i].origin, rays[i].direction, 100.0f, info);
+            if (found != hits[i].hit || (found && std::fabs(info.nearestDistance - hits[i].t) > 1e-4f))
+                mismatches++;
+            else if (found && (hits[i].point - info.intersectionPoint).length() > 1e-3f)
+                mismatches++;
+            outHits += found ? 1 : 0;
+        }
+        return mismatches;
+    };
+
+    TEST("Batch matches single rays (scattered)");
+    {
+        std::vector<RayHit> hits;
+        world.rayCastBatch(scattered, 100.0f, hits);
+        u32 found = 0;
+        const u32 mismatches = countMismatches(scattered, hits, found);
+        ASSERT_TRUE(hits.size() == scattered.size() && mismatches == 0 && found > scattered.size() / 2);
+    }
+
+    TEST("Batch matches single rays (camera fan)");
+    {
+        std::vector<RayHit> hits;
+        world.rayCastBatch(camera, 100.0f, hits);
+        u32 found = 0;
+        const u32 mismatches = countMismatches(camera, hits, found);
+        ASSERT_TRUE(mismatches == 0 && found > camera.size() / 2);
+    }
+
+    TEST("Batch hit carries triangle and normal");
+    {
+        std::vector<RayHit> hits;
+        world.rayCastBatch(camera, 100.0f, hits);
+        bool ok = true;
+        for (const RayHit &hit : hits)
+        {
+            if (!hit.hit)
+                continue;
+            ok = ok && hit.triangle && (hit.normal - hit.triangle->getNormal()).length() < 1e-4f;
+        }
+        ASSERT_TRUE(ok);
+    }
+
+    TEST("Batch on 4 workers gives the same hits");
+    {
+        std::vector<RayHit> serial, parallel;
+        world.rayCastBatch(scattered, 100.0f, serial);
+        JobSystem &jobs = JobSystem::Instance();
+        jobs.SetWorkerCount(4);
+        world.rayCastBatch(scattered, 100.0f, parallel);
+        jobs.SetWorkerCount(0);
+        bool same = true;
+        for (size_t i = 0; i < serial.size(); i++)
+            same = same && serial[i].hit == parallel[i].hit && serial[i].t == parallel[i].t;
+        ASSERT_TRUE(same);
+    }
+
+    TEST("Batch on an empty world misses");
+    {
+        CollisionSystem empty;
+        std::vector<RayHit> hits;
+        empty.rayCastBatch(camera, 100.0f, hits);
+        bool none = hits.size() == camera.size();
+        for (const RayHit &hit : hits)
+            none = none && !hit.hit;
+        ASSERT_TRUE(none);
+    }
+}
+
+void BenchCollisionRayBatch()
+{
+    std::cout << std::endl
+              << "--- Collision ray batch benchmark ---" << std::endl;
+
+    std::vector<Triangle> triangles;
+    BuildCollisionLevel(300, 20000, triangles);
+    CollisionSystem world;
+    world.addTriangles(triangles);
+
+    std::vector<Vec3> origins, directions;
+    BuildTestRays(300, 20000, origins, directions);
+    std::vector<Ray> scattered, camera;
+    for (size_t i = 0; i < origins.size(); i++)
+        scattered.push_back(Ray(origins[i], directions[i]));
+    BuildCameraRays(300, 200, 100, camera);
+
+    std::vector<RayHit> hits;
+    world.rayCastBatch(camera, 1.0f, hits);
+
+    auto bench = [&](const char *name, const std::vector<Ray> &rays)
+    {
+        Timer singleTimer;
+        u32 singleHits = 0;
+        for (const Ray &ray : rays)
+        {
+            CollisionInfo info;
+            singleHits += world.rayCast(ray.origin, ray.direction, 100.0f, info) ? 1 : 0;
+        }
+        const double singleMs = singleTimer.Elapsed();
+
+        Timer batchTimer;
+        world.rayCastBatch(rays, 100.0f, hits);
+        const double batchMs = batchTimer.Elapsed();
+        u32 batchHits = 0;
+        for (const RayHit &hit : hits)
+            batchHits += hit.hit ? 1 : 0;
+
+        const double mrays = (double)rays.size() / std::max(batchMs, 1e-3) / 1000.0;
+        std::cout << "  " << rays.size() << " " << name << " rays: single " << singleMs << " ms, batch " << batchMs
+                  << " ms (" << singleMs / std::max(batchMs, 1e-3) << "x, " << mrays << " Mrays/s, " << batchHits
+                  << "/" << singleHits << " hits)" << std::endl;
+    };
+
+    std::cout << "  " << triangles.size() << " triangles, " << CollisionTriangles::getKernelName() << " packets"
+              << std::endl;
+    bench("camera", camera);
+    bench("scattered", scattered);
+}
+
+// Menor distancia de p a todos os triangulos (scan linear)
+float ReferenceDistance(const std::vector<Triangle> &triangles, const Vec3 &p)
+{
+    float best = FLT_MAX;
+    for (const Triangle &tri : triangles)
+        best = std::min(best, (tri.closestPoint(p) - p).length());
+    return best;
+}
+
+void TestSphereCast()
+{
+    std::cout << std::endl
+              << "--- Sphere cast ---" << std::endl;
+
+    TEST("Sphere cast lands on the floor");
+    {
+        CollisionSystem world;
+        world.addTriangle(Triangle(Vec3(-10, 0, -10), Vec3(-10, 0, 10), Vec3(10, 0, 10)));
+        world.addTriangle(Triangle(Vec3(-10, 0, -10), Vec3(10, 0, 10), Vec3(10, 0, -10)));
+        CollisionInfo info;
+        const bool hit = world.sphereCast(Vec3(1, 5, 2), Vec3(0, -1, 0), 0.5f, 10.0f, info);
+        ASSERT_TRUE(hit && std::fabs(info.nearestDistance - 4.5f) < 1e-3f && std::fabs(info.intersectionPoint.y) < 1e-3f &&
+                    info.intersectionNormal.y > 0.999f);
+    }
+
+    TEST("Sphere cast catches an edge the ray misses");
+    {
+        // Parede fina em x = 5 com a aresta de cima em y = 1; o centro
+        // passa 0.3 acima, a sphere de raio 0.5 toca a aresta em x = 4.6
+        CollisionSystem world;
+        world.addTriangle(Triangle(Vec3(5, -1, -3), Vec3(5, 1, -3), Vec3(5, 1, 3)));
+        world.addTriangle(Triangle(Vec3(5, -1, -3), Vec3(5, 1, 3), Vec3(5, -1, 3)));
+        CollisionInfo ray, sphere;
+        const bool rayHit = world.rayCast(Vec3(0, 1.3f, 0), Vec3(1, 0, 0), 10.0f, ray);
+        const bool sphereHit = world.sphereCast(Vec3(0, 1.3f, 0), Vec3(1, 0, 0), 0.5f, 10.0f, sphere);
+        const Vec3 expectedNormal(-0.8f, 0.6f, 0.0f);
+        ASSERT_TRUE(!rayHit && sphereHit && std::fabs(sphere.nearestDistance - 4.6f) < 1e-3f &&
+                    (sphere.intersectionNormal - expectedNormal).length() < 1e-3f &&
+                    std::fabs(sphere.intersectionPoint.y - 1.0f) < 1e-3f);
+    }
+
+    TEST("Sphere cast misses past the end of the sweep");
+    {
+        CollisionSystem world;
+        world.addTriangle(Triangle(Vec3(5, -1, -3), Vec3(5, 1, -3), Vec3(5, 1, 3)));
+        CollisionInfo info;
+        ASSERT_TRUE(!world.sphereCast(Vec3(0, 0, 0), Vec3(2, 0, 0), 0.5f, 4.0f, info) && !info.foundCollision);
+    }
+
+    TEST("Sphere cast stops at first contact (random level)");
+    {
+        std::vector<Triangle> triangles;
+        BuildCollisionLevel(12, 120, triangles);
+        CollisionSystem world;
+        world.addTriangles(triangles);
+
+        u32 state = 31;
+        auto next = [&state]()
+        {
+            state = state * 1664525u + 1013904223u;
+            return (float)(state >> 8) / 16777216.0f;
+        };
+
+        u32 bad = 0, hits = 0;
+        for (int i = 0; i < 150; i++)
+        {
+            const float radius = 0.2f + next() * 0.6f;
+            const Vec3 origin(next() * 12.0f, 3.0f + next() * 4.0f, next() * 12.0f);
+            if (ReferenceDistance(triangles, origin) < radius * 1.01f)
+                continue;
+            const Vec3 direction = Vec3(next() - 0.5f, -next(), next() - 0.5f).normalized();
+            CollisionInfo info;
+            if (world.sphereCast(origin, direction, radius, 8.0f, info))
+            {
+                hits++;
+                const Vec3 center = origin + direction * info.nearestDistance;
+                const Vec3 before = origin + direction * std::max(0.0f, info.nearestDistance - 0.01f);
+                // Toca no ponto reportado e antes disso nao tocava em nada
+                if (std::fabs((center - info.intersectionPoint).length() - radius) > 2e-3f ||
+                    ReferenceDistance(triangles, before) < radius - 1e-3f ||
+                    std::fabs(ReferenceDistance(triangles, center) - radius) > 2e-3f)
+                    bad++;
+            }
+            else
+            {
+                for (int step = 0; step <= 16; step++)
+                {
+                    if (ReferenceDistance(triangles, origin + direction * (8.0f * step / 16.0f)) < radius - 1e-3f)
+                    {
+                        bad++;
+                        break;
+                    }
+                }
+            }
+        }
+        ASSERT_TRUE(bad == 0 && hits > 50);
+    }
+}
+
+// Agentes espalhados por cima do nivel, a andar e com raios variados
+void BuildAgents(int size, u32 count, std::vector<Vec3> &positions, std::vector<Vec3> &velocities,
+                 std::vector<Vec3> &radii, std::vector<Vec3> &gravity)
+{
+    u32 state = 2024;
+    auto next = [&state]()
+    {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) / 16777216.0f;
+    };
+    positions.resize(count);
+    velocities.resize(count);
+    radii.resize(count);
+    gravity.assign(count, Vec3(0, -0.3f, 0));
+    for (u32 i = 0; i < count; i++)
+    {
+        positions[i] = Vec3(next() * size, 1.0f + next() * 3.0f, next() * size);
+        velocities[i] = Vec3(next() - 0.5f, 0.0f, next() - 0.5f) * 0.6f;
+        const float r = 0.3f + next() * 0.4f;
+        radii[i] = i % 3 ? Vec3(r, r, r) : Vec3(r, r * 2.0f, r);
+    }
+}
+
+void TestCollisionBatchSlide()
+{
+    std::cout << std::endl
+              << "--- Collision batch slide ---" << std::endl;
+
+    std::vector<Triangle> triangles;
+    BuildCollisionLevel(30, 400, triangles);
+    CollisionSystem world;
+    world.addTriangles(triangles);
+
+    std::vector<Vec3> positions, velocities, radii, gravity;
+    BuildAgents(30, 300, positions, velocities, radii, gravity);
+
+    std::vector<Vec3> expected(positions.size());
+    std::vector<u8> expectedGrounded(positions.size());
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        bool grounded;
+        expected[i] = world.collideAndSlide(positions[i], velocities[i], radii[i], gravity[i], grounded);
+        expectedGrounded[i] = grounded ? 1 : 0;
+    }
+
+    TEST("Batch slide matches one agent at a time");
+    {
+        std::vector<Vec3> result(positions.size());
+        std::vector<u8> grounded(positions.size(), 7);
+        world.collideAndSlideBatch((u32)positions.size(), positions.data(), velocities.data(), radii.data(),
+                                   gravity.data(), result.data(), grounded.data());
+        bool same = true;
+        u32 onGround = 0;
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            same = same && result[i] == expected[i] && grounded[i] == expectedGrounded[i];
+            onGround += grounded[i];
+        }
+        ASSERT_TRUE(same && onGround > 0);
+    }
+
+    TEST("Batch slide on 4 workers, in place");
+    {
+        JobSystem &jobs = JobSystem::Instance();
+        jobs.SetWorkerCount(4);
+        std::vector<Vec3> inPlace = positions;
+        std::vector<u8> grounded(positions.size(), 7);
+        world.collideAndSlideBatch((u32)inPlace.size(), inPlace.data(), velocities.data(), radii.data(),
+                                   gravity.data(), inPlace.data(), grounded.data());
+        jobs.SetWorkerCount(0);
+        bool same = true;
+        for (size_t i = 0; i < positions.size(); i++)
+            same = same && inPlace[i] == expected[i] && grounded[i] == expectedGrounded[i];
+        ASSERT_TRUE(same);
+    }
+
+    TEST("Batch slide without gravity or grounded output");
+    {
+        std::vector<Vec3> result(positions.size());
+        world.collideAndSlideBatch((u32)positions.size(), positions.data(), velocities.data(), radii.data(), nullptr,
+                                   result.data(), nullptr);
+        bool same = true;
+        for (size_t i = 0; i < positions.size(); i++)
+            same = same && result[i] == world.collideAndSlide(positions[i], velocities[i], radii[i]);
+        ASSERT_TRUE(same);
+    }
+}
+
+void BenchCollisionBatchSlide()
+{
+    std::cout << std::endl
+              << "--- Collision batch slide benchmark ---" << std::endl;
+
+    std::vector<Triangle> triangles;
+    BuildCollisionLevel(300, 20000, triangles);
+    CollisionSystem world;
+    world.addTriangles(triangles);
+
+    std::vector<Vec3> positions, velocities, radii, gravity;
+    BuildAgents(300, 500, positions, velocities, radii, gravity);
+    std::vector<Vec3> result(positions.size());
+    std::vector<u8> grounded(positions.size());
+    world.collideAndSlideBatch(1, positions.data(), velocities.data(), radii.data(), gravity.data(), result.data(),
+                               grounded.data());
+
+    const int frames = 20;
+    Timer loopTimer;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            bool onGround;
+            result[i] = world.collideAndSlide(positions[i], velocities[i], radii[i], gravity[i], onGround);
+            grounded[i] = onGround ? 1 : 0;
+        }
+    }
+    const double loopMs = loopTimer.Elapsed() / frames;
+
+    JobSystem &jobs = JobSystem::Instance();
+    std::cout << "  " << positions.size() << " agents, " << triangles.size() << " triangles, loop " << loopMs
+              << " ms/frame" << std::endl;
+    const u32 workerCounts[] = {1, 2, 4};
+    for (u32 workers : workerCounts)
+    {
+        jobs.SetWorkerCount(workers);
+        Timer batchTimer;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            world.collideAndSlideBatch((u32)positions.size(), positions.data(), velocities.data(), radii.data(),
+                                       gravity.data(), result.data(), grounded.data());
+        }
+        const double batchMs = batchTimer.Elapsed() / frames;
+        std::cout << "  batch on " << workers << " workers: " << batchMs << " ms/frame ("
+                  << loopMs / std::max(batchMs, 1e-3) << "x)" << std::endl;
+    }
+    jobs.SetWorkerCount(0);
+}
+
+int main()
+{
+    std::cout << "=== Mesh Test Suite ===" << std::endl
+              << std::endl;
+
+    NullGL::Install();
+
+    TestWeld();
+    TestVertexCache();
+    TestVertexFetch();
+    TestOverdraw();
+    TestSimplify();
+    TestMeshlets();
+    TestQuantization();
+    TestTangents();
+    TestBounds();
+    TestNormals();
+    TestIndices();
+    TestBonePalette();
+    TestSkinning();
+    TestKeyframeCursor();
+    TestClipCompression();
+    TestBakedPose();
+    TestAnimatorBlend();
+    TestSkeletonInstance();
+    TestAnimationLibrary("assets/idle.anim");
+    TestCollisionBVH();
+    TestCollisionTriangles();
+    TestCollisionRayBatch();
+    TestSphereCast();
+    TestCollisionBatchSlide();
+
+    std::cout << std::endl
+              << "--- Benchmarks ---" << std::endl;
+    BenchWeld();
+    BenchVertexCache("assets/idle.mesh");
+    BenchVertexFetch("assets/idle.mesh");
+    BenchSimplify("assets/idle.mesh");
+    BenchMeshlets("assets/idle.mesh");
+    BenchQuantization("assets/idle.mesh");
+    BenchTangents("assets/idle.mesh");
+    BenchNormals("assets/idle.mesh");
+    BenchIndices("assets/idle.mesh");
+    BenchBonePalette();
+    BenchSkinning("assets/idle.mesh");
+    BenchCrowdSkinning("assets/idle.mesh");
+    BenchKeyframeCursor("assets/idle.anim");
+    BenchKeyframeCursor("assets/fish.anim");
+    BenchClipCompression("assets/idle.anim");
+    BenchClipCompression("assets/fish.anim");
+    BenchBakedPose("assets/idle.anim");
+    BenchCollisionBVH();
+    BenchCollisionRayBatch();
+    BenchCollisionBatchSlide();
+
+    std::cout << std::endl;
+    std::cout << "==========================" << std::endl;
+    std::cout << "Tests Passed: " << TestsPassed << std::endl;
+    std::cout << "Tests Failed: " << TestsFailed << std::endl;
+    std::cout << "==========================" << std::endl;
+
+    return TestsFailed > 0 ? 1 : 0;
+}